@@ -1,13 +1,7 @@
 #version 450
 #extension GL_ARB_separate_shader_objects : enable
 
-struct Vertex
-{
-	vec4 Position;
-	vec4 Normal;
-	vec4 Tangent;
-	vec4 TexCoord;
-};
+#include "vertexFormat.glsl"
 
 struct MaterialParameters
 {
@@ -70,9 +64,10 @@ void main()
 	mat4 currTransform = u_Transforms.t[constants.TransformsIndex].CurrTransform;
 	mat4 prevTransform = u_Transforms.t[constants.TransformsIndex].PrevTransform;
 
-	vec3 position 				= vertices[gl_VertexIndex].Position.xyz;
-    vec3 normal 				= vertices[gl_VertexIndex].Normal.xyz;
-	vec3 tangent 				= vertices[gl_VertexIndex].Tangent.xyz;
+	Vertex vertex 				= vertices[gl_VertexIndex];
+	vec3 position 				= getVertexPosition(vertex);
+    vec3 normal 				= getVertexNormal(vertex);
+	vec3 tangent 				= getVertexTangent(vertex);
 	vec4 worldPosition 			= currTransform * vec4(position, 1.0);
 	vec4 prevWorldPosition 		= prevTransform * vec4(position, 1.0);
 
@@ -80,7 +75,7 @@ void main()
 	tangent = normalize((currTransform * vec4(tangent, 0.0)).xyz);
 
 	vec3 bitangent 	= normalize(cross(normal, tangent));
-	vec2 texCoord 	= vertices[gl_VertexIndex].TexCoord.xy;
+	vec2 texCoord 	= getVertexTexCoord(vertex);
 
 	vec4 viewPosition 		= g_PerFrame.View 		* worldPosition;
 	vec4 prevViewPosition 	= g_PerFrame.LastView 	* prevWorldPosition;
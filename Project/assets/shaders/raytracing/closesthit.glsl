@@ -3,6 +3,7 @@
 #extension GL_EXT_nonuniform_qualifier : enable
 
 #include "../helpers.glsl"
+#include "../vertexFormat.glsl"
 
 struct RayPayload
 {
@@ -15,14 +16,6 @@ struct ShadowRayPayload
 	float Distance;
 };
 
-struct Vertex
-{
-	vec4 Position;
-	vec4 Normal;
-	vec4 Tangent;
-	vec4 TexCoord;
-};
-
 struct MaterialParameters
 {
 	vec4 Albedo;
@@ -113,7 +106,7 @@ void calculateTriangleData(out uint materialIndex, out vec2 texCoords, out vec3
 
 	const vec3 barycentricCoords = vec3(1.0f - attribs.x - attribs.y, attribs.x, attribs.y);
 
-	texCoords = (v0.TexCoord.xy * barycentricCoords.x + v1.TexCoord.xy * barycentricCoords.y + v2.TexCoord.xy * barycentricCoords.z);
+	texCoords = (getVertexTexCoord(v0) * barycentricCoords.x + getVertexTexCoord(v1) * barycentricCoords.y + getVertexTexCoord(v2) * barycentricCoords.z);
 
 	mat4 transform;
 	transform[0] = vec4(gl_ObjectToWorldNV[0], 0.0f);
@@ -121,8 +114,8 @@ void calculateTriangleData(out uint materialIndex, out vec2 texCoords, out vec3
 	transform[2] = vec4(gl_ObjectToWorldNV[2], 0.0f);
 	transform[3] = vec4(gl_ObjectToWorldNV[3], 1.0f);
 
-	vec3 T = normalize(v0.Tangent.xyz * barycentricCoords.x + v1.Tangent.xyz * barycentricCoords.y + v2.Tangent.xyz * barycentricCoords.z);
-	vec3 N  = normalize(v0.Normal.xyz * barycentricCoords.x + v1.Normal.xyz * barycentricCoords.y + v2.Normal.xyz * barycentricCoords.z);
+	vec3 T = normalize(getVertexTangent(v0) * barycentricCoords.x + getVertexTangent(v1) * barycentricCoords.y + getVertexTangent(v2) * barycentricCoords.z);
+	vec3 N  = normalize(getVertexNormal(v0) * barycentricCoords.x + getVertexNormal(v1) * barycentricCoords.y + getVertexNormal(v2) * barycentricCoords.z);
 
 	T = normalize(vec3(transform * vec4(T, 0.0)));
 	N = normalize(vec3(transform * vec4(N, 0.0)));
@@ -1,13 +1,7 @@
 #version 450
 #extension GL_ARB_separate_shader_objects : enable
 
-struct Vertex
-{
-	vec4 Position;
-	vec4 Normal;
-	vec4 Tangent;
-	vec4 TexCoord;
-};
+#include "vertexFormat.glsl"
 
 struct InstanceTransforms
 {
@@ -52,7 +46,7 @@ layout (binding = 9, set = 1) uniform DirectionalLight
 
 void main()
 {
-    vec3 position       = vertices[gl_VertexIndex].Position.xyz;
+    vec3 position       = getVertexPosition(vertices[gl_VertexIndex]);
 	mat4 currTransform  = u_Transforms.t[constants.TransformsIndex].CurrTransform;
 
 	vec4 worldPosition  = currTransform * vec4(position, 1.0);
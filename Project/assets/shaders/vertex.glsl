@@ -1,13 +1,7 @@
 #version 450
 #extension GL_ARB_separate_shader_objects : enable
 
-struct Vertex
-{
-	vec4 Position;
-	vec4 Normal;
-	vec4 Tangent;
-	vec4 TexCoord;
-};
+#include "vertexFormat.glsl"
 
 layout(location = 0) out vec3 out_Normal;
 layout(location = 1) out vec3 out_Tangent;
@@ -34,16 +28,17 @@ layout(binding = 1) buffer vertexBuffer
 
 void main()
 {
-	vec3 position 	= vertices[gl_VertexIndex].Position.xyz;
-    vec3 normal 	= vertices[gl_VertexIndex].Normal.xyz;
-	vec3 tangent 	= vertices[gl_VertexIndex].Tangent.xyz;
+	Vertex vertex 	= vertices[gl_VertexIndex];
+	vec3 position 	= getVertexPosition(vertex);
+    vec3 normal 	= getVertexNormal(vertex);
+	vec3 tangent 	= getVertexTangent(vertex);
 	vec4 worldPosition = g_Constants.Transform * vec4(position, 1.0);
 
 	normal 	= normalize((g_Constants.Transform * vec4(normal, 0.0)).xyz);
 	tangent = normalize((g_Constants.Transform * vec4(tangent, 0.0)).xyz);
 
 	vec3 bitangent 	= normalize(cross(normal, tangent));
-	vec2 texCoord 	= vertices[gl_VertexIndex].TexCoord.xy;
+	vec2 texCoord 	= getVertexTexCoord(vertex);
 
 	out_Normal 		= normal;
 	out_Tangent 	= tangent;
@@ -0,0 +1,77 @@
+
+//Has to match PACKED_VERTICES in src/Core/VertexFormat.h
+#define PACKED_VERTICES 1
+
+#if PACKED_VERTICES
+
+//24 bytes, the position is three floats since a vec3 would be aligned to 16 bytes
+struct Vertex
+{
+	float PositionX;
+	float PositionY;
+	float PositionZ;
+	uint Normal;
+	uint Tangent;
+	uint TexCoord;
+};
+
+vec3 decodeOctahedral(uint encoded)
+{
+	vec2 octahedral = unpackSnorm2x16(encoded);
+	vec3 direction 	= vec3(octahedral, 1.0f - abs(octahedral.x) - abs(octahedral.y));
+	float fold 		= max(-direction.z, 0.0f);
+	direction.xy   += mix(vec2(fold), vec2(-fold), greaterThanEqual(direction.xy, vec2(0.0f)));
+	return normalize(direction);
+}
+
+vec3 getVertexPosition(Vertex vertex)
+{
+	return vec3(vertex.PositionX, vertex.PositionY, vertex.PositionZ);
+}
+
+vec3 getVertexNormal(Vertex vertex)
+{
+	return decodeOctahedral(vertex.Normal);
+}
+
+vec3 getVertexTangent(Vertex vertex)
+{
+	return decodeOctahedral(vertex.Tangent);
+}
+
+vec2 getVertexTexCoord(Vertex vertex)
+{
+	return unpackHalf2x16(vertex.TexCoord);
+}
+
+#else
+
+struct Vertex
+{
+	vec4 Position;
+	vec4 Normal;
+	vec4 Tangent;
+	vec4 TexCoord;
+};
+
+vec3 getVertexPosition(Vertex vertex)
+{
+	return vertex.Position.xyz;
+}
+
+vec3 getVertexNormal(Vertex vertex)
+{
+	return vertex.Normal.xyz;
+}
+
+vec3 getVertexTangent(Vertex vertex)
+{
+	return vertex.Tangent.xyz;
+}
+
+vec2 getVertexTexCoord(Vertex vertex)
+{
+	return vertex.TexCoord.xy;
+}
+
+#endif
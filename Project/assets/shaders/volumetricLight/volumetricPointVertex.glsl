@@ -1,13 +1,7 @@
 #version 450
 #extension GL_ARB_separate_shader_objects : enable
 
-struct Vertex
-{
-	vec4 Position;
-	vec4 Normal;
-	vec4 Tangent;
-	vec4 TexCoord;
-};
+#include "../vertexFormat.glsl"
 
 layout(binding = 0, set = 0) buffer vertexBuffer
 {
@@ -39,7 +33,7 @@ layout(location = 0) out vec3 out_WorldPosition;
 
 void main()
 {
-	vec4 vertPos = vec4(vertices[gl_VertexIndex].Position.xyz, 1.0);
+	vec4 vertPos = vec4(getVertexPosition(vertices[gl_VertexIndex]), 1.0);
 	vec4 worldPosition = g_Light.worldMatrix * vertPos;
 	out_WorldPosition = worldPosition.xyz;
 
@@ -61,6 +61,7 @@ workspace "Vulkan-Project"
 			links
 			{
                 "vulkan-1",
+                "Synchronization",
 			}
 			libdirs
 			{
@@ -1,9 +1,19 @@
 #pragma once
 
+//Replaces the global operator new to count heap allocations, on by default in debug builds
+#ifndef TRACK_ALLOCATIONS
+    #if _DEBUG
+        #define TRACK_ALLOCATIONS 1
+    #else
+        #define TRACK_ALLOCATIONS 0
+    #endif
+#endif
+
 #if defined(_WIN32) && defined(_MSC_VER)
     #include <crtdbg.h>
     #ifndef DBG_NEW
-        #if defined(_DEBUG)
+        //The debug operator new of the CRT can not be replaced, so allocations go through the counted one instead
+        #if defined(_DEBUG) && !TRACK_ALLOCATIONS
             #define DBG_NEW new ( _NORMAL_BLOCK , __FILE__ , __LINE__ )
         #else
             #define DBG_NEW new
@@ -9,6 +9,7 @@ struct BufferParams
 	VkBufferUsageFlags		Usage			= 0;
 	VkMemoryPropertyFlags	MemoryProperty	= 0;
 	bool					IsExclusive		= false;
+	EMemoryCategory			Category		= EMemoryCategory::UNKNOWN;
 };
 
 class IBuffer
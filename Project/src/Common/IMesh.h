@@ -22,4 +22,7 @@ public:
     virtual uint32_t getIndexCount() const = 0;
 
     virtual uint32_t getMeshID() const = 0;
+
+    //False until the vertices and indices have arrived on the GPU, the renderer skips the mesh until then
+    virtual bool isResident() const = 0;
 };
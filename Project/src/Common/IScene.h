@@ -20,13 +20,19 @@ public:
 	virtual void updateMeshesAndGraphicsObjects() = 0;
 	virtual void updateMaterials() = 0;
 
+	//The camera, transforms and lights are double buffered. Updates are only seen by the renderer after commitFrameState,
+	//so the next frame can be updated while the last one is still being recorded
 	virtual void updateCamera(const Camera& camera) = 0;
 
+	//Has to be called while nothing is being rendered
 	virtual uint32_t submitGraphicsObject(const IMesh* pMesh, const Material* pMaterial, const glm::mat4& transform = glm::mat4(1.0f), uint8_t customMask = 0x80) = 0;
 	virtual void updateGraphicsObjectTransform(uint32_t index, const glm::mat4& transform) = 0;
 
 	virtual LightSetup& getLightSetup() = 0;
 
+	//Copies the updated state to the state used for rendering, has to be called while nothing is being rendered
+	virtual void commitFrameState() = 0;
+
 	//Debug
 	virtual void renderUI() = 0;
 	virtual void updateDebugParameters() = 0;
@@ -8,4 +8,7 @@ public:
 
 	virtual bool initFromFile(const std::string& filename, ETextureFormat format, bool generateMips = true) = 0;
 	virtual bool initFromMemory(const void* pData, uint32_t width, uint32_t height, ETextureFormat format, uint32_t usageFlags, bool generateMips = false) = 0;
+
+	//False until the pixels have arrived on the GPU, the renderer uses a placeholder until then
+	virtual bool isResident() const = 0;
 };
\ No newline at end of file
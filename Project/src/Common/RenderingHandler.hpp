@@ -1,5 +1,6 @@
 #pragma once
 #include "Core/Core.h"
+#include "Core/AllocationCounter.h"
 
 #include <thread>
 
@@ -32,6 +33,9 @@ public:
 
     virtual void drawProfilerUI() = 0;
 
+	//Heap allocations made while the last frame was recorded, always zero without TRACK_ALLOCATIONS
+	virtual FrameAllocations getFrameAllocations() const = 0;
+
     virtual void swapBuffers() = 0;
 
     IScene* getScene() { return m_pScene; }
@@ -0,0 +1,267 @@
+#include "AllocationCounter.h"
+
+#include <new>
+#include <atomic>
+#include <cstdlib>
+
+static std::atomic<uint64_t> g_TotalAllocations = 0;
+static thread_local uint64_t g_ThreadAllocations = 0;
+static thread_local AllocationScope* g_pThreadScope = nullptr;
+//The compiler is allowed to remove a new that is deleted right away, storing the pointer here keeps the allocations in verifyCounting
+static void* volatile g_pVerifiedAllocation = nullptr;
+
+uint64_t AllocationCounter::getTotalAllocations()
+{
+	return g_TotalAllocations.load(std::memory_order_relaxed);
+}
+
+uint64_t AllocationCounter::getThreadAllocations()
+{
+	return g_ThreadAllocations;
+}
+
+AllocationScope* AllocationCounter::exchangeScope(AllocationScope* pScope)
+{
+	AllocationScope* pPrevious = g_pThreadScope;
+	g_pThreadScope = pScope;
+	return pPrevious;
+}
+
+void AllocationCounter::countScopeAllocation()
+{
+	//Only the code that opened the scope counts into it, it is never touched by two threads at the same time
+	if (g_pThreadScope)
+	{
+		g_pThreadScope->m_Allocations++;
+	}
+}
+
+AllocationScope::AllocationScope()
+	: m_pParent(AllocationCounter::exchangeScope(this)),
+	m_Allocations(0)
+{
+}
+
+AllocationScope::~AllocationScope()
+{
+	//The scope may be closed on another thread than the one it was opened on
+	AllocationCounter::exchangeScope(m_pParent);
+	if (m_pParent)
+	{
+		m_pParent->m_Allocations += m_Allocations;
+	}
+}
+
+bool AllocationCounter::verifyCounting()
+{
+#if TRACK_ALLOCATIONS
+	struct alignas(64) AlignedObject
+	{
+		uint8_t Data[64];
+	};
+
+	bool counted = true;
+	auto expectAllocation = [&counted](const char* pName, uint64_t startAllocations, void* pMemory)
+	{
+		g_pVerifiedAllocation = pMemory;
+		if (g_ThreadAllocations == startAllocations)
+		{
+			LOG("--- AllocationCounter: '%s' was not counted", pName);
+			counted = false;
+		}
+	};
+
+	uint64_t startAllocations = g_ThreadAllocations;
+	int* pObject = DBG_NEW int(0);
+	expectAllocation("DBG_NEW", startAllocations, pObject);
+	delete pObject;
+
+	startAllocations = g_ThreadAllocations;
+	int* pArray = DBG_NEW int[4];
+	expectAllocation("DBG_NEW[]", startAllocations, pArray);
+	delete[] pArray;
+
+	startAllocations = g_ThreadAllocations;
+	int* pNothrow = new(std::nothrow) int(0);
+	expectAllocation("new(std::nothrow)", startAllocations, pNothrow);
+	delete pNothrow;
+
+	startAllocations = g_ThreadAllocations;
+	AlignedObject* pAligned = DBG_NEW AlignedObject();
+	expectAllocation("Aligned new", startAllocations, pAligned);
+	delete pAligned;
+
+	startAllocations = g_ThreadAllocations;
+	AlignedObject* pAlignedArray = DBG_NEW AlignedObject[2];
+	expectAllocation("Aligned new[]", startAllocations, pAlignedArray);
+	delete[] pAlignedArray;
+
+	g_pVerifiedAllocation = nullptr;
+	return counted;
+#else
+	return false;
+#endif
+}
+
+#if TRACK_ALLOCATIONS
+static FORCEINLINE void countAllocation()
+{
+	g_TotalAllocations.fetch_add(1, std::memory_order_relaxed);
+	g_ThreadAllocations++;
+	AllocationCounter::countScopeAllocation();
+}
+
+static void* tryAllocate(std::size_t size) noexcept
+{
+	countAllocation();
+	return malloc(size > 0 ? size : 1);
+}
+
+static void* tryAllocateAligned(std::size_t size, std::align_val_t alignment) noexcept
+{
+	countAllocation();
+
+#ifdef _WIN32
+	return _aligned_malloc(size > 0 ? size : 1, std::size_t(alignment));
+#else
+	void* pMemory = nullptr;
+	if (posix_memalign(&pMemory, std::max(std::size_t(alignment), sizeof(void*)), size > 0 ? size : 1) != 0)
+	{
+		return nullptr;
+	}
+
+	return pMemory;
+#endif
+}
+
+static void freeAligned(void* pMemory) noexcept
+{
+#ifdef _WIN32
+	_aligned_free(pMemory);
+#else
+	free(pMemory);
+#endif
+}
+
+static void* allocate(std::size_t size)
+{
+	void* pMemory = tryAllocate(size);
+	if (!pMemory)
+	{
+		throw std::bad_alloc();
+	}
+
+	return pMemory;
+}
+
+static void* allocateAligned(std::size_t size, std::align_val_t alignment)
+{
+	void* pMemory = tryAllocateAligned(size, alignment);
+	if (!pMemory)
+	{
+		throw std::bad_alloc();
+	}
+
+	return pMemory;
+}
+
+void* operator new(std::size_t size)
+{
+	return allocate(size);
+}
+
+void* operator new[](std::size_t size)
+{
+	return allocate(size);
+}
+
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept
+{
+	return tryAllocate(size);
+}
+
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept
+{
+	return tryAllocate(size);
+}
+
+void* operator new(std::size_t size, std::align_val_t alignment)
+{
+	return allocateAligned(size, alignment);
+}
+
+void* operator new[](std::size_t size, std::align_val_t alignment)
+{
+	return allocateAligned(size, alignment);
+}
+
+void* operator new(std::size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept
+{
+	return tryAllocateAligned(size, alignment);
+}
+
+void* operator new[](std::size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept
+{
+	return tryAllocateAligned(size, alignment);
+}
+
+void operator delete(void* pMemory) noexcept
+{
+	free(pMemory);
+}
+
+void operator delete[](void* pMemory) noexcept
+{
+	free(pMemory);
+}
+
+void operator delete(void* pMemory, std::size_t) noexcept
+{
+	free(pMemory);
+}
+
+void operator delete[](void* pMemory, std::size_t) noexcept
+{
+	free(pMemory);
+}
+
+void operator delete(void* pMemory, const std::nothrow_t&) noexcept
+{
+	free(pMemory);
+}
+
+void operator delete[](void* pMemory, const std::nothrow_t&) noexcept
+{
+	free(pMemory);
+}
+
+void operator delete(void* pMemory, std::align_val_t) noexcept
+{
+	freeAligned(pMemory);
+}
+
+void operator delete[](void* pMemory, std::align_val_t) noexcept
+{
+	freeAligned(pMemory);
+}
+
+void operator delete(void* pMemory, std::size_t, std::align_val_t) noexcept
+{
+	freeAligned(pMemory);
+}
+
+void operator delete[](void* pMemory, std::size_t, std::align_val_t) noexcept
+{
+	freeAligned(pMemory);
+}
+
+void operator delete(void* pMemory, std::align_val_t, const std::nothrow_t&) noexcept
+{
+	freeAligned(pMemory);
+}
+
+void operator delete[](void* pMemory, std::align_val_t, const std::nothrow_t&) noexcept
+{
+	freeAligned(pMemory);
+}
+#endif
@@ -0,0 +1,54 @@
+#pragma once
+#include "Core.h"
+
+//Heap allocations made while one frame was recorded, split by where they were made
+struct FrameAllocations
+{
+	//The render thread itself, outside of the recording tasks
+	uint64_t RenderThread	= 0;
+	//The render thread while it queued the recording tasks
+	uint64_t TaskDispatch	= 0;
+	//Inside the recording tasks, on the workers or on the render thread while it waited for them
+	uint64_t RecordingTasks	= 0;
+
+	uint64_t getTotal() const { return RenderThread + TaskDispatch + RecordingTasks; }
+};
+
+//Counts the allocations made by the code that opened it until it is closed, also when that code is a task that continues on
+//another worker after a wait. The TaskDispatcher moves the scope along with the fiber and does not count the tasks a thread
+//runs while it waits into it. A closed scope adds its count to the one it was opened inside of
+class AllocationScope
+{
+public:
+	DECL_NO_COPY(AllocationScope);
+
+	AllocationScope();
+	~AllocationScope();
+
+	uint64_t getAllocations() const { return m_Allocations; }
+
+private:
+	AllocationScope* m_pParent;
+	uint64_t m_Allocations;
+
+	friend class AllocationCounter;
+};
+
+class AllocationCounter
+{
+public:
+	DECL_STATIC_CLASS(AllocationCounter);
+
+	//Allocations made by all threads
+	static uint64_t getTotalAllocations();
+	//Allocations made by the calling thread
+	static uint64_t getThreadAllocations();
+
+	//The scope allocations on the calling thread are counted into, the previous one is returned so that it can be put back
+	static AllocationScope* exchangeScope(AllocationScope* pScope);
+	//Called by the replaced operator new
+	static void countScopeAllocation();
+
+	//Makes sure that every form of new the engine uses is counted, the allocation checks can not be trusted otherwise
+	static bool verifyCounting();
+};
@@ -1,7 +1,9 @@
 #include "Application.h"
 #include "Camera.h"
+#include "FrameAllocator.h"
 #include "Input.h"
 #include "TaskDispatcher.h"
+#include "TimelineTracer.h"
 #include "Transform.h"
 
 #include "Common/Profiler.h"
@@ -22,6 +24,8 @@
 #include <thread>
 #include <chrono>
 #include <fstream>
+#include <iterator>
+#include <algorithm>
 
 #include <imgui/imgui.h>
 
@@ -46,6 +50,24 @@ Application* Application::s_pInstance = nullptr;
 constexpr bool	FORCE_RAY_TRACING_OFF	= true;
 constexpr bool	HIGH_RESOLUTION_SPHERE	= false;
 constexpr float CAMERA_PAN_LENGTH		= 10.0f;
+constexpr bool	USE_TASK_FIBERS			= true;
+constexpr uint32_t NUM_BACKGROUND_THREADS	= 2;
+
+struct StreamedTexture
+{
+	const char* pFilename;
+	ETextureFormat Format;
+};
+
+//Loaded over and over on the background pool while a test streams assets
+static const StreamedTexture STREAMED_TEXTURES[] =
+{
+	{ "assets/textures/arches.hdr",			ETextureFormat::FORMAT_R32G32B32A32_FLOAT },
+	{ "assets/textures/gunAlbedo.tga",		ETextureFormat::FORMAT_R8G8B8A8_UNORM },
+	{ "assets/textures/gunNormal.tga",		ETextureFormat::FORMAT_R8G8B8A8_UNORM },
+	{ "assets/textures/gunMetallic.tga",	ETextureFormat::FORMAT_R8G8B8A8_UNORM },
+	{ "assets/textures/gunRoughness.tga",	ETextureFormat::FORMAT_R8G8B8A8_UNORM },
+};
 
 Application::Application()
 	: m_pWindow(nullptr),
@@ -58,6 +80,10 @@ Application::Application()
 	m_pGunMesh(nullptr),
 	m_pGunAlbedo(nullptr),
 	m_pInputHandler(nullptr),
+	m_pStreamingTask(nullptr),
+	m_pStreamedTexture(nullptr),
+	m_StreamedTextureCount(0),
+	m_TimelineCount(0),
 	m_Camera(),
 	m_IsRunning(false),
 	m_UpdateCamera(false),
@@ -80,7 +106,8 @@ void Application::init()
 {
 	LOG("Starting application");
 
-	TaskDispatcher::init();
+	TimelineTracer::setThreadName("Main Thread");
+	TaskDispatcher::init(0, USE_TASK_FIBERS, NUM_BACKGROUND_THREADS);
 
 	//Create window
 	m_pWindow = IWindow::create("Hello Vulkan", 1440, 900);
@@ -112,10 +139,10 @@ void Application::init()
 
 	m_pRenderingHandler->setScene(m_pScene);
 
-	TaskDispatcher::execute([this]
+	TaskDispatcher::execute(Task("Load Scene", [this]
 		{
 			m_pScene->loadFromFile("assets/sponza/", "sponza.obj");
-		});
+		}));
 
 	//Setup lights
 	LightSetup& lightSetup = m_pScene->getLightSetup();
@@ -151,41 +178,41 @@ void Application::init()
 
 	//Load resources
 	ITexture2D* pPanorama = m_pContext->createTexture2D();
-	TaskDispatcher::execute([&]
+	TaskDispatcher::execute(Task("Load Skybox", [&]
 		{
 			pPanorama->initFromFile("assets/textures/arches.hdr", ETextureFormat::FORMAT_R32G32B32A32_FLOAT, false);
 			m_pSkybox = m_pRenderingHandler->generateTextureCube(pPanorama, ETextureFormat::FORMAT_R16G16B16A16_FLOAT, 2048, 1);
-		});
+		}));
 
 	m_pGunMesh = m_pContext->createMesh();
-	TaskDispatcher::execute([&]
+	TaskDispatcher::execute(Task("Load Mesh", [&]
 		{
 			m_pGunMesh->initFromFile("assets/meshes/gun.obj");
-		});
+		}));
 
 	m_pGunAlbedo = m_pContext->createTexture2D();
-	TaskDispatcher::execute([this]
+	TaskDispatcher::execute(Task("Load Texture", [this]
 		{
 			m_pGunAlbedo->initFromFile("assets/textures/gunAlbedo.tga", ETextureFormat::FORMAT_R8G8B8A8_UNORM);
-		});
+		}));
 
 	m_pGunNormal = m_pContext->createTexture2D();
-	TaskDispatcher::execute([this]
+	TaskDispatcher::execute(Task("Load Texture", [this]
 		{
 			m_pGunNormal->initFromFile("assets/textures/gunNormal.tga", ETextureFormat::FORMAT_R8G8B8A8_UNORM);
-		});
+		}));
 
 	m_pGunMetallic = m_pContext->createTexture2D();
-	TaskDispatcher::execute([this]
+	TaskDispatcher::execute(Task("Load Texture", [this]
 		{
 			m_pGunMetallic->initFromFile("assets/textures/gunMetallic.tga", ETextureFormat::FORMAT_R8G8B8A8_UNORM);
-		});
+		}));
 
 	m_pGunRoughness = m_pContext->createTexture2D();
-	TaskDispatcher::execute([this]
+	TaskDispatcher::execute(Task("Load Texture", [this]
 		{
 			m_pGunRoughness->initFromFile("assets/textures/gunRoughness.tga", ETextureFormat::FORMAT_R8G8B8A8_UNORM);
-		});
+		}));
 	
 	//We can set the pointer to the material even if loading happens on another thread
 	m_GunMaterial.setAlbedo(glm::vec4(1.0f));
@@ -283,6 +310,8 @@ void Application::run()
 	//HACK to get a non-null deltatime
 	std::this_thread::sleep_for(std::chrono::milliseconds(16));
 
+	//Recording and submission of the last frame when frames are pipelined
+	TaskGroup renderTask;
 	while (m_IsRunning)
 	{
 		lastTime	= currentTime;
@@ -290,10 +319,34 @@ void Application::run()
 		std::chrono::duration<double, std::milli> deltatime = currentTime - lastTime;
 		double seconds = deltatime.count() / 1000.0;
 
+		//The check has to render every frame, even when the window is in the background
+		const bool renderFrame = m_pWindow->hasFocus() || m_AllocationCheckParameters.Enabled;
+		if (m_ApplicationParameters.PipelinedFrames && renderFrame)
+		{
+			//The scene keeps the update away from the state the last frame is rendered with until it is committed
+			update(seconds);
+			renderTask.wait();
+
+			//Events can resize the swapchain so they are handled when nothing is being rendered
+			m_pWindow->peekEvents();
+			prepareFrame(seconds);
+			renderUI(seconds);
+
+			renderTask = TaskDispatcher::execute(Task("Render Frame", [this, seconds]
+				{
+					render(seconds);
+				}));
+
+			continue;
+		}
+
+		renderTask.wait();
+
 		m_pWindow->peekEvents();
-		if (m_pWindow->hasFocus())
+		if (renderFrame)
 		{
 			update(seconds);
+			prepareFrame(seconds);
 			renderUI(seconds);
 			render(seconds);
 		}
@@ -302,6 +355,8 @@ void Application::run()
 			std::this_thread::sleep_for(std::chrono::milliseconds(16));
 		}
 	}
+
+	renderTask.wait();
 }
 
 void Application::release()
@@ -310,6 +365,7 @@ void Application::release()
 	m_pWindow->removeEventHandler(m_pImgui);
 	m_pWindow->removeEventHandler(this);
 
+	stopAssetStreaming();
 	m_pContext->sync();
 
 	m_GunMaterial.release();
@@ -337,6 +393,15 @@ void Application::release()
 	SAFEDELETE(m_pCameraPositionSpline);
 
 	TaskDispatcher::release();
+	FrameAllocator::release();
+
+	//Everything up until exit is kept when the timeline is being recorded
+	if (TimelineTracer::isEnabled())
+	{
+		TimelineTracer::writeChromeTrace("Results/trace.json");
+	}
+
+	TimelineTracer::release();
 
 	LOG("Exiting Application");
 }
@@ -384,6 +449,10 @@ void Application::onKeyPressed(EKey key)
 	{
 		m_IsRunning = false;
 	}
+	else if (key == EKey::KEY_F5)
+	{
+		dumpTimeline();
+	}
 
 	if (m_KeyInputEnabled)
 	{
@@ -421,8 +490,6 @@ static glm::vec4 g_Color = glm::vec4(1.0f);
 
 void Application::update(double dt)
 {
-	Profiler::progressTimer((float)dt);
-
 	if (!m_TestParameters.Running)
 	{
 		if (m_KeyInputEnabled)
@@ -494,6 +561,11 @@ void Application::update(double dt)
 		m_TestParameters.BestFrametime = deltaTimeMS < m_TestParameters.BestFrametime ? deltaTimeMS : m_TestParameters.BestFrametime;
 		m_TestParameters.Frametimes.push_back(deltaTimeMS);
 
+		if (m_TestParameters.StreamAssets)
+		{
+			updateAssetStreaming();
+		}
+
 		auto& interpolatedPositionPT = m_pCameraPositionSpline->getTangent(m_CameraSplineTimer);
 		glm::vec3 position = interpolatedPositionPT.position;
 		glm::vec3 heading = interpolatedPositionPT.tangent;
@@ -530,6 +602,13 @@ void Application::update(double dt)
 	m_pScene->updateGraphicsObjectTransform(m_GraphicsIndex0, glm::translate(glm::mat4(1.0f), glm::vec3( 0.0f, 1.0f, 0.1f)) * rotation * scale);
 
 	m_pScene->updateCamera(m_Camera);
+}
+
+void Application::prepareFrame(double dt)
+{
+	Profiler::progressTimer((float)dt);
+
+	m_pScene->commitFrameState();
 	m_pScene->updateDebugParameters();
 
 	m_pScene->updateMeshesAndGraphicsObjects();
@@ -605,12 +684,26 @@ void Application::renderUI(double dt)
 			//Graphical Parameters
 
 			m_ApplicationParameters.IsDirty = m_ApplicationParameters.IsDirty || ImGui::SliderInt("Ray Tracing Res. Denom.", &m_ApplicationParameters.RayTracingResolutionDenominator, 1, 8);
+			ImGui::Checkbox("Pipelined Frame Loop", &m_ApplicationParameters.PipelinedFrames);
+
+			bool recordTimeline = TimelineTracer::isEnabled();
+			if (ImGui::Checkbox("Record Timeline", &recordTimeline))
+			{
+				TimelineTracer::setEnabled(recordTimeline);
+			}
+
+			ImGui::SameLine();
+			if (ImGui::Button("Dump Timeline (F5)"))
+			{
+				dumpTimeline();
+			}
 
 			ImGui::NewLine();
 
 			//Test Parameters
 			ImGui::InputText("Test Name", m_TestParameters.TestName, 256);
 			ImGui::SliderInt("Number of Test Rounds", &m_TestParameters.NumRounds, 1, 5);
+			ImGui::Checkbox("Stream Assets During Test", &m_TestParameters.StreamAssets);
 
 			if (ImGui::Button("Start Test"))
 			{
@@ -623,6 +716,7 @@ void Application::renderUI(double dt)
 				m_TestParameters.WorstFrametime = std::numeric_limits<float>::min();
 				m_TestParameters.BestFrametime = std::numeric_limits<float>::max();
 				m_TestParameters.CurrentRound = 0;
+				m_StreamedTextureCount = 0;
 
 				constexpr const uint32_t FRAME_TIMES_RESERVED = 500 * 60 * 2 * 5;
 
@@ -641,9 +735,15 @@ void Application::renderUI(double dt)
 			if (ImGui::Button("Stop Test"))
 			{
 				m_TestParameters.Running = false;
+				stopAssetStreaming();
 			}
 
 			ImGui::Text("Round: %d / %d", m_TestParameters.CurrentRound, m_TestParameters.NumRounds);
+			if (m_TestParameters.StreamAssets)
+			{
+				ImGui::Text("Streamed Textures: %u", m_StreamedTextureCount);
+			}
+
 			ImGui::Text("Average Frametime: %f", m_TestParameters.AverageFrametime);
 			ImGui::Text("Worst Frametime: %f", m_TestParameters.WorstFrametime);
 			ImGui::Text("Best Frametime: %f", m_TestParameters.BestFrametime);
@@ -660,11 +760,110 @@ void Application::render(double dt)
 {
 	UNREFERENCED_PARAMETER(dt);
 	m_pRenderingHandler->render(m_pScene);
+
+	if (m_AllocationCheckParameters.Enabled)
+	{
+		checkFrameAllocations();
+	}
+}
+
+void Application::enableFrameAllocationCheck(uint32_t warmupFrames, uint32_t frameCount)
+{
+	m_AllocationCheckParameters = {};
+	m_AllocationCheckParameters.Enabled			= true;
+	m_AllocationCheckParameters.WarmupFrames	= warmupFrames;
+	m_AllocationCheckParameters.FrameCount		= frameCount;
+
+	LOG("--- Frame allocation check: Recording %u frames after %u warmup frames", frameCount, warmupFrames);
+}
+
+bool Application::hasPassedFrameAllocationCheck() const
+{
+	//Closing the window before all frames were rendered does not count as passing
+	const AllocationCheckParameters& check = m_AllocationCheckParameters;
+	return check.CurrentFrame >= check.WarmupFrames + check.FrameCount && check.FailedFrames == 0;
+}
+
+void Application::checkFrameAllocations()
+{
+	//Pools, arenas and containers grow to fit during the warmup, after that a frame is not allowed to touch the heap
+	AllocationCheckParameters& check = m_AllocationCheckParameters;
+	const uint32_t frame = check.CurrentFrame++;
+	if (frame < check.WarmupFrames)
+	{
+		return;
+	}
+
+	const FrameAllocations allocations = m_pRenderingHandler->getFrameAllocations();
+	if (allocations.getTotal() > 0)
+	{
+		LOG("--- Frame allocation check: Frame %u made %llu allocations (render thread %llu, task dispatch %llu, recording tasks %llu)", frame, (unsigned long long)allocations.getTotal(),
+			(unsigned long long)allocations.RenderThread, (unsigned long long)allocations.TaskDispatch, (unsigned long long)allocations.RecordingTasks);
+		check.FailedFrames++;
+	}
+
+	if (check.CurrentFrame >= check.WarmupFrames + check.FrameCount)
+	{
+		LOG("--- Frame allocation check: %s, %u of %u frames allocated", check.FailedFrames == 0 ? "PASSED" : "FAILED", check.FailedFrames, check.FrameCount);
+		m_IsRunning = false;
+	}
+}
+
+void Application::updateAssetStreaming()
+{
+	//Keeps one texture load in flight on the background pool, the next one starts when the last has finished
+	if (m_pStreamingTask && !m_pStreamingTask->isFinished())
+	{
+		return;
+	}
+
+	//The texture is never used for rendering so it can be deleted as soon as it has loaded
+	SAFEDELETE(m_pStreamingTask);
+	SAFEDELETE(m_pStreamedTexture);
+
+	const StreamedTexture* pStreamed = &STREAMED_TEXTURES[m_StreamedTextureCount % std::size(STREAMED_TEXTURES)];
+	ITexture2D* pTexture = m_pContext->createTexture2D();
+	m_pStreamedTexture = pTexture;
+
+	m_pStreamingTask = DBG_NEW TaskGroup(TaskDispatcher::execute(Task("Stream Texture", [pTexture, pStreamed]
+		{
+			pTexture->initFromFile(pStreamed->pFilename, pStreamed->Format);
+		}), ETaskPriority::BACKGROUND));
+
+	m_StreamedTextureCount++;
+}
+
+void Application::stopAssetStreaming()
+{
+	if (m_pStreamingTask)
+	{
+		m_pStreamingTask->wait();
+		SAFEDELETE(m_pStreamingTask);
+	}
+
+	SAFEDELETE(m_pStreamedTexture);
+}
+
+void Application::dumpTimeline()
+{
+	if (!TimelineTracer::isEnabled())
+	{
+		LOG("Timeline is not being recorded, enable it or start with --trace");
+		return;
+	}
+
+	const std::string filepath = "Results/trace_" + std::to_string(m_TimelineCount) + ".json";
+	if (TimelineTracer::writeChromeTrace(filepath))
+	{
+		LOG("Timeline written to '%s', open it in chrome://tracing", filepath.c_str());
+		m_TimelineCount++;
+	}
 }
 
 void Application::testFinished()
 {
 	m_TestParameters.Running = false;
+	stopAssetStreaming();
 
 	sanitizeString(m_TestParameters.TestName, 256);
 
@@ -688,6 +887,34 @@ void Application::testFinished()
 	}
 
 	fileStream.close();
+
+	//Percentiles shows the stutter that the average hides, like a frame waiting on a texture decode
+	std::vector<float> sortedFrametimes = m_TestParameters.Frametimes;
+	if (sortedFrametimes.empty())
+	{
+		return;
+	}
+
+	std::sort(sortedFrametimes.begin(), sortedFrametimes.end());
+	auto percentile = [&sortedFrametimes](float fraction)
+	{
+		const size_t index = size_t(fraction * float(sortedFrametimes.size() - 1) + 0.5f);
+		return sortedFrametimes[std::min(index, sortedFrametimes.size() - 1)];
+	};
+
+	fileStream.open("Results/test_" + std::string(m_TestParameters.TestName) + "_percentiles.txt");
+	if (fileStream.is_open())
+	{
+		fileStream << "P50\tP90\tP99\tP99.9\tWorst\tStreamed Textures" << std::endl;
+		fileStream << percentile(0.5f) << "\t";
+		fileStream << percentile(0.9f) << "\t";
+		fileStream << percentile(0.99f) << "\t";
+		fileStream << percentile(0.999f) << "\t";
+		fileStream << sortedFrametimes.back() << "\t";
+		fileStream << (m_TestParameters.StreamAssets ? m_StreamedTextureCount : 0) << std::endl;
+	}
+
+	fileStream.close();
 }
 
 void Application::sanitizeString(char string[], uint32_t numCharacters)
@@ -5,8 +5,11 @@
 
 #include <spline_library/splines/uniform_cr_spline.h>
 
+#include <atomic>
+
 class IMesh;
 class IScene;
+class TaskGroup;
 class IImgui;
 class IWindow;
 class IRenderer;
@@ -23,6 +26,8 @@ class Application : public CommonEventHandler
 		bool IsDirty = false;
 
 		int RayTracingResolutionDenominator = 1;
+		//Updates the next frame while the last one is recorded and submitted on a worker
+		bool PipelinedFrames = false;
 	};
 
 	struct TestParameters
@@ -38,6 +43,16 @@ class Application : public CommonEventHandler
 
 		char TestName[256] = "";
 		int NumRounds = 1;
+		bool StreamAssets = false;
+	};
+
+	struct AllocationCheckParameters
+	{
+		bool Enabled = false;
+		uint32_t WarmupFrames = 0;
+		uint32_t FrameCount = 0;
+		uint32_t CurrentFrame = 0;
+		uint32_t FailedFrames = 0;
 	};
 
 public:
@@ -50,6 +65,10 @@ public:
 	void run();
 	void release();
 
+	//Renders frameCount frames after the warmup and stops, every frame that allocated from the heap while it was recorded fails the check
+	void enableFrameAllocationCheck(uint32_t warmupFrames, uint32_t frameCount);
+	bool hasPassedFrameAllocationCheck() const;
+
 	virtual void onWindowClose() override;
 	virtual void onWindowResize(uint32_t width, uint32_t height) override;
 
@@ -63,8 +82,16 @@ public:
 
 private:
 	void update(double dt);
+	void prepareFrame(double dt);
 	void renderUI(double dt);
 	void render(double dt);
+	void checkFrameAllocations();
+
+	void updateAssetStreaming();
+	void stopAssetStreaming();
+
+	//Writes the recorded timeline to Results/trace_<n>.json
+	void dumpTimeline();
 
 	void testFinished();
 	void sanitizeString(char string[], uint32_t numCharacters);
@@ -74,6 +101,7 @@ private:
 	Material				m_GunMaterial;
 	ApplicationParameters	m_ApplicationParameters;
 	TestParameters			m_TestParameters;
+	AllocationCheckParameters	m_AllocationCheckParameters;
 
 	IWindow*			m_pWindow;
 	IGraphicsContext*	m_pContext;
@@ -93,6 +121,11 @@ private:
 
 	ITextureCube* m_pSkybox;
 
+	TaskGroup*	m_pStreamingTask;
+	ITexture2D* m_pStreamedTexture;
+	uint32_t	m_StreamedTextureCount;
+	uint32_t	m_TimelineCount;
+
 	LoopingUniformCRSpline<glm::vec3, float>* m_pCameraPositionSpline;
 	LoopingUniformCRSpline<glm::vec3, float>* m_pCameraDirectionSpline;
 	float m_CameraSplineTimer;
@@ -101,7 +134,8 @@ private:
 	uint32_t m_GraphicsIndex1;
 	uint32_t m_GraphicsIndex2;
 
-	bool m_IsRunning;
+	//The frame allocation check stops the loop from the render task when frames are pipelined
+	std::atomic<bool> m_IsRunning;
 	bool m_UpdateCamera;
 	bool m_KeyInputEnabled;
 	bool m_CameraSplineEnabled;
@@ -0,0 +1,440 @@
+#include "CookedScene.h"
+#include "MeshOptimizer.h"
+#include "TaskDispatcher.h"
+#include "VertexDeduplicator.h"
+
+#include <tinyobjloader/tiny_obj_loader.h>
+
+#include <cstring>
+#include <numeric>
+#include <fstream>
+#include <algorithm>
+#include <filesystem>
+#include <unordered_map>
+
+static uint64_t alignOffset(uint64_t offset, uint64_t alignment)
+{
+	return (offset + alignment - 1) & ~(alignment - 1);
+}
+
+static bool isRangeInside(uint64_t offset, uint64_t sizeInBytes, uint64_t fileSize)
+{
+	return offset <= fileSize && sizeInBytes <= fileSize - offset;
+}
+
+//Builds the vertices and indices of one shape, shapes does not share any vertices so they are built independently
+static void buildShapeGeometry(const tinyobj::attrib_t& attributes, const tinyobj::shape_t& shape, std::vector<Vertex>& vertices, std::vector<uint32_t>& indices, CookedMeshReport& report)
+{
+	//Every index may be a new vertex, so the table never has to grow
+	VertexDeduplicator deduplicator(uint32_t(shape.mesh.indices.size()));
+	indices.reserve(shape.mesh.indices.size());
+
+	for (const tinyobj::index_t& index : shape.mesh.indices)
+	{
+		Vertex vertex = {};
+
+		//Normals and texcoords are optional, while positions are required
+		ASSERT(index.vertex_index >= 0);
+
+		vertex.Position =
+		{
+			attributes.vertices[3 * (size_t)index.vertex_index + 0],
+			attributes.vertices[3 * (size_t)index.vertex_index + 1],
+			attributes.vertices[3 * (size_t)index.vertex_index + 2]
+		};
+
+		if (index.normal_index >= 0)
+		{
+			vertex.Normal =
+			{
+				attributes.normals[3 * (size_t)index.normal_index + 0],
+				attributes.normals[3 * (size_t)index.normal_index + 1],
+				attributes.normals[3 * (size_t)index.normal_index + 2]
+			};
+		}
+
+		if (index.texcoord_index >= 0)
+		{
+			vertex.TexCoord =
+			{
+				attributes.texcoords[2 * (size_t)index.texcoord_index + 0],
+				1.0f - attributes.texcoords[2 * (size_t)index.texcoord_index + 1]
+			};
+		}
+
+		indices.push_back(deduplicator.insert(vertex, vertices));
+	}
+
+	//Calculate tangents
+	for (uint32_t index = 0; index < indices.size(); index += 3)
+	{
+		Vertex& v0 = vertices[indices[(size_t)index + 0]];
+		Vertex& v1 = vertices[indices[(size_t)index + 1]];
+		Vertex& v2 = vertices[indices[(size_t)index + 2]];
+
+		v0.calculateTangent(v1, v2);
+		v1.calculateTangent(v2, v0);
+		v2.calculateTangent(v0, v1);
+	}
+
+	//Reordered after the tangents, since triangles that share a vertex overwrite the tangent of each other in triangle order
+	report.VertexCount	= uint32_t(vertices.size());
+	report.IndexCount	= uint32_t(indices.size());
+	report.Before		= MeshOptimizer::analyzeVertexCache(indices.data(), report.IndexCount, report.VertexCount);
+
+	MeshOptimizer::optimizeVertexCache(indices.data(), report.IndexCount, report.VertexCount);
+	report.VertexCount	= MeshOptimizer::optimizeVertexFetch(vertices, indices.data(), report.IndexCount);
+	report.After		= MeshOptimizer::analyzeVertexCache(indices.data(), report.IndexCount, report.VertexCount);
+}
+
+CookedScene::CookedScene()
+	: m_File(),
+	m_MemoryData(),
+	m_pData(nullptr),
+	m_Size(0),
+	m_pHeader(nullptr),
+	m_pMeshes(nullptr),
+	m_pMaterials(nullptr),
+	m_pTextures(nullptr)
+{
+}
+
+CookedScene::~CookedScene()
+{
+	close();
+}
+
+bool CookedScene::cookFromOBJ(const std::string& dir, const std::string& fileName, std::vector<uint8_t>& fileData, std::vector<CookedMeshReport>* pReports)
+{
+	const std::string sourcePath = dir + fileName;
+
+	tinyobj::attrib_t attributes;
+	std::vector<tinyobj::shape_t> shapes;
+	std::vector<tinyobj::material_t> materials;
+	std::string warn, err;
+
+	if (!tinyobj::LoadObj(&attributes, &shapes, &materials, &warn, &err, sourcePath.c_str(), dir.c_str(), true, false))
+	{
+		LOG("Failed to load scene '%s'. Warning: %s Error: %s", sourcePath.c_str(), warn.c_str(), err.c_str());
+		return false;
+	}
+
+	//Materials that share a texture refer to the same entry in the texture table
+	std::vector<std::string> texturePaths;
+	std::unordered_map<std::string, uint32_t> textureIndices;
+	auto addTexture = [&](const std::string& path) -> uint32_t
+	{
+		if (path.empty())
+		{
+			return COOKED_NO_TEXTURE;
+		}
+
+		auto texture = textureIndices.find(path);
+		if (texture != textureIndices.end())
+		{
+			return texture->second;
+		}
+
+		const uint32_t index = uint32_t(texturePaths.size());
+		textureIndices[path] = index;
+		texturePaths.push_back(path);
+		return index;
+	};
+
+	std::vector<CookedMaterial> cookedMaterials(materials.size());
+	for (uint32_t m = 0; m < materials.size(); m++)
+	{
+		const tinyobj::material_t& material = materials[m];
+
+		CookedMaterial& cookedMaterial = cookedMaterials[m];
+		cookedMaterial.AlbedoMap	= addTexture(material.diffuse_texname);
+		cookedMaterial.NormalMap	= addTexture(material.bump_texname);
+		cookedMaterial.MetallicMap	= addTexture(material.ambient_texname);
+		cookedMaterial.RoughnessMap	= addTexture(material.specular_highlight_texname);
+	}
+
+	//Every shape is a task of its own, and the results are stored per shape so the file is the same for any number of threads.
+	//The largest shapes are queued first so that one of them does not end up last on a worker while the others are idle
+	std::vector<std::vector<Vertex>> shapeVertices(shapes.size());
+	std::vector<std::vector<uint32_t>> shapeIndices(shapes.size());
+	std::vector<CookedMeshReport> reports(shapes.size());
+
+	std::vector<uint32_t> shapeOrder(shapes.size());
+	std::iota(shapeOrder.begin(), shapeOrder.end(), 0);
+	std::stable_sort(shapeOrder.begin(), shapeOrder.end(), [&](uint32_t a, uint32_t b)
+		{
+			return shapes[a].mesh.indices.size() > shapes[b].mesh.indices.size();
+		});
+
+	const ETaskPriority priority = TaskDispatcher::getCurrentPriority();
+
+	TaskGroup group;
+	for (uint32_t s : shapeOrder)
+	{
+		const tinyobj::attrib_t* pAttributes	= &attributes;
+		const tinyobj::shape_t* pShape			= &shapes[s];
+		std::vector<Vertex>* pVertices			= &shapeVertices[s];
+		std::vector<uint32_t>* pIndices			= &shapeIndices[s];
+		CookedMeshReport* pReport				= &reports[s];
+		TaskDispatcher::execute(Task("Import Shape", [=]
+			{
+				buildShapeGeometry(*pAttributes, *pShape, *pVertices, *pIndices, *pReport);
+			}), group, priority);
+	}
+
+	group.wait();
+
+	//Weighted by the number of triangles, so the small meshes does not hide the large ones
+	VertexCacheStatistics before	= {};
+	VertexCacheStatistics after		= {};
+	uint64_t triangleCount	= 0;
+	uint64_t vertexCount	= 0;
+	for (const CookedMeshReport& report : reports)
+	{
+		const float triangles = float(report.IndexCount / 3);
+		before.ACMR	+= report.Before.ACMR * triangles;
+		after.ACMR	+= report.After.ACMR * triangles;
+		before.ATVR	+= report.Before.ATVR * float(report.VertexCount);
+		after.ATVR	+= report.After.ATVR * float(report.VertexCount);
+		triangleCount	+= report.IndexCount / 3;
+		vertexCount		+= report.VertexCount;
+	}
+
+	if (triangleCount > 0 && vertexCount > 0)
+	{
+		LOG("CookedScene: Reordered %u meshes in '%s'. ACMR %.3f -> %.3f, ATVR %.3f -> %.3f", uint32_t(reports.size()), sourcePath.c_str(),
+			before.ACMR / float(triangleCount), after.ACMR / float(triangleCount), before.ATVR / float(vertexCount), after.ATVR / float(vertexCount));
+	}
+
+	if (pReports)
+	{
+		*pReports = std::move(reports);
+	}
+
+	//Tables first, then the strings, then the vertices and indices of every mesh
+	CookedSceneHeader header = {};
+	header.Magic			= COOKED_SCENE_MAGIC;
+	header.Version			= COOKED_SCENE_VERSION;
+	header.VertexSize		= uint32_t(sizeof(GPUVertex));
+	header.MeshCount		= uint32_t(shapes.size());
+	header.MaterialCount	= uint32_t(cookedMaterials.size());
+	header.TextureCount		= uint32_t(texturePaths.size());
+	getSourceStamp(sourcePath, header.SourceSize, header.SourceTime);
+
+	header.MeshesOffset		= alignOffset(sizeof(CookedSceneHeader), 8);
+	header.MaterialsOffset	= alignOffset(header.MeshesOffset + sizeof(CookedMesh) * header.MeshCount, 8);
+	header.TexturesOffset	= alignOffset(header.MaterialsOffset + sizeof(CookedMaterial) * header.MaterialCount, 8);
+
+	uint64_t offset = header.TexturesOffset + sizeof(CookedTexture) * header.TextureCount;
+	std::vector<CookedTexture> cookedTextures(texturePaths.size());
+	for (uint32_t t = 0; t < texturePaths.size(); t++)
+	{
+		cookedTextures[t].PathOffset = offset;
+		cookedTextures[t].PathLength = uint32_t(texturePaths[t].size());
+		offset += texturePaths[t].size() + 1;
+	}
+
+	std::vector<CookedMesh> cookedMeshes(shapes.size());
+	for (uint32_t s = 0; s < shapes.size(); s++)
+	{
+		CookedMesh& cookedMesh = cookedMeshes[s];
+		cookedMesh.VertexCount		= uint32_t(shapeVertices[s].size());
+		cookedMesh.IndexCount		= uint32_t(shapeIndices[s].size());
+		cookedMesh.MaterialIndex	= uint32_t(shapes[s].mesh.material_ids.empty() ? 0 : shapes[s].mesh.material_ids[0] + 1);
+
+		cookedMesh.VerticesOffset	= alignOffset(offset, alignof(GPUVertex));
+		cookedMesh.IndicesOffset	= cookedMesh.VerticesOffset + sizeof(GPUVertex) * cookedMesh.VertexCount;
+		offset = cookedMesh.IndicesOffset + sizeof(uint32_t) * cookedMesh.IndexCount;
+	}
+
+	header.FileSize = offset;
+
+	fileData.assign(size_t(header.FileSize), 0);
+	uint8_t* pData = fileData.data();
+	memcpy(pData, &header, sizeof(CookedSceneHeader));
+	memcpy(pData + header.MeshesOffset, cookedMeshes.data(), sizeof(CookedMesh) * cookedMeshes.size());
+	memcpy(pData + header.MaterialsOffset, cookedMaterials.data(), sizeof(CookedMaterial) * cookedMaterials.size());
+	memcpy(pData + header.TexturesOffset, cookedTextures.data(), sizeof(CookedTexture) * cookedTextures.size());
+
+	for (uint32_t t = 0; t < texturePaths.size(); t++)
+	{
+		memcpy(pData + cookedTextures[t].PathOffset, texturePaths[t].c_str(), texturePaths[t].size() + 1);
+	}
+
+	for (uint32_t s = 0; s < shapes.size(); s++)
+	{
+		encodeVertices(shapeVertices[s].data(), uint32_t(shapeVertices[s].size()), reinterpret_cast<GPUVertex*>(pData + cookedMeshes[s].VerticesOffset));
+		memcpy(pData + cookedMeshes[s].IndicesOffset, shapeIndices[s].data(), sizeof(uint32_t) * shapeIndices[s].size());
+	}
+
+	return true;
+}
+
+bool CookedScene::writeToFile(const std::string& filepath, const std::vector<uint8_t>& fileData)
+{
+	//Written next to the final file and renamed, so a cook that is interrupted never leaves half a file behind
+	const std::string temporaryPath = filepath + ".tmp";
+	{
+		std::ofstream fileStream(temporaryPath, std::ios::binary | std::ios::trunc);
+		if (!fileStream.is_open())
+		{
+			LOG("CookedScene: Failed to open '%s' for writing", temporaryPath.c_str());
+			return false;
+		}
+
+		fileStream.write(reinterpret_cast<const char*>(fileData.data()), std::streamsize(fileData.size()));
+		if (!fileStream.good())
+		{
+			LOG("CookedScene: Failed to write '%s'", temporaryPath.c_str());
+			return false;
+		}
+	}
+
+	std::error_code error;
+	std::filesystem::rename(temporaryPath, filepath, error);
+	if (error)
+	{
+		LOG("CookedScene: Failed to rename '%s'. Error: %s", temporaryPath.c_str(), error.message().c_str());
+		std::filesystem::remove(temporaryPath, error);
+		return false;
+	}
+
+	return true;
+}
+
+bool CookedScene::open(const std::string& filepath, const std::string& sourcePath)
+{
+	close();
+
+	if (!m_File.open(filepath))
+	{
+		return false;
+	}
+
+	m_pData = m_File.getData();
+	m_Size	= m_File.getSize();
+	if (!validate(sourcePath))
+	{
+		close();
+		return false;
+	}
+
+	return true;
+}
+
+bool CookedScene::openFromMemory(std::vector<uint8_t>&& fileData, const std::string& sourcePath)
+{
+	close();
+
+	m_MemoryData	= std::move(fileData);
+	m_pData			= m_MemoryData.data();
+	m_Size			= m_MemoryData.size();
+	if (!validate(sourcePath))
+	{
+		close();
+		return false;
+	}
+
+	return true;
+}
+
+void CookedScene::close()
+{
+	m_File.close();
+	m_MemoryData.clear();
+	m_MemoryData.shrink_to_fit();
+
+	m_pData			= nullptr;
+	m_Size			= 0;
+	m_pHeader		= nullptr;
+	m_pMeshes		= nullptr;
+	m_pMaterials	= nullptr;
+	m_pTextures		= nullptr;
+}
+
+bool CookedScene::validate(const std::string& sourcePath)
+{
+	if (m_Size < sizeof(CookedSceneHeader))
+	{
+		return false;
+	}
+
+	const CookedSceneHeader* pHeader = reinterpret_cast<const CookedSceneHeader*>(m_pData);
+	if (pHeader->Magic != COOKED_SCENE_MAGIC || pHeader->Version != COOKED_SCENE_VERSION || pHeader->VertexSize != sizeof(GPUVertex) || pHeader->FileSize != m_Size)
+	{
+		return false;
+	}
+
+	uint64_t sourceSize = 0;
+	int64_t sourceTime	= 0;
+	getSourceStamp(sourcePath, sourceSize, sourceTime);
+	if ((sourceSize != 0 || sourceTime != 0) && (pHeader->SourceSize != sourceSize || pHeader->SourceTime != sourceTime))
+	{
+		LOG("CookedScene: '%s' has changed since it was cooked", sourcePath.c_str());
+		return false;
+	}
+
+	//Everything is checked once here, so the accessors can hand out pointers into the file without any checks
+	if (!isRangeInside(pHeader->MeshesOffset, sizeof(CookedMesh) * uint64_t(pHeader->MeshCount), m_Size) ||
+		!isRangeInside(pHeader->MaterialsOffset, sizeof(CookedMaterial) * uint64_t(pHeader->MaterialCount), m_Size) ||
+		!isRangeInside(pHeader->TexturesOffset, sizeof(CookedTexture) * uint64_t(pHeader->TextureCount), m_Size))
+	{
+		return false;
+	}
+
+	const CookedMesh* pMeshes = reinterpret_cast<const CookedMesh*>(m_pData + pHeader->MeshesOffset);
+	for (uint32_t m = 0; m < pHeader->MeshCount; m++)
+	{
+		const CookedMesh& mesh = pMeshes[m];
+		if (mesh.VerticesOffset % alignof(GPUVertex) != 0 || mesh.IndicesOffset % alignof(uint32_t) != 0 || mesh.MaterialIndex > pHeader->MaterialCount ||
+			!isRangeInside(mesh.VerticesOffset, sizeof(GPUVertex) * uint64_t(mesh.VertexCount), m_Size) ||
+			!isRangeInside(mesh.IndicesOffset, sizeof(uint32_t) * uint64_t(mesh.IndexCount), m_Size))
+		{
+			return false;
+		}
+	}
+
+	const CookedMaterial* pMaterials = reinterpret_cast<const CookedMaterial*>(m_pData + pHeader->MaterialsOffset);
+	for (uint32_t m = 0; m < pHeader->MaterialCount; m++)
+	{
+		const uint32_t maps[] = { pMaterials[m].AlbedoMap, pMaterials[m].NormalMap, pMaterials[m].MetallicMap, pMaterials[m].RoughnessMap };
+		for (uint32_t map : maps)
+		{
+			if (map != COOKED_NO_TEXTURE && map >= pHeader->TextureCount)
+			{
+				return false;
+			}
+		}
+	}
+
+	const CookedTexture* pTextures = reinterpret_cast<const CookedTexture*>(m_pData + pHeader->TexturesOffset);
+	for (uint32_t t = 0; t < pHeader->TextureCount; t++)
+	{
+		const CookedTexture& texture = pTextures[t];
+		if (!isRangeInside(texture.PathOffset, uint64_t(texture.PathLength) + 1, m_Size) || m_pData[texture.PathOffset + texture.PathLength] != '\0')
+		{
+			return false;
+		}
+	}
+
+	m_pHeader		= pHeader;
+	m_pMeshes		= pMeshes;
+	m_pMaterials	= pMaterials;
+	m_pTextures		= pTextures;
+	return true;
+}
+
+void CookedScene::getSourceStamp(const std::string& sourcePath, uint64_t& size, int64_t& time)
+{
+	std::error_code error;
+	size = std::filesystem::file_size(sourcePath, error);
+	if (error)
+	{
+		size = 0;
+		time = 0;
+		return;
+	}
+
+	const std::filesystem::file_time_type writeTime = std::filesystem::last_write_time(sourcePath, error);
+	time = error ? 0 : int64_t(writeTime.time_since_epoch().count());
+}
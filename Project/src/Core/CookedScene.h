@@ -0,0 +1,122 @@
+#pragma once
+#include "Core.h"
+#include "MappedFile.h"
+#include "MeshOptimizer.h"
+#include "VertexFormat.h"
+
+#include <string>
+#include <vector>
+
+//Bump the version when the layout of the file or the way the OBJ is turned into meshes changes, old files are cooked again
+#define COOKED_SCENE_MAGIC		0x4E435356U
+#define COOKED_SCENE_VERSION	3U
+#define COOKED_SCENE_EXTENSION	".cooked"
+#define COOKED_NO_TEXTURE		0xFFFFFFFFU
+
+//Offsets are in bytes from the start of the file
+struct CookedSceneHeader
+{
+	uint32_t Magic;
+	uint32_t Version;
+	//The vertices are stored encoded the way they are laid out in the geometry buffer, so a file cooked with the other
+	//vertex format is cooked again
+	uint32_t VertexSize;
+	uint32_t MeshCount;
+	uint32_t MaterialCount;
+	uint32_t TextureCount;
+	//Size and modification time of the OBJ it was cooked from
+	uint64_t SourceSize;
+	int64_t SourceTime;
+	uint64_t MeshesOffset;
+	uint64_t MaterialsOffset;
+	uint64_t TexturesOffset;
+	uint64_t FileSize;
+};
+
+struct CookedMesh
+{
+	uint64_t VerticesOffset;
+	uint64_t IndicesOffset;
+	uint32_t VertexCount;
+	uint32_t IndexCount;
+	//Zero is the default material, the materials of the file start at one
+	uint32_t MaterialIndex;
+	uint32_t Padding;
+};
+
+//Indices into the texture table
+struct CookedMaterial
+{
+	uint32_t AlbedoMap;
+	uint32_t NormalMap;
+	uint32_t MetallicMap;
+	uint32_t RoughnessMap;
+};
+
+//Paths are relative to the directory of the scene and null terminated
+struct CookedTexture
+{
+	uint64_t PathOffset;
+	uint32_t PathLength;
+	uint32_t Padding;
+};
+
+//Vertex cache efficiency of a mesh before and after it was reordered during cooking
+struct CookedMeshReport
+{
+	uint32_t VertexCount = 0;
+	uint32_t IndexCount = 0;
+	VertexCacheStatistics Before;
+	VertexCacheStatistics After;
+};
+
+//A scene with the final vertices, indices, materials and texture references, so loading it is only a matter of uploading
+//the data. The OBJ is cooked the first time it is loaded and the file is memory mapped from then on
+class CookedScene
+{
+public:
+	CookedScene();
+	~CookedScene();
+
+	DECL_NO_COPY(CookedScene);
+
+	//Parses the OBJ and builds the contents of a cooked file in memory. The triangles and vertices of every mesh are reordered
+	//for the vertex cache and fetch locality, pReports receives one report per mesh
+	static bool cookFromOBJ(const std::string& dir, const std::string& fileName, std::vector<uint8_t>& fileData, std::vector<CookedMeshReport>* pReports = nullptr);
+	static bool writeToFile(const std::string& filepath, const std::vector<uint8_t>& fileData);
+
+	//Fails when the file is missing, damaged, from another version or cooked from another revision of the source
+	bool open(const std::string& filepath, const std::string& sourcePath);
+	//Uses a cooked file that is kept in memory, when it could not be written to disk
+	bool openFromMemory(std::vector<uint8_t>&& fileData, const std::string& sourcePath);
+	void close();
+
+	FORCEINLINE uint32_t getMeshCount() const		{ return m_pHeader->MeshCount; }
+	FORCEINLINE uint32_t getMaterialCount() const	{ return m_pHeader->MaterialCount; }
+	FORCEINLINE uint32_t getTextureCount() const	{ return m_pHeader->TextureCount; }
+
+	FORCEINLINE const CookedMesh& getMesh(uint32_t index) const				{ return m_pMeshes[index]; }
+	FORCEINLINE const CookedMaterial& getMaterial(uint32_t index) const		{ return m_pMaterials[index]; }
+
+	FORCEINLINE const GPUVertex* getVertices(const CookedMesh& mesh) const	{ return reinterpret_cast<const GPUVertex*>(m_pData + mesh.VerticesOffset); }
+	FORCEINLINE const uint32_t* getIndices(const CookedMesh& mesh) const	{ return reinterpret_cast<const uint32_t*>(m_pData + mesh.IndicesOffset); }
+	FORCEINLINE const char* getTexturePath(uint32_t index) const			{ return reinterpret_cast<const char*>(m_pData + m_pTextures[index].PathOffset); }
+
+	FORCEINLINE size_t getSizeInBytes() const { return m_Size; }
+
+private:
+	bool validate(const std::string& sourcePath);
+
+	//Zero for both when the source can not be found, a cooked file is then used as it is
+	static void getSourceStamp(const std::string& sourcePath, uint64_t& size, int64_t& time);
+
+private:
+	MappedFile m_File;
+	std::vector<uint8_t> m_MemoryData;
+	const uint8_t* m_pData;
+	size_t m_Size;
+	const CookedSceneHeader* m_pHeader;
+	const CookedMesh* m_pMeshes;
+	const CookedMaterial* m_pMaterials;
+	const CookedTexture* m_pTextures;
+};
@@ -60,9 +60,11 @@
 // Compiler macros
 #ifdef _MSC_VER
 	#define FORCEINLINE __forceinline
+	#define NOINLINE	__declspec(noinline)
 #else
 	//TODO: Make sure this is actually a forceinline
 	#define FORCEINLINE inline
+	#define NOINLINE	__attribute__((noinline))
 #endif
 
 // Size macros
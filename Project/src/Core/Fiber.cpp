@@ -0,0 +1,132 @@
+#include "Fiber.h"
+
+#ifdef _WIN32
+	#define WIN32_LEAN_AND_MEAN
+	#include <Windows.h>
+#endif
+
+Fiber::Fiber()
+	: m_pEntry(nullptr),
+	m_pUserData(nullptr),
+	m_IsThread(false),
+#ifdef _WIN32
+	m_pHandle(nullptr)
+#else
+	m_Context(),
+	m_pStack(nullptr)
+#endif
+{
+}
+
+Fiber::~Fiber()
+{
+	release();
+}
+
+bool Fiber::init(FiberEntryFunc pEntry, void* pUserData, size_t stackSize)
+{
+	m_pEntry	= pEntry;
+	m_pUserData = pUserData;
+	m_IsThread	= false;
+
+#ifdef _WIN32
+	m_pHandle = CreateFiber(stackSize, fiberEntry, this);
+	if (!m_pHandle)
+	{
+		LOG("Fiber: CreateFiber failed");
+		return false;
+	}
+#else
+	if (getcontext(&m_Context) != 0)
+	{
+		LOG("Fiber: getcontext failed");
+		return false;
+	}
+
+	m_pStack = DBG_NEW uint8_t[stackSize];
+	m_Context.uc_stack.ss_sp	= m_pStack;
+	m_Context.uc_stack.ss_size	= stackSize;
+	m_Context.uc_link			= nullptr;
+
+	//makecontext only passes ints, so the pointer is split in two
+	const uint64_t address = uint64_t(reinterpret_cast<uintptr_t>(this));
+	makecontext(&m_Context, reinterpret_cast<void(*)()>(fiberEntry), 2, uint32_t(address >> 32), uint32_t(address & 0xffffffff));
+#endif
+
+	return true;
+}
+
+bool Fiber::initFromCurrentThread()
+{
+	m_IsThread = true;
+
+#ifdef _WIN32
+	m_pHandle = ConvertThreadToFiber(nullptr);
+	if (!m_pHandle)
+	{
+		LOG("Fiber: ConvertThreadToFiber failed");
+		return false;
+	}
+#endif
+
+	//The context gets filled in the first time this fiber switches away
+	return true;
+}
+
+void Fiber::release()
+{
+#ifdef _WIN32
+	if (m_pHandle)
+	{
+		if (m_IsThread)
+		{
+			ConvertFiberToThread();
+		}
+		else
+		{
+			DeleteFiber(m_pHandle);
+		}
+
+		m_pHandle = nullptr;
+	}
+#else
+	if (m_pStack)
+	{
+		delete[] m_pStack;
+		m_pStack = nullptr;
+	}
+#endif
+
+	m_IsThread = false;
+}
+
+void Fiber::switchTo(Fiber* pFiber)
+{
+	ASSERT(pFiber != nullptr && pFiber != this);
+
+#ifdef _WIN32
+	SwitchToFiber(pFiber->m_pHandle);
+#else
+	swapcontext(&m_Context, &pFiber->m_Context);
+#endif
+}
+
+#ifdef _WIN32
+void __stdcall Fiber::fiberEntry(void* pParameter)
+{
+	Fiber* pFiber = reinterpret_cast<Fiber*>(pParameter);
+	pFiber->m_pEntry(pFiber->m_pUserData);
+
+	//Returning from a fiber exits the thread
+	ASSERT(false);
+}
+#else
+void Fiber::fiberEntry(uint32_t high, uint32_t low)
+{
+	Fiber* pFiber = reinterpret_cast<Fiber*>(uintptr_t((uint64_t(high) << 32) | uint64_t(low)));
+	pFiber->m_pEntry(pFiber->m_pUserData);
+
+	//uc_link is null so returning would exit the thread
+	ASSERT(false);
+}
+#endif
@@ -0,0 +1,45 @@
+#pragma once
+#include "Core.h"
+
+#ifndef _WIN32
+	#include <ucontext.h>
+#endif
+
+typedef void(*FiberEntryFunc)(void* pUserData);
+
+//Execution context with its own stack, uses Win32 fibers on windows and ucontext everywhere else
+class Fiber
+{
+public:
+	Fiber();
+	~Fiber();
+
+	DECL_NO_COPY(Fiber);
+
+	//Creates a fiber that starts in pEntry the first time it is switched to, pEntry must never return
+	bool init(FiberEntryFunc pEntry, void* pUserData, size_t stackSize);
+	//Turns the calling thread into a fiber so that it can switch to other fibers
+	bool initFromCurrentThread();
+	void release();
+
+	//Has to be called from the fiber that currently runs on the calling thread
+	void switchTo(Fiber* pFiber);
+
+private:
+#ifdef _WIN32
+	static void __stdcall fiberEntry(void* pParameter);
+#else
+	static void fiberEntry(uint32_t high, uint32_t low);
+#endif
+
+private:
+	FiberEntryFunc m_pEntry;
+	void* m_pUserData;
+	bool m_IsThread;
+#ifdef _WIN32
+	void* m_pHandle;
+#else
+	ucontext_t m_Context;
+	uint8_t* m_pStack;
+#endif
+};
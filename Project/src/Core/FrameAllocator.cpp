@@ -0,0 +1,149 @@
+#include "FrameAllocator.h"
+
+#include <mutex>
+#include <cstdlib>
+
+std::atomic<uint64_t>					FrameAllocator::s_Frame = 1;
+FrameAllocator::ThreadArena*			FrameAllocator::s_pArenas[FRAME_ALLOCATOR_MAX_THREADS];
+std::atomic<uint32_t>					FrameAllocator::s_NumArenas = 0;
+thread_local FrameAllocator::ThreadArena*	FrameAllocator::s_pThreadArena = nullptr;
+Spinlock								FrameAllocator::s_ArenaLock;
+
+static size_t alignUp(size_t value, size_t alignment)
+{
+	return (value + alignment - 1) & ~(alignment - 1);
+}
+
+LinearAllocator::LinearAllocator(size_t sizeInBytes)
+	: m_pMemory(nullptr),
+	m_Offset(0),
+	m_Overflow(),
+	m_OverflowBytes(0),
+	m_SizeInBytes(sizeInBytes),
+	m_UsedBytes(0),
+	m_OverflowCount(0)
+{
+	m_pMemory = reinterpret_cast<uint8_t*>(malloc(sizeInBytes));
+}
+
+LinearAllocator::~LinearAllocator()
+{
+	reset();
+
+	::free(m_pMemory);
+	m_pMemory = nullptr;
+}
+
+void* LinearAllocator::allocate(size_t sizeInBytes, size_t alignment)
+{
+	//Both the block and the overflow allocations come from malloc, which is aligned for every fundamental type but not more
+	ASSERT((alignment & (alignment - 1)) == 0 && alignment <= alignof(std::max_align_t));
+
+	const size_t offset = alignUp(m_Offset, alignment);
+	if (offset + sizeInBytes <= m_SizeInBytes.load(std::memory_order_relaxed))
+	{
+		m_Offset = offset + sizeInBytes;
+		m_UsedBytes.store(m_Offset, std::memory_order_relaxed);
+		return m_pMemory + offset;
+	}
+
+	void* pMemory = malloc(sizeInBytes > 0 ? sizeInBytes : 1);
+	m_Overflow.push_back(pMemory);
+	m_OverflowBytes += alignUp(sizeInBytes, alignof(std::max_align_t));
+	m_OverflowCount.fetch_add(1, std::memory_order_relaxed);
+	return pMemory;
+}
+
+void LinearAllocator::reset()
+{
+	for (void* pMemory : m_Overflow)
+	{
+		::free(pMemory);
+	}
+
+	m_Overflow.clear();
+
+	//Grow so that the same frame fits next time, then the render loop stops allocating once it has seen its largest frame
+	if (m_OverflowBytes > 0)
+	{
+		const size_t sizeInBytes = alignUp(m_SizeInBytes.load(std::memory_order_relaxed) + m_OverflowBytes, FRAME_ALLOCATOR_ARENA_SIZE);
+
+		::free(m_pMemory);
+		m_pMemory = reinterpret_cast<uint8_t*>(malloc(sizeInBytes));
+		m_SizeInBytes.store(sizeInBytes, std::memory_order_relaxed);
+		m_OverflowBytes = 0;
+	}
+
+	m_Offset = 0;
+	m_UsedBytes.store(0, std::memory_order_relaxed);
+}
+
+void FrameAllocator::release()
+{
+	std::scoped_lock<Spinlock> lock(s_ArenaLock);
+
+	const uint32_t numArenas = s_NumArenas.load();
+	for (uint32_t i = 0; i < numArenas; i++)
+	{
+		SAFEDELETE(s_pArenas[i]);
+	}
+
+	s_NumArenas		= 0;
+	s_pThreadArena	= nullptr;
+}
+
+void FrameAllocator::beginFrame()
+{
+	s_Frame.fetch_add(1, std::memory_order_relaxed);
+}
+
+void* FrameAllocator::allocate(size_t sizeInBytes, size_t alignment)
+{
+	ThreadArena* pArena = s_pThreadArena;
+	if (!pArena)
+	{
+		pArena = getThreadArena();
+	}
+
+	//The arena is only reset by the thread that owns it
+	const uint64_t frame = s_Frame.load(std::memory_order_relaxed);
+	if (pArena->Frame != frame)
+	{
+		pArena->Allocator.reset();
+		pArena->Frame = frame;
+	}
+
+	return pArena->Allocator.allocate(sizeInBytes, alignment);
+}
+
+FrameAllocatorStatistics FrameAllocator::getStatistics()
+{
+	std::scoped_lock<Spinlock> lock(s_ArenaLock);
+
+	FrameAllocatorStatistics statistics = {};
+	statistics.ThreadCount = s_NumArenas.load();
+	for (uint32_t i = 0; i < statistics.ThreadCount; i++)
+	{
+		const LinearAllocator& allocator = s_pArenas[i]->Allocator;
+		statistics.UsedBytes		+= allocator.getUsedBytes();
+		statistics.ArenaBytes		+= allocator.getSizeInBytes();
+		statistics.OverflowCount	+= allocator.getOverflowCount();
+	}
+
+	return statistics;
+}
+
+FrameAllocator::ThreadArena* FrameAllocator::getThreadArena()
+{
+	std::scoped_lock<Spinlock> lock(s_ArenaLock);
+
+	const uint32_t index = s_NumArenas.load();
+	ASSERT(index < FRAME_ALLOCATOR_MAX_THREADS);
+
+	ThreadArena* pArena = DBG_NEW ThreadArena();
+	s_pArenas[index] = pArena;
+	s_NumArenas.store(index + 1);
+
+	s_pThreadArena = pArena;
+	return pArena;
+}
@@ -0,0 +1,136 @@
+#pragma once
+#include "Core.h"
+#include "Spinlock.h"
+
+#include <atomic>
+#include <vector>
+#include <cstddef>
+
+//Size of the arena that each thread starts out with, an arena that overflows grows to fit the frame when it is reset
+#define FRAME_ALLOCATOR_ARENA_SIZE		(256U * 1024U)
+#define FRAME_ALLOCATOR_MAX_THREADS		32U
+
+struct FrameAllocatorStatistics
+{
+	uint32_t ThreadCount	= 0;
+	//Summed over the arenas of every thread
+	uint64_t UsedBytes		= 0;
+	uint64_t ArenaBytes		= 0;
+	//Allocations that did not fit in an arena and went to the heap
+	uint64_t OverflowCount	= 0;
+};
+
+//Bump allocator over one block of memory. Allocations are not freed one by one, reset releases all of them at once
+class LinearAllocator
+{
+public:
+	LinearAllocator(size_t sizeInBytes);
+	~LinearAllocator();
+
+	DECL_NO_COPY(LinearAllocator);
+
+	void* allocate(size_t sizeInBytes, size_t alignment);
+	//Frees the overflow allocations, if there were any the block is made large enough to hold them next time
+	void reset();
+
+	FORCEINLINE size_t getUsedBytes() const		{ return m_UsedBytes.load(std::memory_order_relaxed); }
+	FORCEINLINE size_t getSizeInBytes() const	{ return m_SizeInBytes.load(std::memory_order_relaxed); }
+	FORCEINLINE uint64_t getOverflowCount() const	{ return m_OverflowCount.load(std::memory_order_relaxed); }
+
+private:
+	uint8_t* m_pMemory;
+	size_t m_Offset;
+	std::vector<void*> m_Overflow;
+	size_t m_OverflowBytes;
+
+	//Read by other threads for the statistics
+	std::atomic<size_t> m_SizeInBytes;
+	std::atomic<size_t> m_UsedBytes;
+	std::atomic<uint64_t> m_OverflowCount;
+};
+
+//Scratch memory for temporaries in the render loop, so recording a frame does not touch the heap. Every thread has its own
+//arena which is reset the first time the thread allocates after beginFrame. Memory is only valid during the frame it was
+//allocated in and has to be used by the call that allocated it, since code that runs across a frame boundary (like
+//background loading) could otherwise see its memory reused
+class FrameAllocator
+{
+	struct ThreadArena
+	{
+		ThreadArena()
+			: Allocator(FRAME_ALLOCATOR_ARENA_SIZE),
+			Frame(0)
+		{
+		}
+
+		LinearAllocator Allocator;
+		uint64_t Frame;
+	};
+
+public:
+	DECL_STATIC_CLASS(FrameAllocator);
+
+	static void release();
+
+	//Called by the renderer before anything is recorded
+	static void beginFrame();
+
+	static void* allocate(size_t sizeInBytes, size_t alignment = alignof(std::max_align_t));
+
+	template<typename T>
+	static FORCEINLINE T* allocate(size_t count)
+	{
+		return reinterpret_cast<T*>(allocate(sizeof(T) * count, alignof(T)));
+	}
+
+	static FrameAllocatorStatistics getStatistics();
+
+private:
+	static NOINLINE ThreadArena* getThreadArena();
+
+private:
+	static std::atomic<uint64_t> s_Frame;
+	static ThreadArena* s_pArenas[FRAME_ALLOCATOR_MAX_THREADS];
+	static std::atomic<uint32_t> s_NumArenas;
+	static thread_local ThreadArena* s_pThreadArena;
+	static Spinlock s_ArenaLock;
+};
+
+//Lets the standard containers use the frame allocator, deallocate does nothing since the memory goes back with the arena
+template<typename T>
+class FrameSTLAllocator
+{
+public:
+	typedef T value_type;
+
+	FrameSTLAllocator() = default;
+
+	template<typename U>
+	FrameSTLAllocator(const FrameSTLAllocator<U>&)
+	{
+	}
+
+	FORCEINLINE T* allocate(size_t count)
+	{
+		return FrameAllocator::allocate<T>(count);
+	}
+
+	FORCEINLINE void deallocate(T*, size_t)
+	{
+	}
+
+	template<typename U>
+	FORCEINLINE bool operator==(const FrameSTLAllocator<U>&) const
+	{
+		return true;
+	}
+
+	template<typename U>
+	FORCEINLINE bool operator!=(const FrameSTLAllocator<U>&) const
+	{
+		return false;
+	}
+};
+
+template<typename T>
+using FrameVector = std::vector<T, FrameSTLAllocator<T>>;
@@ -0,0 +1,133 @@
+#pragma once
+#include "Core.h"
+
+#include <atomic>
+
+//Bounded lock free multi producer/multi consumer queue, every slot has a sequence number that tells if it is ready to be written or read
+template<typename T>
+class MPMCQueue
+{
+	struct Cell
+	{
+		std::atomic<uint64_t> Sequence;
+		T Data;
+	};
+
+public:
+	MPMCQueue()
+		: m_pCells(nullptr),
+		m_Mask(0),
+		m_EnqueuePosition(0),
+		m_DequeuePosition(0)
+	{
+	}
+
+	~MPMCQueue()
+	{
+		release();
+	}
+
+	DECL_NO_COPY(MPMCQueue);
+
+	//Capacity has to be a power of two
+	bool init(uint32_t capacity)
+	{
+		ASSERT(capacity >= 2 && (capacity & (capacity - 1)) == 0);
+
+		release();
+
+		m_pCells = DBG_NEW Cell[capacity];
+		for (uint32_t i = 0; i < capacity; i++)
+		{
+			m_pCells[i].Sequence.store(i, std::memory_order_relaxed);
+		}
+
+		m_Mask = capacity - 1;
+		m_EnqueuePosition.store(0, std::memory_order_relaxed);
+		m_DequeuePosition.store(0, std::memory_order_relaxed);
+		return true;
+	}
+
+	void release()
+	{
+		if (m_pCells)
+		{
+			delete[] m_pCells;
+			m_pCells = nullptr;
+		}
+	}
+
+	//Returns false when the queue is full
+	bool push(T&& item)
+	{
+		Cell* pCell = nullptr;
+		uint64_t position = m_EnqueuePosition.load(std::memory_order_relaxed);
+		for (;;)
+		{
+			pCell = &m_pCells[position & m_Mask];
+
+			const uint64_t sequence = pCell->Sequence.load(std::memory_order_acquire);
+			const int64_t difference = int64_t(sequence) - int64_t(position);
+			if (difference == 0)
+			{
+				if (m_EnqueuePosition.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+				{
+					break;
+				}
+			}
+			else if (difference < 0)
+			{
+				return false;
+			}
+			else
+			{
+				position = m_EnqueuePosition.load(std::memory_order_relaxed);
+			}
+		}
+
+		pCell->Data = std::move(item);
+		pCell->Sequence.store(position + 1, std::memory_order_release);
+		return true;
+	}
+
+	//Returns false when the queue is empty
+	bool pop(T& item)
+	{
+		Cell* pCell = nullptr;
+		uint64_t position = m_DequeuePosition.load(std::memory_order_relaxed);
+		for (;;)
+		{
+			pCell = &m_pCells[position & m_Mask];
+
+			const uint64_t sequence = pCell->Sequence.load(std::memory_order_acquire);
+			const int64_t difference = int64_t(sequence) - int64_t(position + 1);
+			if (difference == 0)
+			{
+				if (m_DequeuePosition.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+				{
+					break;
+				}
+			}
+			else if (difference < 0)
+			{
+				return false;
+			}
+			else
+			{
+				position = m_DequeuePosition.load(std::memory_order_relaxed);
+			}
+		}
+
+		item = std::move(pCell->Data);
+		pCell->Sequence.store(position + m_Mask + 1, std::memory_order_release);
+		return true;
+	}
+
+private:
+	Cell* m_pCells;
+	uint64_t m_Mask;
+
+	//Kept on separate cache lines so that producers and consumers does not fight over them
+	alignas(64) std::atomic<uint64_t> m_EnqueuePosition;
+	alignas(64) std::atomic<uint64_t> m_DequeuePosition;
+};
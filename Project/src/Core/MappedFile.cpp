@@ -0,0 +1,133 @@
+#include "MappedFile.h"
+
+#ifdef _WIN32
+	#define WIN32_LEAN_AND_MEAN
+	#include <Windows.h>
+#else
+	#include <fcntl.h>
+	#include <unistd.h>
+	#include <sys/mman.h>
+	#include <sys/stat.h>
+#endif
+
+MappedFile::MappedFile()
+	: m_pData(nullptr),
+	m_Size(0),
+#ifdef _WIN32
+	m_hFile(nullptr),
+	m_hMapping(nullptr)
+#else
+	m_FileDescriptor(-1)
+#endif
+{
+}
+
+MappedFile::~MappedFile()
+{
+	close();
+}
+
+bool MappedFile::open(const std::string& filepath)
+{
+	close();
+
+#ifdef _WIN32
+	HANDLE hFile = CreateFileA(filepath.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	if (hFile == INVALID_HANDLE_VALUE)
+	{
+		return false;
+	}
+
+	m_hFile = hFile;
+
+	LARGE_INTEGER size = {};
+	if (!GetFileSizeEx(hFile, &size) || size.QuadPart == 0)
+	{
+		close();
+		return false;
+	}
+
+	m_hMapping = CreateFileMappingA(hFile, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (!m_hMapping)
+	{
+		LOG("MappedFile: CreateFileMapping failed for '%s'", filepath.c_str());
+		close();
+		return false;
+	}
+
+	m_pData = reinterpret_cast<const uint8_t*>(MapViewOfFile(m_hMapping, FILE_MAP_READ, 0, 0, 0));
+	if (!m_pData)
+	{
+		LOG("MappedFile: MapViewOfFile failed for '%s'", filepath.c_str());
+		close();
+		return false;
+	}
+
+	m_Size = size_t(size.QuadPart);
+#else
+	m_FileDescriptor = ::open(filepath.c_str(), O_RDONLY);
+	if (m_FileDescriptor < 0)
+	{
+		return false;
+	}
+
+	struct stat status = {};
+	if (fstat(m_FileDescriptor, &status) != 0 || status.st_size == 0)
+	{
+		close();
+		return false;
+	}
+
+	void* pData = mmap(nullptr, size_t(status.st_size), PROT_READ, MAP_PRIVATE, m_FileDescriptor, 0);
+	if (pData == MAP_FAILED)
+	{
+		LOG("MappedFile: mmap failed for '%s'", filepath.c_str());
+		close();
+		return false;
+	}
+
+	//The file is read from start to end, so the kernel can read ahead
+	madvise(pData, size_t(status.st_size), MADV_SEQUENTIAL);
+
+	m_pData = reinterpret_cast<const uint8_t*>(pData);
+	m_Size	= size_t(status.st_size);
+#endif
+
+	return true;
+}
+
+void MappedFile::close()
+{
+#ifdef _WIN32
+	if (m_pData)
+	{
+		UnmapViewOfFile(m_pData);
+	}
+
+	if (m_hMapping)
+	{
+		CloseHandle(m_hMapping);
+		m_hMapping = nullptr;
+	}
+
+	if (m_hFile)
+	{
+		CloseHandle(m_hFile);
+		m_hFile = nullptr;
+	}
+#else
+	if (m_pData)
+	{
+		munmap(const_cast<uint8_t*>(m_pData), m_Size);
+	}
+
+	if (m_FileDescriptor >= 0)
+	{
+		::close(m_FileDescriptor);
+		m_FileDescriptor = -1;
+	}
+#endif
+
+	m_pData = nullptr;
+	m_Size	= 0;
+}
@@ -0,0 +1,32 @@
+#pragma once
+#include "Core.h"
+
+#include <string>
+
+//Read only view of a whole file, uses file mappings on windows and mmap everywhere else. Pages are read from disk the first
+//time they are touched
+class MappedFile
+{
+public:
+	MappedFile();
+	~MappedFile();
+
+	DECL_NO_COPY(MappedFile);
+
+	bool open(const std::string& filepath);
+	void close();
+
+	FORCEINLINE const uint8_t* getData() const	{ return m_pData; }
+	FORCEINLINE size_t getSize() const			{ return m_Size; }
+	FORCEINLINE bool isOpen() const				{ return m_pData != nullptr; }
+
+private:
+	const uint8_t* m_pData;
+	size_t m_Size;
+#ifdef _WIN32
+	void* m_hFile;
+	void* m_hMapping;
+#else
+	int m_FileDescriptor;
+#endif
+};
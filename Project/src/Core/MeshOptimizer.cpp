@@ -0,0 +1,184 @@
+#include "MeshOptimizer.h"
+
+//Returns a vertex that still has triangles left, the most recently used ones first
+static int32_t skipDeadEnd(const std::vector<uint32_t>& liveTriangles, std::vector<uint32_t>& deadEndStack, uint32_t& cursor, uint32_t vertexCount)
+{
+	while (!deadEndStack.empty())
+	{
+		const uint32_t vertex = deadEndStack.back();
+		deadEndStack.pop_back();
+		if (liveTriangles[vertex] > 0)
+		{
+			return int32_t(vertex);
+		}
+	}
+
+	while (cursor < vertexCount)
+	{
+		if (liveTriangles[cursor] > 0)
+		{
+			return int32_t(cursor);
+		}
+
+		cursor++;
+	}
+
+	return -1;
+}
+
+void MeshOptimizer::optimizeVertexCache(uint32_t* pIndices, uint32_t indexCount, uint32_t vertexCount)
+{
+	const uint32_t triangleCount = indexCount / 3;
+	if (triangleCount == 0)
+	{
+		return;
+	}
+
+	//The triangles that use each vertex, stored as one array with an offset per vertex
+	std::vector<uint32_t> liveTriangles(vertexCount, 0);
+	for (uint32_t i = 0; i < triangleCount * 3; i++)
+	{
+		liveTriangles[pIndices[i]]++;
+	}
+
+	std::vector<uint32_t> adjacencyOffsets(size_t(vertexCount) + 1, 0);
+	for (uint32_t v = 0; v < vertexCount; v++)
+	{
+		adjacencyOffsets[size_t(v) + 1] = adjacencyOffsets[v] + liveTriangles[v];
+	}
+
+	std::vector<uint32_t> adjacency(size_t(triangleCount) * 3);
+	std::vector<uint32_t> adjacencyFill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+	for (uint32_t i = 0; i < triangleCount * 3; i++)
+	{
+		adjacency[adjacencyFill[pIndices[i]]++] = i / 3;
+	}
+
+	std::vector<uint32_t> outputIndices;
+	outputIndices.reserve(size_t(triangleCount) * 3);
+
+	std::vector<uint32_t> cacheTime(vertexCount, 0);
+	std::vector<uint32_t> deadEndStack;
+	std::vector<uint32_t> candidates;
+	std::vector<bool> isEmitted(triangleCount, false);
+
+	uint32_t timeStamp	= VERTEX_CACHE_SIZE + 1;
+	uint32_t cursor		= 0;
+	int32_t fanningVertex = skipDeadEnd(liveTriangles, deadEndStack, cursor, vertexCount);
+	while (fanningVertex >= 0)
+	{
+		//Emit every remaining triangle around the fanning vertex
+		candidates.clear();
+		for (uint32_t a = adjacencyOffsets[fanningVertex]; a < adjacencyOffsets[size_t(fanningVertex) + 1]; a++)
+		{
+			const uint32_t triangle = adjacency[a];
+			if (isEmitted[triangle])
+			{
+				continue;
+			}
+
+			for (uint32_t corner = 0; corner < 3; corner++)
+			{
+				const uint32_t vertex = pIndices[triangle * 3 + corner];
+				outputIndices.push_back(vertex);
+				deadEndStack.push_back(vertex);
+				candidates.push_back(vertex);
+				liveTriangles[vertex]--;
+
+				if (timeStamp - cacheTime[vertex] > VERTEX_CACHE_SIZE)
+				{
+					cacheTime[vertex] = timeStamp++;
+				}
+			}
+
+			isEmitted[triangle] = true;
+		}
+
+		//The next fan is the candidate that stays in the cache the longest while its triangles are emitted
+		int32_t nextVertex	= -1;
+		int32_t bestPriority = -1;
+		for (uint32_t vertex : candidates)
+		{
+			if (liveTriangles[vertex] == 0)
+			{
+				continue;
+			}
+
+			int32_t priority = 0;
+			if (timeStamp - cacheTime[vertex] + 2 * liveTriangles[vertex] <= VERTEX_CACHE_SIZE)
+			{
+				priority = int32_t(timeStamp - cacheTime[vertex]);
+			}
+
+			if (priority > bestPriority)
+			{
+				bestPriority	= priority;
+				nextVertex		= int32_t(vertex);
+			}
+		}
+
+		if (nextVertex < 0)
+		{
+			nextVertex = skipDeadEnd(liveTriangles, deadEndStack, cursor, vertexCount);
+		}
+
+		fanningVertex = nextVertex;
+	}
+
+	ASSERT(outputIndices.size() == size_t(triangleCount) * 3);
+	std::copy(outputIndices.begin(), outputIndices.end(), pIndices);
+}
+
+uint32_t MeshOptimizer::optimizeVertexFetch(std::vector<Vertex>& vertices, uint32_t* pIndices, uint32_t indexCount)
+{
+	std::vector<uint32_t> remap(vertices.size(), UINT32_MAX);
+	std::vector<Vertex> orderedVertices;
+	orderedVertices.reserve(vertices.size());
+
+	for (uint32_t i = 0; i < indexCount; i++)
+	{
+		uint32_t& newIndex = remap[pIndices[i]];
+		if (newIndex == UINT32_MAX)
+		{
+			newIndex = uint32_t(orderedVertices.size());
+			orderedVertices.push_back(vertices[pIndices[i]]);
+		}
+
+		pIndices[i] = newIndex;
+	}
+
+	vertices = std::move(orderedVertices);
+	return uint32_t(vertices.size());
+}
+
+VertexCacheStatistics MeshOptimizer::analyzeVertexCache(const uint32_t* pIndices, uint32_t indexCount, uint32_t vertexCount)
+{
+	VertexCacheStatistics statistics = {};
+	if (indexCount < 3)
+	{
+		return statistics;
+	}
+
+	//A vertex is in the FIFO when fewer than VERTEX_CACHE_SIZE misses have happened since it was added
+	std::vector<uint32_t> addedAt(vertexCount, UINT32_MAX);
+	uint32_t misses			= 0;
+	uint32_t usedVertices	= 0;
+	for (uint32_t i = 0; i < indexCount; i++)
+	{
+		const uint32_t vertex = pIndices[i];
+		if (addedAt[vertex] == UINT32_MAX)
+		{
+			usedVertices++;
+		}
+		else if (misses - addedAt[vertex] < VERTEX_CACHE_SIZE)
+		{
+			continue;
+		}
+
+		addedAt[vertex] = misses++;
+	}
+
+	statistics.ACMR = float(misses) / float(indexCount / 3);
+	statistics.ATVR = float(misses) / float(usedVertices);
+	return statistics;
+}
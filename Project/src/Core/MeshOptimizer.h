@@ -0,0 +1,30 @@
+#pragma once
+#include "Core.h"
+
+#include <vector>
+
+//Size of the FIFO post-transform cache that the triangle order is optimized for and that the statistics are simulated with
+#define VERTEX_CACHE_SIZE 16U
+
+struct VertexCacheStatistics
+{
+	//Average cache miss ratio, vertex shader invocations per triangle. 0.5 is the best possible and 3 the worst
+	float ACMR = 0.0f;
+	//Average transform to vertex ratio, vertex shader invocations per vertex. 1 is the best possible
+	float ATVR = 0.0f;
+};
+
+//Reorders indexed triangle lists for the GPU. The triangles are ordered for the post-transform cache first, then the vertices
+//are ordered by first use, so the vertex fetches from the storage buffer walk through memory in order
+class MeshOptimizer
+{
+public:
+	DECL_STATIC_CLASS(MeshOptimizer);
+
+	//Tipsify (Sander, Nehab and Barczak 2007), linear in the number of triangles
+	static void optimizeVertexCache(uint32_t* pIndices, uint32_t indexCount, uint32_t vertexCount);
+	//Vertices that no triangle refers to are removed, returns the new number of vertices
+	static uint32_t optimizeVertexFetch(std::vector<Vertex>& vertices, uint32_t* pIndices, uint32_t indexCount);
+
+	static VertexCacheStatistics analyzeVertexCache(const uint32_t* pIndices, uint32_t indexCount, uint32_t vertexCount);
+};
@@ -0,0 +1,366 @@
+#include "SceneLoadBenchmark.h"
+#include "CookedScene.h"
+#include "TaskDispatcher.h"
+#include "VertexDeduplicator.h"
+
+#include <tinyobjloader/tiny_obj_loader.h>
+
+#include <chrono>
+#include <fstream>
+#include <unordered_map>
+
+#define BENCHMARK_LOAD_REPETITIONS 4U
+
+using BenchmarkClock = std::chrono::high_resolution_clock;
+
+//Reads every vertex and index the way the upload to the staging buffer does, a mapped file is not read until it is touched
+static uint64_t checksumScene(const CookedScene& scene)
+{
+	uint64_t checksum = 0;
+	for (uint32_t m = 0; m < scene.getMeshCount(); m++)
+	{
+		const CookedMesh& mesh = scene.getMesh(m);
+
+		const uint32_t* pVertexData = reinterpret_cast<const uint32_t*>(scene.getVertices(mesh));
+		const size_t vertexWords	= (sizeof(GPUVertex) * mesh.VertexCount) / sizeof(uint32_t);
+		for (size_t i = 0; i < vertexWords; i++)
+		{
+			checksum += pVertexData[i];
+		}
+
+		const uint32_t* pIndices = scene.getIndices(mesh);
+		for (uint32_t i = 0; i < mesh.IndexCount; i++)
+		{
+			checksum += pIndices[i];
+		}
+	}
+
+	return checksum;
+}
+
+//Average time to parse and build the OBJ, the shapes are built as tasks on numThreads workers
+static bool measureOBJ(const std::string& dir, const std::string& fileName, uint32_t numThreads, float& loadTime, std::vector<uint8_t>& fileData)
+{
+	TaskDispatcher::init(numThreads);
+
+	loadTime = 0.0f;
+	for (uint32_t i = 0; i < BENCHMARK_LOAD_REPETITIONS; i++)
+	{
+		const BenchmarkClock::time_point startTime = BenchmarkClock::now();
+		if (!CookedScene::cookFromOBJ(dir, fileName, fileData))
+		{
+			TaskDispatcher::release();
+			return false;
+		}
+
+		std::chrono::duration<float, std::milli> elapsed = BenchmarkClock::now() - startTime;
+		loadTime += elapsed.count() / float(BENCHMARK_LOAD_REPETITIONS);
+	}
+
+	TaskDispatcher::release();
+	return true;
+}
+
+void SceneLoadBenchmark::run(const std::string& dir, const std::string& fileName, const std::string& filepath)
+{
+	std::ofstream fileStream;
+	fileStream.open(filepath);
+	if (!fileStream.is_open())
+	{
+		LOG("SceneLoadBenchmark: Failed to open '%s'", filepath.c_str());
+		return;
+	}
+
+	const std::string sourcePath = dir + fileName;
+	const std::string cookedPath = sourcePath + COOKED_SCENE_EXTENSION;
+
+	fileStream << "Format\tWorkers\tLoad(ms)\tSpeedup\tSize(MB)" << std::endl;
+
+	//Every file has to be identical to the one built with a single worker
+	const uint32_t workerCounts[] = { 1, 4, 16 };
+	std::vector<uint8_t> serialData;
+	float serialTime = 0.0f;
+	for (uint32_t numThreads : workerCounts)
+	{
+		float objTime = 0.0f;
+		std::vector<uint8_t> fileData;
+		if (!measureOBJ(dir, fileName, numThreads, objTime, fileData))
+		{
+			LOG("SceneLoadBenchmark: Failed to load '%s'", sourcePath.c_str());
+			return;
+		}
+
+		if (serialData.empty())
+		{
+			serialData	= std::move(fileData);
+			serialTime	= objTime;
+		}
+		else if (fileData != serialData)
+		{
+			LOG("SceneLoadBenchmark: The scene built with %u workers differs from the one built with one worker", numThreads);
+		}
+
+		LOG("SceneLoadBenchmark [%s]: OBJ with %u workers=%.2fms (%.2fx)", sourcePath.c_str(), numThreads, objTime, serialTime / objTime);
+		fileStream << "OBJ\t" << numThreads << "\t" << objTime << "\t" << serialTime / objTime << "\t-" << std::endl;
+	}
+
+	const size_t cookedSize = serialData.size();
+	if (!CookedScene::writeToFile(cookedPath, serialData))
+	{
+		return;
+	}
+
+	//The file was just written, so these are warm loads from the page cache. The first run of the application after a
+	//reboot reads from disk in both cases
+	float cookedTime		= 0.0f;
+	uint64_t cookedChecksum	= 0;
+	for (uint32_t i = 0; i < BENCHMARK_LOAD_REPETITIONS; i++)
+	{
+		const BenchmarkClock::time_point startTime = BenchmarkClock::now();
+
+		CookedScene cookedScene;
+		if (!cookedScene.open(cookedPath, sourcePath))
+		{
+			LOG("SceneLoadBenchmark: Failed to open '%s'", cookedPath.c_str());
+			return;
+		}
+
+		cookedChecksum = checksumScene(cookedScene);
+		cookedScene.close();
+
+		std::chrono::duration<float, std::milli> elapsed = BenchmarkClock::now() - startTime;
+		cookedTime += elapsed.count() / float(BENCHMARK_LOAD_REPETITIONS);
+	}
+
+	//Both paths have to produce the same meshes for the comparison to mean anything
+	CookedScene memoryScene;
+	if (!memoryScene.openFromMemory(std::move(serialData), sourcePath) || checksumScene(memoryScene) != cookedChecksum)
+	{
+		LOG("SceneLoadBenchmark: The cooked file does not match the OBJ");
+	}
+
+	const float sizeInMB = float(cookedSize) / (1024.0f * 1024.0f);
+	LOG("SceneLoadBenchmark [%s]: Cooked=%.2fms (%.1fx) CookedSize=%.2fMB", sourcePath.c_str(), cookedTime, serialTime / cookedTime, sizeInMB);
+
+	fileStream << "Cooked\t1\t" << cookedTime << "\t" << serialTime / cookedTime << "\t" << sizeInMB << std::endl;
+	fileStream.close();
+
+	LOG("SceneLoadBenchmark: Results written to '%s'", filepath.c_str());
+}
+
+//Keeps track of the bytes held by a container, the peak is what the container needed at most
+struct AllocationTracker
+{
+	size_t CurrentBytes	= 0;
+	size_t PeakBytes	= 0;
+};
+
+template<typename T>
+class TrackingAllocator
+{
+public:
+	using value_type = T;
+
+	explicit TrackingAllocator(AllocationTracker* pTracker)
+		: m_pTracker(pTracker)
+	{
+	}
+
+	template<typename U>
+	TrackingAllocator(const TrackingAllocator<U>& other)
+		: m_pTracker(other.m_pTracker)
+	{
+	}
+
+	T* allocate(size_t count)
+	{
+		m_pTracker->CurrentBytes	+= sizeof(T) * count;
+		m_pTracker->PeakBytes		= std::max(m_pTracker->PeakBytes, m_pTracker->CurrentBytes);
+		return std::allocator<T>().allocate(count);
+	}
+
+	void deallocate(T* pMemory, size_t count)
+	{
+		m_pTracker->CurrentBytes -= sizeof(T) * count;
+		std::allocator<T>().deallocate(pMemory, count);
+	}
+
+	template<typename U>
+	bool operator==(const TrackingAllocator<U>& other) const { return m_pTracker == other.m_pTracker; }
+	template<typename U>
+	bool operator!=(const TrackingAllocator<U>& other) const { return m_pTracker != other.m_pTracker; }
+
+public:
+	AllocationTracker* m_pTracker;
+};
+
+//The vertices of every shape in the order they are referenced, before deduplication
+static bool loadVertexStream(const std::string& filepath, std::vector<Vertex>& stream)
+{
+	tinyobj::attrib_t attributes;
+	std::vector<tinyobj::shape_t> shapes;
+	std::vector<tinyobj::material_t> materials;
+	std::string warn, err;
+
+	if (!tinyobj::LoadObj(&attributes, &shapes, &materials, &warn, &err, filepath.c_str(), nullptr, true, false))
+	{
+		LOG("SceneLoadBenchmark: Failed to load '%s'. Warning: %s Error: %s", filepath.c_str(), warn.c_str(), err.c_str());
+		return false;
+	}
+
+	for (const tinyobj::shape_t& shape : shapes)
+	{
+		for (const tinyobj::index_t& index : shape.mesh.indices)
+		{
+			Vertex vertex = {};
+			vertex.Position = glm::vec3(attributes.vertices[3 * (size_t)index.vertex_index + 0], attributes.vertices[3 * (size_t)index.vertex_index + 1], attributes.vertices[3 * (size_t)index.vertex_index + 2]);
+
+			if (index.normal_index >= 0)
+			{
+				vertex.Normal = glm::vec3(attributes.normals[3 * (size_t)index.normal_index + 0], attributes.normals[3 * (size_t)index.normal_index + 1], attributes.normals[3 * (size_t)index.normal_index + 2]);
+			}
+
+			if (index.texcoord_index >= 0)
+			{
+				vertex.TexCoord = glm::vec2(attributes.texcoords[2 * (size_t)index.texcoord_index + 0], 1.0f - attributes.texcoords[2 * (size_t)index.texcoord_index + 1]);
+			}
+
+			stream.push_back(vertex);
+		}
+	}
+
+	return true;
+}
+
+void SceneLoadBenchmark::runVertexDeduplication(const std::vector<std::string>& objFiles, const std::string& filepath)
+{
+	std::ofstream fileStream;
+	fileStream.open(filepath);
+	if (!fileStream.is_open())
+	{
+		LOG("SceneLoadBenchmark: Failed to open '%s'", filepath.c_str());
+		return;
+	}
+
+	fileStream << "File\tIndices\tVertices\tMethod\tTime(ms)\tSpeedup\tPeakMemory(MB)" << std::endl;
+	for (const std::string& objFile : objFiles)
+	{
+		std::vector<Vertex> stream;
+		if (!loadVertexStream(objFile, stream))
+		{
+			continue;
+		}
+
+		//The way the meshes were deduplicated before, two lookups for every index in a node based map
+		using TrackedMap = std::unordered_map<Vertex, uint32_t, std::hash<Vertex>, std::equal_to<Vertex>, TrackingAllocator<std::pair<const Vertex, uint32_t>>>;
+
+		std::vector<Vertex> mapVertices;
+		std::vector<uint32_t> mapIndices;
+		AllocationTracker mapTracker = {};
+		float mapTime = 0.0f;
+		for (uint32_t i = 0; i < BENCHMARK_LOAD_REPETITIONS; i++)
+		{
+			mapVertices.clear();
+			mapIndices.clear();
+			mapIndices.reserve(stream.size());
+
+			const BenchmarkClock::time_point startTime = BenchmarkClock::now();
+			{
+				TrackedMap uniqueVertices(0, std::hash<Vertex>(), std::equal_to<Vertex>(), TrackingAllocator<std::pair<const Vertex, uint32_t>>(&mapTracker));
+				for (const Vertex& vertex : stream)
+				{
+					if (uniqueVertices.count(vertex) == 0)
+					{
+						uniqueVertices[vertex] = static_cast<uint32_t>(mapVertices.size());
+						mapVertices.push_back(vertex);
+					}
+
+					mapIndices.push_back(uniqueVertices[vertex]);
+				}
+			}
+
+			std::chrono::duration<float, std::milli> elapsed = BenchmarkClock::now() - startTime;
+			mapTime += elapsed.count() / float(BENCHMARK_LOAD_REPETITIONS);
+		}
+
+		std::vector<Vertex> flatVertices;
+		std::vector<uint32_t> flatIndices;
+		size_t flatPeakBytes = 0;
+		float flatTime = 0.0f;
+		for (uint32_t i = 0; i < BENCHMARK_LOAD_REPETITIONS; i++)
+		{
+			flatVertices.clear();
+			flatIndices.clear();
+			flatIndices.reserve(stream.size());
+
+			const BenchmarkClock::time_point startTime = BenchmarkClock::now();
+			{
+				VertexDeduplicator deduplicator(uint32_t(stream.size()));
+				for (const Vertex& vertex : stream)
+				{
+					flatIndices.push_back(deduplicator.insert(vertex, flatVertices));
+				}
+
+				flatPeakBytes = std::max(flatPeakBytes, deduplicator.getSizeInBytes());
+			}
+
+			std::chrono::duration<float, std::milli> elapsed = BenchmarkClock::now() - startTime;
+			flatTime += elapsed.count() / float(BENCHMARK_LOAD_REPETITIONS);
+		}
+
+		if (mapIndices != flatIndices || mapVertices.size() != flatVertices.size())
+		{
+			LOG("SceneLoadBenchmark: VertexDeduplicator and std::unordered_map disagree on '%s'", objFile.c_str());
+		}
+
+		const float mapMemory	= float(mapTracker.PeakBytes) / (1024.0f * 1024.0f);
+		const float flatMemory	= float(flatPeakBytes) / (1024.0f * 1024.0f);
+		LOG("SceneLoadBenchmark [%s]: %zu indices, %zu vertices. unordered_map=%.2fms (%.2fMB) VertexDeduplicator=%.2fms (%.2fMB) %.2fx",
+			objFile.c_str(), stream.size(), flatVertices.size(), mapTime, mapMemory, flatTime, flatMemory, mapTime / flatTime);
+
+		fileStream << objFile << "\t" << stream.size() << "\t" << flatVertices.size() << "\tunordered_map\t" << mapTime << "\t1\t" << mapMemory << std::endl;
+		fileStream << objFile << "\t" << stream.size() << "\t" << flatVertices.size() << "\tVertexDeduplicator\t" << flatTime << "\t" << mapTime / flatTime << "\t" << flatMemory << std::endl;
+	}
+
+	fileStream.close();
+	LOG("SceneLoadBenchmark: Results written to '%s'", filepath.c_str());
+}
+
+void SceneLoadBenchmark::runVertexCache(const std::vector<std::string>& objFiles, const std::string& filepath)
+{
+	std::ofstream fileStream;
+	fileStream.open(filepath);
+	if (!fileStream.is_open())
+	{
+		LOG("SceneLoadBenchmark: Failed to open '%s'", filepath.c_str());
+		return;
+	}
+
+	TaskDispatcher::init();
+
+	fileStream << "File\tMesh\tTriangles\tVertices\tACMRBefore\tACMRAfter\tATVRBefore\tATVRAfter" << std::endl;
+	for (const std::string& objFile : objFiles)
+	{
+		const size_t separator	= objFile.find_last_of('/');
+		const std::string dir	= (separator == std::string::npos) ? std::string() : objFile.substr(0, separator + 1);
+
+		std::vector<uint8_t> fileData;
+		std::vector<CookedMeshReport> reports;
+		if (!CookedScene::cookFromOBJ(dir, objFile.substr(dir.size()), fileData, &reports))
+		{
+			continue;
+		}
+
+		for (uint32_t m = 0; m < reports.size(); m++)
+		{
+			const CookedMeshReport& report = reports[m];
+			fileStream << objFile << "\t" << m << "\t" << report.IndexCount / 3 << "\t" << report.VertexCount << "\t";
+			fileStream << report.Before.ACMR << "\t" << report.After.ACMR << "\t" << report.Before.ATVR << "\t" << report.After.ATVR << std::endl;
+		}
+	}
+
+	TaskDispatcher::release();
+
+	fileStream.close();
+	LOG("SceneLoadBenchmark: Results written to '%s'", filepath.c_str());
+}
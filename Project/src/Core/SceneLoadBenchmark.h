@@ -0,0 +1,21 @@
+#pragma once
+#include "Core.h"
+
+#include <string>
+#include <vector>
+
+//Compares loading a scene from the OBJ with loading it from the cooked file, started with --benchmark-scene-load
+class SceneLoadBenchmark
+{
+public:
+	DECL_STATIC_CLASS(SceneLoadBenchmark);
+
+	//Only measures the CPU side, from opening the file until the vertices and indices are ready to be copied to the GPU.
+	//The OBJ is loaded with 1, 4 and 16 workers
+	static void run(const std::string& dir, const std::string& fileName, const std::string& filepath);
+	//Compares the time and peak memory of deduplicating the vertices of the OBJs with std::unordered_map and VertexDeduplicator,
+	//started with --benchmark-vertex-dedup
+	static void runVertexDeduplication(const std::vector<std::string>& objFiles, const std::string& filepath);
+	//Writes the ACMR and ATVR of every mesh before and after it is reordered, started with --benchmark-vertex-cache
+	static void runVertexCache(const std::vector<std::string>& objFiles, const std::string& filepath);
+};
@@ -0,0 +1,194 @@
+#include "Spinlock.h"
+
+#include <mutex>
+#include <chrono>
+#include <thread>
+
+#if defined(_WIN32)
+	#define NOMINMAX
+	#define WIN32_LEAN_AND_MEAN
+	#include <Windows.h>
+#elif defined(__linux__)
+	#include <unistd.h>
+	#include <sys/syscall.h>
+	#include <linux/futex.h>
+#endif
+
+//The OS waits directly on the lock word
+static_assert(sizeof(std::atomic<uint32_t>) == sizeof(uint32_t), "Spinlock needs a lock-free 32-bit atomic");
+
+#if SPINLOCK_STATISTICS
+static std::mutex& getRegistryMutex()
+{
+	static std::mutex registryMutex;
+	return registryMutex;
+}
+
+static std::vector<Spinlock*>& getRegistry()
+{
+	static std::vector<Spinlock*> registry;
+	return registry;
+}
+
+static uint64_t getTimeNS()
+{
+	return uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+#endif
+
+Spinlock::~Spinlock()
+{
+	disableStatistics();
+}
+
+uint32_t Spinlock::lockContended() noexcept
+{
+	uint32_t spins		= 0;
+	uint32_t backoff	= 1;
+	while (spins < SPINLOCK_PARK_THRESHOLD)
+	{
+		for (uint32_t i = 0; i < backoff; i++)
+		{
+			CPU_PAUSE();
+		}
+
+		spins	+= backoff;
+		backoff = std::min(backoff * 2, SPINLOCK_MAX_BACKOFF);
+
+		if (try_lock())
+		{
+			return spins;
+		}
+	}
+
+	//The holder has probably been preempted, park until it unlocks. Whoever gets the lock this way keeps it marked as
+	//contended, since there can be more threads sleeping behind it
+	while (m_Locked.exchange(LOCK_CONTENDED, std::memory_order_acquire) != LOCK_UNLOCKED)
+	{
+#if defined(_WIN32)
+		uint32_t contended = LOCK_CONTENDED;
+		WaitOnAddress(&m_Locked, &contended, sizeof(contended), INFINITE);
+#elif defined(__linux__)
+		syscall(SYS_futex, reinterpret_cast<uint32_t*>(&m_Locked), FUTEX_WAIT_PRIVATE, LOCK_CONTENDED, nullptr, nullptr, 0);
+#else
+		std::this_thread::yield();
+#endif
+	}
+
+	return spins;
+}
+
+void Spinlock::wakeWaiter() noexcept
+{
+#if defined(_WIN32)
+	WakeByAddressSingle(&m_Locked);
+#elif defined(__linux__)
+	syscall(SYS_futex, reinterpret_cast<uint32_t*>(&m_Locked), FUTEX_WAKE_PRIVATE, 1, nullptr, nullptr, 0);
+#endif
+}
+
+void Spinlock::enableStatistics(const std::string& name)
+{
+#if SPINLOCK_STATISTICS
+	//The registry mutex also keeps the name from changing while the profiler reads it
+	std::scoped_lock<std::mutex> lock(getRegistryMutex());
+	if (Counters* pCounters = m_pCounters.load(std::memory_order_relaxed))
+	{
+		pCounters->Name = name;
+		return;
+	}
+
+	Counters* pCounters = DBG_NEW Counters();
+	pCounters->Name = name;
+	m_pCounters.store(pCounters, std::memory_order_release);
+
+	getRegistry().push_back(this);
+#else
+	UNREFERENCED_PARAMETER(name);
+#endif
+}
+
+void Spinlock::disableStatistics()
+{
+#if SPINLOCK_STATISTICS
+	std::scoped_lock<std::mutex> lock(getRegistryMutex());
+	Counters* pCounters = m_pCounters.exchange(nullptr, std::memory_order_acq_rel);
+	if (!pCounters)
+	{
+		return;
+	}
+
+	std::vector<Spinlock*>& registry = getRegistry();
+	registry.erase(std::remove(registry.begin(), registry.end(), this), registry.end());
+
+	SAFEDELETE(pCounters);
+#endif
+}
+
+void Spinlock::getStatistics(std::vector<SpinlockStatistics>& statistics)
+{
+	statistics.clear();
+
+#if SPINLOCK_STATISTICS
+	std::scoped_lock<std::mutex> lock(getRegistryMutex());
+	for (Spinlock* pLock : getRegistry())
+	{
+		const Counters* pCounters = pLock->m_pCounters.load(std::memory_order_acquire);
+
+		SpinlockStatistics lockStatistics = {};
+		lockStatistics.Name						= pCounters->Name;
+		lockStatistics.Acquisitions				= pCounters->Acquisitions.load(std::memory_order_relaxed);
+		lockStatistics.ContendedAcquisitions	= pCounters->ContendedAcquisitions.load(std::memory_order_relaxed);
+		lockStatistics.Spins					= pCounters->Spins.load(std::memory_order_relaxed);
+		lockStatistics.MaxHoldTimeNS			= pCounters->MaxHoldTimeNS.load(std::memory_order_relaxed);
+		statistics.emplace_back(lockStatistics);
+	}
+#endif
+}
+
+void Spinlock::resetStatistics()
+{
+#if SPINLOCK_STATISTICS
+	std::scoped_lock<std::mutex> lock(getRegistryMutex());
+	for (Spinlock* pLock : getRegistry())
+	{
+		Counters* pCounters = pLock->m_pCounters.load(std::memory_order_acquire);
+		pCounters->Acquisitions				= 0;
+		pCounters->ContendedAcquisitions	= 0;
+		pCounters->Spins					= 0;
+		pCounters->MaxHoldTimeNS			= 0;
+	}
+#endif
+}
+
+#if SPINLOCK_STATISTICS
+void Spinlock::onLocked(Counters* pCounters, uint32_t spins) noexcept
+{
+	pCounters->Acquisitions.fetch_add(1, std::memory_order_relaxed);
+	if (spins > 0)
+	{
+		pCounters->ContendedAcquisitions.fetch_add(1, std::memory_order_relaxed);
+		pCounters->Spins.fetch_add(spins, std::memory_order_relaxed);
+	}
+
+	pCounters->LockedAt = getTimeNS();
+}
+
+void Spinlock::onUnlocked(Counters* pCounters) noexcept
+{
+	//The statistics were enabled while the lock was held, so there is no start time for this hold
+	if (pCounters->LockedAt == 0)
+	{
+		return;
+	}
+
+	//Only the holder updates the max so there is no need for a compare exchange
+	const uint64_t holdTime = getTimeNS() - pCounters->LockedAt;
+	if (holdTime > pCounters->MaxHoldTimeNS.load(std::memory_order_relaxed))
+	{
+		pCounters->MaxHoldTimeNS.store(holdTime, std::memory_order_relaxed);
+	}
+
+	pCounters->LockedAt = 0;
+}
+#endif
@@ -2,25 +2,133 @@
 #include "Core.h"
 
 #include <atomic>
+#include <string>
+#include <vector>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+	#include <immintrin.h>
+	#define CPU_PAUSE() _mm_pause()
+#elif defined(_M_ARM64) || defined(_M_ARM)
+	#include <intrin.h>
+	#define CPU_PAUSE() __yield()
+#elif defined(__aarch64__) || defined(__arm__)
+	#define CPU_PAUSE() __asm__ __volatile__("yield")
+#else
+	#define CPU_PAUSE()
+#endif
+
+//Locks with statistics enabled counts acquisitions, spins and hold time, on by default in debug builds
+#ifndef SPINLOCK_STATISTICS
+	#if _DEBUG
+		#define SPINLOCK_STATISTICS 1
+	#else
+		#define SPINLOCK_STATISTICS 0
+	#endif
+#endif
+
+//Pauses between two checks of the lock doubles up to this
+#define SPINLOCK_MAX_BACKOFF 64U
+//After this many pauses the waiting thread parks on the lock word until the holder wakes it
+#define SPINLOCK_PARK_THRESHOLD 4096U
+
+struct SpinlockStatistics
+{
+	std::string Name;
+	uint64_t Acquisitions			= 0;
+	uint64_t ContendedAcquisitions	= 0;
+	uint64_t Spins					= 0;
+	uint64_t MaxHoldTimeNS			= 0;
+};
 
 class Spinlock
 {
+#if SPINLOCK_STATISTICS
+	struct Counters
+	{
+		std::string Name;
+		std::atomic<uint64_t> Acquisitions			= 0;
+		std::atomic<uint64_t> ContendedAcquisitions = 0;
+		std::atomic<uint64_t> Spins					= 0;
+		std::atomic<uint64_t> MaxHoldTimeNS			= 0;
+		//Only written by the thread holding the lock, zero when the lock was taken before statistics were enabled
+		uint64_t LockedAt = 0;
+	};
+#endif
+
 public:
+	Spinlock() = default;
+	~Spinlock();
+
+	DECL_NO_COPY(Spinlock);
+
 	FORCEINLINE void lock() noexcept
 	{
-		while (m_Flag.test_and_set(std::memory_order_acquire));
+#if SPINLOCK_STATISTICS
+		const uint32_t spins = try_lock() ? 0 : lockContended();
+		if (Counters* pCounters = m_pCounters.load(std::memory_order_acquire))
+		{
+			onLocked(pCounters, spins);
+		}
+#else
+		if (!try_lock())
+		{
+			lockContended();
+		}
+#endif
 	}
 
 	FORCEINLINE void unlock() noexcept
 	{
-		m_Flag.clear(std::memory_order_release);
+#if SPINLOCK_STATISTICS
+		if (Counters* pCounters = m_pCounters.load(std::memory_order_acquire))
+		{
+			onUnlocked(pCounters);
+		}
+#endif
+
+		//Only go to the OS when someone is sleeping on the lock
+		if (m_Locked.exchange(LOCK_UNLOCKED, std::memory_order_release) == LOCK_CONTENDED)
+		{
+			wakeWaiter();
+		}
 	}
 
 	FORCEINLINE bool try_lock() noexcept
 	{
-		return !m_Flag.test_and_set(std::memory_order_acquire);
+		//Reading first keeps the cache line shared while someone else holds the lock
+		uint32_t unlocked = LOCK_UNLOCKED;
+		return m_Locked.load(std::memory_order_relaxed) == LOCK_UNLOCKED && m_Locked.compare_exchange_strong(unlocked, LOCK_LOCKED, std::memory_order_acquire, std::memory_order_relaxed);
 	}
 
+	//Starts counting for this lock and shows it in the profiler, does nothing without SPINLOCK_STATISTICS. Can be called while
+	//other threads use the lock
+	void enableStatistics(const std::string& name);
+	//Has to be called before the lock is destroyed if it outlives the statistics, like a lock in a static. No other thread may
+	//use the lock at the same time, since the counters are deleted
+	void disableStatistics();
+
+	static void getStatistics(std::vector<SpinlockStatistics>& statistics);
+	static void resetStatistics();
+
 private:
-	std::atomic_flag m_Flag = ATOMIC_FLAG_INIT;
-};
\ No newline at end of file
+	//Spins with exponential backoff, then parks on the lock word. Returns the number of pauses it took
+	NOINLINE uint32_t lockContended() noexcept;
+	NOINLINE void wakeWaiter() noexcept;
+
+#if SPINLOCK_STATISTICS
+	static void onLocked(Counters* pCounters, uint32_t spins) noexcept;
+	static void onUnlocked(Counters* pCounters) noexcept;
+#endif
+
+private:
+	//Waiters that went to sleep set the lock to contended so that unlock knows it has to wake one of them
+	static constexpr uint32_t LOCK_UNLOCKED		= 0;
+	static constexpr uint32_t LOCK_LOCKED		= 1;
+	static constexpr uint32_t LOCK_CONTENDED	= 2;
+
+	std::atomic<uint32_t> m_Locked = LOCK_UNLOCKED;
+#if SPINLOCK_STATISTICS
+	//Set by enableStatistics while other threads may be locking
+	std::atomic<Counters*> m_pCounters = nullptr;
+#endif
+};
@@ -0,0 +1,130 @@
+#pragma once
+#include "Core.h"
+
+#include <new>
+#include <utility>
+#include <type_traits>
+
+#define TASK_STORAGE_SIZE 64
+
+//Move only callable that stores the function inline, it never allocates memory
+class Task
+{
+	enum class EOperation
+	{
+		MOVE,
+		DESTROY
+	};
+
+public:
+	Task() = default;
+
+	template<typename TFunc, typename = std::enable_if_t<!std::is_same_v<std::decay_t<TFunc>, Task>>>
+	Task(TFunc&& func)
+	{
+		using TFunction = std::decay_t<TFunc>;
+		static_assert(sizeof(TFunction) <= TASK_STORAGE_SIZE, "Task: Captures are too big to be stored inline");
+		static_assert(alignof(TFunction) <= alignof(std::max_align_t), "Task: Captures are over aligned");
+
+		new(m_Storage) TFunction(std::forward<TFunc>(func));
+		m_pInvoke = &invoke<TFunction>;
+		m_pManage = &manage<TFunction>;
+	}
+
+	//The name is shown in the timeline, it has to be a string literal since only the pointer is kept
+	template<typename TFunc>
+	Task(const char* pName, TFunc&& func)
+		: Task(std::forward<TFunc>(func))
+	{
+		m_pName = pName;
+	}
+
+	Task(Task&& other) noexcept
+	{
+		moveFrom(other);
+	}
+
+	~Task()
+	{
+		reset();
+	}
+
+	Task(const Task&) = delete;
+	Task& operator=(const Task&) = delete;
+
+	Task& operator=(Task&& other) noexcept
+	{
+		if (this != &other)
+		{
+			reset();
+			moveFrom(other);
+		}
+
+		return *this;
+	}
+
+	FORCEINLINE void operator()()
+	{
+		ASSERT(m_pInvoke != nullptr);
+		m_pInvoke(m_Storage);
+	}
+
+	FORCEINLINE explicit operator bool() const
+	{
+		return m_pInvoke != nullptr;
+	}
+
+	FORCEINLINE const char* getName() const
+	{
+		return m_pName;
+	}
+
+	void reset()
+	{
+		if (m_pManage)
+		{
+			m_pManage(EOperation::DESTROY, m_Storage, nullptr);
+			m_pInvoke = nullptr;
+			m_pManage = nullptr;
+		}
+	}
+
+private:
+	void moveFrom(Task& other)
+	{
+		if (other.m_pManage)
+		{
+			other.m_pManage(EOperation::MOVE, m_Storage, other.m_Storage);
+			m_pInvoke = other.m_pInvoke;
+			m_pManage = other.m_pManage;
+			other.reset();
+		}
+
+		m_pName = other.m_pName;
+	}
+
+	template<typename TFunction>
+	static void invoke(void* pStorage)
+	{
+		(*std::launder(reinterpret_cast<TFunction*>(pStorage)))();
+	}
+
+	template<typename TFunction>
+	static void manage(EOperation operation, void* pDestination, void* pSource)
+	{
+		if (operation == EOperation::MOVE)
+		{
+			new(pDestination) TFunction(std::move(*std::launder(reinterpret_cast<TFunction*>(pSource))));
+		}
+		else
+		{
+			std::launder(reinterpret_cast<TFunction*>(pDestination))->~TFunction();
+		}
+	}
+
+private:
+	alignas(std::max_align_t) uint8_t m_Storage[TASK_STORAGE_SIZE];
+	void(*m_pInvoke)(void*) = nullptr;
+	void(*m_pManage)(EOperation, void*, void*) = nullptr;
+	const char* m_pName = "Task";
+};
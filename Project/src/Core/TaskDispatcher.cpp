@@ -1,26 +1,90 @@
 #include "TaskDispatcher.h"
+#include "AllocationCounter.h"
 
+#include <cstdio>
 #include <algorithm>
 
-std::vector<std::thread>			TaskDispatcher::s_Threads;
-std::mutex							TaskDispatcher::s_EventMutex;
-std::atomic<uint64_t>				TaskDispatcher::s_FinishedFence;
-std::condition_variable				TaskDispatcher::s_WakeCondition;
-std::queue<std::function<void()>>	TaskDispatcher::s_TaskQueue;
-uint64_t							TaskDispatcher::s_CurrentFence = 0;
-Spinlock							TaskDispatcher::s_QueueLock;
-bool								TaskDispatcher::s_RunWorkers = true;
+//Number of times a worker looks for work before going to sleep
+#define WORKER_SPIN_COUNT 64U
 
-bool TaskDispatcher::init()
+std::vector<std::thread>				TaskDispatcher::s_Threads;
+MPMCQueue<TaskDispatcher::QueuedTask>	TaskDispatcher::s_WorkQueues[MAX_THREADS];
+TaskDispatcher::WorkerPool				TaskDispatcher::s_Pools[TASK_PRIORITY_COUNT];
+thread_local TaskDispatcher::WorkerContext	TaskDispatcher::s_WorkerContext;
+bool									TaskDispatcher::s_UseFibers = false;
+TaskFiber*								TaskDispatcher::s_pFibers = nullptr;
+Fiber									TaskDispatcher::s_ThreadFibers[MAX_THREADS];
+MPMCQueue<TaskFiber*>					TaskDispatcher::s_FreeFibers;
+TaskCounter*							TaskDispatcher::s_pFreeCounters = nullptr;
+Spinlock								TaskDispatcher::s_CounterLock;
+std::mutex								TaskDispatcher::s_EventMutex;
+std::atomic<uint64_t>					TaskDispatcher::s_FinishedFence = 0;
+std::atomic<uint64_t>					TaskDispatcher::s_CurrentFence = 0;
+std::atomic<bool>						TaskDispatcher::s_RunWorkers = true;
+
+bool TaskDispatcher::init(uint32_t numThreads, bool useFibers, uint32_t numBackgroundThreads)
 {
-	const uint32_t numThreads = std::min(std::max(1U, std::thread::hardware_concurrency()), MAX_THREADS);
+	//The frame pool always gets at least one thread, by default it gets the hardware threads that the background pool does not use
+	numBackgroundThreads = std::min(numBackgroundThreads, MAX_THREADS - 1);
+	if (numThreads == 0)
+	{
+		const uint32_t hardwareThreads = std::thread::hardware_concurrency();
+		numThreads = (hardwareThreads > numBackgroundThreads) ? hardwareThreads - numBackgroundThreads : 1;
+	}
+
+	numThreads = std::min(std::max(1U, numThreads), MAX_THREADS - numBackgroundThreads);
+
+	LOG("TaskManager: Starting up %u frame threads and %u background threads%s", numThreads, numBackgroundThreads, useFibers ? " with fibers" : "");
+
+	WorkerPool& framePool		= s_Pools[uint32_t(ETaskPriority::FRAME)];
+	framePool.FirstWorker		= 0;
+	framePool.NumWorkers		= numThreads;
+	WorkerPool& backgroundPool	= s_Pools[uint32_t(ETaskPriority::BACKGROUND)];
+	backgroundPool.FirstWorker	= numThreads;
+	backgroundPool.NumWorkers	= numBackgroundThreads;
+
+	//All queue memory is allocated up front so that dispatching never allocates
+	const uint32_t totalThreads = numThreads + numBackgroundThreads;
+	for (uint32_t i = 0; i < totalThreads; i++)
+	{
+		s_WorkQueues[i].init(WORKER_QUEUE_SIZE);
+	}
+
+	s_UseFibers = useFibers;
+	for (WorkerPool& pool : s_Pools)
+	{
+		pool.InjectionQueue.init(INJECTION_QUEUE_SIZE);
+		if (s_UseFibers)
+		{
+			pool.ReadyFibers.init(FIBER_COUNT);
+		}
+	}
+
+	if (s_UseFibers)
+	{
+		s_FreeFibers.init(FIBER_COUNT);
+
+		s_pFibers = DBG_NEW TaskFiber[FIBER_COUNT];
+		for (uint32_t i = 0; i < FIBER_COUNT; i++)
+		{
+			if (!s_pFibers[i].Context.init(fiberMain, nullptr, FIBER_STACK_SIZE))
+			{
+				return false;
+			}
 
-	LOG("TaskManager: Starting up %u threads", numThreads);
+			s_FreeFibers.push(&s_pFibers[i]);
+		}
+	}
+
+	s_CounterLock.enableStatistics("TaskDispatcher Counter Pool");
 
 	s_RunWorkers = true;
-	for (uint32_t i = 0; i < numThreads; i++)
+	for (uint32_t pool = 0; pool < TASK_PRIORITY_COUNT; pool++)
 	{
-		s_Threads.emplace_back(taskThread);
+		for (uint32_t i = 0; i < s_Pools[pool].NumWorkers; i++)
+		{
+			s_Threads.emplace_back(taskThread, s_Pools[pool].FirstWorker + i, pool);
+		}
 	}
 
 	return true;
@@ -28,71 +92,663 @@ bool TaskDispatcher::init()
 
 void TaskDispatcher::release()
 {
-	s_RunWorkers = false;
-	s_WakeCondition.notify_all();
-
 	waitForTasks();
+
+	{
+		std::scoped_lock<std::mutex> lock(s_EventMutex);
+		s_RunWorkers = false;
+		for (WorkerPool& pool : s_Pools)
+		{
+			pool.WakeCondition.notify_all();
+		}
+	}
+
 	for (std::thread& thread : s_Threads)
 	{
 		thread.join();
 	}
+
+	s_Threads.clear();
+
+	for (WorkerPool& pool : s_Pools)
+	{
+		pool.InjectionQueue.release();
+		pool.ReadyFibers.release();
+		pool.FirstWorker	= 0;
+		pool.NumWorkers		= 0;
+	}
+
+	for (uint32_t i = 0; i < MAX_THREADS; i++)
+	{
+		s_WorkQueues[i].release();
+	}
+
+	if (s_pFibers)
+	{
+		delete[] s_pFibers;
+		s_pFibers = nullptr;
+	}
+
+	s_FreeFibers.release();
+	s_UseFibers = false;
+
+	{
+		std::scoped_lock<Spinlock> lock(s_CounterLock);
+		while (s_pFreeCounters)
+		{
+			TaskCounter* pCounter = s_pFreeCounters;
+			s_pFreeCounters = pCounter->pNext;
+			delete pCounter;
+		}
+	}
+
+	//The lock is a static and would otherwise outlive the statistics
+	s_CounterLock.disableStatistics();
 }
 
-void TaskDispatcher::execute(const std::function<void()>& task)
+TaskGroup TaskDispatcher::execute(Task&& task, ETaskPriority priority)
 {
-	s_CurrentFence++;
+	TaskGroup group;
+	queueTask(std::move(task), group.m_pCounter, priority);
+	return group;
+}
 
+TaskGroup TaskDispatcher::execute(Task&& task, const TaskGroup& group, ETaskPriority priority)
+{
+	queueTask(std::move(task), group.m_pCounter, priority);
+	return group;
+}
+
+TaskGroup TaskDispatcher::executeAfter(Task&& task, std::initializer_list<TaskGroup> dependencies, ETaskPriority priority)
+{
+	//Counts down the dependencies, the extra task makes sure it does not finish before all continuations are added
+	TaskGroup joined;
+	joined.m_pCounter->PendingTasks = uint32_t(dependencies.size()) + 1;
+
+	for (const TaskGroup& dependency : dependencies)
 	{
-		std::scoped_lock<Spinlock> lock(s_QueueLock);
-		s_TaskQueue.push(task);
-		s_WakeCondition.notify_one();
+		addContinuation(dependency.m_pCounter, Task(), joined.m_pCounter, priority);
 	}
+
+	finishTask(joined.m_pCounter);
+	return joined.then(std::move(task), priority);
 }
 
 void TaskDispatcher::waitForTasks()
 {
+	ASSERT(getWorkerContext().NoWaitDepth == 0);
+
+	QueuedTask task;
 	while (!isFinished())
 	{
-		poll();
+		if (poptask(task))
+		{
+			runTask(task);
+		}
+		else
+		{
+			std::this_thread::yield();
+		}
+	}
+}
+
+void TaskDispatcher::waitForGroup(const TaskGroup& group)
+{
+	ASSERT(getWorkerContext().NoWaitDepth == 0);
+
+	if (group.isFinished())
+	{
+		return;
+	}
+
+	QueuedTask task;
+	if (s_UseFibers && getWorkerContext().pCurrentFiber)
+	{
+		//Suspend the task and keep the worker busy with another fiber, this one is resumed when the group has finished.
+		//The fiber can not move to another pool while waiting, so the pool is the same for the whole loop
+		WorkerPool& pool = s_Pools[getWorkerContext().Pool];
+		while (!group.isFinished())
+		{
+			TaskFiber* pFiber = nullptr;
+			if (pool.ReadyFibers.pop(pFiber))
+			{
+				pool.QueuedTasks--;
+				suspendFiber(pFiber, group.m_pCounter);
+				break;
+			}
+			else if (s_FreeFibers.pop(pFiber))
+			{
+				suspendFiber(pFiber, group.m_pCounter);
+				break;
+			}
+			else if (poptask(task))
+			{
+				//Every fiber is in use, help out until one is available
+				runTask(task);
+			}
+			else
+			{
+				std::this_thread::yield();
+			}
+		}
+
+		ASSERT(group.isFinished());
+		return;
+	}
+
+	const bool isTracing = TimelineTracer::isEnabled();
+	if (isTracing)
+	{
+		TimelineTracer::record(ETraceEventType::WAIT_BEGIN, nullptr);
+	}
+
+	const bool isWorker = getWorkerContext().WorkerIndex >= 0;
+	while (!group.isFinished())
+	{
+		if (isWorker && poptask(task))
+		{
+			runTask(task);
+		}
+		else
+		{
+			std::this_thread::yield();
+		}
+	}
+
+	if (isTracing)
+	{
+		TimelineTracer::record(ETraceEventType::WAIT_END, nullptr);
 	}
 }
 
-bool TaskDispatcher::poptask(std::function<void()>& task)
+void TaskDispatcher::beginNoWait()
 {
-	std::scoped_lock<Spinlock> lock(s_QueueLock);
-	if (!s_TaskQueue.empty())
+	getWorkerContext().NoWaitDepth++;
+}
+
+void TaskDispatcher::endNoWait()
+{
+	WorkerContext& context = getWorkerContext();
+	ASSERT(context.NoWaitDepth > 0);
+	context.NoWaitDepth--;
+}
+
+ETaskPriority TaskDispatcher::getCurrentPriority()
+{
+	const WorkerContext& context = getWorkerContext();
+	return (context.WorkerIndex >= 0) ? ETaskPriority(context.Pool) : ETaskPriority::FRAME;
+}
+
+void TaskDispatcher::queueTask(Task&& task, TaskCounter* pCounter, ETaskPriority priority)
+{
+	ASSERT(pCounter != nullptr);
+
+	s_CurrentFence++;
+
+	//The queued task keeps the counter alive even if every handle is gone
+	pCounter->PendingTasks++;
+	pCounter->References++;
+
+	QueuedTask queuedTask = {};
+	queuedTask.Function = std::move(task);
+	queuedTask.pCounter = pCounter;
+
+	//Workers keep their own tasks as long as the task belongs to their pool, everything else goes through the injection queue
+	const uint32_t poolIndex		= getPoolIndex(priority);
+	WorkerPool& pool				= s_Pools[poolIndex];
+	const WorkerContext& context	= getWorkerContext();
+
+	bool queued = false;
+	if (context.WorkerIndex >= 0 && context.Pool == poolIndex)
 	{
-		task = s_TaskQueue.front();
-		s_TaskQueue.pop();
+		queued = s_WorkQueues[context.WorkerIndex].push(std::move(queuedTask));
+	}
 
+	if (!queued)
+	{
+		queued = pool.InjectionQueue.push(std::move(queuedTask));
+	}
+
+	if (!queued)
+	{
+		//Everything is full, run it here instead of growing the queues
+		runTask(queuedTask);
+		return;
+	}
+
+	pool.QueuedTasks++;
+	wakeWorker(poolIndex);
+}
+
+bool TaskDispatcher::poptask(QueuedTask& task)
+{
+	//Threads that are not workers only help out in the frame pool
+	const WorkerContext& context	= getWorkerContext();
+	const int32_t workerIndex		= context.WorkerIndex;
+	WorkerPool& pool				= s_Pools[context.Pool];
+	if (workerIndex >= 0 && s_WorkQueues[workerIndex].pop(task))
+	{
+		pool.QueuedTasks--;
+		return true;
+	}
+
+	if (pool.InjectionQueue.pop(task))
+	{
+		pool.QueuedTasks--;
 		return true;
 	}
 
+	//Steal from another worker in the same pool
+	const uint32_t numThreads	= pool.NumWorkers;
+	const uint32_t start		= (workerIndex >= 0) ? uint32_t(workerIndex) - pool.FirstWorker + 1 : 0;
+	for (uint32_t i = 0; i < numThreads; i++)
+	{
+		const uint32_t victim = pool.FirstWorker + ((start + i) % numThreads);
+		if (int32_t(victim) != workerIndex && s_WorkQueues[victim].pop(task))
+		{
+			pool.QueuedTasks--;
+			if (TimelineTracer::isEnabled())
+			{
+				TimelineTracer::record(ETraceEventType::STEAL, task.Function.getName(), victim);
+			}
+
+			return true;
+		}
+	}
+
 	return false;
 }
 
-void TaskDispatcher::poll()
+void TaskDispatcher::runTask(QueuedTask& task)
+{
+	//The name of the running task is kept so that a fiber that suspends knows what it ends and later begins again
+	const bool isTracing = TimelineTracer::isEnabled();
+	const char* pName = task.Function.getName();
+	const char* pPreviousName = nullptr;
+	if (isTracing)
+	{
+		WorkerContext& context = getWorkerContext();
+		pPreviousName = context.pTaskName;
+		context.pTaskName = pName;
+		TimelineTracer::record(ETraceEventType::BEGIN, pName);
+	}
+
+#if TRACK_ALLOCATIONS
+	//A task run by a thread that waits is not part of what the waiting code allocates
+	AllocationScope* pWaitingScope = AllocationCounter::exchangeScope(nullptr);
+#endif
+
+	task.Function();
+	task.Function.reset();
+
+#if TRACK_ALLOCATIONS
+	AllocationCounter::exchangeScope(pWaitingScope);
+#endif
+
+	if (isTracing)
+	{
+		//The fiber may have moved to another thread while the task was running
+		TimelineTracer::record(ETraceEventType::END, pName);
+		getWorkerContext().pTaskName = pPreviousName;
+	}
+
+	finishTask(task.pCounter);
+	releaseCounter(task.pCounter);
+	task.pCounter = nullptr;
+
+	s_FinishedFence.fetch_add(1);
+}
+
+void TaskDispatcher::wakeWorker(uint32_t pool)
+{
+	//Only pay for the notify when someone is actually asleep
+	if (s_Pools[pool].SleepingWorkers.load() > 0)
+	{
+		std::scoped_lock<std::mutex> lock(s_EventMutex);
+		s_Pools[pool].WakeCondition.notify_one();
+	}
+}
+
+TaskCounter* TaskDispatcher::acquireCounter()
+{
+	{
+		std::scoped_lock<Spinlock> lock(s_CounterLock);
+		if (s_pFreeCounters)
+		{
+			TaskCounter* pCounter = s_pFreeCounters;
+			s_pFreeCounters = pCounter->pNext;
+
+			pCounter->pNext = nullptr;
+			pCounter->References = 1;
+			pCounter->PendingTasks = 0;
+			return pCounter;
+		}
+	}
+
+	return DBG_NEW TaskCounter();
+}
+
+void TaskDispatcher::releaseCounter(TaskCounter* pCounter)
+{
+	if (pCounter->References.fetch_sub(1) != 1)
+	{
+		return;
+	}
+
+	//Nothing references the counter anymore so the continuations can not be run
+	ASSERT(pCounter->Continuations.empty());
+
+	std::scoped_lock<Spinlock> lock(s_CounterLock);
+	pCounter->pNext = s_pFreeCounters;
+	s_pFreeCounters = pCounter;
+}
+
+void TaskDispatcher::finishTask(TaskCounter* pCounter)
+{
+	if (pCounter->PendingTasks.fetch_sub(1) != 1)
+	{
+		return;
+	}
+
+	//Tasks can be added to the group again after it finished, in that case the continuations waits for those as well
+	std::vector<TaskContinuation> continuations;
+	TaskFiber* pWaitingFibers = nullptr;
+	{
+		std::scoped_lock<Spinlock> lock(pCounter->Lock);
+		if (pCounter->PendingTasks.load() == 0)
+		{
+			continuations.swap(pCounter->Continuations);
+			std::swap(pWaitingFibers, pCounter->pWaitingFibers);
+		}
+	}
+
+	while (pWaitingFibers)
+	{
+		TaskFiber* pFiber = pWaitingFibers;
+		pWaitingFibers = pFiber->pNextWaiting;
+		pFiber->pNextWaiting = nullptr;
+
+		//The fiber is resumed by the pool it was suspended in
+		const uint32_t pool = pFiber->Pool;
+		s_Pools[pool].ReadyFibers.push(std::move(pFiber));
+		s_Pools[pool].QueuedTasks++;
+		wakeWorker(pool);
+	}
+
+	for (TaskContinuation& continuation : continuations)
+	{
+		runContinuation(continuation);
+	}
+}
+
+void TaskDispatcher::addContinuation(TaskCounter* pCounter, Task&& task, TaskCounter* pGroup, ETaskPriority priority)
+{
+	TaskContinuation continuation = {};
+	continuation.Function	= std::move(task);
+	continuation.pGroup		= pGroup;
+	continuation.Priority	= priority;
+	pGroup->References++;
+
+	{
+		std::scoped_lock<Spinlock> lock(pCounter->Lock);
+		if (pCounter->PendingTasks.load() > 0)
+		{
+			pCounter->Continuations.emplace_back(std::move(continuation));
+			return;
+		}
+	}
+
+	runContinuation(continuation);
+}
+
+void TaskDispatcher::runContinuation(TaskContinuation& continuation)
+{
+	if (continuation.Function)
+	{
+		queueTask(std::move(continuation.Function), continuation.pGroup, continuation.Priority);
+	}
+
+	finishTask(continuation.pGroup);
+	releaseCounter(continuation.pGroup);
+	continuation.pGroup = nullptr;
+}
+
+void TaskDispatcher::switchFiber(TaskFiber* pFiber, EFiberAction action, TaskCounter* pCounter)
+{
+	//A null fiber means the fiber that the worker thread started on
+	WorkerContext& context = getWorkerContext();
+	Fiber* pThreadFiber = &s_ThreadFibers[context.WorkerIndex];
+	Fiber* pCurrent		= context.pCurrentFiber ? &context.pCurrentFiber->Context : pThreadFiber;
+	Fiber* pNext		= pFiber ? &pFiber->Context : pThreadFiber;
+
+	//The action is carried out by the next fiber, if it happened here another thread could resume this fiber before it has stopped running
+	context.Action			= action;
+	context.pActionFiber	= context.pCurrentFiber;
+	context.pActionCounter	= pCounter;
+	context.pCurrentFiber	= pFiber;
+	pCurrent->switchTo(pNext);
+
+	//Resumed, possibly on another thread
+	handleFiberAction();
+}
+
+void TaskDispatcher::suspendFiber(TaskFiber* pFiber, TaskCounter* pCounter)
+{
+	//The name is kept on the fiber's stack since the context belongs to the thread and not the task
+	const char* pTaskName	= getWorkerContext().pTaskName;
+	const bool isTracing	= TimelineTracer::isEnabled() && pTaskName;
+	if (isTracing)
+	{
+		TimelineTracer::record(ETraceEventType::END, pTaskName);
+		TimelineTracer::record(ETraceEventType::SUSPEND, pTaskName);
+	}
+
+#if TRACK_ALLOCATIONS
+	//The allocation scope belongs to the task and not the thread, it continues on the thread that resumes the fiber
+	AllocationScope* pScope = AllocationCounter::exchangeScope(nullptr);
+#endif
+
+	switchFiber(pFiber, EFiberAction::WAIT, pCounter);
+
+#if TRACK_ALLOCATIONS
+	AllocationCounter::exchangeScope(pScope);
+#endif
+
+	if (isTracing)
+	{
+		getWorkerContext().pTaskName = pTaskName;
+		TimelineTracer::record(ETraceEventType::RESUME, pTaskName);
+		TimelineTracer::record(ETraceEventType::BEGIN, pTaskName);
+	}
+}
+
+void TaskDispatcher::handleFiberAction()
+{
+	WorkerContext& context = getWorkerContext();
+	TaskFiber* pFiber		= context.pActionFiber;
+	TaskCounter* pCounter	= context.pActionCounter;
+
+	if (context.Action == EFiberAction::FREE)
+	{
+		s_FreeFibers.push(std::move(pFiber));
+	}
+	else if (context.Action == EFiberAction::WAIT)
+	{
+		pFiber->Pool = context.Pool;
+
+		bool isReady = true;
+		{
+			std::scoped_lock<Spinlock> lock(pCounter->Lock);
+			if (pCounter->PendingTasks.load() > 0)
+			{
+				pFiber->pNextWaiting = pCounter->pWaitingFibers;
+				pCounter->pWaitingFibers = pFiber;
+				isReady = false;
+			}
+		}
+
+		if (isReady)
+		{
+			s_Pools[context.Pool].ReadyFibers.push(std::move(pFiber));
+			s_Pools[context.Pool].QueuedTasks++;
+		}
+	}
+
+	context.Action			= EFiberAction::NONE;
+	context.pActionFiber	= nullptr;
+	context.pActionCounter	= nullptr;
+}
+
+void TaskDispatcher::fiberMain(void*)
 {
-	s_WakeCondition.notify_one();
-	std::this_thread::yield();
+	handleFiberAction();
+	workerLoop();
+
+	//Give the thread back to the worker so that it can exit
+	switchFiber(nullptr, EFiberAction::FREE, nullptr);
 }
 
-void TaskDispatcher::taskThread()
+void TaskDispatcher::workerLoop()
 {
+	QueuedTask task;
+	uint32_t spinCount = 0;
 	while (shouldRunWorker())
 	{
-		std::function<void()> task;
-		if (poptask(task))
+		//A pooled fiber can continue here on a worker from the other pool, so the pool is looked up every time
+		WorkerPool& pool = s_Pools[getWorkerContext().Pool];
+
+		//Resuming a suspended task comes first, this fiber goes back to the pool and continues from here the next time it is used
+		TaskFiber* pFiber = nullptr;
+		if (s_UseFibers && pool.ReadyFibers.pop(pFiber))
 		{
-			task();
-			s_FinishedFence.fetch_add(1);
+			pool.QueuedTasks--;
+			switchFiber(pFiber, EFiberAction::FREE, nullptr);
+			spinCount = 0;
+		}
+		else if (poptask(task))
+		{
+			runTask(task);
+			spinCount = 0;
+		}
+		else if (spinCount < WORKER_SPIN_COUNT)
+		{
+			spinCount++;
+			std::this_thread::yield();
 		}
 		else
 		{
+			//The task counter is checked while holding the mutex so that a wake up cannot be missed
 			std::unique_lock<std::mutex> lock(s_EventMutex);
-			s_WakeCondition.wait(lock);
+			pool.SleepingWorkers++;
+			pool.WakeCondition.wait(lock, [&pool]
+				{
+					return pool.QueuedTasks.load() > 0 || !shouldRunWorker();
+				});
+			pool.SleepingWorkers--;
+
+			spinCount = 0;
 		}
 	}
+}
+
+void TaskDispatcher::taskThread(uint32_t workerIndex, uint32_t pool)
+{
+	getWorkerContext().WorkerIndex	= int32_t(workerIndex);
+	getWorkerContext().Pool			= pool;
+
+	char threadName[32];
+	snprintf(threadName, sizeof(threadName), "%s Worker %u", (pool == uint32_t(ETaskPriority::FRAME)) ? "Frame" : "Background", workerIndex - s_Pools[pool].FirstWorker);
+	TimelineTracer::setThreadName(threadName);
+
+	if (s_UseFibers)
+	{
+		//The thread's own fiber only starts the first pooled fiber and waits for it to hand the thread back
+		TaskFiber* pFiber = nullptr;
+		if (s_ThreadFibers[workerIndex].initFromCurrentThread() && s_FreeFibers.pop(pFiber))
+		{
+			switchFiber(pFiber, EFiberAction::NONE, nullptr);
+		}
+		else
+		{
+			LOG("TaskManager: Failed to start worker %u on a fiber", workerIndex);
+		}
+
+		s_ThreadFibers[workerIndex].release();
+	}
+	else
+	{
+		workerLoop();
+	}
 
 	LOG("Shutting down worker");
 }
+
+TaskDispatcher::WorkerContext& TaskDispatcher::getWorkerContext()
+{
+	return s_WorkerContext;
+}
+
+TaskGroup::TaskGroup()
+	: m_pCounter(TaskDispatcher::acquireCounter())
+{
+}
+
+TaskGroup::TaskGroup(const TaskGroup& other)
+	: m_pCounter(other.m_pCounter)
+{
+	if (m_pCounter)
+	{
+		m_pCounter->References++;
+	}
+}
+
+TaskGroup::TaskGroup(TaskGroup&& other) noexcept
+	: m_pCounter(other.m_pCounter)
+{
+	other.m_pCounter = nullptr;
+}
+
+TaskGroup::~TaskGroup()
+{
+	if (m_pCounter)
+	{
+		TaskDispatcher::releaseCounter(m_pCounter);
+		m_pCounter = nullptr;
+	}
+}
+
+TaskGroup& TaskGroup::operator=(const TaskGroup& other)
+{
+	if (this != &other)
+	{
+		TaskGroup copy(other);
+		std::swap(m_pCounter, copy.m_pCounter);
+	}
+
+	return *this;
+}
+
+TaskGroup& TaskGroup::operator=(TaskGroup&& other) noexcept
+{
+	if (this != &other)
+	{
+		std::swap(m_pCounter, other.m_pCounter);
+	}
+
+	return *this;
+}
+
+void TaskGroup::wait() const
+{
+	TaskDispatcher::waitForGroup(*this);
+}
+
+TaskGroup TaskGroup::then(Task&& task, ETaskPriority priority) const
+{
+	//The next group counts as unfinished until task has been queued
+	TaskGroup next;
+	next.m_pCounter->PendingTasks = 1;
+
+	TaskDispatcher::addContinuation(m_pCounter, std::move(task), next.m_pCounter, priority);
+	return next;
+}
@@ -1,57 +1,333 @@
 #pragma once
+#include "Task.h"
+#include "Fiber.h"
 #include "Spinlock.h"
+#include "TimelineTracer.h"
+#include "MPMCQueue.h"
 
-#include <queue>
 #include <mutex>
 #include <vector>
 #include <atomic>
 #include <thread>
-#include <functional>
+#include <initializer_list>
 #include <condition_variable>
 
 #define MAX_THREADS 16U
 
+//Capacity of the queues, tasks are executed directly on the calling thread when they are full
+#define WORKER_QUEUE_SIZE		4096U
+#define INJECTION_QUEUE_SIZE	16384U
+
+//Fibers used when running with fibers enabled, waiting falls back to helping on the current stack when all are in use
+#define FIBER_COUNT			128U
+#define FIBER_STACK_SIZE	(512 * 1024)
+
+//Upper limit on the number of chunks parallelFor and parallelReduce splits a range into
+#define MAX_PARALLEL_CHUNKS (MAX_THREADS * 4U)
+
+//Each priority has its own pool of workers
+enum class ETaskPriority : uint32_t
+{
+	//Work the current frame waits for, like recording command buffers
+	FRAME		= 0,
+	//Streaming and I/O, kept on a small separate pool so that a long decode never delays the frame
+	BACKGROUND	= 1
+};
+
+#define TASK_PRIORITY_COUNT 2U
+
+struct TaskCounter;
+
+//Pooled fiber that runs the worker loop, tasks that wait on a group suspend the fiber they run on
+struct TaskFiber
+{
+	Fiber Context;
+	TaskFiber* pNextWaiting = nullptr;
+	uint32_t Pool = 0;
+};
+
+//Task that is queued when a group finishes, pGroup is finished after the task has been queued
+struct TaskContinuation
+{
+	Task Function;
+	TaskCounter* pGroup = nullptr;
+	ETaskPriority Priority = ETaskPriority::FRAME;
+};
+
+//Shared state of a TaskGroup, returned to a pool when the last handle or queued task lets go of it
+struct TaskCounter
+{
+	std::atomic<uint32_t> References		= 1;
+	std::atomic<uint32_t> PendingTasks	= 0;
+	std::vector<TaskContinuation> Continuations;
+	TaskFiber* pWaitingFibers = nullptr;
+	Spinlock Lock;
+	TaskCounter* pNext = nullptr;
+};
+
+//Handle to a set of tasks that can be waited on without waiting for every task in the dispatcher
+class TaskGroup
+{
+	friend class TaskDispatcher;
+
+public:
+	TaskGroup();
+	TaskGroup(const TaskGroup& other);
+	TaskGroup(TaskGroup&& other) noexcept;
+	~TaskGroup();
+
+	TaskGroup& operator=(const TaskGroup& other);
+	TaskGroup& operator=(TaskGroup&& other) noexcept;
+
+	//Waits until all tasks in the group have finished
+	void wait() const;
+	//Queues task when all tasks in the group have finished, the returned group contains task
+	TaskGroup then(Task&& task, ETaskPriority priority = ETaskPriority::FRAME) const;
+
+	FORCEINLINE bool isFinished() const
+	{
+		return m_pCounter ? (m_pCounter->PendingTasks.load() == 0) : true;
+	}
+
+private:
+	TaskCounter* m_pCounter;
+};
+
 class TaskDispatcher
 {
+	friend class TaskGroup;
+
+	struct QueuedTask
+	{
+		Task Function;
+		TaskCounter* pCounter = nullptr;
+	};
+
+	//What the next fiber should do with the fiber that switched to it
+	enum class EFiberAction
+	{
+		NONE,
+		FREE,
+		WAIT
+	};
+
+	struct WorkerPool
+	{
+		//Tasks from threads that are not workers in this pool ends up here
+		MPMCQueue<QueuedTask> InjectionQueue;
+		//Suspended fibers whose group has finished, workers resume these before starting new tasks
+		MPMCQueue<TaskFiber*> ReadyFibers;
+		std::condition_variable WakeCondition;
+		std::atomic<uint32_t> SleepingWorkers	= 0;
+		std::atomic<uint64_t> QueuedTasks		= 0;
+		uint32_t FirstWorker	= 0;
+		uint32_t NumWorkers		= 0;
+	};
+
+	struct WorkerContext
+	{
+		int32_t WorkerIndex			= -1;
+		uint32_t Pool				= 0;
+		TaskFiber* pCurrentFiber	= nullptr;
+		EFiberAction Action			= EFiberAction::NONE;
+		TaskFiber* pActionFiber		= nullptr;
+		TaskCounter* pActionCounter = nullptr;
+		//Only kept while the timeline is recorded
+		const char* pTaskName		= nullptr;
+		//Open scopes that may not wait, see beginNoWait
+		uint32_t NoWaitDepth		= 0;
+	};
+
 public:
 	DECL_STATIC_CLASS(TaskDispatcher);
 
-	static bool init();
+	//Zero threads means one frame worker per hardware thread. With fibers a task waiting on a group is suspended instead of blocking its worker.
+	//Background tasks get numBackgroundThreads workers of their own, with zero they share the frame workers
+	static bool init(uint32_t numThreads = 0, bool useFibers = false, uint32_t numBackgroundThreads = 0);
 	static void release();
 
-	//Excutes a task in a seperate thread
-	static void execute(const std::function<void()>& task);
-	//Makes sure that all queued up tasks have been completed
+	//Excutes a task in a seperate thread, returns a new group containing only this task
+	static TaskGroup execute(Task&& task, ETaskPriority priority = ETaskPriority::FRAME);
+	//Excutes a task in a seperate thread as part of group
+	static TaskGroup execute(Task&& task, const TaskGroup& group, ETaskPriority priority = ETaskPriority::FRAME);
+	//Excutes a task when all the dependencies have finished
+	static TaskGroup executeAfter(Task&& task, std::initializer_list<TaskGroup> dependencies, ETaskPriority priority = ETaskPriority::FRAME);
+
+	//Calls func(index) for every index in [begin, end). The range is split into chunks of at least grainSize and the calling thread runs the first chunk itself.
+	//The chunks runs in the pool of the calling thread, so a loop in a background task stays in the background
+	template<typename TFunc>
+	static void parallelFor(uint32_t begin, uint32_t end, uint32_t grainSize, const TFunc& func)
+	{
+		const ETaskPriority priority	= getCurrentPriority();
+		const uint32_t chunkCount		= calculateChunkCount(begin, end, grainSize, priority);
+		if (chunkCount <= 1)
+		{
+			for (uint32_t i = begin; i < end; i++)
+			{
+				func(i);
+			}
+
+			return;
+		}
+
+		const uint32_t chunkSize = ((end - begin) + chunkCount - 1) / chunkCount;
+
+		TaskGroup group;
+		for (uint32_t chunk = 1; chunk < chunkCount; chunk++)
+		{
+			const uint32_t chunkBegin	= begin + chunk * chunkSize;
+			const uint32_t chunkEnd		= std::min(chunkBegin + chunkSize, end);
+			execute(Task("Parallel For", [&func, chunkBegin, chunkEnd]
+				{
+					for (uint32_t i = chunkBegin; i < chunkEnd; i++)
+					{
+						func(i);
+					}
+				}), group, priority);
+		}
+
+		for (uint32_t i = begin; i < begin + chunkSize; i++)
+		{
+			func(i);
+		}
+
+		group.wait();
+	}
+
+	//Reduces func(index) for every index in [begin, end) with reduce(a, b). The partial results are combined in index order, so the result is the same for any number of threads
+	template<typename T, typename TFunc, typename TReduce>
+	static T parallelReduce(uint32_t begin, uint32_t end, uint32_t grainSize, const T& identity, const TFunc& func, const TReduce& reduce)
+	{
+		const uint32_t chunkCount	= std::max(calculateChunkCount(begin, end, grainSize, getCurrentPriority()), 1U);
+		const uint32_t chunkSize	= ((end - begin) + chunkCount - 1) / chunkCount;
+
+		T partials[MAX_PARALLEL_CHUNKS];
+		parallelFor(0, chunkCount, 1, [&](uint32_t chunk)
+			{
+				const uint32_t chunkBegin	= begin + chunk * chunkSize;
+				const uint32_t chunkEnd		= std::min(chunkBegin + chunkSize, end);
+
+				T result = identity;
+				for (uint32_t i = chunkBegin; i < chunkEnd; i++)
+				{
+					result = reduce(result, func(i));
+				}
+
+				partials[chunk] = result;
+			});
+
+		T result = identity;
+		for (uint32_t chunk = 0; chunk < chunkCount; chunk++)
+		{
+			result = reduce(result, partials[chunk]);
+		}
+
+		return result;
+	}
+
+	//Makes sure that all queued up tasks have been completed, the calling thread helps out while waiting
 	static void waitForTasks();
+	//Waits for the tasks in a single group. Tasks suspend when fibers are enabled and can resume on another thread, so no locks may be held while waiting.
+	//Without fibers only worker threads help out since the calling thread could pick up an unrelated long task
+	static void waitForGroup(const TaskGroup& group);
+
+	//Code that keeps state in thread_locals from beginNoWait to endNoWait may not wait for tasks in between, since with fibers it
+	//could continue on another thread. Waiting inside is asserted against, whether or not the group has finished yet
+	static void beginNoWait();
+	static void endNoWait();
 
 	static FORCEINLINE bool isFinished()
 	{
-		return (s_CurrentFence <= s_FinishedFence.load());
+		return (s_CurrentFence.load() <= s_FinishedFence.load());
 	}
 
 	static FORCEINLINE bool shouldRunWorker()
 	{
-		return s_RunWorkers;
+		return s_RunWorkers.load();
+	}
+
+	static FORCEINLINE uint32_t getThreadCount(ETaskPriority priority = ETaskPriority::FRAME)
+	{
+		return s_Pools[getPoolIndex(priority)].NumWorkers;
+	}
+
+	//Threads that are not workers counts as frame threads
+	static ETaskPriority getCurrentPriority();
+
+	static FORCEINLINE bool isUsingFibers()
+	{
+		return s_UseFibers;
 	}
 
 private:
-	static bool poptask(std::function<void()>& task);
-	static void poll();
+	//Background tasks use the frame pool when there are no background workers
+	static FORCEINLINE uint32_t getPoolIndex(ETaskPriority priority)
+	{
+		const uint32_t pool = uint32_t(priority);
+		return (s_Pools[pool].NumWorkers > 0) ? pool : uint32_t(ETaskPriority::FRAME);
+	}
+
+	static FORCEINLINE uint32_t calculateChunkCount(uint32_t begin, uint32_t end, uint32_t grainSize, ETaskPriority priority)
+	{
+		const uint32_t numWorkers = getThreadCount(priority);
+		if (end <= begin)
+		{
+			return 0;
+		}
+		else if (numWorkers == 0)
+		{
+			return 1;
+		}
+
+		//A few chunks per worker so that uneven chunks even out
+		const uint32_t count	= end - begin;
+		const uint32_t maxCount = (count + std::max(grainSize, 1U) - 1) / std::max(grainSize, 1U);
+		return std::min(std::min(maxCount, numWorkers * 4U), MAX_PARALLEL_CHUNKS);
+	}
+
+	static void queueTask(Task&& task, TaskCounter* pCounter, ETaskPriority priority);
+	static bool poptask(QueuedTask& task);
+	static void runTask(QueuedTask& task);
+	static void wakeWorker(uint32_t pool);
 
-	static void taskThread();
+	static TaskCounter* acquireCounter();
+	static void releaseCounter(TaskCounter* pCounter);
+	static void finishTask(TaskCounter* pCounter);
+	static void addContinuation(TaskCounter* pCounter, Task&& task, TaskCounter* pGroup, ETaskPriority priority);
+	static void runContinuation(TaskContinuation& continuation);
+
+	static void switchFiber(TaskFiber* pFiber, EFiberAction action, TaskCounter* pCounter);
+	//Switches to another fiber and parks this one until the counter reaches zero
+	static void suspendFiber(TaskFiber* pFiber, TaskCounter* pCounter);
+	static void handleFiberAction();
+	static void fiberMain(void* pUserData);
+
+	static void workerLoop();
+	static void taskThread(uint32_t workerIndex, uint32_t pool);
+
+	//Fibers can move between threads, so the thread locals have to be looked up again after every switch
+	static NOINLINE WorkerContext& getWorkerContext();
 
 private:
 	static std::vector<std::thread> s_Threads;
 
-	static std::queue<std::function<void()>> s_TaskQueue;
-	static Spinlock s_QueueLock;
-	
+	//Workers push to their own queue and steal from the others in the same pool when it is empty
+	static MPMCQueue<QueuedTask> s_WorkQueues[MAX_THREADS];
+	static WorkerPool s_Pools[TASK_PRIORITY_COUNT];
+	static thread_local WorkerContext s_WorkerContext;
+
+	static bool s_UseFibers;
+	static TaskFiber* s_pFibers;
+	static Fiber s_ThreadFibers[MAX_THREADS];
+	static MPMCQueue<TaskFiber*> s_FreeFibers;
+
+	static TaskCounter* s_pFreeCounters;
+	static Spinlock s_CounterLock;
+
 	static std::mutex s_EventMutex;
-	static std::condition_variable s_WakeCondition;
-	
+
 	static std::atomic<uint64_t> s_FinishedFence;
-	static uint64_t s_CurrentFence;
-	
-	static bool s_RunWorkers;
-};
+	static std::atomic<uint64_t> s_CurrentFence;
 
+	static std::atomic<bool> s_RunWorkers;
+};
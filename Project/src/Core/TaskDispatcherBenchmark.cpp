@@ -0,0 +1,569 @@
+#include "TaskDispatcherBenchmark.h"
+#include "TaskDispatcher.h"
+#include "AllocationCounter.h"
+
+#include <queue>
+#include <chrono>
+#include <fstream>
+#include <algorithm>
+#include <functional>
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#define BENCHMARK_TASK_COUNT	65536U
+#define BENCHMARK_ROOT_TASKS	64U
+#define BENCHMARK_OBJECT_COUNT	100000U
+#define BENCHMARK_REPETITIONS	16U
+
+#define ALLOCATION_CHECK_WARMUP_FRAMES	16U
+#define ALLOCATION_CHECK_FRAMES			1000U
+#define ALLOCATION_CHECK_FRAME_TASKS	64U
+
+using BenchmarkClock = std::chrono::high_resolution_clock;
+
+enum class EScenario
+{
+	FLAT	= 0,
+	NESTED	= 1,
+	WAITING	= 2
+};
+
+struct BenchmarkResult
+{
+	double TasksPerSecond	= 0.0;
+	float MedianLatency		= 0.0f;
+	float P99Latency		= 0.0f;
+	float P999Latency		= 0.0f;
+	float MaxLatency		= 0.0f;
+	float AllocationsPerTask	= 0.0f;
+};
+
+//The single queue dispatcher that the work stealing one replaced, kept as a baseline
+class GlobalQueueDispatcher
+{
+public:
+	GlobalQueueDispatcher() = default;
+	~GlobalQueueDispatcher() = default;
+
+	DECL_NO_COPY(GlobalQueueDispatcher);
+
+	static const char* getName() { return "GlobalQueue"; }
+
+	//Waiting on other tasks blocks a worker for good, with few workers it never finishes
+	static constexpr bool SUPPORTS_WAITING = false;
+
+	void start(uint32_t numThreads)
+	{
+		m_RunWorkers = true;
+		for (uint32_t i = 0; i < numThreads; i++)
+		{
+			m_Threads.emplace_back([this] { taskThread(); });
+		}
+	}
+
+	void stop()
+	{
+		wait();
+
+		{
+			std::scoped_lock<std::mutex> lock(m_EventMutex);
+			m_RunWorkers = false;
+			m_WakeCondition.notify_all();
+		}
+
+		for (std::thread& thread : m_Threads)
+		{
+			thread.join();
+		}
+
+		m_Threads.clear();
+	}
+
+	template<typename TFunc>
+	void execute(TFunc&& task)
+	{
+		m_CurrentFence++;
+
+		{
+			std::scoped_lock<Spinlock> lock(m_QueueLock);
+			m_TaskQueue.push(std::forward<TFunc>(task));
+			m_WakeCondition.notify_one();
+		}
+	}
+
+	void wait()
+	{
+		while (m_CurrentFence.load() > m_FinishedFence.load())
+		{
+			m_WakeCondition.notify_one();
+			std::this_thread::yield();
+		}
+	}
+
+private:
+	void taskThread()
+	{
+		while (m_RunWorkers)
+		{
+			std::function<void()> task;
+			bool hasTask = false;
+
+			{
+				std::scoped_lock<Spinlock> lock(m_QueueLock);
+				if (!m_TaskQueue.empty())
+				{
+					task = m_TaskQueue.front();
+					m_TaskQueue.pop();
+					hasTask = true;
+				}
+			}
+
+			if (hasTask)
+			{
+				task();
+				m_FinishedFence++;
+			}
+			else
+			{
+				std::unique_lock<std::mutex> lock(m_EventMutex);
+				if (m_RunWorkers)
+				{
+					m_WakeCondition.wait(lock);
+				}
+			}
+		}
+	}
+
+private:
+	std::vector<std::thread> m_Threads;
+	std::queue<std::function<void()>> m_TaskQueue;
+	Spinlock m_QueueLock;
+	std::mutex m_EventMutex;
+	std::condition_variable m_WakeCondition;
+	std::atomic<uint64_t> m_FinishedFence = 0;
+	std::atomic<uint64_t> m_CurrentFence = 0;
+	std::atomic<bool> m_RunWorkers = false;
+};
+
+template<bool USE_FIBERS>
+class WorkStealingDispatcher
+{
+public:
+	static const char* getName() { return USE_FIBERS ? "WorkStealingFibers" : "WorkStealing"; }
+
+	static constexpr bool SUPPORTS_WAITING = true;
+
+	void start(uint32_t numThreads)	{ TaskDispatcher::init(numThreads, USE_FIBERS); }
+	void stop()						{ TaskDispatcher::release(); }
+	void wait()						{ TaskDispatcher::waitForTasks(); }
+
+	template<typename TFunc>
+	void execute(TFunc&& task)
+	{
+		TaskDispatcher::execute(Task(std::forward<TFunc>(task)));
+	}
+};
+
+//A little bit of work so that the tasks are not completely free
+static void doWork(uint32_t seed)
+{
+	volatile uint32_t value = seed;
+	for (uint32_t i = 0; i < 256; i++)
+	{
+		value = value * 1664525U + 1013904223U;
+	}
+}
+
+template<typename TDispatcher>
+static BenchmarkResult runScenario(TDispatcher& dispatcher, EScenario scenario)
+{
+	std::vector<BenchmarkClock::time_point> queuedTimes(BENCHMARK_TASK_COUNT);
+	std::vector<float> latencies(BENCHMARK_TASK_COUNT);
+
+	auto executeTask = [&](uint32_t index)
+	{
+		queuedTimes[index] = BenchmarkClock::now();
+		dispatcher.execute([&, index]
+			{
+				std::chrono::duration<float, std::micro> latency = BenchmarkClock::now() - queuedTimes[index];
+				latencies[index] = latency.count();
+
+				doWork(index);
+			});
+	};
+
+	const uint64_t startAllocations = AllocationCounter::getTotalAllocations();
+	const BenchmarkClock::time_point startTime = BenchmarkClock::now();
+	constexpr uint32_t tasksPerRoot = BENCHMARK_TASK_COUNT / BENCHMARK_ROOT_TASKS;
+	if (scenario == EScenario::NESTED)
+	{
+		//Tasks queued from other tasks, the same way SceneVK::loadFromFile queues up texture loads
+		for (uint32_t root = 0; root < BENCHMARK_ROOT_TASKS; root++)
+		{
+			dispatcher.execute([&, root]
+				{
+					for (uint32_t i = 0; i < tasksPerRoot; i++)
+					{
+						executeTask(root * tasksPerRoot + i);
+					}
+				});
+		}
+	}
+	else if (scenario == EScenario::WAITING)
+	{
+		//Every root task waits for its children in small batches, like a loader waiting for each step of an asset
+		if constexpr (TDispatcher::SUPPORTS_WAITING)
+		{
+			constexpr uint32_t batchSize = 16;
+			for (uint32_t root = 0; root < BENCHMARK_ROOT_TASKS; root++)
+			{
+				dispatcher.execute([&, root]
+					{
+						for (uint32_t i = 0; i < tasksPerRoot; i += batchSize)
+						{
+							TaskGroup batch;
+							for (uint32_t j = 0; j < batchSize; j++)
+							{
+								const uint32_t index = root * tasksPerRoot + i + j;
+								queuedTimes[index] = BenchmarkClock::now();
+								TaskDispatcher::execute([&, index]
+									{
+										std::chrono::duration<float, std::micro> latency = BenchmarkClock::now() - queuedTimes[index];
+										latencies[index] = latency.count();
+
+										doWork(index);
+									}, batch);
+							}
+
+							batch.wait();
+						}
+					});
+			}
+		}
+	}
+	else
+	{
+		for (uint32_t i = 0; i < BENCHMARK_TASK_COUNT; i++)
+		{
+			executeTask(i);
+		}
+	}
+
+	dispatcher.wait();
+
+	std::chrono::duration<double> elapsed = BenchmarkClock::now() - startTime;
+	const uint64_t allocations = AllocationCounter::getTotalAllocations() - startAllocations;
+	std::sort(latencies.begin(), latencies.end());
+
+	BenchmarkResult result = {};
+	result.TasksPerSecond	= double(BENCHMARK_TASK_COUNT) / elapsed.count();
+	result.MedianLatency	= latencies[latencies.size() / 2];
+	result.P99Latency		= latencies[(latencies.size() * 99) / 100];
+	result.P999Latency		= latencies[(latencies.size() * 999) / 1000];
+	result.MaxLatency		= latencies.back();
+	result.AllocationsPerTask	= float(allocations) / float(BENCHMARK_TASK_COUNT);
+	return result;
+}
+
+template<typename TDispatcher>
+static void runDispatcher(uint32_t numThreads, std::ofstream& fileStream)
+{
+	TDispatcher dispatcher;
+	dispatcher.start(numThreads);
+
+	const char* pScenarios[] = { "Flat", "Nested", "Waiting" };
+	for (uint32_t scenario = 0; scenario < 3; scenario++)
+	{
+		if (EScenario(scenario) == EScenario::WAITING && !TDispatcher::SUPPORTS_WAITING)
+		{
+			continue;
+		}
+
+		//First round warms up the threads and the allocator
+		runScenario(dispatcher, EScenario(scenario));
+		BenchmarkResult result = runScenario(dispatcher, EScenario(scenario));
+
+		LOG("%s %s [%u workers]: %.0f tasks/s, p50=%.2fus p99=%.2fus p99.9=%.2fus max=%.2fus, %.2f allocations/task", TDispatcher::getName(), pScenarios[scenario], numThreads,
+			result.TasksPerSecond, result.MedianLatency, result.P99Latency, result.P999Latency, result.MaxLatency, result.AllocationsPerTask);
+
+		fileStream << TDispatcher::getName() << "\t" << pScenarios[scenario] << "\t" << numThreads << "\t";
+		fileStream << result.TasksPerSecond << "\t" << result.MedianLatency << "\t" << result.P99Latency << "\t";
+		fileStream << result.P999Latency << "\t" << result.MaxLatency << "\t" << result.AllocationsPerTask << std::endl;
+	}
+
+	dispatcher.stop();
+}
+
+void TaskDispatcherBenchmark::run(const std::string& filepath)
+{
+	std::ofstream fileStream;
+	fileStream.open(filepath);
+	if (!fileStream.is_open())
+	{
+		LOG("TaskDispatcherBenchmark: Failed to open '%s'", filepath.c_str());
+		return;
+	}
+
+	fileStream << "Dispatcher\tScenario\tWorkers\tTasksPerSecond\tP50(us)\tP99(us)\tP99.9(us)\tMax(us)\tAllocationsPerTask" << std::endl;
+	for (uint32_t numThreads = 1; numThreads <= MAX_THREADS; numThreads *= 2)
+	{
+		runDispatcher<GlobalQueueDispatcher>(numThreads, fileStream);
+		runDispatcher<WorkStealingDispatcher<false>>(numThreads, fileStream);
+		runDispatcher<WorkStealingDispatcher<true>>(numThreads, fileStream);
+	}
+
+	fileStream.close();
+	LOG("TaskDispatcherBenchmark: Results written to '%s'", filepath.c_str());
+}
+
+struct BenchmarkObject
+{
+	glm::vec3 Position;
+	glm::vec3 Rotation;
+	glm::vec3 Scale;
+	glm::mat4 Transform;
+};
+
+struct BenchmarkBounds
+{
+	glm::vec3 Min = glm::vec3(std::numeric_limits<float>::max());
+	glm::vec3 Max = glm::vec3(std::numeric_limits<float>::lowest());
+};
+
+static void updateObject(BenchmarkObject& object)
+{
+	glm::mat4 transform = glm::translate(glm::mat4(1.0f), object.Position);
+	transform = glm::rotate(transform, object.Rotation.x, glm::vec3(1.0f, 0.0f, 0.0f));
+	transform = glm::rotate(transform, object.Rotation.y, glm::vec3(0.0f, 1.0f, 0.0f));
+	transform = glm::rotate(transform, object.Rotation.z, glm::vec3(0.0f, 0.0f, 1.0f));
+	object.Transform = glm::scale(transform, object.Scale);
+}
+
+static BenchmarkBounds combineBounds(const BenchmarkBounds& first, const BenchmarkBounds& second)
+{
+	BenchmarkBounds bounds = {};
+	bounds.Min = glm::min(first.Min, second.Min);
+	bounds.Max = glm::max(first.Max, second.Max);
+	return bounds;
+}
+
+static BenchmarkBounds objectBounds(const BenchmarkObject& object)
+{
+	BenchmarkBounds bounds = {};
+	bounds.Min = glm::vec3(object.Transform[3]) - object.Scale;
+	bounds.Max = glm::vec3(object.Transform[3]) + object.Scale;
+	return bounds;
+}
+
+template<typename TFunc>
+static float measureMilliseconds(TFunc func)
+{
+	const BenchmarkClock::time_point startTime = BenchmarkClock::now();
+	for (uint32_t i = 0; i < BENCHMARK_REPETITIONS; i++)
+	{
+		func();
+	}
+
+	std::chrono::duration<float, std::milli> elapsed = BenchmarkClock::now() - startTime;
+	return elapsed.count() / float(BENCHMARK_REPETITIONS);
+}
+
+void TaskDispatcherBenchmark::runParallelFor(const std::string& filepath)
+{
+	std::ofstream fileStream;
+	fileStream.open(filepath);
+	if (!fileStream.is_open())
+	{
+		LOG("TaskDispatcherBenchmark: Failed to open '%s'", filepath.c_str());
+		return;
+	}
+
+	std::vector<BenchmarkObject> objects(BENCHMARK_OBJECT_COUNT);
+	for (uint32_t i = 0; i < BENCHMARK_OBJECT_COUNT; i++)
+	{
+		BenchmarkObject& object = objects[i];
+		object.Position = glm::vec3(float(i % 100), float((i / 100) % 100), float(i / 10000));
+		object.Rotation = glm::vec3(float(i) * 0.01f, float(i) * 0.02f, float(i) * 0.03f);
+		object.Scale	= glm::vec3(0.5f + float(i % 7) * 0.1f);
+	}
+
+	//The serial loops are the baseline every worker count is compared against
+	const float serialUpdate = measureMilliseconds([&]
+		{
+			for (BenchmarkObject& object : objects)
+			{
+				updateObject(object);
+			}
+		});
+
+	BenchmarkBounds serialBounds = {};
+	const float serialReduce = measureMilliseconds([&]
+		{
+			serialBounds = BenchmarkBounds();
+			for (const BenchmarkObject& object : objects)
+			{
+				serialBounds = combineBounds(serialBounds, objectBounds(object));
+			}
+		});
+
+	fileStream << "Workers\tUpdate(ms)\tUpdateSpeedup\tReduce(ms)\tReduceSpeedup" << std::endl;
+	fileStream << "Serial\t" << serialUpdate << "\t1\t" << serialReduce << "\t1" << std::endl;
+	LOG("Serial [%u objects]: update=%.3fms bounds=%.3fms", BENCHMARK_OBJECT_COUNT, serialUpdate, serialReduce);
+
+	for (uint32_t numThreads = 1; numThreads <= MAX_THREADS; numThreads *= 2)
+	{
+		TaskDispatcher::init(numThreads);
+
+		const float parallelUpdate = measureMilliseconds([&]
+			{
+				TaskDispatcher::parallelFor(0, BENCHMARK_OBJECT_COUNT, 1024, [&](uint32_t i)
+					{
+						updateObject(objects[i]);
+					});
+			});
+
+		BenchmarkBounds parallelBounds = {};
+		const float parallelReduce = measureMilliseconds([&]
+			{
+				parallelBounds = TaskDispatcher::parallelReduce(0, BENCHMARK_OBJECT_COUNT, 1024, BenchmarkBounds(), [&](uint32_t i)
+					{
+						return objectBounds(objects[i]);
+					}, combineBounds);
+			});
+
+		TaskDispatcher::release();
+
+		if (parallelBounds.Min != serialBounds.Min || parallelBounds.Max != serialBounds.Max)
+		{
+			LOG("TaskDispatcherBenchmark: parallelReduce returned different bounds than the serial loop");
+		}
+
+		LOG("ParallelFor [%u workers]: update=%.3fms (%.2fx) bounds=%.3fms (%.2fx)", numThreads,
+			parallelUpdate, serialUpdate / parallelUpdate, parallelReduce, serialReduce / parallelReduce);
+
+		fileStream << numThreads << "\t" << parallelUpdate << "\t" << serialUpdate / parallelUpdate << "\t";
+		fileStream << parallelReduce << "\t" << serialReduce / parallelReduce << std::endl;
+	}
+
+	fileStream.close();
+	LOG("TaskDispatcherBenchmark: Results written to '%s'", filepath.c_str());
+}
+
+#if TRACK_ALLOCATIONS
+//Keeps the compiler from removing the allocation in the frame that has to be caught
+static void* volatile s_pCheckAllocation = nullptr;
+
+//Dispatches one frame of tasks into a single group, like the recording tasks of a frame, and returns the allocations all threads made
+static uint64_t dispatchCheckFrame(bool allocateInTask)
+{
+	const uint64_t startAllocations = AllocationCounter::getTotalAllocations();
+
+	TaskGroup recordingTasks;
+	for (uint32_t chunk = 0; chunk < ALLOCATION_CHECK_FRAME_TASKS; chunk++)
+	{
+		const bool allocate = allocateInTask && chunk == 0;
+		TaskDispatcher::execute(Task("Record Chunk", [chunk, allocate]
+			{
+				doWork(chunk);
+				if (allocate)
+				{
+					uint32_t* pValue = DBG_NEW uint32_t(chunk);
+					s_pCheckAllocation = pValue;
+					delete pValue;
+				}
+			}), recordingTasks);
+	}
+
+	recordingTasks.wait();
+	return AllocationCounter::getTotalAllocations() - startAllocations;
+}
+
+//Renders a frame from a task like the pipelined loop does and returns what the frame's own scope counted. It allocates once
+//before and once after waiting for the recording tasks, which may be on different workers, and the recording tasks allocate as well
+static uint64_t countFrameScopeAllocations()
+{
+	uint64_t scopeAllocations = 0;
+
+	TaskGroup frameTask;
+	TaskDispatcher::execute(Task("Render Frame", [&scopeAllocations]
+		{
+			AllocationScope frameScope;
+
+			uint32_t* pValue = DBG_NEW uint32_t(0);
+			s_pCheckAllocation = pValue;
+			delete pValue;
+
+			dispatchCheckFrame(true);
+
+			pValue = DBG_NEW uint32_t(1);
+			s_pCheckAllocation = pValue;
+			delete pValue;
+
+			scopeAllocations = frameScope.getAllocations();
+		}), frameTask);
+
+	frameTask.wait();
+	return scopeAllocations;
+}
+#endif
+
+bool TaskDispatcherBenchmark::checkFrameAllocations()
+{
+#if TRACK_ALLOCATIONS
+	if (!AllocationCounter::verifyCounting())
+	{
+		LOG("TaskDispatcherBenchmark: Frame allocation check FAILED, not every allocation is counted");
+		return false;
+	}
+
+	bool passed = true;
+	for (uint32_t useFibers = 0; useFibers < 2; useFibers++)
+	{
+		const char* pName = useFibers ? "WorkStealingFibers" : "WorkStealing";
+		for (uint32_t numThreads = 1; numThreads <= MAX_THREADS; numThreads++)
+		{
+			TaskDispatcher::init(numThreads, useFibers == 1);
+
+			uint32_t failedFrames = 0;
+			for (uint32_t frame = 0; frame < ALLOCATION_CHECK_WARMUP_FRAMES + ALLOCATION_CHECK_FRAMES; frame++)
+			{
+				//Every thread is counted, the workers are not allowed to allocate either
+				const uint64_t allocations = dispatchCheckFrame(false);
+				if (frame >= ALLOCATION_CHECK_WARMUP_FRAMES && allocations > 0)
+				{
+					LOG("%s [%u workers]: Frame %u made %llu allocations", pName, numThreads, frame, (unsigned long long)allocations);
+					failedFrames++;
+				}
+			}
+
+			//A frame where a task allocates has to be caught, otherwise a passing run proves nothing
+			if (dispatchCheckFrame(true) == 0)
+			{
+				LOG("%s [%u workers]: An allocation in a task was not counted", pName, numThreads);
+				failedFrames++;
+			}
+
+			//The frame's scope has to follow it across the wait and leave out the tasks that were run while waiting. The first
+			//frame dispatched from a task grows the counter pool for the nested group, so it is only warmup
+			countFrameScopeAllocations();
+			const uint64_t scopeAllocations = countFrameScopeAllocations();
+			if (scopeAllocations != 2)
+			{
+				LOG("%s [%u workers]: The frame scope counted %llu of its 2 allocations", pName, numThreads, (unsigned long long)scopeAllocations);
+				failedFrames++;
+			}
+
+			TaskDispatcher::release();
+
+			LOG("%s [%u workers]: %u of %u frames allocated", pName, numThreads, failedFrames, ALLOCATION_CHECK_FRAMES);
+			passed = passed && (failedFrames == 0);
+		}
+	}
+
+	LOG("TaskDispatcherBenchmark: Frame allocation check %s", passed ? "PASSED" : "FAILED");
+	return passed;
+#else
+	LOG("TaskDispatcherBenchmark: The frame allocation check needs a build with TRACK_ALLOCATIONS");
+	return false;
+#endif
+}
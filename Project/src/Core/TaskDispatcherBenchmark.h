@@ -0,0 +1,18 @@
+#pragma once
+#include "Core.h"
+
+#include <string>
+
+//Measures throughput and queue latency of the TaskDispatcher, started with --benchmark-tasks, --benchmark-parallel-for and --check-task-allocations
+class TaskDispatcherBenchmark
+{
+public:
+	DECL_STATIC_CLASS(TaskDispatcherBenchmark);
+
+	//Runs every scenario with 1 to MAX_THREADS workers and writes a tab separated table to filepath
+	static void run(const std::string& filepath);
+	//Updates the transforms and bounds of a synthetic scene with parallelFor and parallelReduce and compares them to a serial loop
+	static void runParallelFor(const std::string& filepath);
+	//Dispatches and waits for a frame of tasks the same way RenderingHandlerVK records a frame, returns false if any frame after the warmup allocated
+	static bool checkFrameAllocations();
+};
@@ -0,0 +1,277 @@
+#include "TimelineTracer.h"
+
+#include <mutex>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <algorithm>
+
+std::atomic<bool>								TimelineTracer::s_Enabled = false;
+TimelineTracer::ThreadBuffer*					TimelineTracer::s_pBuffers[TRACE_MAX_THREADS];
+std::atomic<uint32_t>							TimelineTracer::s_NumBuffers = 0;
+thread_local TimelineTracer::ThreadBuffer*		TimelineTracer::s_pThreadBuffer = nullptr;
+thread_local char								TimelineTracer::s_ThreadName[32] = "";
+TimelineTracer::GPUTraceEvent*					TimelineTracer::s_pGPUEvents = nullptr;
+uint64_t										TimelineTracer::s_GPUHead = 0;
+int64_t											TimelineTracer::s_GPUClockOffset = INT64_MAX;
+Spinlock										TimelineTracer::s_BufferLock;
+Spinlock										TimelineTracer::s_GPULock;
+
+static void writeEscaped(std::ofstream& file, const char* pString)
+{
+	for (const char* pCharacter = pString; *pCharacter; pCharacter++)
+	{
+		const char character = *pCharacter;
+		if (character == '"' || character == '\\')
+		{
+			file << '\\' << character;
+		}
+		else if (uint8_t(character) >= 0x20)
+		{
+			file << character;
+		}
+	}
+}
+
+static void writeTimestamp(std::ofstream& file, int64_t timestampNS)
+{
+	//Chrome wants microseconds, keep the nanoseconds as decimals
+	const int64_t microseconds	= timestampNS / 1000;
+	const int64_t remainder		= std::abs(timestampNS % 1000);
+	if (timestampNS < 0 && microseconds == 0)
+	{
+		file << '-';
+	}
+
+	file << microseconds << '.' << char('0' + remainder / 100) << char('0' + (remainder / 10) % 10) << char('0' + remainder % 10);
+}
+
+void TimelineTracer::setEnabled(bool enabled)
+{
+	s_Enabled.store(enabled, std::memory_order_relaxed);
+}
+
+void TimelineTracer::release()
+{
+	s_Enabled.store(false, std::memory_order_relaxed);
+
+	const uint32_t numBuffers = std::min(s_NumBuffers.load(), TRACE_MAX_THREADS);
+	for (uint32_t i = 0; i < numBuffers; i++)
+	{
+		SAFEDELETE(s_pBuffers[i]);
+	}
+
+	s_NumBuffers	= 0;
+	s_pThreadBuffer = nullptr;
+
+	std::scoped_lock<Spinlock> lock(s_GPULock);
+	if (s_pGPUEvents)
+	{
+		delete[] s_pGPUEvents;
+		s_pGPUEvents = nullptr;
+	}
+
+	s_GPUHead			= 0;
+	s_GPUClockOffset	= INT64_MAX;
+}
+
+void TimelineTracer::setThreadName(const char* pName)
+{
+	strncpy(s_ThreadName, pName, sizeof(s_ThreadName) - 1);
+	if (s_pThreadBuffer)
+	{
+		strncpy(s_pThreadBuffer->Name, s_ThreadName, sizeof(s_pThreadBuffer->Name) - 1);
+	}
+}
+
+void TimelineTracer::record(ETraceEventType type, const char* pName, uint32_t argument)
+{
+	ThreadBuffer* pBuffer = getThreadBuffer();
+	if (!pBuffer)
+	{
+		return;
+	}
+
+	//Only the owning thread writes, the head is atomic so that the writer of the trace sees complete events
+	const uint64_t head = pBuffer->Head.load(std::memory_order_relaxed);
+	TraceEvent& event = pBuffer->Events[head % TRACE_BUFFER_SIZE];
+	event.Timestamp = getTimeNS();
+	event.pName		= pName ? pName : "Task";
+	event.Type		= type;
+	event.Argument	= argument;
+	pBuffer->Head.store(head + 1, std::memory_order_release);
+}
+
+void TimelineTracer::recordGPU(const char* pName, uint64_t beginNS, uint64_t endNS)
+{
+	const uint64_t now = getTimeNS();
+
+	std::scoped_lock<Spinlock> lock(s_GPULock);
+	if (!s_pGPUEvents)
+	{
+		s_pGPUEvents = DBG_NEW GPUTraceEvent[TRACE_GPU_BUFFER_SIZE];
+	}
+
+	//The results can not be read before the work is done, so the smallest difference is the closest to the real offset
+	s_GPUClockOffset = std::min(s_GPUClockOffset, int64_t(now) - int64_t(endNS));
+
+	GPUTraceEvent& event = s_pGPUEvents[s_GPUHead % TRACE_GPU_BUFFER_SIZE];
+	strncpy(event.Name, pName, sizeof(event.Name) - 1);
+	event.Name[sizeof(event.Name) - 1] = '\0';
+	event.Begin		= beginNS;
+	event.Duration	= endNS > beginNS ? endNS - beginNS : 0;
+	s_GPUHead++;
+}
+
+bool TimelineTracer::writeChromeTrace(const std::string& filepath)
+{
+	const bool wasEnabled = s_Enabled.exchange(false);
+
+	std::ofstream file(filepath, std::ios::out | std::ios::trunc);
+	if (!file.is_open())
+	{
+		LOG("Failed to open '%s' for writing the timeline", filepath.c_str());
+		s_Enabled.store(wasEnabled);
+		return false;
+	}
+
+	//Workers can still be finishing an event, the heads are read once so half written events are not included
+	const uint32_t numBuffers = std::min(s_NumBuffers.load(std::memory_order_acquire), TRACE_MAX_THREADS);
+	uint64_t heads[TRACE_MAX_THREADS] = {};
+	uint64_t startTime = UINT64_MAX;
+	for (uint32_t i = 0; i < numBuffers; i++)
+	{
+		ThreadBuffer* pBuffer = s_pBuffers[i];
+		heads[i] = pBuffer->Head.load(std::memory_order_acquire);
+		if (heads[i] > 0)
+		{
+			const uint64_t first = heads[i] > TRACE_BUFFER_SIZE ? heads[i] - TRACE_BUFFER_SIZE : 0;
+			startTime = std::min(startTime, pBuffer->Events[first % TRACE_BUFFER_SIZE].Timestamp);
+		}
+	}
+
+	if (startTime == UINT64_MAX)
+	{
+		startTime = getTimeNS();
+	}
+
+	file << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n";
+	file << "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":0,\"tid\":0,\"args\":{\"name\":\"CPU\"}}";
+	file << ",\n{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"tid\":0,\"args\":{\"name\":\"GPU\"}}";
+
+	uint64_t numEvents = 0;
+	for (uint32_t i = 0; i < numBuffers; i++)
+	{
+		ThreadBuffer* pBuffer = s_pBuffers[i];
+		file << ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":" << i << ",\"args\":{\"name\":\"";
+		if (pBuffer->Name[0] != '\0')
+		{
+			writeEscaped(file, pBuffer->Name);
+		}
+		else
+		{
+			file << "Thread " << i;
+		}
+		file << "\"}}";
+
+		//When the buffer has wrapped, the oldest events can be ends without a begin, chrome ignores those
+		const uint64_t first = heads[i] > TRACE_BUFFER_SIZE ? heads[i] - TRACE_BUFFER_SIZE : 0;
+		for (uint64_t j = first; j < heads[i]; j++)
+		{
+			const TraceEvent& event = pBuffer->Events[j % TRACE_BUFFER_SIZE];
+
+			file << ",\n{\"name\":\"";
+			switch (event.Type)
+			{
+			case ETraceEventType::BEGIN:
+			case ETraceEventType::END:
+				writeEscaped(file, event.pName);
+				file << "\",\"cat\":\"Task\",\"ph\":\"" << (event.Type == ETraceEventType::BEGIN ? 'B' : 'E') << '"';
+				break;
+			case ETraceEventType::WAIT_BEGIN:
+			case ETraceEventType::WAIT_END:
+				file << "Wait\",\"cat\":\"Wait\",\"ph\":\"" << (event.Type == ETraceEventType::WAIT_BEGIN ? 'B' : 'E') << '"';
+				break;
+			case ETraceEventType::STEAL:
+				file << "Steal\",\"cat\":\"Steal\",\"ph\":\"i\",\"s\":\"t\",\"args\":{\"task\":\"";
+				writeEscaped(file, event.pName);
+				file << "\",\"victim\":" << event.Argument << '}';
+				break;
+			case ETraceEventType::SUSPEND:
+			case ETraceEventType::RESUME:
+				file << (event.Type == ETraceEventType::SUSPEND ? "Suspend" : "Resume") << "\",\"cat\":\"Fiber\",\"ph\":\"i\",\"s\":\"t\",\"args\":{\"task\":\"";
+				writeEscaped(file, event.pName);
+				file << "\"}";
+				break;
+			}
+
+			file << ",\"pid\":0,\"tid\":" << i << ",\"ts\":";
+			writeTimestamp(file, int64_t(event.Timestamp - startTime));
+			file << '}';
+		}
+
+		numEvents += heads[i] - first;
+	}
+
+	{
+		std::scoped_lock<Spinlock> lock(s_GPULock);
+		if (s_pGPUEvents)
+		{
+			file << ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":0,\"args\":{\"name\":\"Graphics Queue\"}}";
+
+			const uint64_t first = s_GPUHead > TRACE_GPU_BUFFER_SIZE ? s_GPUHead - TRACE_GPU_BUFFER_SIZE : 0;
+			for (uint64_t i = first; i < s_GPUHead; i++)
+			{
+				const GPUTraceEvent& event = s_pGPUEvents[i % TRACE_GPU_BUFFER_SIZE];
+				file << ",\n{\"name\":\"";
+				writeEscaped(file, event.Name);
+				file << "\",\"cat\":\"GPU\",\"ph\":\"X\",\"pid\":1,\"tid\":0,\"ts\":";
+				writeTimestamp(file, int64_t(event.Begin) + s_GPUClockOffset - int64_t(startTime));
+				file << ",\"dur\":";
+				writeTimestamp(file, int64_t(event.Duration));
+				file << '}';
+			}
+
+			numEvents += s_GPUHead - first;
+		}
+	}
+
+	file << "\n]}\n";
+	file.close();
+
+	D_LOG("Wrote %llu timeline events to '%s'", (unsigned long long)numEvents, filepath.c_str());
+
+	s_Enabled.store(wasEnabled);
+	return true;
+}
+
+uint64_t TimelineTracer::getTimeNS()
+{
+	return uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+TimelineTracer::ThreadBuffer* TimelineTracer::getThreadBuffer()
+{
+	//Not inlined since a fiber can continue on another thread, the thread local has to be looked up again
+	if (s_pThreadBuffer)
+	{
+		return s_pThreadBuffer;
+	}
+
+	std::scoped_lock<Spinlock> lock(s_BufferLock);
+	const uint32_t index = s_NumBuffers.load(std::memory_order_relaxed);
+	if (index >= TRACE_MAX_THREADS)
+	{
+		return nullptr;
+	}
+
+	ThreadBuffer* pBuffer = DBG_NEW ThreadBuffer();
+	strncpy(pBuffer->Name, s_ThreadName, sizeof(pBuffer->Name) - 1);
+
+	//The buffer is stored before the count is published so the writer never sees a null buffer
+	s_pBuffers[index] = pBuffer;
+	s_NumBuffers.store(index + 1, std::memory_order_release);
+
+	s_pThreadBuffer = pBuffer;
+	return pBuffer;
+}
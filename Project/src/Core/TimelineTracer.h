@@ -0,0 +1,91 @@
+#pragma once
+#include "Core.h"
+#include "Spinlock.h"
+
+#include <atomic>
+#include <string>
+
+//Events kept per thread, older events are overwritten when the buffer is full
+#define TRACE_BUFFER_SIZE	65536U
+#define TRACE_MAX_THREADS	32U
+#define TRACE_GPU_BUFFER_SIZE 16384U
+
+enum class ETraceEventType : uint32_t
+{
+	BEGIN		= 0,
+	END			= 1,
+	WAIT_BEGIN	= 2,
+	WAIT_END	= 3,
+	//A task taken from another worker's queue, the argument is the worker it was stolen from
+	STEAL		= 4,
+	SUSPEND		= 5,
+	RESUME		= 6
+};
+
+struct TraceEvent
+{
+	uint64_t Timestamp;
+	const char* pName;
+	ETraceEventType Type;
+	uint32_t Argument;
+};
+
+//Records what every thread is doing into per thread ring buffers and writes them as Chrome trace event JSON (chrome://tracing).
+//Names has to be string literals or outlive the trace since only the pointer is stored
+class TimelineTracer
+{
+	struct ThreadBuffer
+	{
+		TraceEvent Events[TRACE_BUFFER_SIZE];
+		std::atomic<uint64_t> Head = 0;
+		char Name[32] = "";
+	};
+
+	struct GPUTraceEvent
+	{
+		char Name[48];
+		uint64_t Begin;
+		uint64_t Duration;
+	};
+
+public:
+	DECL_STATIC_CLASS(TimelineTracer);
+
+	//Memory for a thread's buffer is allocated the first time it records something
+	static void setEnabled(bool enabled);
+	static void release();
+
+	//Shown as the name of the calling thread in the trace
+	static void setThreadName(const char* pName);
+
+	static void record(ETraceEventType type, const char* pName, uint32_t argument = 0);
+	//Timestamps are in nanoseconds of the GPU clock, they are moved to the CPU clock when the trace is written
+	static void recordGPU(const char* pName, uint64_t beginNS, uint64_t endNS);
+
+	//Stops tracing while the file is written
+	static bool writeChromeTrace(const std::string& filepath);
+
+	static uint64_t getTimeNS();
+
+	static FORCEINLINE bool isEnabled()
+	{
+		return s_Enabled.load(std::memory_order_relaxed);
+	}
+
+private:
+	static NOINLINE ThreadBuffer* getThreadBuffer();
+
+private:
+	static std::atomic<bool> s_Enabled;
+	static ThreadBuffer* s_pBuffers[TRACE_MAX_THREADS];
+	static std::atomic<uint32_t> s_NumBuffers;
+	static thread_local ThreadBuffer* s_pThreadBuffer;
+	static thread_local char s_ThreadName[32];
+	static Spinlock s_BufferLock;
+
+	static GPUTraceEvent* s_pGPUEvents;
+	static uint64_t s_GPUHead;
+	//Smallest difference seen between the CPU clock when results were read back and the end of the GPU work
+	static int64_t s_GPUClockOffset;
+	static Spinlock s_GPULock;
+};
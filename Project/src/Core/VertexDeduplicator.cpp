@@ -0,0 +1,63 @@
+#include "VertexDeduplicator.h"
+
+#define MIN_DEDUPLICATOR_SLOTS 64U
+
+static size_t slotCountFor(uint32_t vertexCount)
+{
+	//At most half of the slots are used, so the probes stay short
+	size_t slotCount = MIN_DEDUPLICATOR_SLOTS;
+	while (slotCount < size_t(vertexCount) * 2)
+	{
+		slotCount *= 2;
+	}
+
+	return slotCount;
+}
+
+VertexDeduplicator::VertexDeduplicator(uint32_t expectedVertices)
+	: m_Slots(),
+	m_Count(0)
+{
+	reserve(expectedVertices);
+}
+
+void VertexDeduplicator::reserve(uint32_t expectedVertices)
+{
+	const size_t slotCount = slotCountFor(std::max(expectedVertices, m_Count + 1));
+	if (slotCount <= m_Slots.size())
+	{
+		return;
+	}
+
+	std::vector<Slot> oldSlots = std::move(m_Slots);
+	m_Slots.assign(slotCount, { 0, UINT32_MAX });
+
+	//The stored hashes are enough to place the old entries, the vertices are not hashed again
+	const size_t mask = slotCount - 1;
+	for (const Slot& oldSlot : oldSlots)
+	{
+		if (oldSlot.Index == UINT32_MAX)
+		{
+			continue;
+		}
+
+		size_t slot = oldSlot.Hash & mask;
+		while (m_Slots[slot].Index != UINT32_MAX)
+		{
+			slot = (slot + 1) & mask;
+		}
+
+		m_Slots[slot] = oldSlot;
+	}
+}
+
+void VertexDeduplicator::clear()
+{
+	std::fill(m_Slots.begin(), m_Slots.end(), Slot{ 0, UINT32_MAX });
+	m_Count = 0;
+}
+
+void VertexDeduplicator::grow()
+{
+	reserve(std::max(m_Count * 2, MIN_DEDUPLICATOR_SLOTS / 2));
+}
@@ -0,0 +1,119 @@
+#pragma once
+#include "Core.h"
+
+#include <vector>
+#include <cstring>
+
+//Number of 32-bit words a vertex is packed into, the padding between the members is left out
+#define PACKED_VERTEX_WORDS 11U
+
+//Open addressing hash table that turns a stream of vertices into unique vertices and indices. The slots only store the
+//hash and the index of the vertex, the vertex itself is compared against the unique vertex array, and an insert is a
+//single linear probe that either finds the vertex or claims the empty slot it ends on
+class VertexDeduplicator
+{
+	struct Slot
+	{
+		uint32_t Hash;
+		uint32_t Index;
+	};
+
+	struct PackedVertex
+	{
+		uint32_t Words[PACKED_VERTEX_WORDS];
+	};
+
+public:
+	//With an upper bound on the number of unique vertices the table is allocated once and never grows
+	explicit VertexDeduplicator(uint32_t expectedVertices = 0);
+	~VertexDeduplicator() = default;
+
+	DECL_NO_COPY(VertexDeduplicator);
+
+	void reserve(uint32_t expectedVertices);
+	void clear();
+
+	//Returns the index of vertex in vertices, the vertex is appended when it has not been inserted before
+	FORCEINLINE uint32_t insert(const Vertex& vertex, std::vector<Vertex>& vertices)
+	{
+		if ((m_Count + 1) * 2 > m_Slots.size())
+		{
+			grow();
+		}
+
+		PackedVertex packed;
+		packVertex(vertex, packed);
+
+		const uint32_t hash = hashVertex(packed);
+		const size_t mask	= m_Slots.size() - 1;
+		for (size_t slot = hash & mask; ; slot = (slot + 1) & mask)
+		{
+			Slot& current = m_Slots[slot];
+			if (current.Index == UINT32_MAX)
+			{
+				current.Hash	= hash;
+				current.Index	= uint32_t(vertices.size());
+				vertices.push_back(vertex);
+				m_Count++;
+				return current.Index;
+			}
+
+			if (current.Hash == hash)
+			{
+				PackedVertex other;
+				packVertex(vertices[current.Index], other);
+				if (memcmp(&packed, &other, sizeof(PackedVertex)) == 0)
+				{
+					return current.Index;
+				}
+			}
+		}
+	}
+
+	FORCEINLINE uint32_t getCount() const			{ return m_Count; }
+	FORCEINLINE size_t getSizeInBytes() const		{ return m_Slots.capacity() * sizeof(Slot); }
+
+private:
+	void grow();
+
+	//Negative zero is stored as zero, so vertices that compare equal as floats are also equal as bytes
+	static FORCEINLINE void packVertex(const Vertex& vertex, PackedVertex& packed)
+	{
+		const float values[PACKED_VERTEX_WORDS] =
+		{
+			vertex.Position.x + 0.0f,	vertex.Position.y + 0.0f,	vertex.Position.z + 0.0f,
+			vertex.Normal.x + 0.0f,		vertex.Normal.y + 0.0f,		vertex.Normal.z + 0.0f,
+			vertex.Tangent.x + 0.0f,	vertex.Tangent.y + 0.0f,	vertex.Tangent.z + 0.0f,
+			vertex.TexCoord.x + 0.0f,	vertex.TexCoord.y + 0.0f
+		};
+
+		memcpy(packed.Words, values, sizeof(values));
+	}
+
+	//The short input path of xxHash32
+	static FORCEINLINE uint32_t hashVertex(const PackedVertex& packed)
+	{
+		constexpr uint32_t PRIME2 = 2246822519U;
+		constexpr uint32_t PRIME3 = 3266489917U;
+		constexpr uint32_t PRIME4 = 668265263U;
+		constexpr uint32_t PRIME5 = 374761393U;
+
+		uint32_t hash = PRIME5 + uint32_t(sizeof(PackedVertex));
+		for (uint32_t i = 0; i < PACKED_VERTEX_WORDS; i++)
+		{
+			hash += packed.Words[i] * PRIME3;
+			hash = ((hash << 17) | (hash >> 15)) * PRIME4;
+		}
+
+		hash ^= hash >> 15;
+		hash *= PRIME2;
+		hash ^= hash >> 13;
+		hash *= PRIME3;
+		hash ^= hash >> 16;
+		return hash;
+	}
+
+private:
+	std::vector<Slot> m_Slots;
+	uint32_t m_Count;
+};
@@ -0,0 +1,79 @@
+#pragma once
+#include "Core.h"
+
+#include <cmath>
+
+//Layout of the vertices in the geometry buffer. With 0 the padded Vertex is uploaded as it is, which is kept to compare
+//against. Has to match PACKED_VERTICES in assets/shaders/vertexFormat.glsl
+#ifndef PACKED_VERTICES
+	#define PACKED_VERTICES 1
+#endif
+
+//24 bytes instead of 64. The position stays a float so that the acceleration structures are built straight from the
+//geometry buffer, the normal and tangent are octahedral encoded into two snorm16 and the texcoord is two halfs
+struct CompactVertex
+{
+	glm::vec3 Position;
+	uint32_t Normal;
+	uint32_t Tangent;
+	uint32_t TexCoord;
+};
+
+static_assert(sizeof(CompactVertex) == 24, "CompactVertex must match the layout in vertexFormat.glsl");
+
+#if PACKED_VERTICES
+	using GPUVertex = CompactVertex;
+#else
+	using GPUVertex = Vertex;
+#endif
+
+//Maps a unit vector onto the octahedron and unfolds it into a square, a zero or invalid vector is stored as +Z
+inline uint32_t encodeOctahedral(const glm::vec3& direction)
+{
+	const float length = std::abs(direction.x) + std::abs(direction.y) + std::abs(direction.z);
+	if (!(length > 1e-20f) || !std::isfinite(length))
+	{
+		return glm::packSnorm2x16(glm::vec2(0.0f));
+	}
+
+	glm::vec2 octahedral = glm::vec2(direction.x, direction.y) / length;
+	if (direction.z < 0.0f)
+	{
+		const glm::vec2 signs = glm::vec2(octahedral.x >= 0.0f ? 1.0f : -1.0f, octahedral.y >= 0.0f ? 1.0f : -1.0f);
+		octahedral = (glm::vec2(1.0f) - glm::abs(glm::vec2(octahedral.y, octahedral.x))) * signs;
+	}
+
+	return glm::packSnorm2x16(octahedral);
+}
+
+inline glm::vec3 decodeOctahedral(uint32_t encoded)
+{
+	const glm::vec2 octahedral = glm::unpackSnorm2x16(encoded);
+
+	glm::vec3 direction = glm::vec3(octahedral.x, octahedral.y, 1.0f - std::abs(octahedral.x) - std::abs(octahedral.y));
+	const float fold = std::max(-direction.z, 0.0f);
+	direction.x += direction.x >= 0.0f ? -fold : fold;
+	direction.y += direction.y >= 0.0f ? -fold : fold;
+	return glm::normalize(direction);
+}
+
+inline void encodeVertex(const Vertex& vertex, Vertex& gpuVertex)
+{
+	gpuVertex = vertex;
+}
+
+inline void encodeVertex(const Vertex& vertex, CompactVertex& gpuVertex)
+{
+	gpuVertex.Position	= vertex.Position;
+	gpuVertex.Normal	= encodeOctahedral(vertex.Normal);
+	gpuVertex.Tangent	= encodeOctahedral(vertex.Tangent);
+	gpuVertex.TexCoord	= glm::packHalf2x16(vertex.TexCoord);
+}
+
+inline void encodeVertices(const Vertex* pVertices, uint32_t vertexCount, GPUVertex* pGPUVertices)
+{
+	for (uint32_t i = 0; i < vertexCount; i++)
+	{
+		encodeVertex(pVertices[i], pGPUVertices[i]);
+	}
+}
@@ -1,10 +1,13 @@
 #include "BufferVK.h"
 #include "DeviceVK.h"
+#include "DeviceAllocatorVK.h"
+
+#include <atomic>
 
 BufferVK::BufferVK(DeviceVK* pDevice)
 	: m_pDevice(pDevice),
 	m_Buffer(VK_NULL_HANDLE),
-	m_Memory(VK_NULL_HANDLE),
+	m_Allocation(),
 	m_Params(),
 	m_IsMapped(false)
 {
@@ -23,11 +26,7 @@ BufferVK::~BufferVK()
 		m_Buffer = VK_NULL_HANDLE;
 	}
 
-	if (m_Memory != VK_NULL_HANDLE)
-	{
-		vkFreeMemory(m_pDevice->getDevice(), m_Memory, nullptr);
-		m_Memory = VK_NULL_HANDLE;
-	}
+	m_pDevice->getAllocator()->deallocate(m_Allocation);
 
 	m_pDevice = nullptr;
 }
@@ -66,21 +65,21 @@ bool BufferVK::init(const BufferParams& params)
 	VkMemoryRequirements memRequirements = {};
 	vkGetBufferMemoryRequirements(m_pDevice->getDevice(), m_Buffer, &memRequirements);
 
-	VkMemoryAllocateInfo allocInfo = {};
-	allocInfo.sType				= VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-	allocInfo.pNext				= nullptr;
-	allocInfo.allocationSize	= memRequirements.size;
-	allocInfo.memoryTypeIndex	= findMemoryType(m_pDevice->getPhysicalDevice(), memRequirements.memoryTypeBits, params.MemoryProperty);
-
-	VK_CHECK_RESULT_RETURN_FALSE(vkAllocateMemory(m_pDevice->getDevice(), &allocInfo, nullptr, &m_Memory), "Failed to allocate memory for buffer");
+	if (!m_pDevice->getAllocator()->allocate(m_Allocation, memRequirements, params.MemoryProperty, EAllocationTypeVK::BUFFER, params.Category))
+	{
+		LOG("Failed to allocate memory for buffer");
+		return false;
+	}
 
-	vkBindBufferMemory(m_pDevice->getDevice(), m_Buffer, m_Memory, 0);
+	VK_CHECK_RESULT_RETURN_FALSE(vkBindBufferMemory(m_pDevice->getDevice(), m_Buffer, m_Allocation.Memory, m_Allocation.Offset), "Failed to bind buffer memory");
 	D_LOG("--- Buffer: Vulkan Allocated '%d' bytes for buffer", memRequirements.size);
 
-	static uint32_t num = 0;
-	std::string name = "Buffer " + std::to_string(num++);
+	//Buffers are created from the loading threads and the render loop, so the name is formatted without the heap
+	static std::atomic<uint32_t> num = 0;
+	char name[32];
+	snprintf(name, sizeof(name), "Buffer %u", num.fetch_add(1, std::memory_order_relaxed));
 
-	setName(name.c_str());
+	setName(name);
     return true;
 }
 
@@ -88,16 +87,13 @@ void BufferVK::map(void** ppMappedMemory)
 {
 	assert((ppMappedMemory != nullptr) && (m_Params.MemoryProperty & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT));
 
-	if (!m_IsMapped)
-	{
-		VK_CHECK_RESULT(vkMapMemory(m_pDevice->getDevice(), m_Memory, 0, m_Params.SizeInBytes, 0, ppMappedMemory), "MapMemory Failed");
-		m_IsMapped = true;
-	}
+	//Host visible memory is mapped for as long as the allocator keeps it, so mapping is only handing out the pointer
+	*ppMappedMemory = m_Allocation.pHostMemory;
+	m_IsMapped = true;
 }
 
 void BufferVK::unmap()
 {
-	vkUnmapMemory(m_pDevice->getDevice(), m_Memory);
 	m_IsMapped = false;
 }
 
@@ -2,6 +2,7 @@
 #include "Common/IBuffer.h"
 
 #include "VulkanCommon.h"
+#include "DeviceMemoryBlockVK.h"
 
 class DeviceVK;
 
@@ -27,7 +28,7 @@ public:
 private:
 	DeviceVK* m_pDevice;
 	VkBuffer m_Buffer;
-	VkDeviceMemory m_Memory;
+	AllocationVK m_Allocation;
 	BufferParams m_Params;
 	bool m_IsMapped;
 };
@@ -6,10 +6,10 @@
 
 CommandBufferVK::CommandBufferVK(DeviceVK* pDevice, VkCommandBuffer commandBuffer)
 	: m_pDevice(pDevice),
-	m_pStagingBuffer(nullptr),
+	m_UploadRanges(),
+	m_OverflowBuffers(),
 	m_CommandBuffer(commandBuffer),
-	m_Fence(VK_NULL_HANDLE),
-	m_DescriptorSets()
+	m_Fence(VK_NULL_HANDLE)
 {
 }
 
@@ -21,7 +21,7 @@ CommandBufferVK::~CommandBufferVK()
 		m_Fence = VK_NULL_HANDLE;
 	}
 
-	SAFEDELETE(m_pStagingBuffer);
+	releaseUploads();
 	m_pDevice = nullptr;
 }
 
@@ -35,13 +35,6 @@ bool CommandBufferVK::finalize()
 	VK_CHECK_RESULT_RETURN_FALSE(vkCreateFence(m_pDevice->getDevice(), &fenceInfo, nullptr, &m_Fence), "Create Fence for CommandBuffer Failed");
 	D_LOG("--- CommandBuffer: Vulkan Fence created successfully");
 
-	//Create staging-buffers
-	m_pStagingBuffer = DBG_NEW StagingBufferVK(m_pDevice);
-	if (!m_pStagingBuffer->init(MB(1)))
-	{
-		return false;
-	}
-
 	return true;
 }
 
@@ -56,16 +49,22 @@ void CommandBufferVK::reset(bool waitForFence)
 	}
 
 	vkResetCommandBuffer(m_CommandBuffer, VK_COMMAND_BUFFER_RESET_RELEASE_RESOURCES_BIT);
-	m_pStagingBuffer->reset();
+
+	//Buffers that are not waited on are reset when the caller knows that the GPU is done with them, so the uploads can be released either way
+	releaseUploads();
 }
 
 void CommandBufferVK::updateBuffer(BufferVK* pDestination, uint64_t destinationOffset, const void* pSource, uint64_t sizeInBytes)
 {
-	VkDeviceSize offset = m_pStagingBuffer->getCurrentOffset();
-	void* pHostMemory	= m_pStagingBuffer->allocate(sizeInBytes);
-	memcpy(pHostMemory, pSource, sizeInBytes);
+	UploadAllocationVK allocation = {};
+	void* pHostMemory = allocateUpload(allocation, sizeInBytes);
+	if (!pHostMemory)
+	{
+		return;
+	}
 
-	copyBuffer(m_pStagingBuffer->getBuffer(), offset, pDestination, destinationOffset, sizeInBytes);
+	memcpy(pHostMemory, pSource, sizeInBytes);
+	copyBuffer(allocation.pBuffer, allocation.Offset, pDestination, destinationOffset, sizeInBytes);
 }
 
 void CommandBufferVK::copyBuffer(BufferVK* pSource, uint64_t sourceOffset, BufferVK* pDestination, uint64_t destinationOffset, uint64_t sizeInBytes)
@@ -124,13 +123,13 @@ void CommandBufferVK::acquireImageOwnership(ImageVK* pImage, VkAccessFlags dstAc
 
 void CommandBufferVK::releaseImagesOwnership(ImageVK* const* ppImages, uint32_t count, VkAccessFlags srcAccessMask, uint32_t srcQueueFamilyIndex, uint32_t dstQueueFamilyIndex, VkPipelineStageFlags srcStageMask, VkPipelineStageFlags dstStageMask, VkImageAspectFlags aspectMask)
 {
-	std::vector<VkImageMemoryBarrier> imageMemoryBarriers;
+	FrameVector<VkImageMemoryBarrier> imageMemoryBarriers;
 	imageMemoryBarriers.reserve(count);
 
 	for (uint32_t i = 0; i < count; i++)
 	{
 		VkImageMemoryBarrier imageMemoryBarrier = {};
-		imageMemoryBarrier.sType				= VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+		imageMemoryBarrier.sType				= VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
 		imageMemoryBarrier.pNext				= nullptr;
 		imageMemoryBarrier.srcAccessMask		= srcAccessMask;
 		imageMemoryBarrier.dstAccessMask		= 0;
@@ -138,6 +137,7 @@ void CommandBufferVK::releaseImagesOwnership(ImageVK* const* ppImages, uint32_t
 		imageMemoryBarrier.dstQueueFamilyIndex	= dstQueueFamilyIndex;
 		imageMemoryBarrier.image				= ppImages[i]->getImage();
 		imageMemoryBarrier.subresourceRange		= { aspectMask, 0, ppImages[i]->getMiplevelCount(), 0, ppImages[i]->getArrayLayers() };
+		imageMemoryBarriers.push_back(imageMemoryBarrier);
 	}
 
 	vkCmdPipelineBarrier(m_CommandBuffer, srcStageMask, dstStageMask, 0, 0, nullptr, 0, nullptr, uint32_t(imageMemoryBarriers.size()), imageMemoryBarriers.data());
@@ -145,13 +145,13 @@ void CommandBufferVK::releaseImagesOwnership(ImageVK* const* ppImages, uint32_t
 
 void CommandBufferVK::acquireImagesOwnership(ImageVK* const * ppImages, uint32_t count, VkAccessFlags dstAccessMask, uint32_t srcQueueFamilyIndex, uint32_t dstQueueFamilyIndex, VkPipelineStageFlags srcStageMask, VkPipelineStageFlags dstStageMask, VkImageAspectFlags aspectMask)
 {
-	std::vector<VkImageMemoryBarrier> imageMemoryBarriers;
+	FrameVector<VkImageMemoryBarrier> imageMemoryBarriers;
 	imageMemoryBarriers.reserve(count);
 
 	for (uint32_t i = 0; i < count; i++)
 	{
 		VkImageMemoryBarrier imageMemoryBarrier = {};
-		imageMemoryBarrier.sType				= VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+		imageMemoryBarrier.sType				= VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
 		imageMemoryBarrier.pNext				= nullptr;
 		imageMemoryBarrier.srcAccessMask		= 0;
 		imageMemoryBarrier.dstAccessMask		= dstAccessMask;
@@ -159,6 +159,7 @@ void CommandBufferVK::acquireImagesOwnership(ImageVK* const * ppImages, uint32_t
 		imageMemoryBarrier.dstQueueFamilyIndex	= dstQueueFamilyIndex;
 		imageMemoryBarrier.image				= ppImages[i]->getImage();
 		imageMemoryBarrier.subresourceRange		= { aspectMask, 0, ppImages[i]->getMiplevelCount(), 0, ppImages[i]->getArrayLayers() };
+		imageMemoryBarriers.push_back(imageMemoryBarrier);
 	}
 
 	vkCmdPipelineBarrier(m_CommandBuffer, srcStageMask, dstStageMask, 0, 0, nullptr, 0, nullptr, uint32_t(imageMemoryBarriers.size()), imageMemoryBarriers.data());
@@ -186,13 +187,17 @@ void CommandBufferVK::blitImage2D(ImageVK* pSource, uint32_t sourceMip, VkExtent
 
 void CommandBufferVK::updateImage(const void* pPixelData, ImageVK* pImage, uint32_t width, uint32_t height, uint32_t pixelStride, uint32_t miplevel, uint32_t layer)
 {
-	uint32_t sizeInBytes = width * height * pixelStride;
+	const VkDeviceSize sizeInBytes = VkDeviceSize(width) * VkDeviceSize(height) * VkDeviceSize(pixelStride);
 	
-	VkDeviceSize offset = m_pStagingBuffer->getCurrentOffset();
-	void* pHostMemory	= m_pStagingBuffer->allocate(sizeInBytes);
+	UploadAllocationVK allocation = {};
+	void* pHostMemory = allocateUpload(allocation, sizeInBytes);
+	if (!pHostMemory)
+	{
+		return;
+	}
+
 	memcpy(pHostMemory, pPixelData, sizeInBytes);
-	
-	copyBufferToImage(m_pStagingBuffer->getBuffer(), offset, pImage, width, height, miplevel, layer);
+	copyBufferToImage(allocation.pBuffer, allocation.Offset, pImage, width, height, miplevel, layer);
 }
 
 void CommandBufferVK::copyBufferToImage(BufferVK* pSource, VkDeviceSize sourceOffset, ImageVK* pImage, uint32_t width, uint32_t height, uint32_t miplevel, uint32_t layer)
@@ -356,3 +361,64 @@ void CommandBufferVK::setName(const char* pName)
 {
 	m_pDevice->setVulkanObjectName(pName, (uint64_t)m_CommandBuffer, VK_OBJECT_TYPE_COMMAND_BUFFER);
 }
+
+void* CommandBufferVK::allocateUpload(UploadAllocationVK& allocation, VkDeviceSize sizeInBytes)
+{
+	UploadRingVK* pUploadRing = m_pDevice->getUploadRing();
+
+	uint64_t range = m_UploadRanges.empty() ? UPLOAD_RING_NO_RANGE : m_UploadRanges.back();
+	if (pUploadRing->allocate(allocation, range, sizeInBytes))
+	{
+		if (m_UploadRanges.empty() || m_UploadRanges.back() != range)
+		{
+			m_UploadRanges.emplace_back(range);
+		}
+
+		return allocation.pHostMemory;
+	}
+
+	//Too large for the ring or the ring is full, a buffer of its own is slower but never fails because of other uploads
+	BufferParams params = {};
+	params.Usage			= VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+	params.MemoryProperty	= VK_MEMORY_PROPERTY_HOST_COHERENT_BIT | VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT;
+	params.SizeInBytes		= sizeInBytes;
+	params.IsExclusive		= true;
+	params.Category			= EMemoryCategory::STAGING;
+
+	BufferVK* pBuffer = DBG_NEW BufferVK(m_pDevice);
+	if (!pBuffer->init(params))
+	{
+		LOG("--- CommandBuffer: Failed to create staging buffer of %llu bytes", (unsigned long long)sizeInBytes);
+		SAFEDELETE(pBuffer);
+		return nullptr;
+	}
+
+	pUploadRing->addOverflow(sizeInBytes);
+	m_OverflowBuffers.emplace_back(pBuffer);
+
+	allocation.pBuffer	= pBuffer;
+	allocation.Offset	= 0;
+	pBuffer->map(&allocation.pHostMemory);
+	return allocation.pHostMemory;
+}
+
+void CommandBufferVK::releaseUploads()
+{
+	if (!m_UploadRanges.empty())
+	{
+		UploadRingVK* pUploadRing = m_pDevice->getUploadRing();
+		for (uint64_t range : m_UploadRanges)
+		{
+			pUploadRing->retire(range);
+		}
+
+		m_UploadRanges.clear();
+	}
+
+	for (BufferVK* pBuffer : m_OverflowBuffers)
+	{
+		SAFEDELETE(pBuffer);
+	}
+
+	m_OverflowBuffers.clear();
+}
@@ -1,6 +1,8 @@
 #pragma once
 #include <vector>
 
+#include "Core/FrameAllocator.h"
+
 #include "VulkanCommon.h"
 #include "RenderPassVK.h"
 #include "FrameBufferVK.h"
@@ -8,7 +10,7 @@
 #include "PipelineLayoutVK.h"
 #include "ImageVK.h"
 #include "BufferVK.h"
-#include "StagingBufferVK.h"
+#include "UploadRingVK.h"
 #include "DescriptorSetVK.h"
 
 class DeviceVK;
@@ -18,6 +20,7 @@ class ShaderBindingTableVK;
 class CommandBufferVK
 {
 	friend class CommandPoolVK;
+	friend class CopyHandlerVK;
 
 public:
 	DECL_NO_COPY(CommandBufferVK);
@@ -76,13 +79,13 @@ public:
 
 	FORCEINLINE void bindVertexBuffers(const BufferVK* const* ppVertexBuffers, uint32_t vertexBufferCount, const VkDeviceSize* pOffsets)
 	{
+		VkBuffer* pVertexBuffers = FrameAllocator::allocate<VkBuffer>(vertexBufferCount);
 		for (uint32_t i = 0; i < vertexBufferCount; i++)
 		{
-			m_VertexBuffers.emplace_back(ppVertexBuffers[i]->getBuffer());
+			pVertexBuffers[i] = ppVertexBuffers[i]->getBuffer();
 		}
 
-		vkCmdBindVertexBuffers(m_CommandBuffer, 0, vertexBufferCount, m_VertexBuffers.data(), pOffsets);
-		m_VertexBuffers.clear();
+		vkCmdBindVertexBuffers(m_CommandBuffer, 0, vertexBufferCount, pVertexBuffers, pOffsets);
 	}
 
 	FORCEINLINE void bindIndexBuffer(const BufferVK* pIndexBuffer, VkDeviceSize offset, VkIndexType indexType)
@@ -97,13 +100,13 @@ public:
 
 	FORCEINLINE void bindDescriptorSet(VkPipelineBindPoint bindPoint, PipelineLayoutVK* pPipelineLayout, uint32_t firstSet, uint32_t count, const DescriptorSetVK* const* ppDescriptorSets, uint32_t dynamicOffsetCount, const uint32_t* pDynamicOffsets)
 	{
+		VkDescriptorSet* pDescriptorSets = FrameAllocator::allocate<VkDescriptorSet>(count);
 		for (uint32_t i = 0; i < count; i++)
 		{
-			m_DescriptorSets.emplace_back(ppDescriptorSets[i]->getDescriptorSet());
+			pDescriptorSets[i] = ppDescriptorSets[i]->getDescriptorSet();
 		}
 
-		vkCmdBindDescriptorSets(m_CommandBuffer, bindPoint, pPipelineLayout->getPipelineLayout(), firstSet, count, m_DescriptorSets.data(), dynamicOffsetCount, pDynamicOffsets);
-		m_DescriptorSets.clear();
+		vkCmdBindDescriptorSets(m_CommandBuffer, bindPoint, pPipelineLayout->getPipelineLayout(), firstSet, count, pDescriptorSets, dynamicOffsetCount, pDynamicOffsets);
 	}
 
 	FORCEINLINE void beginRenderPass(RenderPassVK* pRenderPass, FrameBufferVK* pFrameBuffer, uint32_t width, uint32_t height, VkClearValue* pClearVales, uint32_t clearValueCount, VkSubpassContents subpassContent)
@@ -181,11 +184,14 @@ private:
 
 	bool finalize();
 
+	//Space in the upload ring when there is room, otherwise a staging buffer that lives until the next reset
+	void* allocateUpload(UploadAllocationVK& allocation, VkDeviceSize sizeInBytes);
+	void releaseUploads();
+
 private:
-	std::vector<VkBuffer> m_VertexBuffers;
-	std::vector<VkDescriptorSet> m_DescriptorSets;
 	DeviceVK* m_pDevice;
-	StagingBufferVK* m_pStagingBuffer;
+	std::vector<uint64_t> m_UploadRanges;
+	std::vector<BufferVK*> m_OverflowBuffers;
 	VkFence m_Fence;
 	VkCommandBuffer m_CommandBuffer;
 };
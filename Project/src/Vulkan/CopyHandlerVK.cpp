@@ -5,6 +5,8 @@
 #include "GraphicsContextVK.h"
 #include "ImageVK.h"
 
+#include "Core/TaskDispatcher.h"
+
 #include <mutex>
 #include <algorithm>
 
@@ -12,23 +14,28 @@
 	#undef max
 #endif
 
+thread_local uint32_t CopyHandlerVK::s_BatchDepth = 0;
+
 CopyHandlerVK::CopyHandlerVK(DeviceVK* pDevice)
 	: m_pDevice(pDevice),
-	m_pTransferPool(),
-	m_pGraphicsPool(),
-	m_pTransferBuffers(),
-	m_pGraphicsBuffers(),
-	m_CurrentTransferBuffer(0),
-	m_CurrentGraphicsBuffer(0)
+	m_TransferQueue(),
+	m_GraphicsQueue(),
+	m_CopyCount(0),
+	m_SubmitCount(0),
+	m_BatchCount(0)
 {
 }
 
 CopyHandlerVK::~CopyHandlerVK()
 {
+	//Anything that was recorded has to be submitted and finished before the commandbuffers are destroyed
+	wait(m_TransferQueue, m_TransferQueue.IsRecording ? m_TransferQueue.NextValue : m_TransferQueue.NextValue - 1);
+	wait(m_GraphicsQueue, m_GraphicsQueue.IsRecording ? m_GraphicsQueue.NextValue : m_GraphicsQueue.NextValue - 1);
+
 	for (uint32_t i = 0; i < MAX_COMMAND_BUFFERS; i++)
 	{
-		SAFEDELETE(m_pGraphicsPool[i]);
-		SAFEDELETE(m_pTransferPool[i]);
+		SAFEDELETE(m_GraphicsQueue.pPools[i]);
+		SAFEDELETE(m_TransferQueue.pPools[i]);
 	}
 
 	m_pDevice = nullptr;
@@ -36,164 +43,327 @@ CopyHandlerVK::~CopyHandlerVK()
 
 bool CopyHandlerVK::init()
 {
-	for (uint32_t i = 0; i < MAX_COMMAND_BUFFERS; i++)
+	if (!initQueue(m_GraphicsQueue, m_pDevice->getQueueFamilyIndices().graphicsFamily.value(), "Graphics"))
 	{
-		m_pGraphicsPool[i] = DBG_NEW CommandPoolVK(m_pDevice, m_pDevice->getQueueFamilyIndices().graphicsFamily.value());
-		if (!m_pGraphicsPool[i]->init())
-		{
-			return false;
-		}
+		return false;
+	}
 
-		m_pTransferPool[i] = DBG_NEW CommandPoolVK(m_pDevice, m_pDevice->getQueueFamilyIndices().transferFamily.value());
-		if (!m_pTransferPool[i]->init())
-		{
-			return false;
-		}
+	return initQueue(m_TransferQueue, m_pDevice->getQueueFamilyIndices().transferFamily.value(), "Transfer");
+}
 
-		m_pTransferBuffers[i] = m_pTransferPool[i]->allocateCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY);
-		if (!m_pTransferBuffers[i])
-		{
-			return false;
-		}
+void CopyHandlerVK::beginBatch()
+{
+	TaskDispatcher::beginNoWait();
+	s_BatchDepth++;
+}
 
-		m_pGraphicsBuffers[i] = m_pGraphicsPool[i]->allocateCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY);
-		if (!m_pGraphicsBuffers[i])
-		{
-			return false;
-		}
+CopyTokenVK CopyHandlerVK::endBatch()
+{
+	ASSERT(s_BatchDepth > 0);
+	s_BatchDepth--;
+	TaskDispatcher::endNoWait();
+
+	//A nested batch is submitted with the outermost one, until then the token refers to the values that are being recorded
+	CopyTokenVK token = {};
+	token.TransferValue = endBatch(m_TransferQueue);
+	token.GraphicsValue = endBatch(m_GraphicsQueue);
+
+	if (s_BatchDepth == 0)
+	{
+		m_BatchCount++;
 	}
 
-	return true;
+	return token;
 }
 
-void CopyHandlerVK::updateBuffer(BufferVK* pDestination, uint64_t destinationOffset, const void* pSource, uint64_t sizeInBytes)
+bool CopyHandlerVK::isComplete(const CopyTokenVK& token)
 {
-	CommandBufferVK* pCommandBuffer = getNextTransferBuffer();
-	{
-		std::scoped_lock<Spinlock> lock(m_pTransferLocks[m_CurrentTransferBuffer]);
+	return isComplete(m_TransferQueue, token.TransferValue) && isComplete(m_GraphicsQueue, token.GraphicsValue);
+}
 
-		pCommandBuffer->reset(true);
-		pCommandBuffer->begin(nullptr, VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
-		pCommandBuffer->updateBuffer(pDestination, destinationOffset, pSource, sizeInBytes);
-		pCommandBuffer->end();
+void CopyHandlerVK::wait(const CopyTokenVK& token)
+{
+	wait(m_TransferQueue, token.TransferValue);
+	wait(m_GraphicsQueue, token.GraphicsValue);
+}
 
-		submitTransferBuffer(pCommandBuffer);
+void CopyHandlerVK::releaseCompletedUploads()
+{
+	{
+		std::scoped_lock<Spinlock> lock(m_TransferQueue.Lock);
+		updateCompletedValue(m_TransferQueue);
 	}
+
+	std::scoped_lock<Spinlock> lock(m_GraphicsQueue.Lock);
+	updateCompletedValue(m_GraphicsQueue);
+}
+
+void CopyHandlerVK::updateBuffer(BufferVK* pDestination, uint64_t destinationOffset, const void* pSource, uint64_t sizeInBytes)
+{
+	std::scoped_lock<Spinlock> lock(m_TransferQueue.Lock);
+
+	CommandBufferVK* pCommandBuffer = beginRecording(m_TransferQueue);
+	pCommandBuffer->updateBuffer(pDestination, destinationOffset, pSource, sizeInBytes);
+	endRecording(m_TransferQueue, sizeInBytes);
 }
 
 void CopyHandlerVK::copyBuffer(BufferVK* pSource, uint64_t sourceOffset, BufferVK* pDestination, uint64_t destinationOffset, uint64_t sizeInBytes)
 {
-	CommandBufferVK* pCommandBuffer = getNextTransferBuffer();
+	std::scoped_lock<Spinlock> lock(m_TransferQueue.Lock);
+
+	CommandBufferVK* pCommandBuffer = beginRecording(m_TransferQueue);
+	pCommandBuffer->copyBuffer(pSource, sourceOffset, pDestination, destinationOffset, sizeInBytes);
+	endRecording(m_TransferQueue, sizeInBytes);
+}
+
+void CopyHandlerVK::updateImage(const void* pPixelData, ImageVK* pImage, uint32_t width, uint32_t height, uint32_t pixelStride, VkImageLayout initalLayout, VkImageLayout finalLayout, uint32_t miplevel, uint32_t layer)
+{
+	std::scoped_lock<Spinlock> lock(m_GraphicsQueue.Lock);
+
+	CommandBufferVK* pCommandBuffer = beginRecording(m_GraphicsQueue);
+
+	//Insert barrier if we need to
+	if (initalLayout != VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL)
 	{
-		std::scoped_lock<Spinlock> lock(m_pTransferLocks[m_CurrentTransferBuffer]);
+		pCommandBuffer->transitionImageLayout(pImage, initalLayout, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 0, pImage->getMiplevelCount(), layer, 1);
+	}
 
-		pCommandBuffer->reset(true);
-		pCommandBuffer->begin(nullptr, VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
-		pCommandBuffer->copyBuffer(pSource, sourceOffset, pDestination, destinationOffset, sizeInBytes);
-		pCommandBuffer->end();
+	pCommandBuffer->updateImage(pPixelData, pImage, width, height, pixelStride, miplevel, layer);
 
-		submitTransferBuffer(pCommandBuffer);
+	//Insert barrier if we need to
+	if (finalLayout != VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL)
+	{
+		pCommandBuffer->transitionImageLayout(pImage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, finalLayout, 0, pImage->getMiplevelCount(), layer, 1);
 	}
+
+	endRecording(m_GraphicsQueue, uint64_t(width) * uint64_t(height) * uint64_t(pixelStride));
 }
 
-void CopyHandlerVK::updateImage(const void* pPixelData, ImageVK* pImage, uint32_t width, uint32_t height, uint32_t pixelStride, VkImageLayout initalLayout, VkImageLayout finalLayout, uint32_t miplevel, uint32_t layer)
+void CopyHandlerVK::copyBufferToImage(BufferVK* pSource, VkDeviceSize sourceOffset, ImageVK* pImage, uint32_t width, uint32_t height, uint32_t miplevel, uint32_t layer)
 {
-	CommandBufferVK* pCommandBuffer = getNextGraphicsBuffer();
+	std::scoped_lock<Spinlock> lock(m_GraphicsQueue.Lock);
+
+	CommandBufferVK* pCommandBuffer = beginRecording(m_GraphicsQueue);
+	pCommandBuffer->copyBufferToImage(pSource, sourceOffset, pImage, width, height, miplevel, layer);
+	endRecording(m_GraphicsQueue, 0);
+}
+
+void CopyHandlerVK::generateMips(ImageVK* pImage)
+{
+	//D_LOG("CopyHandlerVK::generateMips");
+
+	std::scoped_lock<Spinlock> lock(m_GraphicsQueue.Lock);
+
+	CommandBufferVK* pCommandBuffer = beginRecording(m_GraphicsQueue);
+
+	const uint32_t miplevelCount = pImage->getMiplevelCount();
+	pCommandBuffer->transitionImageLayout(pImage, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 0, miplevelCount, 0, 1);
+
+	VkExtent2D destinationExtent = {};
+	VkExtent2D sourceExtent = { pImage->getExtent().width, pImage->getExtent().height };
+	for (uint32_t i = 1; i < miplevelCount; i++)
 	{
-		std::scoped_lock<Spinlock> lock(m_pGraphicsLocks[m_CurrentGraphicsBuffer]);
+		destinationExtent = { std::max(sourceExtent.width / 2U, 1u), std::max(sourceExtent.height / 2U, 1U) };
 
-		pCommandBuffer->reset(true);
-		pCommandBuffer->begin(nullptr, VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
+		pCommandBuffer->transitionImageLayout(pImage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, i - 1, 1, 0, 1);
+		pCommandBuffer->blitImage2D(pImage, i - 1, sourceExtent, pImage, i, destinationExtent);
+		sourceExtent = destinationExtent;
+	}
 
-		//Insert barrier if we need to
-		if (initalLayout != VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL)
-		{
-			pCommandBuffer->transitionImageLayout(pImage, initalLayout, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 0, pImage->getMiplevelCount(), layer, 1);
-		}
+	pCommandBuffer->transitionImageLayout(pImage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, miplevelCount - 1, 1, 0, 1);
+	pCommandBuffer->transitionImageLayout(pImage, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, 0, miplevelCount, 0, 1);
 
-		pCommandBuffer->updateImage(pPixelData, pImage, width, height, pixelStride, miplevel, layer);
+	endRecording(m_GraphicsQueue, 0);
+}
+
+void CopyHandlerVK::transitionImageLayout(ImageVK* pImage, VkImageLayout oldLayout, VkImageLayout newLayout, uint32_t baseMipLevel, uint32_t mipLevels, uint32_t baseLayer, uint32_t layerCount)
+{
+	std::scoped_lock<Spinlock> lock(m_GraphicsQueue.Lock);
+
+	CommandBufferVK* pCommandBuffer = beginRecording(m_GraphicsQueue);
+	pCommandBuffer->transitionImageLayout(pImage, oldLayout, newLayout, baseMipLevel, mipLevels, baseLayer, layerCount);
+	endRecording(m_GraphicsQueue, 0);
+}
 
-		//Insert barrier if we need to
-		if (finalLayout != VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL)
+CopyHandlerStatistics CopyHandlerVK::getStatistics() const
+{
+	CopyHandlerStatistics statistics = {};
+	statistics.CopyCount	= m_CopyCount;
+	statistics.SubmitCount	= m_SubmitCount;
+	statistics.BatchCount	= m_BatchCount;
+	return statistics;
+}
+
+bool CopyHandlerVK::initQueue(CopyQueue& queue, uint32_t queueFamilyIndex, const char* pName)
+{
+	for (uint32_t i = 0; i < MAX_COMMAND_BUFFERS; i++)
+	{
+		queue.pPools[i] = DBG_NEW CommandPoolVK(m_pDevice, queueFamilyIndex);
+		if (!queue.pPools[i]->init())
 		{
-			pCommandBuffer->transitionImageLayout(pImage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, finalLayout, 0, pImage->getMiplevelCount(), layer, 1);
+			return false;
 		}
 
-		pCommandBuffer->end();
+		queue.pBuffers[i] = queue.pPools[i]->allocateCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY);
+		if (!queue.pBuffers[i])
+		{
+			return false;
+		}
 
-		submitGraphicsBuffer(pCommandBuffer);
+		queue.SubmittedValues[i] = 0;
 	}
+
+	queue.NextValue			= 1;
+	queue.CompletedValue	= 0;
+	queue.ReleasedValue		= 0;
+	queue.RecordedCopies	= 0;
+	queue.RecordedBytes		= 0;
+	queue.IsRecording		= false;
+	queue.Lock.enableStatistics(std::string("CopyHandlerVK ") + pName);
+	return true;
 }
 
-void CopyHandlerVK::copyBufferToImage(BufferVK* pSource, VkDeviceSize sourceOffset, ImageVK* pImage, uint32_t width, uint32_t height, uint32_t miplevel, uint32_t layer)
+CommandBufferVK* CopyHandlerVK::beginRecording(CopyQueue& queue)
 {
-	CommandBufferVK* pCommandBuffer = getNextGraphicsBuffer();
+	//The value that is being recorded decides the commandbuffer, so a commandbuffer is reused every MAX_COMMAND_BUFFERS submissions
+	const uint32_t index = uint32_t((queue.NextValue - 1) % MAX_COMMAND_BUFFERS);
+	CommandBufferVK* pCommandBuffer = queue.pBuffers[index];
+	if (!queue.IsRecording)
 	{
-		std::scoped_lock<Spinlock> lock(m_pGraphicsLocks[m_CurrentGraphicsBuffer]);
-
 		pCommandBuffer->reset(true);
-		pCommandBuffer->begin(nullptr, VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
-		pCommandBuffer->copyBufferToImage(pSource, sourceOffset, pImage, width, height, miplevel, layer);
-		pCommandBuffer->end();
+		queue.CompletedValue = std::max(queue.CompletedValue, queue.SubmittedValues[index]);
+		releaseUploads(queue);
 
-		submitGraphicsBuffer(pCommandBuffer);
+		pCommandBuffer->begin(nullptr, VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
+		queue.IsRecording = true;
 	}
+
+	return pCommandBuffer;
 }
 
-void CopyHandlerVK::generateMips(ImageVK* pImage)
+void CopyHandlerVK::endRecording(CopyQueue& queue, uint64_t sizeInBytes)
 {
-	//D_LOG("CopyHandlerVK::generateMips");
+	m_CopyCount++;
+	queue.RecordedCopies++;
+	queue.RecordedBytes += sizeInBytes;
 
-	CommandBufferVK* pCommandBuffer = getNextGraphicsBuffer();
+	if (s_BatchDepth == 0 || queue.RecordedCopies >= COPY_BATCH_MAX_COPIES || queue.RecordedBytes >= COPY_BATCH_MAX_BYTES)
 	{
-		std::scoped_lock<Spinlock> lock(m_pGraphicsLocks[m_CurrentGraphicsBuffer]);
+		submit(queue);
+	}
+}
 
-		pCommandBuffer->reset(true);
-		pCommandBuffer->begin(nullptr, VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
+void CopyHandlerVK::submit(CopyQueue& queue)
+{
+	if (!queue.IsRecording)
+	{
+		return;
+	}
 
-		const uint32_t miplevelCount = pImage->getMiplevelCount();
-		pCommandBuffer->transitionImageLayout(pImage, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 0, miplevelCount, 0, 1);
+	const uint32_t index = uint32_t((queue.NextValue - 1) % MAX_COMMAND_BUFFERS);
+	CommandBufferVK* pCommandBuffer = queue.pBuffers[index];
+	pCommandBuffer->end();
 
-		VkExtent2D destinationExtent = {};
-		VkExtent2D sourceExtent = { pImage->getExtent().width, pImage->getExtent().height };
-		for (uint32_t i = 1; i < miplevelCount; i++)
-		{
-			destinationExtent = { std::max(sourceExtent.width / 2U, 1u), std::max(sourceExtent.height / 2U, 1U) };
+	if (&queue == &m_TransferQueue)
+	{
+		m_pDevice->executeTransfer(pCommandBuffer, nullptr, nullptr, 0, nullptr, 0);
+	}
+	else
+	{
+		m_pDevice->executeGraphics(pCommandBuffer, nullptr, nullptr, 0, nullptr, 0);
+	}
 
-			pCommandBuffer->transitionImageLayout(pImage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, i - 1, 1, 0, 1);
-			pCommandBuffer->blitImage2D(pImage, i - 1, sourceExtent, pImage, i, destinationExtent);
-			sourceExtent = destinationExtent;
-		}
+	queue.SubmittedValues[index] = queue.NextValue;
+	queue.NextValue++;
+	queue.RecordedCopies	= 0;
+	queue.RecordedBytes		= 0;
+	queue.IsRecording		= false;
+	m_SubmitCount++;
+}
 
-		pCommandBuffer->transitionImageLayout(pImage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, miplevelCount - 1, 1, 0, 1);
-		pCommandBuffer->transitionImageLayout(pImage, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, 0, miplevelCount, 0, 1);
-		pCommandBuffer->end();
+void CopyHandlerVK::updateCompletedValue(CopyQueue& queue)
+{
+	//A signaled fence means that everything submitted before it on the queue has finished as well
+	while (queue.CompletedValue + 1 < queue.NextValue)
+	{
+		const uint64_t value	= queue.CompletedValue + 1;
+		const uint32_t index	= uint32_t((value - 1) % MAX_COMMAND_BUFFERS);
+		if (queue.SubmittedValues[index] == value && vkGetFenceStatus(m_pDevice->getDevice(), queue.pBuffers[index]->getFence()) != VK_SUCCESS)
+		{
+			break;
+		}
 
-		submitGraphicsBuffer(pCommandBuffer);
+		queue.CompletedValue = value;
 	}
+
+	releaseUploads(queue);
 }
 
-CommandBufferVK* CopyHandlerVK::getNextTransferBuffer()
+void CopyHandlerVK::releaseUploads(CopyQueue& queue)
 {
-	CommandBufferVK* pCommandBuffer = m_pTransferBuffers[m_CurrentTransferBuffer];
-	m_CurrentTransferBuffer = (m_CurrentTransferBuffer+1) % MAX_COMMAND_BUFFERS;
+	//The commandbuffers are only reset when they are reused, so without this an idle one would keep its part of the ring forever
+	for (uint64_t value = queue.ReleasedValue + 1; value <= queue.CompletedValue; value++)
+	{
+		const uint32_t index = uint32_t((value - 1) % MAX_COMMAND_BUFFERS);
+		if (queue.SubmittedValues[index] == value)
+		{
+			queue.pBuffers[index]->releaseUploads();
+		}
+	}
 
-	return pCommandBuffer;
+	queue.ReleasedValue = std::max(queue.ReleasedValue, queue.CompletedValue);
 }
 
-CommandBufferVK* CopyHandlerVK::getNextGraphicsBuffer()
+uint64_t CopyHandlerVK::endBatch(CopyQueue& queue)
 {
-	CommandBufferVK* pCommandBuffer = m_pGraphicsBuffers[m_CurrentGraphicsBuffer];
-	m_CurrentGraphicsBuffer = (m_CurrentGraphicsBuffer + 1) % MAX_COMMAND_BUFFERS;
-	return pCommandBuffer;
+	std::scoped_lock<Spinlock> lock(queue.Lock);
+	if (!queue.IsRecording)
+	{
+		return queue.NextValue - 1;
+	}
+
+	const uint64_t value = queue.NextValue;
+	if (s_BatchDepth == 0)
+	{
+		submit(queue);
+	}
+
+	return value;
 }
 
-void CopyHandlerVK::submitTransferBuffer(CommandBufferVK* pCommandBuffer)
+bool CopyHandlerVK::isComplete(CopyQueue& queue, uint64_t value)
 {
-	m_pDevice->executeTransfer(pCommandBuffer, nullptr, nullptr, 0, nullptr, 0);
+	std::scoped_lock<Spinlock> lock(queue.Lock);
+	if (value > queue.CompletedValue)
+	{
+		updateCompletedValue(queue);
+	}
+
+	return value <= queue.CompletedValue;
 }
 
-void CopyHandlerVK::submitGraphicsBuffer(CommandBufferVK* pCommandBuffer)
+void CopyHandlerVK::wait(CopyQueue& queue, uint64_t value)
 {
-	m_pDevice->executeGraphics(pCommandBuffer, nullptr, nullptr, 0, nullptr, 0);
+	std::scoped_lock<Spinlock> lock(queue.Lock);
+	if (value <= queue.CompletedValue)
+	{
+		return;
+	}
+
+	//The token may come from a nested batch that has not been submitted yet
+	if (value >= queue.NextValue)
+	{
+		submit(queue);
+	}
+
+	//If the commandbuffer has been reused since, it was waited on before that
+	const uint32_t index = uint32_t((value - 1) % MAX_COMMAND_BUFFERS);
+	if (queue.SubmittedValues[index] == value)
+	{
+		VkFence fence = queue.pBuffers[index]->getFence();
+		vkWaitForFences(m_pDevice->getDevice(), 1, &fence, VK_TRUE, UINT64_MAX);
+	}
+
+	queue.CompletedValue = value;
+	releaseUploads(queue);
 }
@@ -1,4 +1,6 @@
 #pragma once
+#include <atomic>
+
 #include "Core/Spinlock.h"
 
 #include "VulkanCommon.h"
@@ -12,14 +14,61 @@ class CommandBufferVK;
 
 #define MAX_COMMAND_BUFFERS 16
 
+//An open commandbuffer is submitted when it reaches any of these, even inside a batch. The byte limit lets the upload ring recycle during long loads
+#define COPY_BATCH_MAX_COPIES	256U
+#define COPY_BATCH_MAX_BYTES	(8ULL * 1024ULL * 1024ULL)
+
+//Every submission on a queue gets the next value, a token holds the value on each queue that its copies are submitted with.
+//Submissions on a queue finish in order, so the token is complete when the fences of those values have been signaled
+struct CopyTokenVK
+{
+	uint64_t GraphicsValue = 0;
+	uint64_t TransferValue = 0;
+};
+
+struct CopyHandlerStatistics
+{
+	uint64_t CopyCount		= 0;
+	uint64_t SubmitCount	= 0;
+	uint64_t BatchCount		= 0;
+};
+
 class CopyHandlerVK
 {
+	struct CopyQueue
+	{
+		CommandPoolVK* pPools[MAX_COMMAND_BUFFERS];
+		CommandBufferVK* pBuffers[MAX_COMMAND_BUFFERS];
+		//The value each commandbuffer was last submitted with, zero when it has never been submitted
+		uint64_t SubmittedValues[MAX_COMMAND_BUFFERS];
+		uint64_t NextValue;
+		uint64_t CompletedValue;
+		//Uploads of every submission up to this value have been given back to the upload ring
+		uint64_t ReleasedValue;
+		uint32_t RecordedCopies;
+		uint64_t RecordedBytes;
+		bool IsRecording;
+		Spinlock Lock;
+	};
+
 public:
 	CopyHandlerVK(DeviceVK* pDevice);
 	~CopyHandlerVK();
 
 	bool init();
 
+	//Copies between beginBatch and endBatch on the same thread are recorded into shared commandbuffers and submitted together.
+	//Copies outside of a batch are submitted right away, together with everything other threads have recorded so far. The depth
+	//of the batch belongs to the thread, so a batch may not wait for tasks that could move it to another thread with fibers
+	void beginBatch();
+	CopyTokenVK endBatch();
+
+	bool isComplete(const CopyTokenVK& token);
+	void wait(const CopyTokenVK& token);
+
+	//Gives the upload ring space of finished submissions back, called every frame so that idle commandbuffers do not hold on to it
+	void releaseCompletedUploads();
+
 	void updateBuffer(BufferVK* pDestination, uint64_t destinationOffset, const void* pSource, uint64_t sizeInBytes);
 	void copyBuffer(BufferVK* pSource, uint64_t sourceOffset, BufferVK* pDestination, uint64_t destinationOffset, uint64_t sizeInBytes);
 
@@ -27,21 +76,32 @@ public:
 	void copyBufferToImage(BufferVK* pSource, VkDeviceSize sourceOffset, ImageVK* pImage, uint32_t width, uint32_t height, uint32_t miplevel, uint32_t layer);
 
 	void generateMips(ImageVK* pImage);
+	//For images that are created while frames are rendered, the commandpools of the frames can not be used for them
+	void transitionImageLayout(ImageVK* pImage, VkImageLayout oldLayout, VkImageLayout newLayout, uint32_t baseMipLevel, uint32_t mipLevels, uint32_t baseLayer, uint32_t layerCount);
+
+	CopyHandlerStatistics getStatistics() const;
 
 private:
-	CommandBufferVK* getNextTransferBuffer();
-	CommandBufferVK* getNextGraphicsBuffer();
-	void submitTransferBuffer(CommandBufferVK* pCommandBuffer);
-	void submitGraphicsBuffer(CommandBufferVK* pCommandBuffer);
+	bool initQueue(CopyQueue& queue, uint32_t queueFamilyIndex, const char* pName);
+
+	//Has to be called with the lock of the queue held
+	CommandBufferVK* beginRecording(CopyQueue& queue);
+	void endRecording(CopyQueue& queue, uint64_t sizeInBytes);
+	void submit(CopyQueue& queue);
+	void updateCompletedValue(CopyQueue& queue);
+	void releaseUploads(CopyQueue& queue);
+
+	uint64_t endBatch(CopyQueue& queue);
+	bool isComplete(CopyQueue& queue, uint64_t value);
+	void wait(CopyQueue& queue, uint64_t value);
 
 private:
 	DeviceVK* m_pDevice;
-	CommandPoolVK* m_pTransferPool[MAX_COMMAND_BUFFERS];
-	CommandPoolVK* m_pGraphicsPool[MAX_COMMAND_BUFFERS];
-	CommandBufferVK* m_pTransferBuffers[MAX_COMMAND_BUFFERS];
-	CommandBufferVK* m_pGraphicsBuffers[MAX_COMMAND_BUFFERS];
-	Spinlock m_pTransferLocks[MAX_COMMAND_BUFFERS];
-	Spinlock m_pGraphicsLocks[MAX_COMMAND_BUFFERS];
-	uint32_t m_CurrentTransferBuffer;
-	uint32_t m_CurrentGraphicsBuffer;
-};
\ No newline at end of file
+	CopyQueue m_TransferQueue;
+	CopyQueue m_GraphicsQueue;
+	std::atomic<uint64_t> m_CopyCount;
+	std::atomic<uint64_t> m_SubmitCount;
+	std::atomic<uint64_t> m_BatchCount;
+
+	static thread_local uint32_t s_BatchDepth;
+};
@@ -0,0 +1,127 @@
+#include "DeletionQueueVK.h"
+#include "DescriptorSetVK.h"
+#include "DescriptorPoolVK.h"
+#include "DeviceAllocatorVK.h"
+#include "DeviceVK.h"
+
+#include "Core/FrameAllocator.h"
+
+#include <mutex>
+#include <iterator>
+
+DeletionQueueVK::DeletionQueueVK(DeviceVK* pDevice)
+	: m_pDevice(pDevice),
+	m_Entries(),
+	m_FrameIndex(0),
+	m_DeletedCount(0)
+{
+	m_Lock.enableStatistics("DeletionQueueVK");
+}
+
+DeletionQueueVK::~DeletionQueueVK()
+{
+	flush();
+	m_pDevice = nullptr;
+}
+
+void DeletionQueueVK::push(Task&& destroy)
+{
+	std::scoped_lock<Spinlock> lock(m_Lock);
+
+	Entry& entry = m_Entries.emplace_back();
+	entry.Destroy	= std::move(destroy);
+	entry.Frame		= m_FrameIndex;
+}
+
+void DeletionQueueVK::deallocate(DescriptorSetVK* pDescriptorSet)
+{
+	if (pDescriptorSet)
+	{
+		DescriptorPoolVK* pDescriptorPool = pDescriptorSet->getDescriptorPool();
+		push([pDescriptorPool, pDescriptorSet]() { pDescriptorPool->deallocateDescriptorSet(pDescriptorSet); });
+	}
+}
+
+void DeletionQueueVK::deallocate(AllocationVK& allocation)
+{
+	if (allocation.Memory == VK_NULL_HANDLE)
+	{
+		return;
+	}
+
+	std::scoped_lock<Spinlock> lock(m_Lock);
+
+	Entry& entry = m_Entries.emplace_back();
+	entry.Allocation	= allocation;
+	entry.Frame			= m_FrameIndex;
+
+	allocation = AllocationVK();
+}
+
+void DeletionQueueVK::collect(uint64_t completedFrame)
+{
+	destroyEntries(completedFrame);
+}
+
+void DeletionQueueVK::endFrame()
+{
+	std::scoped_lock<Spinlock> lock(m_Lock);
+	m_FrameIndex++;
+}
+
+void DeletionQueueVK::flush()
+{
+	destroyEntries(UINT64_MAX);
+}
+
+uint64_t DeletionQueueVK::getFrameIndex()
+{
+	std::scoped_lock<Spinlock> lock(m_Lock);
+	return m_FrameIndex;
+}
+
+DeletionQueueStatistics DeletionQueueVK::getStatistics()
+{
+	std::scoped_lock<Spinlock> lock(m_Lock);
+
+	DeletionQueueStatistics statistics = {};
+	statistics.PendingCount = uint32_t(m_Entries.size());
+	statistics.DeletedCount = m_DeletedCount;
+	return statistics;
+}
+
+void DeletionQueueVK::destroyEntries(uint64_t lastFrame)
+{
+	//Entries are pushed in frame order, so the ones that are done are always at the front. Collected every frame, so the
+	//list is scratch memory
+	FrameVector<Entry> destroyList;
+	{
+		std::scoped_lock<Spinlock> lock(m_Lock);
+
+		auto firstInUse = m_Entries.begin();
+		while (firstInUse != m_Entries.end() && firstInUse->Frame <= lastFrame)
+		{
+			firstInUse++;
+		}
+
+		if (firstInUse == m_Entries.begin())
+		{
+			return;
+		}
+
+		destroyList.insert(destroyList.end(), std::make_move_iterator(m_Entries.begin()), std::make_move_iterator(firstInUse));
+		m_Entries.erase(m_Entries.begin(), firstInUse);
+		m_DeletedCount += destroyList.size();
+	}
+
+	//Destroyed without the lock held, since destroying a resource may push another one
+	for (Entry& entry : destroyList)
+	{
+		if (entry.Destroy)
+		{
+			entry.Destroy();
+		}
+
+		m_pDevice->getAllocator()->deallocate(entry.Allocation);
+	}
+}
@@ -0,0 +1,70 @@
+#pragma once
+#include "Core/Task.h"
+#include "Core/Spinlock.h"
+
+#include "DeviceMemoryBlockVK.h"
+
+#include <vector>
+
+class DeviceVK;
+class DescriptorSetVK;
+
+struct DeletionQueueStatistics
+{
+	uint32_t PendingCount	= 0;
+	uint64_t DeletedCount	= 0;
+};
+
+//Resources that the frames in flight may still use are pushed here instead of being destroyed right away. Everything that is
+//pushed while frame N is prepared or recorded is destroyed once the fences of frame N have been waited on, so replacing a
+//resource never has to wait for the whole device
+class DeletionQueueVK
+{
+	struct Entry
+	{
+		Task Destroy;
+		AllocationVK Allocation;
+		uint64_t Frame;
+	};
+
+public:
+	DeletionQueueVK(DeviceVK* pDevice);
+	~DeletionQueueVK();
+
+	DECL_NO_COPY(DeletionQueueVK);
+
+	void push(Task&& destroy);
+
+	template<typename TObject>
+	void destroy(TObject* pObject)
+	{
+		if (pObject)
+		{
+			push([pObject]() mutable { SAFEDELETE(pObject); });
+		}
+	}
+
+	//Returns the set to its pool
+	void deallocate(DescriptorSetVK* pDescriptorSet);
+	//Frees the memory and resets the allocation
+	void deallocate(AllocationVK& allocation);
+
+	//Called by the renderer once the fences of the frame have been waited on, runs everything that was pushed up until that frame
+	void collect(uint64_t completedFrame);
+	void endFrame();
+	//Runs everything, the device has to be idle. DeviceVK::wait calls this
+	void flush();
+
+	uint64_t getFrameIndex();
+	DeletionQueueStatistics getStatistics();
+
+private:
+	void destroyEntries(uint64_t lastFrame);
+
+private:
+	DeviceVK* m_pDevice;
+	std::vector<Entry> m_Entries;
+	uint64_t m_FrameIndex;
+	uint64_t m_DeletedCount;
+	Spinlock m_Lock;
+};
@@ -1,10 +1,13 @@
 #include "DescriptorPoolVK.h"
 
+#include "DeletionQueueVK.h"
 #include "DescriptorSetLayoutVK.h"
 #include "DescriptorSetVK.h"
 #include "DeviceVK.h"
 
 #include <array>
+#include <vector>
+#include <algorithm>
 #include <iostream>
 
 DescriptorPoolVK::DescriptorPoolVK(DeviceVK* pDevice)
@@ -30,6 +33,7 @@ bool DescriptorPoolVK::hasRoomFor(const DescriptorCounts& allocations)
 {
 	return	m_DescriptorCounts.m_StorageBuffers			+ allocations.m_StorageBuffers 			< m_DescriptorCapacities.m_StorageBuffers &&
 			m_DescriptorCounts.m_UniformBuffers			+ allocations.m_UniformBuffers 			< m_DescriptorCapacities.m_UniformBuffers &&
+			m_DescriptorCounts.m_DynamicUniformBuffers	+ allocations.m_DynamicUniformBuffers	< m_DescriptorCapacities.m_DynamicUniformBuffers &&
 			m_DescriptorCounts.m_SampledImages 			+ allocations.m_SampledImages			< m_DescriptorCapacities.m_SampledImages  &&
 			m_DescriptorCounts.m_StorageImages			+ allocations.m_StorageImages			< m_DescriptorCapacities.m_StorageImages  &&
 			m_DescriptorCounts.m_AccelerationStructures + allocations.m_AccelerationStructures	< m_DescriptorCapacities.m_AccelerationStructures;
@@ -44,7 +48,7 @@ bool DescriptorPoolVK::init(const DescriptorCounts& descriptorCounts, uint32_t d
 
 	//}
 
-	std::array<VkDescriptorPoolSize, 5> poolSizes;
+	std::array<VkDescriptorPoolSize, 6> poolSizes;
 	poolSizes[0].type				= VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
 	poolSizes[0].descriptorCount	= descriptorCounts.m_StorageBuffers;
 
@@ -60,9 +64,15 @@ bool DescriptorPoolVK::init(const DescriptorCounts& descriptorCounts, uint32_t d
 	poolSizes[4].type				= VK_DESCRIPTOR_TYPE_ACCELERATION_STRUCTURE_NV;
 	poolSizes[4].descriptorCount	= descriptorCounts.m_AccelerationStructures;
 
+	poolSizes[5].type				= VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+	poolSizes[5].descriptorCount	= descriptorCounts.m_DynamicUniformBuffers;
+
+	//Sizes of zero are not allowed, so the used types are moved to the front
+	auto usedSizesEnd = std::remove_if(poolSizes.begin(), poolSizes.end(), [](const VkDescriptorPoolSize& poolSize) { return poolSize.descriptorCount == 0; });
+
 	VkDescriptorPoolCreateInfo poolInfo = {};
 	poolInfo.sType			= VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
-	poolInfo.poolSizeCount	= uint32_t(descriptorCounts.getDescriptorTypesCount());
+	poolInfo.poolSizeCount	= uint32_t(usedSizesEnd - poolSizes.begin());
 	poolInfo.pPoolSizes		= poolSizes.data();
 	poolInfo.maxSets		= descriptorSetCount;
 	poolInfo.pNext			= nullptr;
@@ -70,8 +80,8 @@ bool DescriptorPoolVK::init(const DescriptorCounts& descriptorCounts, uint32_t d
 
 	VK_CHECK_RESULT_RETURN_FALSE(vkCreateDescriptorPool(m_pDevice->getDevice(), &poolInfo, nullptr, &m_DescriptorPool), "Failed to create Descriptor Pool");
 	
-	D_LOG("Created descriptorpool. sets=%d, storagebuffers=%d, uniformBuffers=%d, imageSamplers=%d, storageImages=%d, accelerationStructures=%d",
-		descriptorSetCount, descriptorCounts.m_StorageBuffers, descriptorCounts.m_UniformBuffers, descriptorCounts.m_SampledImages, descriptorCounts.m_StorageImages, descriptorCounts.m_AccelerationStructures);
+	D_LOG("Created descriptorpool. sets=%d, storagebuffers=%d, uniformBuffers=%d, dynamicUniformBuffers=%d, imageSamplers=%d, storageImages=%d, accelerationStructures=%d",
+		descriptorSetCount, descriptorCounts.m_StorageBuffers, descriptorCounts.m_UniformBuffers, descriptorCounts.m_DynamicUniformBuffers, descriptorCounts.m_SampledImages, descriptorCounts.m_StorageImages, descriptorCounts.m_AccelerationStructures);
 	return true;
 }
 
@@ -96,12 +106,51 @@ DescriptorSetVK* DescriptorPoolVK::allocDescriptorSet(const DescriptorSetLayoutV
 	m_DescriptorCounts += allocatedDescriptorCount;
 
 	DescriptorSetVK* pDescriptorSet = DBG_NEW DescriptorSetVK();
-	pDescriptorSet->init(descriptorSetHandle, m_pDevice, this, allocatedDescriptorCount);
+	pDescriptorSet->init(descriptorSetHandle, m_pDevice, this, pDescriptorSetLayout, allocatedDescriptorCount);
 	m_AllocatedSets.push_back(pDescriptorSet);
 
 	return pDescriptorSet;
 }
 
+DescriptorSetVK* DescriptorPoolVK::copyDescriptorSet(const DescriptorSetVK* pSource)
+{
+	const DescriptorSetLayoutVK* pDescriptorSetLayout = pSource->getDescriptorSetLayout();
+
+	DescriptorSetVK* pDescriptorSet = allocDescriptorSet(pDescriptorSetLayout);
+	if (pDescriptorSet == nullptr) {
+		return nullptr;
+	}
+
+	std::vector<VkCopyDescriptorSet> descriptorCopies;
+	for (const VkDescriptorSetLayoutBinding& binding : pDescriptorSetLayout->getBindings()) {
+		VkCopyDescriptorSet descriptorCopy = {};
+		descriptorCopy.sType			= VK_STRUCTURE_TYPE_COPY_DESCRIPTOR_SET;
+		descriptorCopy.pNext			= nullptr;
+		descriptorCopy.srcSet			= pSource->getDescriptorSet();
+		descriptorCopy.srcBinding		= binding.binding;
+		descriptorCopy.srcArrayElement	= 0;
+		descriptorCopy.dstSet			= pDescriptorSet->getDescriptorSet();
+		descriptorCopy.dstBinding		= binding.binding;
+		descriptorCopy.dstArrayElement	= 0;
+		descriptorCopy.descriptorCount	= binding.descriptorCount;
+		descriptorCopies.push_back(descriptorCopy);
+	}
+
+	vkUpdateDescriptorSets(m_pDevice->getDevice(), 0, nullptr, uint32_t(descriptorCopies.size()), descriptorCopies.data());
+	return pDescriptorSet;
+}
+
+DescriptorSetVK* DescriptorPoolVK::replaceDescriptorSet(DescriptorSetVK* pDescriptorSet)
+{
+	DescriptorSetVK* pCopy = copyDescriptorSet(pDescriptorSet);
+	if (pCopy == nullptr) {
+		return pDescriptorSet;
+	}
+
+	m_pDevice->getDeletionQueue()->deallocate(pDescriptorSet);
+	return pCopy;
+}
+
 void DescriptorPoolVK::deallocateDescriptorSet(DescriptorSetVK* pDescriptorSet)
 {
 	VkDescriptorSet descriptorSet = pDescriptorSet->getDescriptorSet();
@@ -19,6 +19,10 @@ public:
 
     bool hasRoomFor(const DescriptorCounts& descriptors);
     DescriptorSetVK* allocDescriptorSet(const DescriptorSetLayoutVK* pDescriptorSetLayout);
+    //Allocates a set with the same layout and copies every descriptor. The copy can be written while the frames in flight still use the original
+    DescriptorSetVK* copyDescriptorSet(const DescriptorSetVK* pSource);
+    //Copies the set and retires the original through the deletion queue of the device, used to update sets that are bound every frame
+    DescriptorSetVK* replaceDescriptorSet(DescriptorSetVK* pDescriptorSet);
     void deallocateDescriptorSet(DescriptorSetVK* pDescriptorSet);
 
 private:
@@ -42,6 +42,18 @@ void DescriptorSetLayoutVK::addBindingUniformBuffer(VkShaderStageFlags shaderSta
     m_DescriptorSetLayoutBindings.push_back(descriptorSetLayoutBinding);
 }
 
+void DescriptorSetLayoutVK::addBindingUniformBufferDynamic(VkShaderStageFlags shaderStageFlags, uint32_t bindingSlot, uint32_t descriptorCount)
+{
+    VkDescriptorSetLayoutBinding descriptorSetLayoutBinding = {};
+    descriptorSetLayoutBinding.binding = bindingSlot;
+    descriptorSetLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+    descriptorSetLayoutBinding.descriptorCount = descriptorCount;
+    descriptorSetLayoutBinding.stageFlags = shaderStageFlags;
+    descriptorSetLayoutBinding.pImmutableSamplers = nullptr;
+
+    m_DescriptorSetLayoutBindings.push_back(descriptorSetLayoutBinding);
+}
+
 void DescriptorSetLayoutVK::addBindingSampledImage(VkShaderStageFlags shaderStageFlags, uint32_t bindingSlot, uint32_t descriptorCount)
 {
     VkDescriptorSetLayoutBinding descriptorSetLayoutBinding = {};
@@ -120,6 +132,9 @@ DescriptorCounts DescriptorSetLayoutVK::getBindingCounts() const
             case VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER:
                 bindingCounts.m_UniformBuffers += binding.descriptorCount;
                 break;
+            case VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC:
+                bindingCounts.m_DynamicUniformBuffers += binding.descriptorCount;
+                break;
             case VK_DESCRIPTOR_TYPE_STORAGE_BUFFER:
                 bindingCounts.m_StorageBuffers += binding.descriptorCount;
                 break;
@@ -14,6 +14,7 @@ public:
 
     void addBindingStorageBuffer(VkShaderStageFlags shaderStageFlags, uint32_t bindingSlot, uint32_t descriptorCount);
     void addBindingUniformBuffer(VkShaderStageFlags shaderStageFlags, uint32_t bindingSlot, uint32_t descriptorCount);
+    void addBindingUniformBufferDynamic(VkShaderStageFlags shaderStageFlags, uint32_t bindingSlot, uint32_t descriptorCount);
     void addBindingSampledImage(VkShaderStageFlags shaderStageFlags, uint32_t bindingSlot, uint32_t descriptorCount);
 	void addBindingStorageImage(VkShaderStageFlags shaderStageFlags, uint32_t bindingSlot, uint32_t descriptorCount);
 	void addBindingAccelerationStructure(VkShaderStageFlags shaderStageFlags, uint32_t bindingSlot, uint32_t descriptorCount);
@@ -22,6 +23,7 @@ public:
 
     VkDescriptorSetLayout getLayout() const { return m_DescriptorSetLayout; }
     DescriptorCounts getBindingCounts() const;
+    const std::vector<VkDescriptorSetLayoutBinding>& getBindings() const { return m_DescriptorSetLayoutBindings; }
 
 private:
     DeviceVK* m_pDevice;
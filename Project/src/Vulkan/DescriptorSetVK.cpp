@@ -7,6 +7,7 @@
 
 DescriptorSetVK::DescriptorSetVK()
     :m_pDescriptorPool(nullptr),
+    m_pDescriptorSetLayout(nullptr),
     m_DescriptorSet(VK_NULL_HANDLE),
     m_DescriptorCounts({0})
 {}
@@ -15,12 +16,13 @@ DescriptorSetVK::~DescriptorSetVK()
 {
 }
 
-void DescriptorSetVK::init(VkDescriptorSet descriptorSetHandle, DeviceVK* pDevice, DescriptorPoolVK* pDescriptorPool, const DescriptorCounts& descriptorCounts)
+void DescriptorSetVK::init(VkDescriptorSet descriptorSetHandle, DeviceVK* pDevice, DescriptorPoolVK* pDescriptorPool, const DescriptorSetLayoutVK* pDescriptorSetLayout, const DescriptorCounts& descriptorCounts)
 {
-    m_DescriptorSet		= descriptorSetHandle;
-    m_pDevice			= pDevice;
-    m_pDescriptorPool	= pDescriptorPool;
-    m_DescriptorCounts	= descriptorCounts;
+    m_DescriptorSet			= descriptorSetHandle;
+    m_pDevice				= pDevice;
+    m_pDescriptorPool		= pDescriptorPool;
+    m_pDescriptorSetLayout	= pDescriptorSetLayout;
+    m_DescriptorCounts		= descriptorCounts;
 }
 
 void DescriptorSetVK::writeUniformBufferDescriptor(const BufferVK* pBuffer, uint32_t binding)
@@ -28,6 +30,11 @@ void DescriptorSetVK::writeUniformBufferDescriptor(const BufferVK* pBuffer, uint
     writeBufferDescriptor(pBuffer, binding, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER);
 }
 
+void DescriptorSetVK::writeUniformBufferDynamicDescriptor(const BufferVK* pBuffer, uint32_t binding, VkDeviceSize range)
+{
+    writeBufferDescriptor(pBuffer, binding, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, range);
+}
+
 void DescriptorSetVK::writeStorageBufferDescriptor(const BufferVK* pBuffer, uint32_t binding)
 {
     writeBufferDescriptor(pBuffer, binding, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);
@@ -77,14 +84,14 @@ void DescriptorSetVK::writeAccelerationStructureDescriptor(VkAccelerationStructu
 	vkUpdateDescriptorSets(m_pDevice->getDevice(), 1, &accelerationStructureWrite, 0, nullptr);
 }
 
-void DescriptorSetVK::writeBufferDescriptor(const BufferVK* pBuffer, uint32_t binding, VkDescriptorType bufferType)
+void DescriptorSetVK::writeBufferDescriptor(const BufferVK* pBuffer, uint32_t binding, VkDescriptorType bufferType, VkDeviceSize range)
 {
     ASSERT(pBuffer != nullptr);
 
     VkDescriptorBufferInfo bufferInfo = {};
     bufferInfo.buffer	= pBuffer->getBuffer();
     bufferInfo.offset	= 0;
-    bufferInfo.range	= VK_WHOLE_SIZE;
+    bufferInfo.range	= range;
 
     VkWriteDescriptorSet descriptorBufferWrite = {};
     descriptorBufferWrite.sType             = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
@@ -9,6 +9,7 @@ class BufferVK;
 class SamplerVK;
 class ImageViewVK;
 class DescriptorPoolVK;
+class DescriptorSetLayoutVK;
 
 class DescriptorSetVK : public IDescriptorSet
 {
@@ -16,9 +17,11 @@ public:
     DescriptorSetVK();
     ~DescriptorSetVK();
 
-    void init(VkDescriptorSet descriptorSetHandle, DeviceVK* pDevice, DescriptorPoolVK* pDescriptorPool, const DescriptorCounts& descriptorCounts);
+    void init(VkDescriptorSet descriptorSetHandle, DeviceVK* pDevice, DescriptorPoolVK* pDescriptorPool, const DescriptorSetLayoutVK* pDescriptorSetLayout, const DescriptorCounts& descriptorCounts);
 
     void writeUniformBufferDescriptor(const BufferVK* pBuffer, uint32_t binding);
+    //The offset is given when the set is bound, so only the size of one slice is written
+    void writeUniformBufferDynamicDescriptor(const BufferVK* pBuffer, uint32_t binding, VkDeviceSize range);
     void writeStorageBufferDescriptor(const BufferVK* pBuffer, uint32_t binding);
 	void writeCombinedImageDescriptors(const ImageViewVK* const * ppImageViews, const SamplerVK* const * ppSamplers, uint32_t count, uint32_t binding);
     void writeSampledImageDescriptor(const ImageViewVK* pImageView, uint32_t binding);
@@ -27,9 +30,11 @@ public:
 	
     VkDescriptorSet getDescriptorSet() const { return m_DescriptorSet; }
     const DescriptorCounts& getDescriptorCounts() const { return m_DescriptorCounts; }
+    DescriptorPoolVK* getDescriptorPool() const { return m_pDescriptorPool; }
+    const DescriptorSetLayoutVK* getDescriptorSetLayout() const { return m_pDescriptorSetLayout; }
 
 private:
-    void writeBufferDescriptor(const BufferVK* pBuffer, uint32_t binding, VkDescriptorType descriptorType);
+    void writeBufferDescriptor(const BufferVK* pBuffer, uint32_t binding, VkDescriptorType descriptorType, VkDeviceSize range = VK_WHOLE_SIZE);
     void writeImageDescriptors(const ImageViewVK* const * ppImageViews, const SamplerVK* const * ppSamplers, uint32_t count, uint32_t binding, VkImageLayout layout, VkDescriptorType descriptorType);
 
 private:
@@ -38,5 +43,6 @@ private:
 
     // The pool that allocated the set
     DescriptorPoolVK* m_pDescriptorPool;
+    const DescriptorSetLayoutVK* m_pDescriptorSetLayout;
     DeviceVK* m_pDevice;
 };
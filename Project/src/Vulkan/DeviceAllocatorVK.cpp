@@ -0,0 +1,385 @@
+#include "DeviceAllocatorVK.h"
+#include "DeviceVK.h"
+#include "InstanceVK.h"
+
+#include <mutex>
+#include <fstream>
+#include <algorithm>
+
+DeviceAllocatorVK::DeviceAllocatorVK(DeviceVK* pDevice)
+	: m_pDevice(pDevice),
+	m_MemoryProperties(),
+	m_SeparateImageBlocks(true),
+	m_DedicatedCount(),
+	m_DedicatedBytes(),
+	m_Categories(),
+	m_UsedBytes(0),
+	m_PeakBytes(0)
+{
+	for (uint32_t category = 0; category < MEMORY_CATEGORY_COUNT; category++)
+	{
+		m_Categories[category].Category = EMemoryCategory(category);
+	}
+}
+
+DeviceAllocatorVK::~DeviceAllocatorVK()
+{
+	release();
+}
+
+bool DeviceAllocatorVK::init()
+{
+	vkGetPhysicalDeviceMemoryProperties(m_pDevice->getPhysicalDevice(), &m_MemoryProperties);
+	m_SeparateImageBlocks = m_pDevice->getDeviceLimits().bufferImageGranularity > 1;
+
+	m_Lock.enableStatistics("DeviceAllocatorVK");
+
+	D_LOG("--- DeviceAllocatorVK: bufferImageGranularity=%llu, images %s", (unsigned long long)m_pDevice->getDeviceLimits().bufferImageGranularity, m_SeparateImageBlocks ? "get separate blocks" : "share blocks with buffers");
+	return true;
+}
+
+void DeviceAllocatorVK::release()
+{
+	std::scoped_lock<Spinlock> lock(m_Lock);
+	for (uint32_t memoryType = 0; memoryType < VK_MAX_MEMORY_TYPES; memoryType++)
+	{
+		for (std::vector<DeviceMemoryBlockVK*>& blocks : m_Blocks[memoryType])
+		{
+			for (DeviceMemoryBlockVK* pBlock : blocks)
+			{
+				SAFEDELETE(pBlock);
+			}
+
+			blocks.clear();
+		}
+
+		if (m_DedicatedCount[memoryType] > 0)
+		{
+			LOG("--- DeviceAllocatorVK: %u dedicated allocations of memory type %u were never freed", m_DedicatedCount[memoryType], memoryType);
+		}
+	}
+}
+
+bool DeviceAllocatorVK::allocate(AllocationVK& allocation, const VkMemoryRequirements& memoryRequirements, VkMemoryPropertyFlags properties, EAllocationTypeVK type, EMemoryCategory category)
+{
+	const uint32_t memoryTypeIndex = findMemoryTypeIndex(memoryRequirements.memoryTypeBits, properties);
+	if (memoryTypeIndex == UINT32_MAX)
+	{
+		LOG("--- DeviceAllocatorVK: No memory type with the requested properties");
+		return false;
+	}
+
+	const VkDeviceSize blockSize = getBlockSize(memoryTypeIndex);
+	if (memoryRequirements.size > blockSize / 2)
+	{
+		return allocateDedicated(allocation, memoryRequirements, memoryTypeIndex, category);
+	}
+
+	{
+		std::scoped_lock<Spinlock> lock(m_Lock);
+
+		std::vector<DeviceMemoryBlockVK*>& blocks = m_Blocks[memoryTypeIndex][m_SeparateImageBlocks ? uint32_t(type) : 0];
+		for (DeviceMemoryBlockVK* pBlock : blocks)
+		{
+			if (pBlock->allocate(allocation, memoryRequirements.size, memoryRequirements.alignment))
+			{
+				addToCategory(allocation, category);
+				return true;
+			}
+		}
+
+		const bool isHostVisible = (m_MemoryProperties.memoryTypes[memoryTypeIndex].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) != 0;
+
+		DeviceMemoryBlockVK* pBlock = DBG_NEW DeviceMemoryBlockVK(m_pDevice);
+		if (pBlock->init(memoryTypeIndex, blockSize, isHostVisible))
+		{
+			blocks.emplace_back(pBlock);
+			if (pBlock->allocate(allocation, memoryRequirements.size, memoryRequirements.alignment))
+			{
+				addToCategory(allocation, category);
+				return true;
+			}
+		}
+		else
+		{
+			SAFEDELETE(pBlock);
+		}
+	}
+
+	//Not enough memory for a whole block, try to get just what is needed
+	LOG("--- DeviceAllocatorVK: Could not allocate a new block for memory type %u, falling back to a dedicated allocation", memoryTypeIndex);
+	return allocateDedicated(allocation, memoryRequirements, memoryTypeIndex, category);
+}
+
+void DeviceAllocatorVK::deallocate(AllocationVK& allocation)
+{
+	if (allocation.Memory == VK_NULL_HANDLE)
+	{
+		return;
+	}
+
+	const uint32_t memoryTypeIndex = allocation.MemoryTypeIndex;
+
+	std::scoped_lock<Spinlock> lock(m_Lock);
+	removeFromCategory(allocation);
+
+	if (!allocation.pBlock)
+	{
+		vkFreeMemory(m_pDevice->getDevice(), allocation.Memory, nullptr);
+
+		m_DedicatedCount[memoryTypeIndex]--;
+		m_DedicatedBytes[memoryTypeIndex] -= allocation.Size;
+		allocation = AllocationVK();
+		return;
+	}
+
+	DeviceMemoryBlockVK* pBlock = allocation.pBlock;
+	pBlock->deallocate(allocation);
+
+	//Keep one block around so that a resource that is recreated every now and then does not allocate a new block each time
+	if (pBlock->isEmpty())
+	{
+		for (std::vector<DeviceMemoryBlockVK*>& blocks : m_Blocks[memoryTypeIndex])
+		{
+			auto block = std::find(blocks.begin(), blocks.end(), pBlock);
+			if (block != blocks.end() && blocks.size() > 1)
+			{
+				blocks.erase(block);
+				SAFEDELETE(pBlock);
+				break;
+			}
+		}
+	}
+}
+
+void DeviceAllocatorVK::getStatistics(std::vector<DeviceMemoryStatistics>& statistics)
+{
+	statistics.clear();
+
+	std::scoped_lock<Spinlock> lock(m_Lock);
+	for (uint32_t memoryType = 0; memoryType < m_MemoryProperties.memoryTypeCount; memoryType++)
+	{
+		DeviceMemoryStatistics memoryStatistics = {};
+		memoryStatistics.MemoryTypeIndex	= memoryType;
+		memoryStatistics.Properties			= m_MemoryProperties.memoryTypes[memoryType].propertyFlags;
+		memoryStatistics.DedicatedCount		= m_DedicatedCount[memoryType];
+		memoryStatistics.DedicatedBytes		= m_DedicatedBytes[memoryType];
+
+		for (const std::vector<DeviceMemoryBlockVK*>& blocks : m_Blocks[memoryType])
+		{
+			for (const DeviceMemoryBlockVK* pBlock : blocks)
+			{
+				memoryStatistics.BlockCount++;
+				memoryStatistics.AllocationCount	+= pBlock->getAllocationCount();
+				memoryStatistics.FreeRegionCount	+= pBlock->getFreeRegionCount();
+				memoryStatistics.BlockBytes			+= pBlock->getSizeInBytes();
+				memoryStatistics.UsedBytes			+= pBlock->getUsedBytes();
+				memoryStatistics.LargestFreeRegion	= std::max(memoryStatistics.LargestFreeRegion, pBlock->getLargestFreeRegion());
+			}
+		}
+
+		if (memoryStatistics.BlockCount == 0 && memoryStatistics.DedicatedCount == 0)
+		{
+			continue;
+		}
+
+		const VkDeviceSize freeBytes = memoryStatistics.BlockBytes - memoryStatistics.UsedBytes;
+		if (freeBytes > 0)
+		{
+			memoryStatistics.Fragmentation = 1.0f - float(double(memoryStatistics.LargestFreeRegion) / double(freeBytes));
+		}
+
+		statistics.emplace_back(memoryStatistics);
+	}
+}
+
+uint32_t DeviceAllocatorVK::getDeviceAllocationCount()
+{
+	std::scoped_lock<Spinlock> lock(m_Lock);
+
+	uint32_t count = 0;
+	for (uint32_t memoryType = 0; memoryType < VK_MAX_MEMORY_TYPES; memoryType++)
+	{
+		count += m_DedicatedCount[memoryType];
+		for (const std::vector<DeviceMemoryBlockVK*>& blocks : m_Blocks[memoryType])
+		{
+			count += uint32_t(blocks.size());
+		}
+	}
+
+	return count;
+}
+
+void DeviceAllocatorVK::getCategoryStatistics(std::vector<MemoryCategoryStatistics>& statistics, VkDeviceSize& usedBytes, VkDeviceSize& peakBytes)
+{
+	std::scoped_lock<Spinlock> lock(m_Lock);
+	statistics.assign(m_Categories, m_Categories + MEMORY_CATEGORY_COUNT);
+	usedBytes = m_UsedBytes;
+	peakBytes = m_PeakBytes;
+}
+
+bool DeviceAllocatorVK::getHeapBudgets(std::vector<MemoryHeapBudget>& budgets)
+{
+	budgets.resize(m_MemoryProperties.memoryHeapCount);
+	for (uint32_t heap = 0; heap < m_MemoryProperties.memoryHeapCount; heap++)
+	{
+		MemoryHeapBudget& budget = budgets[heap];
+		budget.HeapIndex		= heap;
+		budget.Flags			= m_MemoryProperties.memoryHeaps[heap].flags;
+		budget.Size				= m_MemoryProperties.memoryHeaps[heap].size;
+		budget.Budget			= budget.Size;
+		budget.ReservedBytes	= 0;
+	}
+
+	{
+		std::scoped_lock<Spinlock> lock(m_Lock);
+		for (uint32_t memoryType = 0; memoryType < m_MemoryProperties.memoryTypeCount; memoryType++)
+		{
+			MemoryHeapBudget& budget = budgets[m_MemoryProperties.memoryTypes[memoryType].heapIndex];
+			budget.ReservedBytes += m_DedicatedBytes[memoryType];
+
+			for (const std::vector<DeviceMemoryBlockVK*>& blocks : m_Blocks[memoryType])
+			{
+				for (const DeviceMemoryBlockVK* pBlock : blocks)
+				{
+					budget.ReservedBytes += pBlock->getSizeInBytes();
+				}
+			}
+		}
+	}
+
+	if (!m_pDevice->supportsMemoryBudget())
+	{
+		for (MemoryHeapBudget& budget : budgets)
+		{
+			budget.Usage = budget.ReservedBytes;
+		}
+
+		return false;
+	}
+
+	//The budget changes with what other applications use, so it is queried every time
+	VkPhysicalDeviceMemoryBudgetPropertiesEXT budgetProperties = {};
+	budgetProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT;
+
+	VkPhysicalDeviceMemoryProperties2KHR memoryProperties2 = {};
+	memoryProperties2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2_KHR;
+	memoryProperties2.pNext = &budgetProperties;
+	m_pDevice->getInstance()->vkGetPhysicalDeviceMemoryProperties2KHR(m_pDevice->getPhysicalDevice(), &memoryProperties2);
+
+	for (MemoryHeapBudget& budget : budgets)
+	{
+		budget.Budget	= budgetProperties.heapBudget[budget.HeapIndex];
+		budget.Usage	= budgetProperties.heapUsage[budget.HeapIndex];
+	}
+
+	return true;
+}
+
+void DeviceAllocatorVK::writeReport(const std::string& filepath)
+{
+	std::vector<MemoryCategoryStatistics> statistics;
+	VkDeviceSize usedBytes = 0;
+	VkDeviceSize peakBytes = 0;
+	getCategoryStatistics(statistics, usedBytes, peakBytes);
+
+	std::ofstream fileStream;
+	fileStream.open(filepath);
+	if (!fileStream.is_open())
+	{
+		LOG("--- DeviceAllocatorVK: Failed to open '%s'", filepath.c_str());
+		return;
+	}
+
+	fileStream << "Category,Allocations,TotalAllocations,UsedBytes,PeakBytes" << std::endl;
+	for (const MemoryCategoryStatistics& category : statistics)
+	{
+		fileStream << memoryCategoryAsString(category.Category) << "," << category.AllocationCount << "," << category.TotalAllocations << "," << category.UsedBytes << "," << category.PeakBytes << std::endl;
+	}
+
+	//The peak of the total is lower than the sum of the peaks when the categories peak at different times
+	fileStream << "Total,,," << usedBytes << "," << peakBytes << std::endl;
+	fileStream.close();
+
+	D_LOG("--- DeviceAllocatorVK: Memory report written to '%s'", filepath.c_str());
+}
+
+bool DeviceAllocatorVK::allocateDedicated(AllocationVK& allocation, const VkMemoryRequirements& memoryRequirements, uint32_t memoryTypeIndex, EMemoryCategory category)
+{
+	VkMemoryAllocateInfo allocInfo = {};
+	allocInfo.sType				= VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+	allocInfo.pNext				= nullptr;
+	allocInfo.allocationSize	= memoryRequirements.size;
+	allocInfo.memoryTypeIndex	= memoryTypeIndex;
+
+	VkDeviceMemory memory = VK_NULL_HANDLE;
+	VK_CHECK_RESULT_RETURN_FALSE(vkAllocateMemory(m_pDevice->getDevice(), &allocInfo, nullptr, &memory), "--- DeviceAllocatorVK: Failed to allocate dedicated memory");
+
+	void* pHostMemory = nullptr;
+	if (m_MemoryProperties.memoryTypes[memoryTypeIndex].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT)
+	{
+		if (vkMapMemory(m_pDevice->getDevice(), memory, 0, VK_WHOLE_SIZE, 0, &pHostMemory) != VK_SUCCESS)
+		{
+			LOG("--- DeviceAllocatorVK: Failed to map dedicated memory");
+			vkFreeMemory(m_pDevice->getDevice(), memory, nullptr);
+			return false;
+		}
+	}
+
+	allocation.Memory			= memory;
+	allocation.Offset			= 0;
+	allocation.Size				= memoryRequirements.size;
+	allocation.MemoryTypeIndex	= memoryTypeIndex;
+	allocation.pHostMemory		= pHostMemory;
+	allocation.pBlock			= nullptr;
+	allocation.pRegion			= nullptr;
+
+	std::scoped_lock<Spinlock> lock(m_Lock);
+	m_DedicatedCount[memoryTypeIndex]++;
+	m_DedicatedBytes[memoryTypeIndex] += memoryRequirements.size;
+	addToCategory(allocation, category);
+	return true;
+}
+
+void DeviceAllocatorVK::addToCategory(AllocationVK& allocation, EMemoryCategory category)
+{
+	allocation.Category = category;
+
+	MemoryCategoryStatistics& statistics = m_Categories[uint32_t(category)];
+	statistics.AllocationCount++;
+	statistics.TotalAllocations++;
+	statistics.UsedBytes += allocation.Size;
+	statistics.PeakBytes = std::max(statistics.PeakBytes, statistics.UsedBytes);
+
+	m_UsedBytes += allocation.Size;
+	m_PeakBytes = std::max(m_PeakBytes, m_UsedBytes);
+}
+
+void DeviceAllocatorVK::removeFromCategory(const AllocationVK& allocation)
+{
+	MemoryCategoryStatistics& statistics = m_Categories[uint32_t(allocation.Category)];
+	statistics.AllocationCount--;
+	statistics.UsedBytes -= allocation.Size;
+
+	m_UsedBytes -= allocation.Size;
+}
+
+uint32_t DeviceAllocatorVK::findMemoryTypeIndex(uint32_t memoryTypeBits, VkMemoryPropertyFlags properties) const
+{
+	for (uint32_t i = 0; i < m_MemoryProperties.memoryTypeCount; i++)
+	{
+		if ((memoryTypeBits & (1U << i)) && (m_MemoryProperties.memoryTypes[i].propertyFlags & properties) == properties)
+		{
+			return i;
+		}
+	}
+
+	return UINT32_MAX;
+}
+
+VkDeviceSize DeviceAllocatorVK::getBlockSize(uint32_t memoryTypeIndex) const
+{
+	const uint32_t heapIndex	= m_MemoryProperties.memoryTypes[memoryTypeIndex].heapIndex;
+	const VkDeviceSize heapSize = m_MemoryProperties.memoryHeaps[heapIndex].size;
+	return std::min(DEVICE_MEMORY_BLOCK_SIZE, heapSize / 8);
+}
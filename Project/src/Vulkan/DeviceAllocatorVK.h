@@ -0,0 +1,113 @@
+#pragma once
+#include "Core/Spinlock.h"
+
+#include "DeviceMemoryBlockVK.h"
+
+#include <string>
+#include <vector>
+
+//Size of the blocks that resources are sub allocated from, smaller heaps use an eighth of the heap instead
+#define DEVICE_MEMORY_BLOCK_SIZE (64ULL * 1024ULL * 1024ULL)
+
+class DeviceVK;
+
+//Buffers and acceleration structures are linear resources while images are not. When the device has a bufferImageGranularity above one they are
+//kept in separate blocks, so that a buffer and an image never end up on the same page
+enum class EAllocationTypeVK : uint32_t
+{
+	BUFFER	= 0,
+	IMAGE	= 1
+};
+
+#define ALLOCATION_TYPE_COUNT 2U
+
+struct DeviceMemoryStatistics
+{
+	uint32_t MemoryTypeIndex			= 0;
+	VkMemoryPropertyFlags Properties	= 0;
+	uint32_t BlockCount					= 0;
+	uint32_t DedicatedCount				= 0;
+	uint32_t AllocationCount			= 0;
+	uint32_t FreeRegionCount			= 0;
+	VkDeviceSize BlockBytes				= 0;
+	VkDeviceSize UsedBytes				= 0;
+	VkDeviceSize DedicatedBytes			= 0;
+	VkDeviceSize LargestFreeRegion		= 0;
+	//One minus the largest free region divided by all free memory in the blocks, zero when the free memory is in one piece
+	float Fragmentation					= 0.0f;
+};
+
+struct MemoryCategoryStatistics
+{
+	EMemoryCategory Category	= EMemoryCategory::UNKNOWN;
+	uint32_t AllocationCount	= 0;
+	uint64_t TotalAllocations	= 0;
+	VkDeviceSize UsedBytes		= 0;
+	VkDeviceSize PeakBytes		= 0;
+};
+
+//The memory panel warns about heaps above this share of their budget
+#define MEMORY_BUDGET_WARNING_THRESHOLD 0.9f
+
+//Usage and Budget come from VK_EXT_memory_budget and include other processes, without it Budget is the size of the heap and Usage is what this allocator has reserved
+struct MemoryHeapBudget
+{
+	uint32_t HeapIndex			= 0;
+	VkMemoryHeapFlags Flags		= 0;
+	VkDeviceSize Size			= 0;
+	VkDeviceSize Budget			= 0;
+	VkDeviceSize Usage			= 0;
+	VkDeviceSize ReservedBytes	= 0;
+};
+
+//Allocates large blocks of device memory per memory type and sub allocates buffers, images and acceleration structures from them.
+//Resources larger than half a block get a VkDeviceMemory of their own
+class DeviceAllocatorVK
+{
+public:
+	DeviceAllocatorVK(DeviceVK* pDevice);
+	~DeviceAllocatorVK();
+
+	DECL_NO_COPY(DeviceAllocatorVK);
+
+	bool init();
+	void release();
+
+	bool allocate(AllocationVK& allocation, const VkMemoryRequirements& memoryRequirements, VkMemoryPropertyFlags properties, EAllocationTypeVK type, EMemoryCategory category);
+	void deallocate(AllocationVK& allocation);
+
+	//One entry per memory type that has been used
+	void getStatistics(std::vector<DeviceMemoryStatistics>& statistics);
+	//Number of vkAllocateMemory calls that are alive, blocks and dedicated allocations
+	uint32_t getDeviceAllocationCount();
+	//One entry per category, peaks are kept since init
+	void getCategoryStatistics(std::vector<MemoryCategoryStatistics>& statistics, VkDeviceSize& usedBytes, VkDeviceSize& peakBytes);
+	//Returns true when the numbers come from VK_EXT_memory_budget
+	bool getHeapBudgets(std::vector<MemoryHeapBudget>& budgets);
+
+	//Writes the category statistics as csv, allocations still alive at exit show up as used bytes
+	void writeReport(const std::string& filepath);
+
+private:
+	bool allocateDedicated(AllocationVK& allocation, const VkMemoryRequirements& memoryRequirements, uint32_t memoryTypeIndex, EMemoryCategory category);
+	//Has to be called with the lock held
+	void addToCategory(AllocationVK& allocation, EMemoryCategory category);
+	void removeFromCategory(const AllocationVK& allocation);
+	uint32_t findMemoryTypeIndex(uint32_t memoryTypeBits, VkMemoryPropertyFlags properties) const;
+	VkDeviceSize getBlockSize(uint32_t memoryTypeIndex) const;
+
+private:
+	DeviceVK* m_pDevice;
+	VkPhysicalDeviceMemoryProperties m_MemoryProperties;
+	bool m_SeparateImageBlocks;
+
+	std::vector<DeviceMemoryBlockVK*> m_Blocks[VK_MAX_MEMORY_TYPES][ALLOCATION_TYPE_COUNT];
+	uint32_t m_DedicatedCount[VK_MAX_MEMORY_TYPES];
+	VkDeviceSize m_DedicatedBytes[VK_MAX_MEMORY_TYPES];
+
+	MemoryCategoryStatistics m_Categories[MEMORY_CATEGORY_COUNT];
+	VkDeviceSize m_UsedBytes;
+	VkDeviceSize m_PeakBytes;
+
+	Spinlock m_Lock;
+};
@@ -0,0 +1,372 @@
+#include "DeviceMemoryBlockVK.h"
+#include "DeviceVK.h"
+
+#include <algorithm>
+
+#ifdef _MSC_VER
+	#include <intrin.h>
+#endif
+
+static uint32_t findFirstSet(uint64_t bits)
+{
+#ifdef _MSC_VER
+	unsigned long index = 0;
+	_BitScanForward64(&index, bits);
+	return uint32_t(index);
+#else
+	return uint32_t(__builtin_ctzll(bits));
+#endif
+}
+
+static uint32_t findLastSet(uint64_t bits)
+{
+#ifdef _MSC_VER
+	unsigned long index = 0;
+	_BitScanReverse64(&index, bits);
+	return uint32_t(index);
+#else
+	return uint32_t(63 - __builtin_clzll(bits));
+#endif
+}
+
+static VkDeviceSize alignUp(VkDeviceSize offset, VkDeviceSize alignment)
+{
+	return (alignment > 1) ? ((offset + alignment - 1) / alignment) * alignment : offset;
+}
+
+DeviceMemoryBlockVK::DeviceMemoryBlockVK(DeviceVK* pDevice)
+	: m_pDevice(pDevice),
+	m_Memory(VK_NULL_HANDLE),
+	m_pHostMemory(nullptr),
+	m_SizeInBytes(0),
+	m_UsedBytes(0),
+	m_MemoryTypeIndex(0),
+	m_AllocationCount(0),
+	m_FreeRegionCount(0),
+	m_pFirstRegion(nullptr),
+	m_pUnusedRegions(nullptr),
+	m_FreeLists(),
+	m_FirstLevelBitmap(0),
+	m_SecondLevelBitmaps()
+{
+}
+
+DeviceMemoryBlockVK::~DeviceMemoryBlockVK()
+{
+	if (m_AllocationCount > 0)
+	{
+		LOG("--- DeviceMemoryBlockVK: Destroying block with %u allocations left", m_AllocationCount);
+	}
+
+	MemoryRegionVK* pRegion = m_pFirstRegion;
+	while (pRegion)
+	{
+		MemoryRegionVK* pNext = pRegion->pNextPhysical;
+		delete pRegion;
+		pRegion = pNext;
+	}
+
+	pRegion = m_pUnusedRegions;
+	while (pRegion)
+	{
+		MemoryRegionVK* pNext = pRegion->pNextFree;
+		delete pRegion;
+		pRegion = pNext;
+	}
+
+	if (m_Memory != VK_NULL_HANDLE)
+	{
+		vkFreeMemory(m_pDevice->getDevice(), m_Memory, nullptr);
+		m_Memory = VK_NULL_HANDLE;
+	}
+}
+
+bool DeviceMemoryBlockVK::init(uint32_t memoryTypeIndex, VkDeviceSize sizeInBytes, bool isHostVisible)
+{
+	VkMemoryAllocateInfo allocInfo = {};
+	allocInfo.sType				= VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+	allocInfo.pNext				= nullptr;
+	allocInfo.allocationSize	= sizeInBytes;
+	allocInfo.memoryTypeIndex	= memoryTypeIndex;
+
+	VK_CHECK_RESULT_RETURN_FALSE(vkAllocateMemory(m_pDevice->getDevice(), &allocInfo, nullptr, &m_Memory), "--- DeviceMemoryBlockVK: Failed to allocate memory block");
+
+	if (isHostVisible)
+	{
+		VK_CHECK_RESULT_RETURN_FALSE(vkMapMemory(m_pDevice->getDevice(), m_Memory, 0, VK_WHOLE_SIZE, 0, (void**)&m_pHostMemory), "--- DeviceMemoryBlockVK: Failed to map memory block");
+	}
+
+	m_SizeInBytes		= sizeInBytes;
+	m_MemoryTypeIndex	= memoryTypeIndex;
+
+	m_pFirstRegion = createRegion();
+	m_pFirstRegion->Offset	= 0;
+	m_pFirstRegion->Size	= sizeInBytes;
+	insertFreeRegion(m_pFirstRegion);
+
+	D_LOG("--- DeviceMemoryBlockVK: Allocated block of %llu bytes for memory type %u", (unsigned long long)sizeInBytes, memoryTypeIndex);
+	return true;
+}
+
+bool DeviceMemoryBlockVK::allocate(AllocationVK& allocation, VkDeviceSize sizeInBytes, VkDeviceSize alignment)
+{
+	//A good fit may not have room for the alignment, then look for one that is guaranteed to have it
+	MemoryRegionVK* pRegion = findFreeRegion(sizeInBytes);
+	if (pRegion && (alignUp(pRegion->Offset, alignment) + sizeInBytes > pRegion->Offset + pRegion->Size))
+	{
+		pRegion = findFreeRegion(sizeInBytes + alignment - 1);
+	}
+
+	if (!pRegion)
+	{
+		return false;
+	}
+
+	removeFreeRegion(pRegion);
+
+	//Free neighbours are always merged, so whatever is split off can not be merged with anything
+	const VkDeviceSize padding = alignUp(pRegion->Offset, alignment) - pRegion->Offset;
+	if (padding > 0)
+	{
+		MemoryRegionVK* pPadding = createRegion();
+		pPadding->Offset		= pRegion->Offset;
+		pPadding->Size			= padding;
+		pPadding->pPrevPhysical = pRegion->pPrevPhysical;
+		pPadding->pNextPhysical = pRegion;
+		if (pPadding->pPrevPhysical)
+		{
+			pPadding->pPrevPhysical->pNextPhysical = pPadding;
+		}
+		else
+		{
+			m_pFirstRegion = pPadding;
+		}
+
+		pRegion->pPrevPhysical	= pPadding;
+		pRegion->Offset			+= padding;
+		pRegion->Size			-= padding;
+		insertFreeRegion(pPadding);
+	}
+
+	if (pRegion->Size > sizeInBytes)
+	{
+		MemoryRegionVK* pRemainder = createRegion();
+		pRemainder->Offset			= pRegion->Offset + sizeInBytes;
+		pRemainder->Size			= pRegion->Size - sizeInBytes;
+		pRemainder->pPrevPhysical	= pRegion;
+		pRemainder->pNextPhysical	= pRegion->pNextPhysical;
+		if (pRemainder->pNextPhysical)
+		{
+			pRemainder->pNextPhysical->pPrevPhysical = pRemainder;
+		}
+
+		pRegion->pNextPhysical	= pRemainder;
+		pRegion->Size			= sizeInBytes;
+		insertFreeRegion(pRemainder);
+	}
+
+	pRegion->IsFree = false;
+	m_UsedBytes += pRegion->Size;
+	m_AllocationCount++;
+
+	allocation.Memory			= m_Memory;
+	allocation.Offset			= pRegion->Offset;
+	allocation.Size				= pRegion->Size;
+	allocation.MemoryTypeIndex	= m_MemoryTypeIndex;
+	allocation.pHostMemory		= m_pHostMemory ? (m_pHostMemory + pRegion->Offset) : nullptr;
+	allocation.pBlock			= this;
+	allocation.pRegion			= pRegion;
+	return true;
+}
+
+void DeviceMemoryBlockVK::deallocate(AllocationVK& allocation)
+{
+	ASSERT(allocation.pBlock == this);
+
+	MemoryRegionVK* pRegion = allocation.pRegion;
+	ASSERT(pRegion != nullptr && !pRegion->IsFree);
+
+	pRegion->IsFree = true;
+	m_UsedBytes -= pRegion->Size;
+	m_AllocationCount--;
+
+	MemoryRegionVK* pPrevious = pRegion->pPrevPhysical;
+	if (pPrevious && pPrevious->IsFree)
+	{
+		removeFreeRegion(pPrevious);
+		pPrevious->Size				+= pRegion->Size;
+		pPrevious->pNextPhysical	= pRegion->pNextPhysical;
+		if (pRegion->pNextPhysical)
+		{
+			pRegion->pNextPhysical->pPrevPhysical = pPrevious;
+		}
+
+		destroyRegion(pRegion);
+		pRegion = pPrevious;
+	}
+
+	MemoryRegionVK* pNext = pRegion->pNextPhysical;
+	if (pNext && pNext->IsFree)
+	{
+		removeFreeRegion(pNext);
+		pRegion->Size			+= pNext->Size;
+		pRegion->pNextPhysical	= pNext->pNextPhysical;
+		if (pNext->pNextPhysical)
+		{
+			pNext->pNextPhysical->pPrevPhysical = pRegion;
+		}
+
+		destroyRegion(pNext);
+	}
+
+	insertFreeRegion(pRegion);
+
+	allocation = AllocationVK();
+}
+
+VkDeviceSize DeviceMemoryBlockVK::getLargestFreeRegion() const
+{
+	if (m_FirstLevelBitmap == 0)
+	{
+		return 0;
+	}
+
+	//Only the highest list has to be searched, every region in it is larger than the ones in the lists below
+	const uint32_t firstLevel	= findLastSet(m_FirstLevelBitmap);
+	const uint32_t secondLevel	= findLastSet(m_SecondLevelBitmaps[firstLevel]);
+
+	VkDeviceSize largest = 0;
+	for (MemoryRegionVK* pRegion = m_FreeLists[firstLevel][secondLevel]; pRegion; pRegion = pRegion->pNextFree)
+	{
+		largest = std::max(largest, pRegion->Size);
+	}
+
+	return largest;
+}
+
+MemoryRegionVK* DeviceMemoryBlockVK::findFreeRegion(VkDeviceSize sizeInBytes) const
+{
+	//Round up to the next list so that any region in the list is large enough
+	if (sizeInBytes >= (1ULL << TLSF_FL_SHIFT))
+	{
+		sizeInBytes += (1ULL << (findLastSet(sizeInBytes) - TLSF_SL_COUNT_LOG2)) - 1;
+	}
+	else
+	{
+		sizeInBytes += ((1ULL << TLSF_FL_SHIFT) / TLSF_SL_COUNT) - 1;
+	}
+
+	uint32_t firstLevel		= 0;
+	uint32_t secondLevel	= 0;
+	mapping(sizeInBytes, firstLevel, secondLevel);
+	if (firstLevel >= TLSF_FL_COUNT)
+	{
+		return nullptr;
+	}
+
+	uint32_t secondLevelBitmap = m_SecondLevelBitmaps[firstLevel] & (~0U << secondLevel);
+	if (secondLevelBitmap == 0)
+	{
+		const uint64_t firstLevelBitmap = m_FirstLevelBitmap & (~0ULL << (firstLevel + 1));
+		if (firstLevelBitmap == 0)
+		{
+			return nullptr;
+		}
+
+		firstLevel			= findFirstSet(firstLevelBitmap);
+		secondLevelBitmap	= m_SecondLevelBitmaps[firstLevel];
+	}
+
+	secondLevel = findFirstSet(secondLevelBitmap);
+	return m_FreeLists[firstLevel][secondLevel];
+}
+
+void DeviceMemoryBlockVK::insertFreeRegion(MemoryRegionVK* pRegion)
+{
+	uint32_t firstLevel		= 0;
+	uint32_t secondLevel	= 0;
+	mapping(pRegion->Size, firstLevel, secondLevel);
+
+	MemoryRegionVK* pHead = m_FreeLists[firstLevel][secondLevel];
+	pRegion->IsFree		= true;
+	pRegion->pPrevFree	= nullptr;
+	pRegion->pNextFree	= pHead;
+	if (pHead)
+	{
+		pHead->pPrevFree = pRegion;
+	}
+
+	m_FreeLists[firstLevel][secondLevel] = pRegion;
+	m_FirstLevelBitmap					|= (1ULL << firstLevel);
+	m_SecondLevelBitmaps[firstLevel]	|= (1U << secondLevel);
+	m_FreeRegionCount++;
+}
+
+void DeviceMemoryBlockVK::removeFreeRegion(MemoryRegionVK* pRegion)
+{
+	uint32_t firstLevel		= 0;
+	uint32_t secondLevel	= 0;
+	mapping(pRegion->Size, firstLevel, secondLevel);
+
+	if (pRegion->pPrevFree)
+	{
+		pRegion->pPrevFree->pNextFree = pRegion->pNextFree;
+	}
+	else
+	{
+		m_FreeLists[firstLevel][secondLevel] = pRegion->pNextFree;
+	}
+
+	if (pRegion->pNextFree)
+	{
+		pRegion->pNextFree->pPrevFree = pRegion->pPrevFree;
+	}
+
+	if (!m_FreeLists[firstLevel][secondLevel])
+	{
+		m_SecondLevelBitmaps[firstLevel] &= ~(1U << secondLevel);
+		if (m_SecondLevelBitmaps[firstLevel] == 0)
+		{
+			m_FirstLevelBitmap &= ~(1ULL << firstLevel);
+		}
+	}
+
+	pRegion->pPrevFree	= nullptr;
+	pRegion->pNextFree	= nullptr;
+	m_FreeRegionCount--;
+}
+
+MemoryRegionVK* DeviceMemoryBlockVK::createRegion()
+{
+	if (m_pUnusedRegions)
+	{
+		MemoryRegionVK* pRegion = m_pUnusedRegions;
+		m_pUnusedRegions = pRegion->pNextFree;
+
+		*pRegion = MemoryRegionVK();
+		return pRegion;
+	}
+
+	return DBG_NEW MemoryRegionVK();
+}
+
+void DeviceMemoryBlockVK::destroyRegion(MemoryRegionVK* pRegion)
+{
+	pRegion->pNextFree	= m_pUnusedRegions;
+	m_pUnusedRegions	= pRegion;
+}
+
+void DeviceMemoryBlockVK::mapping(VkDeviceSize sizeInBytes, uint32_t& firstLevel, uint32_t& secondLevel)
+{
+	if (sizeInBytes < (1ULL << TLSF_FL_SHIFT))
+	{
+		firstLevel	= 0;
+		secondLevel = uint32_t(sizeInBytes / ((1ULL << TLSF_FL_SHIFT) / TLSF_SL_COUNT));
+	}
+	else
+	{
+		const uint32_t lastSet = findLastSet(sizeInBytes);
+		firstLevel	= lastSet - (TLSF_FL_SHIFT - 1);
+		secondLevel = uint32_t(sizeInBytes >> (lastSet - TLSF_SL_COUNT_LOG2)) ^ TLSF_SL_COUNT;
+	}
+}
@@ -0,0 +1,90 @@
+#pragma once
+#include "VulkanCommon.h"
+
+//Two level segregated fit. Sizes below 2^TLSF_FL_SHIFT share the first level, each level is split into TLSF_SL_COUNT lists
+#define TLSF_SL_COUNT_LOG2	5U
+#define TLSF_SL_COUNT		(1U << TLSF_SL_COUNT_LOG2)
+#define TLSF_FL_SHIFT		8U
+#define TLSF_FL_MAX			40U
+#define TLSF_FL_COUNT		(TLSF_FL_MAX - TLSF_FL_SHIFT + 1U)
+
+class DeviceVK;
+class DeviceMemoryBlockVK;
+
+struct MemoryRegionVK
+{
+	VkDeviceSize Offset				= 0;
+	VkDeviceSize Size				= 0;
+	MemoryRegionVK* pPrevPhysical	= nullptr;
+	MemoryRegionVK* pNextPhysical	= nullptr;
+	MemoryRegionVK* pPrevFree		= nullptr;
+	MemoryRegionVK* pNextFree		= nullptr;
+	bool IsFree						= true;
+};
+
+struct AllocationVK
+{
+	VkDeviceMemory Memory		= VK_NULL_HANDLE;
+	VkDeviceSize Offset			= 0;
+	VkDeviceSize Size			= 0;
+	uint32_t MemoryTypeIndex	= 0;
+	//Points to the start of the allocation when the memory is host visible, blocks stay mapped for their whole lifetime
+	void* pHostMemory			= nullptr;
+	//Null for allocations that got a VkDeviceMemory of their own
+	DeviceMemoryBlockVK* pBlock = nullptr;
+	MemoryRegionVK* pRegion		= nullptr;
+	EMemoryCategory Category	= EMemoryCategory::UNKNOWN;
+};
+
+//One VkDeviceMemory that is sub allocated with TLSF, allocating and freeing is O(1) and free neighbours are merged right away.
+//Not thread safe, DeviceAllocatorVK locks around it
+class DeviceMemoryBlockVK
+{
+public:
+	DeviceMemoryBlockVK(DeviceVK* pDevice);
+	~DeviceMemoryBlockVK();
+
+	DECL_NO_COPY(DeviceMemoryBlockVK);
+
+	bool init(uint32_t memoryTypeIndex, VkDeviceSize sizeInBytes, bool isHostVisible);
+
+	bool allocate(AllocationVK& allocation, VkDeviceSize sizeInBytes, VkDeviceSize alignment);
+	void deallocate(AllocationVK& allocation);
+
+	VkDeviceSize getLargestFreeRegion() const;
+
+	bool isEmpty() const						{ return m_AllocationCount == 0; }
+	uint32_t getMemoryTypeIndex() const			{ return m_MemoryTypeIndex; }
+	uint32_t getAllocationCount() const			{ return m_AllocationCount; }
+	uint32_t getFreeRegionCount() const			{ return m_FreeRegionCount; }
+	VkDeviceSize getSizeInBytes() const			{ return m_SizeInBytes; }
+	VkDeviceSize getUsedBytes() const			{ return m_UsedBytes; }
+
+private:
+	MemoryRegionVK* findFreeRegion(VkDeviceSize sizeInBytes) const;
+	void insertFreeRegion(MemoryRegionVK* pRegion);
+	void removeFreeRegion(MemoryRegionVK* pRegion);
+
+	MemoryRegionVK* createRegion();
+	void destroyRegion(MemoryRegionVK* pRegion);
+
+	static void mapping(VkDeviceSize sizeInBytes, uint32_t& firstLevel, uint32_t& secondLevel);
+
+private:
+	DeviceVK* m_pDevice;
+	VkDeviceMemory m_Memory;
+	uint8_t* m_pHostMemory;
+	VkDeviceSize m_SizeInBytes;
+	VkDeviceSize m_UsedBytes;
+	uint32_t m_MemoryTypeIndex;
+	uint32_t m_AllocationCount;
+	uint32_t m_FreeRegionCount;
+
+	MemoryRegionVK* m_pFirstRegion;
+	//Nodes of merged regions are kept for the next split instead of being deleted
+	MemoryRegionVK* m_pUnusedRegions;
+
+	MemoryRegionVK* m_FreeLists[TLSF_FL_COUNT][TLSF_SL_COUNT];
+	uint64_t m_FirstLevelBitmap;
+	uint32_t m_SecondLevelBitmaps[TLSF_FL_COUNT];
+};
@@ -7,6 +7,10 @@
 #include "DeviceVK.h"
 #include "InstanceVK.h"
 #include "CopyHandlerVK.h"
+#include "DeviceAllocatorVK.h"
+#include "UploadRingVK.h"
+#include "DeletionQueueVK.h"
+#include "GeometryBufferVK.h"
 #include "CommandBufferVK.h"
 
 #define GET_DEVICE_PROC_ADDR(device, function_name) if ((function_name = reinterpret_cast<PFN_##function_name>(vkGetDeviceProcAddr(device, #function_name))) == nullptr) { LOG("--- Vulkan: Failed to load DeviceFunction '%s'", #function_name); }
@@ -22,6 +26,10 @@ DeviceVK::DeviceVK()
 	m_DeviceLimits({}),
 	m_RayTracingProperties({}),
 	m_pCopyHandler(),
+	m_pAllocator(nullptr),
+	m_pUploadRing(nullptr),
+	m_pDeletionQueue(nullptr),
+	m_pGeometryBuffer(nullptr),
 	vkCreateAccelerationStructureNV(),
 	vkDestroyAccelerationStructureNV(),
 	vkBindAccelerationStructureMemoryNV(),
@@ -51,9 +59,35 @@ bool DeviceVK::finalize(InstanceVK* pInstance)
 
 	registerExtensionFunctions();
 
+	m_GraphicsLock.enableStatistics("DeviceVK Graphics Queue");
+	m_ComputeLock.enableStatistics("DeviceVK Compute Queue");
+	m_TransferLock.enableStatistics("DeviceVK Transfer Queue");
+
+	//Every buffer and image is sub allocated from here, including the ones the copy handler creates
+	m_pAllocator = DBG_NEW DeviceAllocatorVK(this);
+	if (!m_pAllocator->init())
+	{
+		return false;
+	}
+
+	//Command buffers stage their uploads here, so it has to outlive all of them
+	m_pUploadRing = DBG_NEW UploadRingVK(this);
+	if (!m_pUploadRing->init(UPLOAD_RING_SIZE))
+	{
+		return false;
+	}
+
 	m_pCopyHandler = DBG_NEW CopyHandlerVK(this);
 	m_pCopyHandler->init();
 
+	m_pDeletionQueue = DBG_NEW DeletionQueueVK(this);
+
+	m_pGeometryBuffer = DBG_NEW GeometryBufferVK(this);
+	if (!m_pGeometryBuffer->init(GEOMETRY_BUFFER_VERTEX_COUNT, GEOMETRY_BUFFER_INDEX_COUNT))
+	{
+		return false;
+	}
+
 	std::cout << "--- Device: Vulkan Device created successfully!" << std::endl;
 	return true;
 }
@@ -64,7 +98,20 @@ void DeviceVK::release()
 	{
 		vkDeviceWaitIdle(m_Device);
 		
+		//Runs what is left in the queue, which can free memory and descriptorsets
+		SAFEDELETE(m_pDeletionQueue);
+		//Meshes free their ranges through the deletion queue, so it has to be emptied first
+		SAFEDELETE(m_pGeometryBuffer);
 		SAFEDELETE(m_pCopyHandler);
+		SAFEDELETE(m_pUploadRing);
+
+		//Everything has been released at this point, so what is left in the report has leaked
+		if (m_pAllocator)
+		{
+			m_pAllocator->writeReport("Results/memory.csv");
+		}
+
+		SAFEDELETE(m_pAllocator);
 	
 		vkDestroyDevice(m_Device, nullptr);
 		m_Device = VK_NULL_HANDLE;
@@ -145,6 +192,12 @@ void DeviceVK::wait()
 	{ 
 		LOG("vkDeviceWaitIdle failed");
 	}
+
+	//Nothing is in flight anymore, so everything that has been retired can go
+	if (m_pDeletionQueue)
+	{
+		m_pDeletionQueue->flush();
+	}
 }
 
 void DeviceVK::setVulkanObjectName(const char* pName, uint64_t objectHandle, VkObjectType type)
@@ -175,6 +228,18 @@ bool DeviceVK::hasUniqueQueueFamilyIndices() const
 	return familyIndices.size() == 3;
 }
 
+bool DeviceVK::supportsMemoryBudget() const
+{
+	//The budget is read with vkGetPhysicalDeviceMemoryProperties2KHR, which comes from the instance extension
+	auto extension = m_ExtensionsStatus.find(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+	if (extension == m_ExtensionsStatus.end() || !extension->second)
+	{
+		return false;
+	}
+
+	return m_pInstance->isExtensionEnabled(VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME) && m_pInstance->vkGetPhysicalDeviceMemoryProperties2KHR;
+}
+
 void DeviceVK::getMaxComputeWorkGroupSize(uint32_t pWorkGroupSize[3])
 {
 	std::memcpy(pWorkGroupSize, m_DeviceLimits.maxComputeWorkGroupSize, sizeof(uint32_t) * 3);
@@ -9,6 +9,10 @@
 
 class InstanceVK;
 class CopyHandlerVK;
+class DeviceAllocatorVK;
+class UploadRingVK;
+class DeletionQueueVK;
+class GeometryBufferVK;
 class CommandBufferVK;
 
 struct QueueFamilyIndices
@@ -52,19 +56,26 @@ public:
 
 	void setVulkanObjectName(const char* pName, uint64_t objectHandle, VkObjectType type);
 
+	InstanceVK*			getInstance() const			{ return m_pInstance; }
 	VkPhysicalDevice	getPhysicalDevice()	const	{ return m_PhysicalDevice; };
 	VkDevice			getDevice() const			{ return m_Device; }
 	VkQueue				getPresentQueue() const		{ return m_PresentQueue; }
 	CopyHandlerVK*		getCopyHandler() const		{ return m_pCopyHandler; }
+	DeviceAllocatorVK*	getAllocator() const		{ return m_pAllocator; }
+	UploadRingVK*		getUploadRing() const		{ return m_pUploadRing; }
+	DeletionQueueVK*	getDeletionQueue() const	{ return m_pDeletionQueue; }
+	GeometryBufferVK*	getGeometryBuffer() const	{ return m_pGeometryBuffer; }
 
 	const QueueFamilyIndices& getQueueFamilyIndices() const { return m_DeviceQueueFamilyIndices; }
 	bool hasUniqueQueueFamilyIndices() const;
 
 	void getMaxComputeWorkGroupSize(uint32_t pWorkGroupSize[3]);
 	float getTimestampPeriod() const { return m_DeviceLimits.timestampPeriod; };
+	const VkPhysicalDeviceLimits& getDeviceLimits() const { return m_DeviceLimits; }
 
 	const VkPhysicalDeviceRayTracingPropertiesNV& getRayTracingProperties() const { return m_RayTracingProperties; }
 	bool supportsRayTracing() const { return m_ExtensionsStatus.at(VK_NV_RAY_TRACING_EXTENSION_NAME); }
+	bool supportsMemoryBudget() const;
 
 private:
 	bool initPhysicalDevice();
@@ -106,6 +117,10 @@ private:
 
 	InstanceVK* m_pInstance;
 	CopyHandlerVK* m_pCopyHandler;
+	DeviceAllocatorVK* m_pAllocator;
+	UploadRingVK* m_pUploadRing;
+	DeletionQueueVK* m_pDeletionQueue;
+	GeometryBufferVK* m_pGeometryBuffer;
 
 	VkPhysicalDeviceLimits m_DeviceLimits;
 
@@ -91,6 +91,7 @@ bool GBufferVK::createImages()
 	imageParams.MipLevels		= 1;
 	imageParams.Samples			= VK_SAMPLE_COUNT_1_BIT;
 	imageParams.Type			= VK_IMAGE_TYPE_2D;
+	imageParams.Category		= EMemoryCategory::RENDER_TARGETS;
 	for (VkFormat format : m_ColorFormats)
 	{
 		imageParams.Format = format;
@@ -0,0 +1,387 @@
+#include "GeometryBufferVK.h"
+#include "DeviceVK.h"
+#include "BufferVK.h"
+#include "DeletionQueueVK.h"
+
+#include "Core/VertexFormat.h"
+
+#include <mutex>
+#include <algorithm>
+
+GeometryBufferVK::GeometryBufferVK(DeviceVK* pDevice)
+	: m_pDevice(pDevice),
+	m_pVertexBuffer(nullptr),
+	m_pIndexBuffer(nullptr),
+	m_Vertices(),
+	m_Indices(),
+	m_Ranges(),
+	m_Moves(),
+	m_LargestFreeRanges(),
+	m_LayoutVersion(0),
+	m_MoveCount(0),
+	m_BytesMoved(0),
+	m_BytesMovedLastFrame(0)
+{
+}
+
+GeometryBufferVK::~GeometryBufferVK()
+{
+	if (m_Vertices.Used > 0 || m_Indices.Used > 0)
+	{
+		LOG("--- GeometryBufferVK: %u vertices and %u indices were never freed", m_Vertices.Used, m_Indices.Used);
+	}
+
+	for (GeometryRangeVK* pRange : m_Ranges)
+	{
+		SAFEDELETE(pRange);
+	}
+
+	m_Ranges.clear();
+	m_Moves.clear();
+
+	SAFEDELETE(m_pVertexBuffer);
+	SAFEDELETE(m_pIndexBuffer);
+	m_pDevice = nullptr;
+}
+
+bool GeometryBufferVK::init(uint32_t vertexCapacity, uint32_t indexCapacity)
+{
+	BufferParams vertexBufferParams = {};
+	vertexBufferParams.Usage			= VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+	vertexBufferParams.SizeInBytes		= VkDeviceSize(sizeof(GPUVertex)) * vertexCapacity;
+	vertexBufferParams.MemoryProperty	= VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+	vertexBufferParams.IsExclusive		= true;
+	vertexBufferParams.Category			= EMemoryCategory::MESHES;
+
+	m_pVertexBuffer = DBG_NEW BufferVK(m_pDevice);
+	if (!m_pVertexBuffer->init(vertexBufferParams))
+	{
+		LOG("--- GeometryBufferVK: Failed to create vertexbuffer");
+		return false;
+	}
+
+	BufferParams indexBufferParams = {};
+	indexBufferParams.Usage				= VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+	indexBufferParams.SizeInBytes		= VkDeviceSize(sizeof(uint32_t)) * indexCapacity;
+	indexBufferParams.MemoryProperty	= VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+	indexBufferParams.IsExclusive		= true;
+	indexBufferParams.Category			= EMemoryCategory::MESHES;
+
+	m_pIndexBuffer = DBG_NEW BufferVK(m_pDevice);
+	if (!m_pIndexBuffer->init(indexBufferParams))
+	{
+		LOG("--- GeometryBufferVK: Failed to create indexbuffer");
+		return false;
+	}
+
+	m_pVertexBuffer->setName("Geometry Vertices");
+	m_pIndexBuffer->setName("Geometry Indices");
+
+	m_Vertices.Capacity = vertexCapacity;
+	m_Vertices.FreeRanges.push_back({ 0, vertexCapacity });
+
+	m_Indices.Capacity = indexCapacity;
+	m_Indices.FreeRanges.push_back({ 0, indexCapacity });
+
+	m_Lock.enableStatistics("GeometryBufferVK");
+	return true;
+}
+
+GeometryRangeVK* GeometryBufferVK::allocate(uint32_t vertexCount, uint32_t indexCount)
+{
+	std::scoped_lock<Spinlock> lock(m_Lock);
+
+	uint32_t vertexOffset = 0;
+	if (!allocateRange(m_Vertices, vertexCount, vertexOffset))
+	{
+		LOG("--- GeometryBufferVK: No room for %u vertices, %u of %u are used", vertexCount, m_Vertices.Used, m_Vertices.Capacity);
+		return nullptr;
+	}
+
+	uint32_t indexOffset = 0;
+	if (!allocateRange(m_Indices, indexCount, indexOffset))
+	{
+		LOG("--- GeometryBufferVK: No room for %u indices, %u of %u are used", indexCount, m_Indices.Used, m_Indices.Capacity);
+		freeRange(m_Vertices, vertexOffset, vertexCount);
+		return nullptr;
+	}
+
+	GeometryRangeVK* pRange = DBG_NEW GeometryRangeVK();
+	pRange->VertexOffset	= vertexOffset;
+	pRange->VertexCount		= vertexCount;
+	pRange->IndexOffset		= indexOffset;
+	pRange->IndexCount		= indexCount;
+
+	m_Ranges.push_back(pRange);
+	return pRange;
+}
+
+void GeometryBufferVK::free(GeometryRangeVK* pRange)
+{
+	std::scoped_lock<Spinlock> lock(m_Lock);
+
+	if (pRange->IsMoving)
+	{
+		auto move = std::find_if(m_Moves.begin(), m_Moves.end(), [pRange](const Move& move) { return move.pRange == pRange; });
+		ASSERT(move != m_Moves.end());
+
+		//The copy still writes to the new place, so it has to finish before the place can be handed out again
+		m_pDevice->getCopyHandler()->wait(move->Token);
+		freeRange(move->IsIndices ? m_Indices : m_Vertices, move->Offset, move->IsIndices ? pRange->IndexCount : pRange->VertexCount);
+		m_Moves.erase(move);
+	}
+
+	freeRange(m_Vertices, pRange->VertexOffset, pRange->VertexCount);
+	freeRange(m_Indices, pRange->IndexOffset, pRange->IndexCount);
+
+	m_Ranges.erase(std::find(m_Ranges.begin(), m_Ranges.end(), pRange));
+	SAFEDELETE(pRange);
+}
+
+void GeometryBufferVK::setUploadToken(GeometryRangeVK* pRange, const CopyTokenVK& token)
+{
+	std::scoped_lock<Spinlock> lock(m_Lock);
+
+	pRange->UploadToken	= token;
+	pRange->IsUploaded	= true;
+}
+
+void GeometryBufferVK::defragment(uint64_t budgetInBytes)
+{
+	std::scoped_lock<Spinlock> lock(m_Lock);
+
+	CopyHandlerVK* pCopyHandler		= m_pDevice->getCopyHandler();
+	DeletionQueueVK* pDeletionQueue	= m_pDevice->getDeletionQueue();
+
+	//The frames in flight may still read the old place, so it is freed through the deletion queue
+	for (auto move = m_Moves.begin(); move != m_Moves.end();)
+	{
+		if (!pCopyHandler->isComplete(move->Token))
+		{
+			move++;
+			continue;
+		}
+
+		GeometryRangeVK* pRange = move->pRange;
+		uint32_t& offset		= move->IsIndices ? pRange->IndexOffset : pRange->VertexOffset;
+		const uint32_t count	= move->IsIndices ? pRange->IndexCount : pRange->VertexCount;
+		const uint32_t oldOffset	= offset;
+		const bool isIndices		= move->IsIndices;
+
+		offset = move->Offset;
+		pRange->IsMoving = false;
+		pDeletionQueue->push([this, isIndices, oldOffset, count]()
+			{
+				std::scoped_lock<Spinlock> lock(m_Lock);
+				freeRange(isIndices ? m_Indices : m_Vertices, oldOffset, count);
+			});
+
+		m_LayoutVersion++;
+		move = m_Moves.erase(move);
+	}
+
+	m_BytesMovedLastFrame = 0;
+	if (budgetInBytes == 0)
+	{
+		return;
+	}
+
+	//Every move started this frame is submitted together and shares the token
+	const size_t firstMove = m_Moves.size();
+	pCopyHandler->beginBatch();
+
+	for (uint32_t moves = 0; moves < GEOMETRY_DEFRAG_MOVES_PER_FRAME && m_BytesMovedLastFrame < budgetInBytes; moves++)
+	{
+		if (!startMove(false, budgetInBytes) && !startMove(true, budgetInBytes))
+		{
+			break;
+		}
+	}
+
+	const CopyTokenVK token = pCopyHandler->endBatch();
+	for (size_t i = firstMove; i < m_Moves.size(); i++)
+	{
+		m_Moves[i].Token = token;
+	}
+}
+
+GeometryBufferStatistics GeometryBufferVK::getStatistics()
+{
+	std::scoped_lock<Spinlock> lock(m_Lock);
+
+	GeometryBufferStatistics statistics = {};
+	statistics.VertexCapacity		= m_Vertices.Capacity;
+	statistics.UsedVertices			= m_Vertices.Used;
+	statistics.VertexFreeRanges		= uint32_t(m_Vertices.FreeRanges.size());
+	statistics.IndexCapacity		= m_Indices.Capacity;
+	statistics.UsedIndices			= m_Indices.Used;
+	statistics.IndexFreeRanges		= uint32_t(m_Indices.FreeRanges.size());
+	statistics.VertexFragmentation	= calculateFragmentation(m_Vertices);
+	statistics.IndexFragmentation	= calculateFragmentation(m_Indices);
+	statistics.PendingMoves			= uint32_t(m_Moves.size());
+	statistics.MoveCount			= m_MoveCount;
+	statistics.BytesMoved			= m_BytesMoved;
+	statistics.BytesMovedLastFrame	= m_BytesMovedLastFrame;
+	return statistics;
+}
+
+uint64_t GeometryBufferVK::getLayoutVersion()
+{
+	std::scoped_lock<Spinlock> lock(m_Lock);
+	return m_LayoutVersion;
+}
+
+bool GeometryBufferVK::startMove(bool isIndices, uint64_t budgetInBytes)
+{
+	FreeList& freeList		= isIndices ? m_Indices : m_Vertices;
+	const uint64_t stride	= isIndices ? sizeof(uint32_t) : sizeof(GPUVertex);
+
+	//The free ranges are sorted by offset, so with the largest one seen so far at each of them, whether a range fits before
+	//its own offset is one binary search instead of a walk through the whole free list
+	m_LargestFreeRanges.resize(freeList.FreeRanges.size());
+	uint32_t largestFreeRange = 0;
+	for (size_t i = 0; i < freeList.FreeRanges.size(); i++)
+	{
+		largestFreeRange		= std::max(largestFreeRange, freeList.FreeRanges[i].Count);
+		m_LargestFreeRanges[i]	= largestFreeRange;
+	}
+
+	//The range furthest towards the end that fits in a free range before it is moved, the new place ends before the old one
+	//starts so the copy never overlaps. Ranges larger than the budget are left where they are
+	GeometryRangeVK* pMoved = nullptr;
+	uint32_t movedOffset = 0;
+	for (GeometryRangeVK* pRange : m_Ranges)
+	{
+		const uint32_t offset	= isIndices ? pRange->IndexOffset : pRange->VertexOffset;
+		const uint32_t count	= isIndices ? pRange->IndexCount : pRange->VertexCount;
+		if (count == 0 || pRange->IsMoving || !pRange->IsUploaded || (pMoved && offset < movedOffset))
+		{
+			continue;
+		}
+
+		if (count > offset || m_BytesMovedLastFrame + stride * count > budgetInBytes)
+		{
+			continue;
+		}
+
+		//Free ranges that start early enough for the range to end before its old place
+		auto lastFreeRange = std::upper_bound(freeList.FreeRanges.begin(), freeList.FreeRanges.end(), offset - count, [](uint32_t lastOffset, const Range& range)
+			{
+				return lastOffset < range.Offset;
+			});
+
+		const size_t freeRangeCount = size_t(lastFreeRange - freeList.FreeRanges.begin());
+		if (freeRangeCount > 0 && m_LargestFreeRanges[freeRangeCount - 1] >= count && m_pDevice->getCopyHandler()->isComplete(pRange->UploadToken))
+		{
+			pMoved		= pRange;
+			movedOffset	= offset;
+		}
+	}
+
+	if (!pMoved)
+	{
+		return false;
+	}
+
+	const uint32_t count = isIndices ? pMoved->IndexCount : pMoved->VertexCount;
+
+	uint32_t newOffset = 0;
+	allocateRange(freeList, count, newOffset, movedOffset);
+
+	BufferVK* pBuffer = isIndices ? m_pIndexBuffer : m_pVertexBuffer;
+	m_pDevice->getCopyHandler()->copyBuffer(pBuffer, stride * movedOffset, pBuffer, stride * newOffset, stride * count);
+
+	Move move = {};
+	move.pRange		= pMoved;
+	move.Offset		= newOffset;
+	move.IsIndices	= isIndices;
+	m_Moves.push_back(move);
+
+	pMoved->IsMoving = true;
+	m_MoveCount++;
+	m_BytesMoved			+= stride * count;
+	m_BytesMovedLastFrame	+= stride * count;
+	return true;
+}
+
+bool GeometryBufferVK::allocateRange(FreeList& freeList, uint32_t count, uint32_t& offset, uint32_t endOffset)
+{
+	if (count == 0)
+	{
+		offset = 0;
+		return true;
+	}
+
+	//First fit keeps the used ranges packed towards the start of the buffer
+	for (auto freeRange = freeList.FreeRanges.begin(); freeRange != freeList.FreeRanges.end(); freeRange++)
+	{
+		if (freeRange->Count >= count && freeRange->Offset + count <= endOffset)
+		{
+			offset = freeRange->Offset;
+			freeRange->Offset	+= count;
+			freeRange->Count	-= count;
+
+			if (freeRange->Count == 0)
+			{
+				freeList.FreeRanges.erase(freeRange);
+			}
+
+			freeList.Used += count;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+void GeometryBufferVK::freeRange(FreeList& freeList, uint32_t offset, uint32_t count)
+{
+	if (count == 0)
+	{
+		return;
+	}
+
+	ASSERT(freeList.Used >= count);
+	freeList.Used -= count;
+
+	auto next = freeList.FreeRanges.begin();
+	while (next != freeList.FreeRanges.end() && next->Offset < offset)
+	{
+		next++;
+	}
+
+	//Merge with the ranges on either side when they touch
+	const bool mergesWithPrevious	= next != freeList.FreeRanges.begin() && (next - 1)->Offset + (next - 1)->Count == offset;
+	const bool mergesWithNext		= next != freeList.FreeRanges.end() && offset + count == next->Offset;
+
+	if (mergesWithPrevious && mergesWithNext)
+	{
+		(next - 1)->Count += count + next->Count;
+		freeList.FreeRanges.erase(next);
+	}
+	else if (mergesWithPrevious)
+	{
+		(next - 1)->Count += count;
+	}
+	else if (mergesWithNext)
+	{
+		next->Offset	= offset;
+		next->Count		+= count;
+	}
+	else
+	{
+		freeList.FreeRanges.insert(next, { offset, count });
+	}
+}
+
+float GeometryBufferVK::calculateFragmentation(const FreeList& freeList)
+{
+	uint32_t largestFree = 0;
+	for (const Range& range : freeList.FreeRanges)
+	{
+		largestFree = std::max(largestFree, range.Count);
+	}
+
+	const uint32_t totalFree = freeList.Capacity - freeList.Used;
+	return totalFree > 0 ? 1.0f - float(largestFree) / float(totalFree) : 0.0f;
+}
@@ -0,0 +1,134 @@
+#pragma once
+#include "Core/Spinlock.h"
+
+#include "VulkanCommon.h"
+#include "CopyHandlerVK.h"
+
+#include <vector>
+
+//Number of vertices and indices that the shared geometry buffers can hold
+#define GEOMETRY_BUFFER_VERTEX_COUNT	(1024U * 1024U)
+#define GEOMETRY_BUFFER_INDEX_COUNT		(4U * 1024U * 1024U)
+
+//Bytes that the defragmentation may copy each frame
+#define GEOMETRY_DEFRAG_BYTES_PER_FRAME	(4ULL * 1024ULL * 1024ULL)
+//Moves that the defragmentation may start each frame, small ranges would otherwise fill the byte budget with many searches
+#define GEOMETRY_DEFRAG_MOVES_PER_FRAME	16U
+
+class DeviceVK;
+class BufferVK;
+
+//Offsets are given in vertices and indices, not bytes. The range is owned by the GeometryBufferVK, which changes the
+//offsets when it moves the range, so they should be read each frame instead of being stored
+struct GeometryRangeVK
+{
+	uint32_t VertexOffset	= 0;
+	uint32_t VertexCount	= 0;
+	uint32_t IndexOffset	= 0;
+	uint32_t IndexCount		= 0;
+
+	//A range is not moved until its upload has finished
+	CopyTokenVK UploadToken;
+	bool IsUploaded	= false;
+	bool IsMoving	= false;
+};
+
+struct GeometryBufferStatistics
+{
+	uint32_t VertexCapacity		= 0;
+	uint32_t UsedVertices		= 0;
+	uint32_t VertexFreeRanges	= 0;
+	uint32_t IndexCapacity		= 0;
+	uint32_t UsedIndices		= 0;
+	uint32_t IndexFreeRanges	= 0;
+
+	//One minus the largest free range divided by all free space, zero when the free space is in one piece
+	float VertexFragmentation	= 0.0f;
+	float IndexFragmentation	= 0.0f;
+
+	uint32_t PendingMoves		= 0;
+	uint64_t MoveCount			= 0;
+	uint64_t BytesMoved			= 0;
+	uint64_t BytesMovedLastFrame = 0;
+};
+
+//Vertex and index buffers that every mesh is sub allocated from. The geometry pass and the closest-hit shaders both read
+//straight from these, so the scene does not need combined copies of the meshes for ray tracing. Indices are relative to
+//the first vertex of the mesh.
+//Freed ranges leave holes behind, so defragment moves ranges from the end of the buffers into the holes with a few
+//copies each frame. A moved range keeps its old place until the copy is done, after that the offsets are swapped
+//and the old place is freed once the frames in flight have finished with it
+class GeometryBufferVK
+{
+	struct Range
+	{
+		uint32_t Offset;
+		uint32_t Count;
+	};
+
+	//Free ranges are kept sorted by offset, so neighbours can be merged when a range is freed
+	struct FreeList
+	{
+		std::vector<Range> FreeRanges;
+		uint32_t Capacity	= 0;
+		uint32_t Used		= 0;
+	};
+
+	struct Move
+	{
+		GeometryRangeVK* pRange;
+		CopyTokenVK Token;
+		uint32_t Offset;
+		bool IsIndices;
+	};
+
+public:
+	GeometryBufferVK(DeviceVK* pDevice);
+	~GeometryBufferVK();
+
+	DECL_NO_COPY(GeometryBufferVK);
+
+	bool init(uint32_t vertexCapacity, uint32_t indexCapacity);
+
+	//Returns nullptr when there is no free range large enough
+	GeometryRangeVK* allocate(uint32_t vertexCount, uint32_t indexCount);
+	//The range may not be used by the GPU anymore, meshes free their range through the deletion queue
+	void free(GeometryRangeVK* pRange);
+	//Called once the copies that fill the range have been submitted
+	void setUploadToken(GeometryRangeVK* pRange, const CopyTokenVK& token);
+
+	//Called at the start of the frame, before anything is recorded. Finishes the moves whose copies are done and starts
+	//new ones, copying at most budgetInBytes in at most GEOMETRY_DEFRAG_MOVES_PER_FRAME moves. A budget of zero only
+	//finishes the moves in flight
+	void defragment(uint64_t budgetInBytes);
+
+	GeometryBufferStatistics getStatistics();
+	//Changes every time a range has been moved
+	uint64_t getLayoutVersion();
+
+	FORCEINLINE BufferVK* getVertexBuffer() const	{ return m_pVertexBuffer; }
+	FORCEINLINE BufferVK* getIndexBuffer() const	{ return m_pIndexBuffer; }
+
+private:
+	bool startMove(bool isIndices, uint64_t budgetInBytes);
+
+	static bool allocateRange(FreeList& freeList, uint32_t count, uint32_t& offset, uint32_t endOffset = UINT32_MAX);
+	static void freeRange(FreeList& freeList, uint32_t offset, uint32_t count);
+	static float calculateFragmentation(const FreeList& freeList);
+
+private:
+	DeviceVK* m_pDevice;
+	BufferVK* m_pVertexBuffer;
+	BufferVK* m_pIndexBuffer;
+	FreeList m_Vertices;
+	FreeList m_Indices;
+	std::vector<GeometryRangeVK*> m_Ranges;
+	std::vector<Move> m_Moves;
+	//The largest free range up to and including each free range, kept between frames so it does not allocate
+	std::vector<uint32_t> m_LargestFreeRanges;
+	uint64_t m_LayoutVersion;
+	uint64_t m_MoveCount;
+	uint64_t m_BytesMoved;
+	uint64_t m_BytesMovedLastFrame;
+	Spinlock m_Lock;
+};
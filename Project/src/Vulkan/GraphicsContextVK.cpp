@@ -62,6 +62,11 @@ void GraphicsContextVK::init()
 	m_Device.addOptionalExtension(VK_KHR_GET_MEMORY_REQUIREMENTS_2_EXTENSION_NAME);
 	//m_Device.addOptionalExtension(VK_KHR_MAINTENANCE3_EXTENSION_NAME);
 	m_Device.addOptionalExtension(VK_NV_RAY_TRACING_EXTENSION_NAME);
+	//Only valid when VK_KHR_get_physical_device_properties2 is enabled on the instance
+	if (m_Instance.isExtensionEnabled(VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME))
+	{
+		m_Device.addOptionalExtension(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+	}
 
 	m_Device.finalize(&m_Instance);
 
@@ -2,6 +2,7 @@
 
 #include "Common/IImage.h"
 #include "VulkanCommon.h"
+#include "DeviceMemoryBlockVK.h"
 
 class DeviceVK;
 
@@ -16,6 +17,7 @@ struct ImageParams
 	VkExtent3D				Extent;
 	uint32_t				MipLevels;
 	uint32_t				ArrayLayers;
+	EMemoryCategory			Category;
 };
 
 class ImageVK : public IImage
@@ -38,6 +40,6 @@ public:
 private:
 	DeviceVK* m_pDevice;
 	VkImage m_Image;
-	VkDeviceMemory m_Memory;
+	AllocationVK m_Allocation;
 	ImageParams m_Params;
 };
\ No newline at end of file
@@ -619,7 +619,7 @@ bool ImguiVK::createPipelineLayout()
 	m_pPipelineLayout = DBG_NEW PipelineLayoutVK(m_pContext->getDevice());
 	m_pPipelineLayout->init(descriptorSetLayouts, pushConstantRanges);
 
-	DescriptorCounts counts;
+	DescriptorCounts counts = {};
 	counts.m_SampledImages			= 64;
 	counts.m_StorageBuffers			= 1;
 	counts.m_UniformBuffers			= 1;
@@ -653,12 +653,14 @@ bool ImguiVK::createBuffers(uint32_t vertexBufferSize, uint32_t indexBufferSize)
 	vertexBufferparams.MemoryProperty	= VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
 	vertexBufferparams.SizeInBytes		= vertexBufferSize;
 	vertexBufferparams.IsExclusive		= true;
+	vertexBufferparams.Category			= EMemoryCategory::IMGUI;
 
 	BufferParams indexBufferparams = {};
 	indexBufferparams.Usage				= VK_BUFFER_USAGE_INDEX_BUFFER_BIT;
 	indexBufferparams.MemoryProperty	= VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
 	indexBufferparams.SizeInBytes		= indexBufferSize;
 	indexBufferparams.IsExclusive		= true;
+	indexBufferparams.Category			= EMemoryCategory::IMGUI;
 
 	for (uint32_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
 	{
@@ -14,6 +14,7 @@ InstanceVK::InstanceVK() :
 	vkSetDebugUtilsObjectNameEXT(nullptr),
 	vkDestroyDebugUtilsMessengerEXT(nullptr),
 	vkCreateDebugUtilsMessengerEXT(nullptr),
+	vkGetPhysicalDeviceMemoryProperties2KHR(nullptr),
 	m_DebugMessenger(VK_NULL_HANDLE)
 {
 }
@@ -58,6 +59,12 @@ void InstanceVK::release()
 {
 }
 
+bool InstanceVK::isExtensionEnabled(const char* extensionName) const
+{
+	auto extension = m_ExtensionsStatus.find(extensionName);
+	return extension != m_ExtensionsStatus.end() && extension->second;
+}
+
 void InstanceVK::debugPrintAvailableExtensions()
 {
 	retriveAvailableExtensions();
@@ -278,6 +285,11 @@ void InstanceVK::registerExtensionFunctions()
 	{
 		LOG("--- Instance: Failed to intialize [ %s ] function pointers", VK_EXT_DEBUG_UTILS_EXTENSION_NAME);
 	}
+
+	if (m_ExtensionsStatus[VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME])
+	{
+		GET_INSTANCE_PROC_ADDR(m_Instance, vkGetPhysicalDeviceMemoryProperties2KHR);
+	}
 }
 
 VkBool32 InstanceVK::DebugCallback(
@@ -23,6 +23,7 @@ public:
 	
 	//GETTERS
 	bool							validationLayersEnabled()	{ return m_ValidationLayersEnabled; }
+	bool							isExtensionEnabled(const char* extensionName) const;
 
 	VkInstance						getInstance()				{ return m_Instance; }
 	const std::vector<const char*>& getValidationLayers()		{ return m_ValidationLayers; }
@@ -68,5 +69,7 @@ public:
 	PFN_vkSetDebugUtilsObjectNameEXT	vkSetDebugUtilsObjectNameEXT;
 	PFN_vkDestroyDebugUtilsMessengerEXT vkDestroyDebugUtilsMessengerEXT;
 	PFN_vkCreateDebugUtilsMessengerEXT	vkCreateDebugUtilsMessengerEXT;
+	//The instance is created for Vulkan 1.0, so the properties2 queries go through VK_KHR_get_physical_device_properties2
+	PFN_vkGetPhysicalDeviceMemoryProperties2KHR vkGetPhysicalDeviceMemoryProperties2KHR;
 };
 
@@ -2,6 +2,7 @@
 
 #include "Core/Camera.h"
 #include "Core/LightSetup.h"
+#include "Core/TaskDispatcher.h"
 
 #include "BufferVK.h"
 #include "CommandBufferVK.h"
@@ -27,6 +28,9 @@
 #include "RenderingHandlerVK.h"
 #include "SceneVK.h"
 
+#include "imgui/imgui.h"
+
+#include <chrono>
 #include <glm/gtc/type_ptr.hpp>
 
 MeshRendererVK::MeshRendererVK(GraphicsContextVK* pContext, RenderingHandlerVK* pRenderingHandler)
@@ -51,6 +55,11 @@ MeshRendererVK::MeshRendererVK(GraphicsContextVK* pContext, RenderingHandlerVK*
 	m_ClearDepth(),
 	m_Viewport(),
 	m_ScissorRect(),
+	m_GeometryChunkCount(1),
+	m_FrameChunkCount(1),
+	m_ObjectsPerChunk(0),
+	m_ChunkRecordingTimes(),
+	m_ChunkDrawCounts(),
 	m_CurrentFrame(0)
 {
 	m_ClearDepth.depthStencil.depth = 1.0f;
@@ -63,7 +72,11 @@ MeshRendererVK::~MeshRendererVK()
 
 	for (uint32_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
 	{
-		SAFEDELETE(m_ppGeometryPassPools[i]);
+		for (uint32_t chunk = 0; chunk < MAX_GEOMETRY_CHUNKS; chunk++)
+		{
+			SAFEDELETE(m_ppGeometryPassPools[i][chunk]);
+		}
+
 		SAFEDELETE(m_ppLightPassPools[i]);
 	}
 
@@ -129,15 +142,17 @@ bool MeshRendererVK::init()
 
 	updateGBufferDescriptors();
 
-	const BufferVK* pLightBuffer	= m_pRenderingHandler->getLightBufferGraphics();
-	const BufferVK* pCameraBuffer	= m_pRenderingHandler->getCameraBufferGraphics();
-	m_pLightDescriptorSet->writeUniformBufferDescriptor(pLightBuffer,	LP_LIGHT_BUFFER_BINDING);
-	m_pLightDescriptorSet->writeUniformBufferDescriptor(pCameraBuffer,	CAMERA_BUFFER_BINDING);
+	const BufferVK* pFrameUniformBuffer = m_pRenderingHandler->getFrameUniformBuffer();
+	m_pLightDescriptorSet->writeUniformBufferDynamicDescriptor(pFrameUniformBuffer, LP_LIGHT_BUFFER_BINDING,	LIGHT_BUFFER_SIZE);
+	m_pLightDescriptorSet->writeUniformBufferDynamicDescriptor(pFrameUniformBuffer, CAMERA_BUFFER_BINDING,	CAMERA_BUFFER_SIZE);
 
 	ImageViewVK* pIntegrationLUT = m_pIntegrationLUT->getImageView();
 	m_pLightDescriptorSet->writeCombinedImageDescriptors(&pIntegrationLUT, &m_pBRDFSampler, 1, LP_BRDF_LUT_BINDING);
 
-	m_pSkyboxDescriptorSet->writeUniformBufferDescriptor(pCameraBuffer, 0);
+	m_pSkyboxDescriptorSet->writeUniformBufferDynamicDescriptor(pFrameUniformBuffer, 0, CAMERA_BUFFER_SIZE);
+
+	//Start out with one chunk per worker
+	setGeometryChunkCount(TaskDispatcher::getThreadCount());
 
 	return true;
 }
@@ -156,8 +171,26 @@ void MeshRendererVK::beginFrame(IScene* pScene)
 
 	m_CurrentFrame = (m_CurrentFrame + 1) % MAX_FRAMES_IN_FLIGHT;
 
-	m_ppGeometryPassBuffers[m_CurrentFrame]->reset(false);
-	m_ppGeometryPassPools[m_CurrentFrame]->reset();
+	//Do not create more chunks than there are objects, the skybox is always drawn by the last chunk
+	const uint32_t objectCount = uint32_t(m_pScene->getGraphicsObjects().size());
+	m_FrameChunkCount	= std::max(1U, std::min(m_GeometryChunkCount, objectCount));
+	m_ObjectsPerChunk	= (objectCount + m_FrameChunkCount - 1) / m_FrameChunkCount;
+}
+
+void MeshRendererVK::endFrame(IScene* pScene)
+{
+	UNREFERENCED_PARAMETER(pScene);
+}
+
+void MeshRendererVK::recordGeometryChunk(uint32_t chunk)
+{
+	ASSERT(chunk < m_FrameChunkCount);
+
+	auto startTime = std::chrono::high_resolution_clock::now();
+
+	CommandBufferVK* pCommandBuffer = m_ppGeometryPassBuffers[m_CurrentFrame][chunk];
+	pCommandBuffer->reset(false);
+	m_ppGeometryPassPools[m_CurrentFrame][chunk]->reset();
 
 	// Needed to begin a secondary buffer
 	RenderPassVK*	pGeometryRenderPass	= m_pRenderingHandler->getGeometryRenderPass();
@@ -171,29 +204,70 @@ void MeshRendererVK::beginFrame(IScene* pScene)
 	inheritanceInfo.subpass		= 0;
 	inheritanceInfo.framebuffer = pFramebuffer->getFrameBuffer();
 
-	m_ppGeometryPassBuffers[m_CurrentFrame]->begin(&inheritanceInfo, VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT);
-	m_pGPassProfiler->beginFrame(m_ppGeometryPassBuffers[m_CurrentFrame]);
+	pCommandBuffer->begin(&inheritanceInfo, VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT);
 
 	// Begin geometrypass
-	m_ppGeometryPassBuffers[m_CurrentFrame]->setViewports(&m_Viewport, 1);
-	m_ppGeometryPassBuffers[m_CurrentFrame]->setScissorRects(&m_ScissorRect, 1);
-}
+	pCommandBuffer->setViewports(&m_Viewport, 1);
+	pCommandBuffer->setScissorRects(&m_ScissorRect, 1);
+
+	const std::vector<GraphicsObjectVK>& graphicsObjects = m_pScene->getGraphicsObjects();
+	const uint32_t first	= std::min(chunk * m_ObjectsPerChunk, uint32_t(graphicsObjects.size()));
+	const uint32_t last		= std::min(first + m_ObjectsPerChunk, uint32_t(graphicsObjects.size()));
+	uint32_t drawCount = 0;
+	for (uint32_t i = first; i < last; i++)
+	{
+		//Meshes that are still being uploaded are skipped instead of waiting for them
+		const GraphicsObjectVK& graphicsObject = graphicsObjects[i];
+		if (!graphicsObject.pMesh->isResident())
+		{
+			continue;
+		}
 
-void MeshRendererVK::endFrame(IScene* pScene)
-{
-	UNREFERENCED_PARAMETER(pScene);
+		submitMesh(pCommandBuffer, graphicsObject, i);
+		drawCount++;
+	}
 
-	m_pGPassProfiler->endFrame();
+	if (chunk == m_FrameChunkCount - 1)
+	{
+		pCommandBuffer->bindPipeline(m_pSkyboxPipeline);
+		const uint32_t cameraBufferOffset = m_pRenderingHandler->getCameraBufferOffset();
+		pCommandBuffer->bindDescriptorSet(VK_PIPELINE_BIND_POINT_GRAPHICS, m_pSkyboxPipelineLayout, 0, 1, &m_pSkyboxDescriptorSet, 1, &cameraBufferOffset);
+		pCommandBuffer->drawInstanced(36, 1, 0, 0);
+	}
+
+	pCommandBuffer->end();
 
-	m_ppGeometryPassBuffers[m_CurrentFrame]->bindPipeline(m_pSkyboxPipeline);
-	m_ppGeometryPassBuffers[m_CurrentFrame]->bindDescriptorSet(VK_PIPELINE_BIND_POINT_GRAPHICS, m_pSkyboxPipelineLayout, 0, 1, &m_pSkyboxDescriptorSet, 0, nullptr);
-	m_ppGeometryPassBuffers[m_CurrentFrame]->drawInstanced(36, 1, 0, 0);
+	std::chrono::duration<float, std::milli> recordingTime = std::chrono::high_resolution_clock::now() - startTime;
+	m_ChunkRecordingTimes[chunk]	= recordingTime.count();
+	m_ChunkDrawCounts[chunk]		= drawCount;
+}
 
-	m_ppGeometryPassBuffers[m_CurrentFrame]->end();
+void MeshRendererVK::executeGeometryChunks(CommandBufferVK* pPrimaryBuffer)
+{
+	for (uint32_t chunk = 0; chunk < m_FrameChunkCount; chunk++)
+	{
+		pPrimaryBuffer->executeSecondary(m_ppGeometryPassBuffers[m_CurrentFrame][chunk]);
+	}
+}
+
+void MeshRendererVK::setGeometryChunkCount(uint32_t chunkCount)
+{
+	m_GeometryChunkCount = std::max(1U, std::min(chunkCount, MAX_GEOMETRY_CHUNKS));
 }
 
 void MeshRendererVK::renderUI()
 {
+	int chunkCount = int(m_GeometryChunkCount);
+	if (ImGui::SliderInt("Geometry Pass Chunks", &chunkCount, 1, int(MAX_GEOMETRY_CHUNKS)))
+	{
+		setGeometryChunkCount(uint32_t(chunkCount));
+	}
+
+	//CPU time spent recording each chunk
+	for (uint32_t chunk = 0; chunk < m_FrameChunkCount; chunk++)
+	{
+		ImGui::Text("--Chunk %u (%u draws):\t%f ms", chunk, m_ChunkDrawCounts[chunk], m_ChunkRecordingTimes[chunk]);
+	}
 }
 
 void MeshRendererVK::setViewport(float width, float height, float minDepth, float maxDepth, float topX, float topY)
@@ -253,28 +327,33 @@ void MeshRendererVK::setSkybox(TextureCubeVK* pSkybox, TextureCubeVK* pIrradianc
 
 void MeshRendererVK::setRayTracingResultImages(ImageViewVK* pRadianceImageView, ImageViewVK* pGlossyImageView)
 {
+	//The images can change between frames, so the set that the frames in flight use is left untouched
+	m_pLightDescriptorSet = m_pDescriptorPool->replaceDescriptorSet(m_pLightDescriptorSet);
 	m_pLightDescriptorSet->writeCombinedImageDescriptors(&pRadianceImageView, &m_pRTSampler, 1, LP_RADIANCE_BINDING);
 	m_pLightDescriptorSet->writeCombinedImageDescriptors(&pGlossyImageView, &m_pRTSampler, 1, LP_GLOSSY_BINDING);
 }
 
-void MeshRendererVK::submitMesh(const MeshVK* pMesh, const Material* pMaterial, uint32_t materialIndex, uint32_t transformsIndex)
+void MeshRendererVK::submitMesh(CommandBufferVK* pCommandBuffer, const GraphicsObjectVK& graphicsObject, uint32_t transformsIndex)
 {
+	const MeshVK* pMesh = graphicsObject.pMesh;
 	ASSERT(pMesh != nullptr);
 
-	m_ppGeometryPassBuffers[m_CurrentFrame]->bindPipeline(m_pGeometryPipeline);
+	pCommandBuffer->bindPipeline(m_pGeometryPipeline);
 
 	PipelineLayoutVK* pGeometryPassLayout = m_pScene->getGeometryPipelineLayout();
 
-	uint32_t pushConstants[2] = { materialIndex, transformsIndex };
-	m_ppGeometryPassBuffers[m_CurrentFrame]->pushConstants(pGeometryPassLayout, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(uint32_t) * 2, &pushConstants);
+	uint32_t pushConstants[2] = { graphicsObject.MaterialParametersIndex, transformsIndex };
+	pCommandBuffer->pushConstants(pGeometryPassLayout, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(uint32_t) * 2, &pushConstants);
 
 	BufferVK* pIndexBuffer = reinterpret_cast<BufferVK*>(pMesh->getIndexBuffer());
-	m_ppGeometryPassBuffers[m_CurrentFrame]->bindIndexBuffer(pIndexBuffer, 0, VK_INDEX_TYPE_UINT32);
+	pCommandBuffer->bindIndexBuffer(pIndexBuffer, 0, VK_INDEX_TYPE_UINT32);
 
-	DescriptorSetVK* pDescriptorSet = m_pScene->getDescriptorSetFromMeshAndMaterial(pMesh, pMaterial);
-	m_ppGeometryPassBuffers[m_CurrentFrame]->bindDescriptorSet(VK_PIPELINE_BIND_POINT_GRAPHICS, pGeometryPassLayout, 0, 1, &pDescriptorSet, 0, nullptr);
+	DescriptorSetVK* pDescriptorSet = m_pScene->getDescriptorSet(graphicsObject);
+	const uint32_t cameraBufferOffset = m_pRenderingHandler->getCameraBufferOffset();
+	pCommandBuffer->bindDescriptorSet(VK_PIPELINE_BIND_POINT_GRAPHICS, pGeometryPassLayout, 0, 1, &pDescriptorSet, 1, &cameraBufferOffset);
 
-	m_ppGeometryPassBuffers[m_CurrentFrame]->drawIndexInstanced(pMesh->getIndexCount(), 1, 0, 0, 0);
+	//The indices are relative to the first vertex of the mesh, which also offsets gl_VertexIndex in the shader
+	pCommandBuffer->drawIndexInstanced(pMesh->getIndexCount(), 1, pMesh->getIndexOffset(), pMesh->getVertexOffset(), 0);
 }
 
 void MeshRendererVK::buildLightPass(RenderPassVK* pRenderPass, FrameBufferVK* pFramebuffer)
@@ -295,7 +374,9 @@ void MeshRendererVK::buildLightPass(RenderPassVK* pRenderPass, FrameBufferVK* pF
 	m_pLightPassProfiler->beginFrame(m_ppLightPassBuffers[m_CurrentFrame]);
 
 	m_ppLightPassBuffers[m_CurrentFrame]->bindPipeline(m_pLightPipeline);
-	m_ppLightPassBuffers[m_CurrentFrame]->bindDescriptorSet(VK_PIPELINE_BIND_POINT_GRAPHICS, m_pLightPipelineLayout, 0, 1, &m_pLightDescriptorSet, 0, nullptr);
+	//Dynamic offsets are given in binding order, the camera has the lower binding
+	const uint32_t dynamicOffsets[] = { m_pRenderingHandler->getCameraBufferOffset(), m_pRenderingHandler->getLightBufferOffset() };
+	m_ppLightPassBuffers[m_CurrentFrame]->bindDescriptorSet(VK_PIPELINE_BIND_POINT_GRAPHICS, m_pLightPipelineLayout, 0, 1, &m_pLightDescriptorSet, 2, dynamicOffsets);
 
 	m_ppLightPassBuffers[m_CurrentFrame]->setViewports(&m_Viewport, 1);
 	m_ppLightPassBuffers[m_CurrentFrame]->setScissorRects(&m_ScissorRect, 1);
@@ -406,19 +487,22 @@ bool MeshRendererVK::createCommandPoolAndBuffers()
 	const uint32_t graphicsQueueIndex = pDevice->getQueueFamilyIndices().graphicsFamily.value();
 	for (uint32_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
 	{
-		m_ppGeometryPassPools[i] = DBG_NEW CommandPoolVK(pDevice, graphicsQueueIndex);
-		if (!m_ppGeometryPassPools[i]->init())
+		for (uint32_t chunk = 0; chunk < MAX_GEOMETRY_CHUNKS; chunk++)
 		{
-			return false;
-		}
-
-		m_ppGeometryPassBuffers[i] = m_ppGeometryPassPools[i]->allocateCommandBuffer(VK_COMMAND_BUFFER_LEVEL_SECONDARY);
-		if (m_ppGeometryPassBuffers[i] == nullptr)
-		{
-			return false;
+			m_ppGeometryPassPools[i][chunk] = DBG_NEW CommandPoolVK(pDevice, graphicsQueueIndex);
+			if (!m_ppGeometryPassPools[i][chunk]->init())
+			{
+				return false;
+			}
+
+			m_ppGeometryPassBuffers[i][chunk] = m_ppGeometryPassPools[i][chunk]->allocateCommandBuffer(VK_COMMAND_BUFFER_LEVEL_SECONDARY);
+			if (m_ppGeometryPassBuffers[i][chunk] == nullptr)
+			{
+				return false;
+			}
+			std::string name = "GeometryPass CommandBuffer[" + std::to_string(i) + "][" + std::to_string(chunk) + "]";
+			m_ppGeometryPassBuffers[i][chunk]->setName(name.c_str());
 		}
-		std::string name = "GeometryPass CommandBuffer[" + std::to_string(i) + "]";
-		m_ppGeometryPassBuffers[i]->setName(name.c_str());
 
 		m_ppLightPassPools[i] = DBG_NEW CommandPoolVK(pDevice, graphicsQueueIndex);
 		if (!m_ppLightPassPools[i]->init())
@@ -431,7 +515,7 @@ bool MeshRendererVK::createCommandPoolAndBuffers()
 		{
 			return false;
 		}
-		name = "LightPass CommandBuffer[" + std::to_string(i) + "]";
+		std::string name = "LightPass CommandBuffer[" + std::to_string(i) + "]";
 		m_ppLightPassBuffers[i]->setName(name.c_str());
 	}
 
@@ -590,6 +674,7 @@ bool MeshRendererVK::createPipelineLayouts()
 	descriptorCounts.m_StorageImages	= 1024;
 	descriptorCounts.m_StorageBuffers	= 2048;
 	descriptorCounts.m_UniformBuffers	= 1024;
+	descriptorCounts.m_DynamicUniformBuffers = 64;
 
 	m_pDescriptorPool = DBG_NEW DescriptorPoolVK(m_pContext->getDevice());
 	if (!m_pDescriptorPool->init(descriptorCounts, 512))
@@ -599,8 +684,8 @@ bool MeshRendererVK::createPipelineLayouts()
 
 	//Lightpass
 	m_pLightDescriptorSetLayout = DBG_NEW DescriptorSetLayoutVK(m_pContext->getDevice());
-	m_pLightDescriptorSetLayout->addBindingUniformBuffer(VK_SHADER_STAGE_FRAGMENT_BIT, LP_LIGHT_BUFFER_BINDING, 1);
-	m_pLightDescriptorSetLayout->addBindingUniformBuffer(VK_SHADER_STAGE_FRAGMENT_BIT, CAMERA_BUFFER_BINDING, 1);
+	m_pLightDescriptorSetLayout->addBindingUniformBufferDynamic(VK_SHADER_STAGE_FRAGMENT_BIT, LP_LIGHT_BUFFER_BINDING, 1);
+	m_pLightDescriptorSetLayout->addBindingUniformBufferDynamic(VK_SHADER_STAGE_FRAGMENT_BIT, CAMERA_BUFFER_BINDING, 1);
 	m_pLightDescriptorSetLayout->addBindingCombinedImage(VK_SHADER_STAGE_FRAGMENT_BIT, nullptr, LP_GBUFFER_ALBEDO_BINDING, 1);
 	m_pLightDescriptorSetLayout->addBindingCombinedImage(VK_SHADER_STAGE_FRAGMENT_BIT, nullptr, LP_GBUFFER_NORMAL_BINDING, 1);
 	m_pLightDescriptorSetLayout->addBindingCombinedImage(VK_SHADER_STAGE_FRAGMENT_BIT, nullptr, LP_GBUFFER_VELOCITY_BINDING, 1);
@@ -632,7 +717,7 @@ bool MeshRendererVK::createPipelineLayouts()
 
 	//Skybox
 	m_pSkyboxDescriptorSetLayout = DBG_NEW DescriptorSetLayoutVK(m_pContext->getDevice());
-	m_pSkyboxDescriptorSetLayout->addBindingUniformBuffer(VK_SHADER_STAGE_VERTEX_BIT, 0, 1);
+	m_pSkyboxDescriptorSetLayout->addBindingUniformBufferDynamic(VK_SHADER_STAGE_VERTEX_BIT, 0, 1);
 	m_pSkyboxDescriptorSetLayout->addBindingCombinedImage(VK_SHADER_STAGE_FRAGMENT_BIT, nullptr, 1, 1);
 	if (!m_pSkyboxDescriptorSetLayout->finalize())
 	{
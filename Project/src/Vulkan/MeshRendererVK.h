@@ -31,6 +31,8 @@ class RenderPassVK;
 class SceneVK;
 class ImageViewVK;
 
+struct GraphicsObjectVK;
+
 //Light pass
 #define LP_GBUFFER_ALBEDO_BINDING		1
 #define LP_GBUFFER_NORMAL_BINDING		2
@@ -43,6 +45,9 @@ class ImageViewVK;
 #define LP_GLOSSY_BINDING				9
 #define LP_LIGHT_BUFFER_BINDING			10
 
+//Max number of secondary buffers the geometry pass is split into
+#define MAX_GEOMETRY_CHUNKS				16U
+
 class MeshRendererVK : public IRenderer
 {
 public:
@@ -62,7 +67,11 @@ public:
 	void setSkybox(TextureCubeVK* pSkybox, TextureCubeVK* pIrradiance, TextureCubeVK* pEnvironmentMap);
 	void setRayTracingResultImages(ImageViewVK* pRadianceImageView, ImageViewVK* pGlossyImageView);
 
-	void submitMesh(const MeshVK* pMesh, const Material* pMaterial, uint32_t materialIndex, uint32_t transformsIndex);
+	//Records a part of the scene's graphics objects into the chunk's secondary buffer, chunks can be recorded in parallel
+	void recordGeometryChunk(uint32_t chunk);
+	//Executes the chunks in order, must be called inside the geometry renderpass
+	void executeGeometryChunks(CommandBufferVK* pPrimaryBuffer);
+	void setGeometryChunkCount(uint32_t chunkCount);
 
 	void buildLightPass(RenderPassVK* pRenderPass, FrameBufferVK* pFramebuffer);
 
@@ -77,7 +86,7 @@ public:
 	FORCEINLINE Texture2DVK*		getBRDFLookUp() const				{ return m_pIntegrationLUT; }
 	FORCEINLINE ProfilerVK*			getLightProfiler() const			{ return m_pLightPassProfiler; }
 	FORCEINLINE ProfilerVK*			getGeometryProfiler() const			{ return m_pGPassProfiler; }
-	FORCEINLINE CommandBufferVK*	getGeometryCommandBuffer() const	{ return m_ppGeometryPassBuffers[m_CurrentFrame]; }
+	FORCEINLINE uint32_t			getGeometryChunkCount() const		{ return m_FrameChunkCount; }
 	FORCEINLINE CommandBufferVK*	getLightCommandBuffer() const		{ return m_ppLightPassBuffers[m_CurrentFrame]; }
 
 private:
@@ -91,6 +100,8 @@ private:
 
 	void updateGBufferDescriptors();
 
+	void submitMesh(CommandBufferVK* pCommandBuffer, const GraphicsObjectVK& graphicsObject, uint32_t transformsIndex);
+
 	VkClearValue	m_ClearColor;
 	VkClearValue	m_ClearDepth;
 	VkViewport		m_Viewport;
@@ -104,8 +115,15 @@ private:
 	// Per frame
 	SceneVK* m_pScene;
 
-	CommandPoolVK*		m_ppGeometryPassPools[MAX_FRAMES_IN_FLIGHT];
-	CommandBufferVK*	m_ppGeometryPassBuffers[MAX_FRAMES_IN_FLIGHT];
+	//One pool per chunk so that each chunk can be recorded on its own thread
+	CommandPoolVK*		m_ppGeometryPassPools[MAX_FRAMES_IN_FLIGHT][MAX_GEOMETRY_CHUNKS];
+	CommandBufferVK*	m_ppGeometryPassBuffers[MAX_FRAMES_IN_FLIGHT][MAX_GEOMETRY_CHUNKS];
+
+	uint32_t	m_GeometryChunkCount;
+	uint32_t	m_FrameChunkCount;
+	uint32_t	m_ObjectsPerChunk;
+	float		m_ChunkRecordingTimes[MAX_GEOMETRY_CHUNKS];
+	uint32_t	m_ChunkDrawCounts[MAX_GEOMETRY_CHUNKS];
 
 	CommandPoolVK*		m_ppLightPassPools[MAX_FRAMES_IN_FLIGHT];
 	CommandBufferVK*	m_ppLightPassBuffers[MAX_FRAMES_IN_FLIGHT];
@@ -2,9 +2,16 @@
 #include "BufferVK.h"
 #include "DeviceVK.h"
 #include "CopyHandlerVK.h"
+#include "DeletionQueueVK.h"
+#include "GeometryBufferVK.h"
 #include "CommandPoolVK.h"
 #include "CommandBufferVK.h"
 
+#include "Core/MeshOptimizer.h"
+#include "Core/TaskDispatcher.h"
+#include "Core/VertexDeduplicator.h"
+#include "Core/VertexFormat.h"
+
 #include <tinyobjloader/tiny_obj_loader.h>
 #include <array>
 
@@ -12,18 +19,26 @@ uint32_t MeshVK::s_ID = 0;
 
 MeshVK::MeshVK(DeviceVK* pDevice)
 	: m_pDevice(pDevice),
-	m_pVertexBuffer(nullptr),
-	m_pIndexBuffer(nullptr),
+	m_pGeometryRange(nullptr),
 	m_IndexCount(0),
 	m_VertexCount(0),
-	m_ID(s_ID++)
+	m_ID(s_ID++),
+	m_UploadToken(),
+	m_IsUploaded(false),
+	m_IsResident(false)
 {
 }
 
 MeshVK::~MeshVK()
 {
-	SAFEDELETE(m_pVertexBuffer);
-	SAFEDELETE(m_pIndexBuffer);
+	//The frames in flight may still draw the mesh, so the range is given back once they have finished
+	if (m_pGeometryRange)
+	{
+		GeometryBufferVK* pGeometryBuffer	= m_pDevice->getGeometryBuffer();
+		GeometryRangeVK* pGeometryRange		= m_pGeometryRange;
+		m_pDevice->getDeletionQueue()->push([pGeometryBuffer, pGeometryRange]() { pGeometryBuffer->free(pGeometryRange); });
+		m_pGeometryRange = nullptr;
+	}
 
 	m_pDevice = 0;
 }
@@ -41,105 +56,135 @@ bool MeshVK::initFromFile(const std::string& filepath)
 		return false;
 	}
 
+	//Build every vertex in parallel, the deduplication below runs in order so the indices are the same as when built serially
+	std::vector<Vertex> shapeVertices = {};
 	std::vector<Vertex> vertices = {};
 	std::vector<uint32_t> indices = {};
-	std::unordered_map<Vertex, uint32_t> uniqueVertices = {};
 
-	for (const tinyobj::shape_t& shape : shapes) 
+	size_t indexCount = 0;
+	for (const tinyobj::shape_t& shape : shapes)
 	{
-		for (const tinyobj::index_t& index : shape.mesh.indices) 
-		{
-			Vertex vertex = {};
+		indexCount += shape.mesh.indices.size();
+	}
 
-			//Normals and texcoords are optional, while positions are required
-			ASSERT(index.vertex_index >= 0);
-			
-			vertex.Position = 
-			{
-				attributes.vertices[3 * index.vertex_index + 0],
-				attributes.vertices[3 * index.vertex_index + 1],
-				attributes.vertices[3 * index.vertex_index + 2]
-			};
+	VertexDeduplicator deduplicator(uint32_t(indexCount));
+	indices.reserve(indexCount);
 
-			if (index.normal_index >= 0)
+	for (const tinyobj::shape_t& shape : shapes) 
+	{
+		shapeVertices.resize(shape.mesh.indices.size());
+		TaskDispatcher::parallelFor(0, uint32_t(shape.mesh.indices.size()), 4096, [&](uint32_t i)
 			{
-				vertex.Normal =
+				const tinyobj::index_t& index = shape.mesh.indices[i];
+				Vertex vertex = {};
+
+				//Normals and texcoords are optional, while positions are required
+				ASSERT(index.vertex_index >= 0);
+			
+				vertex.Position = 
 				{
-					attributes.normals[3 * index.normal_index + 0],
-					attributes.normals[3 * index.normal_index + 1],
-					attributes.normals[3 * index.normal_index + 2]
+					attributes.vertices[3 * index.vertex_index + 0],
+					attributes.vertices[3 * index.vertex_index + 1],
+					attributes.vertices[3 * index.vertex_index + 2]
 				};
-			}
+
+				if (index.normal_index >= 0)
+				{
+					vertex.Normal =
+					{
+						attributes.normals[3 * index.normal_index + 0],
+						attributes.normals[3 * index.normal_index + 1],
+						attributes.normals[3 * index.normal_index + 2]
+					};
+				}
 			
-			if (index.texcoord_index >= 0)
-			{
-				vertex.TexCoord = 
+				if (index.texcoord_index >= 0)
 				{
-					attributes.texcoords[2 * index.texcoord_index + 0],
-					1.0f -	attributes.texcoords[2 * index.texcoord_index + 1]
-				};
-			}
+					vertex.TexCoord = 
+					{
+						attributes.texcoords[2 * index.texcoord_index + 0],
+						1.0f -	attributes.texcoords[2 * index.texcoord_index + 1]
+					};
+				}
 
-			if (uniqueVertices.count(vertex) == 0) 
-			{
-				uniqueVertices[vertex] = static_cast<uint32_t>(vertices.size());
-				vertices.push_back(vertex);
-			}
-			 
-			indices.push_back(uniqueVertices[vertex]);
+				shapeVertices[i] = vertex;
+			});
+
+		for (const Vertex& vertex : shapeVertices)
+		{
+			indices.push_back(deduplicator.insert(vertex, vertices));
 		}
 	}
 
-	//Calculate tangents
-	for (uint32_t index = 0; index < indices.size(); index += 3)
-	{
-		Vertex& v0 = vertices[indices[index + 0]];
-		Vertex& v1 = vertices[indices[index + 1]];
-		Vertex& v2 = vertices[indices[index + 2]];
+	//Calculate tangents, triangles sharing a vertex overwrite each other so they are written in triangle order afterwards
+	std::vector<glm::vec3> tangents(indices.size());
+	TaskDispatcher::parallelFor(0, uint32_t(indices.size()) / 3, 1024, [&](uint32_t triangle)
+		{
+			const uint32_t index = triangle * 3;
+			Vertex v0 = vertices[indices[index + 0]];
+			Vertex v1 = vertices[indices[index + 1]];
+			Vertex v2 = vertices[indices[index + 2]];
+
+			v0.calculateTangent(v1, v2);
+			v1.calculateTangent(v2, v0);
+			v2.calculateTangent(v0, v1);
 
-		v0.calculateTangent(v1, v2);
-		v1.calculateTangent(v2, v0);
-		v2.calculateTangent(v0, v1);
+			tangents[index + 0] = v0.Tangent;
+			tangents[index + 1] = v1.Tangent;
+			tangents[index + 2] = v2.Tangent;
+		});
+
+	for (uint32_t index = 0; index < indices.size(); index++)
+	{
+		vertices[indices[index]].Tangent = tangents[index];
 	}
 
 	//TODO: Calculate normals
 
-	LOG("-- LOADED MESH: %s", filepath.c_str());
+	//Reordered for the post-transform cache and then for fetch locality, after the tangents since they depend on the triangle order
+	const VertexCacheStatistics before = MeshOptimizer::analyzeVertexCache(indices.data(), uint32_t(indices.size()), uint32_t(vertices.size()));
+	MeshOptimizer::optimizeVertexCache(indices.data(), uint32_t(indices.size()), uint32_t(vertices.size()));
+	MeshOptimizer::optimizeVertexFetch(vertices, indices.data(), uint32_t(indices.size()));
+	const VertexCacheStatistics after = MeshOptimizer::analyzeVertexCache(indices.data(), uint32_t(indices.size()), uint32_t(vertices.size()));
+
+	LOG("-- LOADED MESH: %s ACMR %.3f -> %.3f, ATVR %.3f -> %.3f", filepath.c_str(), before.ACMR, after.ACMR, before.ATVR, after.ATVR);
 	return initFromMemory(vertices.data(), sizeof(Vertex), uint32_t(vertices.size()), indices.data(), uint32_t(indices.size()));
 }
 
 bool MeshVK::initFromMemory(const void* pVertices, size_t vertexSize, uint32_t vertexCount, const uint32_t* pIndices, uint32_t indexCount)
 {
-	BufferParams vertexBufferParams = {};
-	vertexBufferParams.Usage			= VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
-	vertexBufferParams.SizeInBytes		= vertexSize * vertexCount;
-	vertexBufferParams.MemoryProperty	= VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
-	vertexBufferParams.IsExclusive		= true;
-
-	m_pVertexBuffer = DBG_NEW BufferVK(m_pDevice);
-	if (!m_pVertexBuffer->init(vertexBufferParams))
+	//The geometry buffer is laid out as an array of GPUVertex, since the shaders index it with the vertex offset of the mesh.
+	//Vertices that are not encoded yet are encoded here
+	std::vector<GPUVertex> encodedVertices;
+	if (vertexSize != sizeof(GPUVertex))
 	{
-		return false;
-	}
+		ASSERT(vertexSize == sizeof(Vertex));
 
-	BufferParams indexBufferParams = {};
-	indexBufferParams.Usage				= VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
-	indexBufferParams.SizeInBytes		= sizeof(uint32_t) * indexCount;
-	indexBufferParams.MemoryProperty	= VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
-	indexBufferParams.IsExclusive		= true;
+		encodedVertices.resize(vertexCount);
+		encodeVertices(reinterpret_cast<const Vertex*>(pVertices), vertexCount, encodedVertices.data());
+		pVertices	= encodedVertices.data();
+		vertexSize	= sizeof(GPUVertex);
+	}
 
-	m_pIndexBuffer = DBG_NEW BufferVK(m_pDevice);
-	if (!m_pIndexBuffer->init(indexBufferParams))
+	GeometryBufferVK* pGeometryBuffer = m_pDevice->getGeometryBuffer();
+	m_pGeometryRange = pGeometryBuffer->allocate(vertexCount, indexCount);
+	if (!m_pGeometryRange)
 	{
 		return false;
 	}
 
 	CopyHandlerVK* pCopyHandler = m_pDevice->getCopyHandler();
-	pCopyHandler->updateBuffer(m_pVertexBuffer, 0, pVertices, vertexBufferParams.SizeInBytes);
-	pCopyHandler->updateBuffer(m_pIndexBuffer, 0, pIndices, indexBufferParams.SizeInBytes);
+	pCopyHandler->beginBatch();
+	pCopyHandler->updateBuffer(pGeometryBuffer->getVertexBuffer(), uint64_t(m_pGeometryRange->VertexOffset) * sizeof(GPUVertex), pVertices, uint64_t(vertexSize) * vertexCount);
+	pCopyHandler->updateBuffer(pGeometryBuffer->getIndexBuffer(), uint64_t(m_pGeometryRange->IndexOffset) * sizeof(uint32_t), pIndices, uint64_t(indexCount) * sizeof(uint32_t));
+	m_UploadToken = pCopyHandler->endBatch();
+	pGeometryBuffer->setUploadToken(m_pGeometryRange, m_UploadToken);
 
 	m_VertexCount	= vertexCount;
 	m_IndexCount	= indexCount;
+
+	//Published last, the render thread reads the token and the counts once it sees the mesh as uploaded
+	m_IsUploaded.store(true, std::memory_order_release);
 	return true;
 }
 
@@ -265,12 +310,12 @@ bool MeshVK::initAsCube()
 
 IBuffer* MeshVK::getVertexBuffer() const
 {
-	return m_pVertexBuffer;
+	return m_pDevice->getGeometryBuffer()->getVertexBuffer();
 }
 
 IBuffer* MeshVK::getIndexBuffer() const
 {
-	return m_pIndexBuffer;
+	return m_pDevice->getGeometryBuffer()->getIndexBuffer();
 }
 
 uint32_t MeshVK::getIndexCount() const
@@ -288,6 +333,20 @@ uint32_t MeshVK::getMeshID() const
 	return m_ID;
 }
 
+bool MeshVK::isResident() const
+{
+	//The copy handler is only asked until it has reported the upload as complete once
+	if (!m_IsResident.load(std::memory_order_acquire) && m_IsUploaded.load(std::memory_order_acquire))
+	{
+		if (m_pDevice->getCopyHandler()->isComplete(m_UploadToken))
+		{
+			m_IsResident.store(true, std::memory_order_release);
+		}
+	}
+
+	return m_IsResident.load(std::memory_order_acquire);
+}
+
 uint32_t MeshVK::vertexForEdge(std::map<std::pair<uint32_t, uint32_t>, uint32_t>& lookup, std::vector<glm::vec3>& vertices, uint32_t first, uint32_t second)
 {
 	std::map<std::pair<uint32_t, uint32_t>, uint32_t>::key_type key(first, second);
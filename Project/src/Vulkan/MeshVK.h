@@ -1,7 +1,11 @@
 #pragma once
 #include "Common/IMesh.h"
 
+#include "CopyHandlerVK.h"
+#include "GeometryBufferVK.h"
+
 #include <map>
+#include <atomic>
 
 class BufferVK;
 class DeviceVK;
@@ -22,6 +26,7 @@ public:
 	virtual bool initAsSphere(uint32_t subDivisions) override;
 	virtual bool initAsCube() override;
 
+	//Every mesh returns the buffers of the GeometryBufferVK, the offsets below tell where this one starts
 	virtual IBuffer* getVertexBuffer() const override;
 	virtual IBuffer* getIndexBuffer() const override;
 
@@ -30,17 +35,29 @@ public:
 
 	virtual uint32_t getMeshID() const override;
 
+	virtual bool isResident() const override;
+
+	FORCEINLINE const CopyTokenVK& getUploadToken() const { return m_UploadToken; }
+
+	//Where the mesh starts in the buffers of the GeometryBufferVK, changes when the geometry buffer is defragmented
+	FORCEINLINE uint32_t getVertexOffset() const	{ return m_pGeometryRange->VertexOffset; }
+	FORCEINLINE uint32_t getIndexOffset() const		{ return m_pGeometryRange->IndexOffset; }
+
 private:
 	uint32_t vertexForEdge(std::map<std::pair<uint32_t, uint32_t>, uint32_t>& lookup, std::vector<glm::vec3>& vertices, uint32_t first, uint32_t second);
 	std::vector<Triangle> subdivide(std::vector<glm::vec3>& vertices, std::vector<Triangle>& triangles);
 
 private:
 	DeviceVK* m_pDevice;
-	BufferVK* m_pVertexBuffer;
-	BufferVK* m_pIndexBuffer;
+	GeometryRangeVK* m_pGeometryRange;
 	uint32_t m_VertexCount;
 	uint32_t m_IndexCount;
 	const uint32_t m_ID;
 
+	//The token is only read after IsUploaded is set, since meshes are created on other threads than the ones rendering them
+	CopyTokenVK m_UploadToken;
+	std::atomic<bool> m_IsUploaded;
+	mutable std::atomic<bool> m_IsResident;
+
 	static uint32_t s_ID;
 };
@@ -4,6 +4,7 @@
 #include "vulkan/vulkan.h"
 
 #include "Core/Core.h"
+#include "Core/TimelineTracer.h"
 #include "Vulkan/CommandBufferVK.h"
 #include "Vulkan/DeviceVK.h"
 
@@ -121,11 +122,22 @@ void ProfilerVK::writeResults()
         // Write the profiler's time first
         m_Time = m_TimeResults[1] - m_TimeResults[0];
 
+        // Add the timestamps to the timeline, the tracer moves them over to the CPU's clock
+        const bool isTracing = TimelineTracer::isEnabled();
+        const double timestampToNanosec = m_TimestampToMillisec * 1000000.0;
+        if (isTracing) {
+            TimelineTracer::recordGPU(m_Name.c_str(), uint64_t(m_TimeResults[0] * timestampToNanosec), uint64_t(m_TimeResults[1] * timestampToNanosec));
+        }
+
         for (Timestamp* pTimestamp : m_Timestamps) {
             pTimestamp->time = 0;
 
             for (uint32_t query : pTimestamp->queries) {
                 pTimestamp->time += m_TimeResults[query + 1] - m_TimeResults[query];
+
+                if (isTracing) {
+                    TimelineTracer::recordGPU(pTimestamp->name.c_str(), uint64_t(m_TimeResults[query] * timestampToNanosec), uint64_t(m_TimeResults[query + 1] * timestampToNanosec));
+                }
             }
 
             pTimestamp->queries.clear();
@@ -154,25 +166,25 @@ void ProfilerVK::endFrame()
 
 void ProfilerVK::drawResults()
 {
-    std::string indent('-', size_t(m_RecurseDepth));
+    // Called every frame, so the dashes and the padding are written by the format string instead of building strings
+    static const char dashes[] = "----------------------------------------------------------------";
+    const int indentLength = int(std::min<uint32_t>(m_RecurseDepth * m_DashesPerRecurse, sizeof(dashes) - 1));
 
     // Align the number across all timestamps and profilers by filling with whitespaces
     uint32_t fillLength = m_MaxTextWidth - (m_RecurseDepth * m_DashesPerRecurse + (uint32_t)m_Name.size());
-    std::string whitespaceFill(fillLength, ' ');
 
     // Convert time to milliseconds
     double timeMs = m_Time * m_TimestampToMillisec;
-    ImGui::Text("%s%s:\t%s%f ms", indent.c_str(), m_Name.c_str(), whitespaceFill.c_str(), timeMs);
+    ImGui::Text("%.*s%s:\t%*s%f ms", indentLength, dashes, m_Name.c_str(), int(fillLength), "", timeMs);
 
     // Print timestamps
     uint32_t timestampPrefixWidth = (m_RecurseDepth + 1) * m_DashesPerRecurse;
 
     for (Timestamp* pTimestamp : m_Timestamps) {
         fillLength = m_MaxTextWidth - (timestampPrefixWidth + (uint32_t)pTimestamp->name.size());
-        whitespaceFill = std::string(fillLength, ' ');
 
         timeMs = pTimestamp->time * m_TimestampToMillisec;
-        ImGui::Text("--%s%s:\t%s%f ms", indent.c_str(), pTimestamp->name.c_str(), whitespaceFill.c_str(), timeMs);
+        ImGui::Text("--%.*s%s:\t%*s%f ms", indentLength, dashes, pTimestamp->name.c_str(), int(fillLength), "", timeMs);
     }
 
     // Draw the child profilers' results
@@ -9,7 +9,9 @@
 #include "Vulkan/RenderingHandlerVK.h"
 #include "Vulkan/PipelineLayoutVK.h"
 #include "Vulkan/DescriptorSetLayoutVK.h"
+#include "Vulkan/DeletionQueueVK.h"
 #include "Vulkan/DescriptorPoolVK.h"
+#include "Vulkan/GeometryBufferVK.h"
 #include "Vulkan/DescriptorSetVK.h"
 #include "Vulkan/CommandPoolVK.h"
 #include "Vulkan/CommandBufferVK.h"
@@ -187,7 +189,8 @@ void RayTracingRendererVK::render(IScene* pScene)
 
 		vkCmdBindPipeline(m_ppComputeCommandBuffers[currentFrame]->getCommandBuffer(), VK_PIPELINE_BIND_POINT_RAY_TRACING_NV, m_pRayTracingPipeline->getPipeline());
 
-		m_ppComputeCommandBuffers[currentFrame]->bindDescriptorSet(VK_PIPELINE_BIND_POINT_RAY_TRACING_NV, m_pRayTracingPipelineLayout, 0, 1, &m_pRayTracingDescriptorSet, 0, nullptr);
+		const uint32_t dynamicOffsets[] = { m_pRenderingHandler->getCameraBufferOffset(), m_pRenderingHandler->getLightBufferOffset() };
+		m_ppComputeCommandBuffers[currentFrame]->bindDescriptorSet(VK_PIPELINE_BIND_POINT_RAY_TRACING_NV, m_pRayTracingPipelineLayout, 0, 1, &m_pRayTracingDescriptorSet, 2, dynamicOffsets);
 		
 		m_ppComputeCommandBuffers[currentFrame]->transitionImageLayout(m_pReflectionTemporalAccumulationImage, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_IMAGE_LAYOUT_GENERAL, 0, 1, 0, 1);
 		
@@ -301,10 +304,12 @@ void RayTracingRendererVK::onWindowResize(uint32_t width, uint32_t height)
 {
 	if (m_RaysWidth != width || m_RaysHeight != height)
 	{
-		SAFEDELETE(m_pReflectionTemporalAccumulationImage);
-		SAFEDELETE(m_pReflectionTemporalAccumulationImageView);
-		SAFEDELETE(m_pReflectionIntermediateImage);
-		SAFEDELETE(m_pReflectionIntermediateImageView);
+		//The frames in flight still write to the old images
+		DeletionQueueVK* pDeletionQueue = m_pContext->getDevice()->getDeletionQueue();
+		pDeletionQueue->destroy(m_pReflectionTemporalAccumulationImageView);
+		pDeletionQueue->destroy(m_pReflectionTemporalAccumulationImage);
+		pDeletionQueue->destroy(m_pReflectionIntermediateImageView);
+		pDeletionQueue->destroy(m_pReflectionIntermediateImage);
 
 		m_RaysWidth = width;
 		m_RaysHeight = height;
@@ -320,6 +325,7 @@ void RayTracingRendererVK::onWindowResize(uint32_t width, uint32_t height)
 		imageParams.Samples = VK_SAMPLE_COUNT_1_BIT;
 		imageParams.Usage = VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
 		imageParams.MemoryProperty = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+		imageParams.Category = EMemoryCategory::RENDER_TARGETS;
 
 		m_pReflectionTemporalAccumulationImage = DBG_NEW ImageVK(m_pContext->getDevice());
 		m_pReflectionTemporalAccumulationImage->init(imageParams);
@@ -349,11 +355,15 @@ void RayTracingRendererVK::onWindowResize(uint32_t width, uint32_t height)
 		pTempCommandBuffer->end();
 
 		m_pContext->getDevice()->executeCompute(pTempCommandBuffer, nullptr, nullptr, 0, nullptr, 0);
-		m_pContext->getDevice()->wait(); //Todo: Remove This
+
+		//Only the transitions have to finish before the commandbuffer is freed
+		VkFence fence = pTempCommandBuffer->getFence();
+		vkWaitForFences(m_pContext->getDevice()->getDevice(), 1, &fence, VK_TRUE, UINT64_MAX);
 
 		m_ppComputeCommandPools[0]->freeCommandBuffer(&pTempCommandBuffer);
 
 		//Update Descriptor Sets
+		replaceDescriptorSets();
 		m_pRayTracingDescriptorSet->writeStorageImageDescriptor(m_pReflectionTemporalAccumulationImageView, RT_RAW_REFLECTION_IMAGE_BINDING);
 
 		m_pHorizontalInitialBlurPassDescriptorSet->writeCombinedImageDescriptors(&m_pReflectionTemporalAccumulationImageView, &m_pLinearSampler, 1, RT_BP_INPUT_BINDING);
@@ -368,6 +378,8 @@ void RayTracingRendererVK::onWindowResize(uint32_t width, uint32_t height)
 void RayTracingRendererVK::setRayTracingResultTextures(ImageVK*, ImageViewVK* pRadianceImageView, ImageVK* pGlossyImage, ImageViewVK* pGlossyImageView, uint32_t width, uint32_t height)
 {
 	m_NumBlurImagePixels = width * height;
+
+	replaceDescriptorSets();
 	m_pRayTracingDescriptorSet->writeStorageImageDescriptor(pRadianceImageView, RT_RADIANCE_IMAGE_BINDING);
 
 	m_pReflectionFinalImage = pGlossyImage;
@@ -423,10 +435,14 @@ void RayTracingRendererVK::setSceneData(IScene* pScene)
 	const std::vector<const SamplerVK*>& samplers = pVulkanScene->getSamplers();
 	const BufferVK* pMaterialParametersBuffer = pVulkanScene->getMaterialParametersBuffer();
 
+	//Called during a frame, so the set that the frames in flight use is left untouched
+	m_pRayTracingDescriptorSet = m_pRayTracingDescriptorPool->replaceDescriptorSet(m_pRayTracingDescriptorSet);
 	m_pRayTracingDescriptorSet->writeAccelerationStructureDescriptor(pVulkanScene->getTLAS().AccelerationStructure, RT_TLAS_BINDING);
 	
-	m_pRayTracingDescriptorSet->writeStorageBufferDescriptor(pVulkanScene->getCombinedVertexBuffer(), RT_COMBINED_VERTEX_BINDING);
-	m_pRayTracingDescriptorSet->writeStorageBufferDescriptor(pVulkanScene->getCombinedIndexBuffer(), RT_COMBINED_INDEX_BINDING);
+	//The closest-hit shaders read the meshes straight from the geometry buffer
+	GeometryBufferVK* pGeometryBuffer = m_pContext->getDevice()->getGeometryBuffer();
+	m_pRayTracingDescriptorSet->writeStorageBufferDescriptor(pGeometryBuffer->getVertexBuffer(), RT_COMBINED_VERTEX_BINDING);
+	m_pRayTracingDescriptorSet->writeStorageBufferDescriptor(pGeometryBuffer->getIndexBuffer(), RT_COMBINED_INDEX_BINDING);
 	m_pRayTracingDescriptorSet->writeStorageBufferDescriptor(pVulkanScene->getMeshIndexBuffer(), RT_MESH_INDEX_BINDING);
 
 	m_pRayTracingDescriptorSet->writeCombinedImageDescriptors(albedoMaps.data(), samplers.data(), MAX_NUM_UNIQUE_MATERIALS, RT_COMBINED_ALBEDO_BINDING);
@@ -446,6 +462,15 @@ void RayTracingRendererVK::setBRDFLookUp(Texture2DVK* pTexture)
 	m_pRayTracingDescriptorSet->writeCombinedImageDescriptors(&pBRDFLookUp, &m_pNearestSampler, 1, RT_BRDF_LUT_BINDING);
 }
 
+void RayTracingRendererVK::replaceDescriptorSets()
+{
+	//The frames in flight still use the current sets, the copies are written instead and the old ones are retired
+	m_pRayTracingDescriptorSet					= m_pRayTracingDescriptorPool->replaceDescriptorSet(m_pRayTracingDescriptorSet);
+	m_pHorizontalInitialBlurPassDescriptorSet	= m_pBlurPassDescriptorPool->replaceDescriptorSet(m_pHorizontalInitialBlurPassDescriptorSet);
+	m_pHorizontalExtraBlurPassDescriptorSet		= m_pBlurPassDescriptorPool->replaceDescriptorSet(m_pHorizontalExtraBlurPassDescriptorSet);
+	m_pVerticalBlurPassDescriptorSet			= m_pBlurPassDescriptorPool->replaceDescriptorSet(m_pVerticalBlurPassDescriptorSet);
+}
+
 CommandBufferVK* RayTracingRendererVK::getComputeCommandBuffer() const
 {
 	return m_ppComputeCommandBuffers[m_pRenderingHandler->getCurrentFrameIndex()];
@@ -486,7 +511,7 @@ bool RayTracingRendererVK::createPipelineLayouts()
 		m_pRayTracingDescriptorSetLayout->addBindingStorageImage(VK_SHADER_STAGE_RAYGEN_BIT_NV, RT_RAW_REFLECTION_IMAGE_BINDING, 1);
 
 		//Uniform Buffer
-		m_pRayTracingDescriptorSetLayout->addBindingUniformBuffer(VK_SHADER_STAGE_RAYGEN_BIT_NV | VK_SHADER_STAGE_CLOSEST_HIT_BIT_NV | VK_SHADER_STAGE_MISS_BIT_NV, RT_CAMERA_BUFFER_BINDING, 1);
+		m_pRayTracingDescriptorSetLayout->addBindingUniformBufferDynamic(VK_SHADER_STAGE_RAYGEN_BIT_NV | VK_SHADER_STAGE_CLOSEST_HIT_BIT_NV | VK_SHADER_STAGE_MISS_BIT_NV, RT_CAMERA_BUFFER_BINDING, 1);
 
 		//TLAS
 		m_pRayTracingDescriptorSetLayout->addBindingAccelerationStructure(VK_SHADER_STAGE_RAYGEN_BIT_NV | VK_SHADER_STAGE_CLOSEST_HIT_BIT_NV, RT_TLAS_BINDING, 1);
@@ -514,7 +539,7 @@ bool RayTracingRendererVK::createPipelineLayouts()
 		m_pRayTracingDescriptorSetLayout->addBindingCombinedImage(VK_SHADER_STAGE_MISS_BIT_NV, nullptr, RT_SKYBOX_BINDING, 1);
 
 		//Light Buffer
-		m_pRayTracingDescriptorSetLayout->addBindingUniformBuffer(VK_SHADER_STAGE_RAYGEN_BIT_NV | VK_SHADER_STAGE_CLOSEST_HIT_BIT_NV, RT_LIGHT_BUFFER_BINDING, 1);
+		m_pRayTracingDescriptorSetLayout->addBindingUniformBufferDynamic(VK_SHADER_STAGE_RAYGEN_BIT_NV | VK_SHADER_STAGE_CLOSEST_HIT_BIT_NV, RT_LIGHT_BUFFER_BINDING, 1);
 
 		//Look Ups
 		m_pRayTracingDescriptorSetLayout->addBindingCombinedImage(VK_SHADER_STAGE_RAYGEN_BIT_NV | VK_SHADER_STAGE_CLOSEST_HIT_BIT_NV, nullptr, RT_BRDF_LUT_BINDING, 1);
@@ -532,11 +557,12 @@ bool RayTracingRendererVK::createPipelineLayouts()
 
 		//Descriptorpool
 		DescriptorCounts descriptorCounts = {};
-		descriptorCounts.m_SampledImages = MAX_NUM_UNIQUE_MATERIALS * 6;
-		descriptorCounts.m_StorageBuffers = 16;
+		descriptorCounts.m_SampledImages = MAX_NUM_UNIQUE_MATERIALS * 6 * RT_DESCRIPTOR_SET_COPIES;
+		descriptorCounts.m_StorageBuffers = 16 * RT_DESCRIPTOR_SET_COPIES;
 		descriptorCounts.m_UniformBuffers = 16;
-		descriptorCounts.m_StorageImages = 2;
-		descriptorCounts.m_AccelerationStructures = 1;
+		descriptorCounts.m_DynamicUniformBuffers = 16 * RT_DESCRIPTOR_SET_COPIES;
+		descriptorCounts.m_StorageImages = 2 * RT_DESCRIPTOR_SET_COPIES;
+		descriptorCounts.m_AccelerationStructures = 1 * RT_DESCRIPTOR_SET_COPIES;
 
 		m_pRayTracingDescriptorPool = DBG_NEW DescriptorPoolVK(m_pContext->getDevice());
 		m_pRayTracingDescriptorPool->init(descriptorCounts, 256);
@@ -576,14 +602,14 @@ bool RayTracingRendererVK::createPipelineLayouts()
 		//Descriptorpool
 		constexpr uint32_t NUM_BLUR_DESCRIPTOR_SETS = 3;
 		DescriptorCounts descriptorCounts = {};
-		descriptorCounts.m_SampledImages = 4 * NUM_BLUR_DESCRIPTOR_SETS;
+		descriptorCounts.m_SampledImages = 4 * NUM_BLUR_DESCRIPTOR_SETS * RT_DESCRIPTOR_SET_COPIES;
 		descriptorCounts.m_StorageBuffers = 1;
 		descriptorCounts.m_UniformBuffers = 1;
-		descriptorCounts.m_StorageImages = 1 * NUM_BLUR_DESCRIPTOR_SETS;
+		descriptorCounts.m_StorageImages = 1 * NUM_BLUR_DESCRIPTOR_SETS * RT_DESCRIPTOR_SET_COPIES;
 		descriptorCounts.m_AccelerationStructures = 1;
 
 		m_pBlurPassDescriptorPool = DBG_NEW DescriptorPoolVK(m_pContext->getDevice());
-		m_pBlurPassDescriptorPool->init(descriptorCounts, 16);
+		m_pBlurPassDescriptorPool->init(descriptorCounts, NUM_BLUR_DESCRIPTOR_SETS * RT_DESCRIPTOR_SET_COPIES);
 
 		m_pHorizontalInitialBlurPassDescriptorSet = m_pBlurPassDescriptorPool->allocDescriptorSet(m_pBlurPassDescriptorSetLayout);
 		if (m_pHorizontalInitialBlurPassDescriptorSet == nullptr)
@@ -688,18 +714,18 @@ bool RayTracingRendererVK::createUniformBuffers()
 	//cameraBufferParams.MemoryProperty = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
 	//cameraBufferParams.SizeInBytes = sizeof(CameraMatricesBuffer);
 
-	m_pCameraBuffer = m_pRenderingHandler->getCameraBufferCompute();//reinterpret_cast<BufferVK*>(m_pContext->createBuffer());
+	m_pCameraBuffer = m_pRenderingHandler->getFrameUniformBuffer();//reinterpret_cast<BufferVK*>(m_pContext->createBuffer());
 	//m_pCameraBuffer->init(cameraBufferParams);
-	m_pRayTracingDescriptorSet->writeUniformBufferDescriptor(m_pCameraBuffer, RT_CAMERA_BUFFER_BINDING);
+	m_pRayTracingDescriptorSet->writeUniformBufferDynamicDescriptor(m_pCameraBuffer, RT_CAMERA_BUFFER_BINDING, CAMERA_BUFFER_SIZE);
 
 	//BufferParams lightsBufferParams = {};
 	//lightsBufferParams.Usage = VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
 	//lightsBufferParams.MemoryProperty = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
 	//lightsBufferParams.SizeInBytes = sizeof(PointLight) * MAX_POINTLIGHTS;
 
-	m_pLightsBuffer = m_pRenderingHandler->getLightBufferCompute();// reinterpret_cast<BufferVK*>(m_pContext->createBuffer());
+	m_pLightsBuffer = m_pRenderingHandler->getFrameUniformBuffer();// reinterpret_cast<BufferVK*>(m_pContext->createBuffer());
 	//m_pLightsBuffer->init(lightsBufferParams);
-	m_pRayTracingDescriptorSet->writeUniformBufferDescriptor(m_pLightsBuffer, RT_LIGHT_BUFFER_BINDING);
+	m_pRayTracingDescriptorSet->writeUniformBufferDynamicDescriptor(m_pLightsBuffer, RT_LIGHT_BUFFER_BINDING, LIGHT_BUFFER_SIZE);
 
 	return true;
 }
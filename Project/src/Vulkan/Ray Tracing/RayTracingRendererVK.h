@@ -54,6 +54,9 @@ constexpr uint32_t RT_BP_GBUFFER_ALBEDO_BINDING = 2;
 constexpr uint32_t RT_BP_GBUFFER_NORMAL_BINDING = 3;
 constexpr uint32_t RT_BP_GBUFFER_DEPTH_BINDING = 4;
 
+//The sets are replaced up to three times in a frame, and a replaced set lives until the frames in flight that use it have finished
+constexpr uint32_t RT_DESCRIPTOR_SET_COPIES = 4 * (MAX_FRAMES_IN_FLIGHT + 1);
+
 class RayTracingRendererVK : public IRenderer
 {
 	struct GPURayTracingParameters
@@ -107,6 +110,8 @@ private:
 
 	void createProfiler();
 
+	void replaceDescriptorSets();
+
 	void updateBuffers(SceneVK* pScene, CommandBufferVK* pCommandBuffer);
 
 private:
@@ -28,6 +28,7 @@ bool ShaderBindingTableVK::init(RayTracingPipelineVK* pRayTracingPipeline)
 	sbtParams.MemoryProperty	= VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
 	sbtParams.SizeInBytes		= sbtSize;
 	sbtParams.IsExclusive		= true;
+	sbtParams.Category			= EMemoryCategory::RAY_TRACING;
 
 	m_pSBT = reinterpret_cast<BufferVK*>(m_pContext->createBuffer());
 	m_pSBT->init(sbtParams);
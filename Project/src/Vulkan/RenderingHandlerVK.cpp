@@ -5,12 +5,18 @@
 
 #include "Core/PointLight.h"
 #include "Core/TaskDispatcher.h"
+#include "Core/AllocationCounter.h"
+#include "Core/FrameAllocator.h"
 
 #include "BufferVK.h"
 #include "CommandBufferVK.h"
 #include "CommandPoolVK.h"
+#include "CopyHandlerVK.h"
+#include "DeletionQueueVK.h"
+#include "DeviceAllocatorVK.h"
 #include "FrameBufferVK.h"
 #include "GBufferVK.h"
+#include "GeometryBufferVK.h"
 #include "GraphicsContextVK.h"
 #include "ImageViewVK.h"
 #include "ImageVK.h"
@@ -22,11 +28,33 @@
 #include "SceneVK.h"
 #include "SkyboxRendererVK.h"
 #include "SwapChainVK.h"
+#include "UploadRingVK.h"
 #include "TextureCubeVK.h"
 
 #include "Ray Tracing/RayTracingRendererVK.h"
 
 #define MULTITHREADED 1
+#define DEFRAGMENT_GEOMETRY 1
+
+#if TRACK_ALLOCATIONS
+//Allocations made by the recording tasks, added to the ones made by the render thread when the frame is done. Tasks the
+//render thread runs while it waits are not counted into its own scope, so they are not counted twice
+static std::atomic<uint64_t> g_TaskAllocations = 0;
+
+struct TaskAllocationScope
+{
+	~TaskAllocationScope()
+	{
+		g_TaskAllocations.fetch_add(Scope.getAllocations(), std::memory_order_relaxed);
+	}
+
+	AllocationScope Scope;
+};
+
+	#define COUNT_TASK_ALLOCATIONS() TaskAllocationScope taskAllocationScope
+#else
+	#define COUNT_TASK_ALLOCATIONS()
+#endif
 
 RenderingHandlerVK::RenderingHandlerVK(GraphicsContextVK* pGraphicsContext)
 	:m_pGraphicsContext(pGraphicsContext),
@@ -44,10 +72,10 @@ RenderingHandlerVK::RenderingHandlerVK(GraphicsContextVK* pGraphicsContext)
 	m_pBackBufferRenderPass(nullptr),
 	m_pParticleRenderPass(nullptr),
 	m_pUIRenderPass(nullptr),
-	m_pCameraBufferCompute(nullptr),
-	m_pCameraBufferGraphics(nullptr),
-	m_pLightBufferCompute(nullptr),
-	m_pLightBufferGraphics(nullptr),
+	m_pFrameUniformBuffer(nullptr),
+	m_pFrameUniformMemory(nullptr),
+	m_FrameUniformSliceSize(0),
+	m_LightBufferOffset(0),
 	m_pPipeline(nullptr),
 	m_ppBackbuffers(),
 	m_ppBackBuffersWithDepth(),
@@ -61,18 +89,15 @@ RenderingHandlerVK::RenderingHandlerVK(GraphicsContextVK* pGraphicsContext)
 	m_pImageAvailableSemaphores(),
 	m_pRenderFinishedSemaphores(),
 	m_ComputeFinishedGraphicsSemaphore(VK_NULL_HANDLE),
-	m_ComputeFinishedTransferSemaphore(VK_NULL_HANDLE),
 	m_GeometryFinishedSemaphore(VK_NULL_HANDLE),
-	m_TransferFinishedGraphicsSemaphore(VK_NULL_HANDLE),
-	m_TransferFinishedComputeSemaphore(VK_NULL_HANDLE),
-	m_TransferStartSemaphore(VK_NULL_HANDLE),
     m_CurrentFrame(0),
 	m_BackBufferIndex(0),
 	m_ClearColor(),
 	m_ClearDepth(),
 	m_Viewport(),
 	m_ScissorRect(),
-	m_RayTracingResolutionDenominator(1)
+	m_RayTracingResolutionDenominator(1),
+	m_FrameAllocations()
 {
 	m_ClearDepth.depthStencil.depth = 1.0f;
 	m_ClearDepth.depthStencil.stencil = 0;
@@ -88,11 +113,7 @@ RenderingHandlerVK::RenderingHandlerVK(GraphicsContextVK* pGraphicsContext)
 
 RenderingHandlerVK::~RenderingHandlerVK()
 {
-	SAFEDELETE(m_pCameraBufferCompute);
-	SAFEDELETE(m_pCameraBufferGraphics);
-
-	SAFEDELETE(m_pLightBufferCompute);
-	SAFEDELETE(m_pLightBufferGraphics);
+	SAFEDELETE(m_pFrameUniformBuffer);
 
 	SAFEDELETE(m_pGeometryRenderPass);
 	SAFEDELETE(m_pShadowMapRenderPass);
@@ -114,7 +135,6 @@ RenderingHandlerVK::~RenderingHandlerVK()
     for (uint32_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
 	{
 		SAFEDELETE(m_ppGraphicsCommandPools[i]);
-		SAFEDELETE(m_ppTransferCommandPools[i]);
 		SAFEDELETE(m_ppComputeCommandPools[i]);
 		SAFEDELETE(m_ppCommandPoolsSecondary[i]);
 
@@ -134,30 +154,10 @@ RenderingHandlerVK::~RenderingHandlerVK()
 		vkDestroySemaphore(device, m_ComputeFinishedGraphicsSemaphore, nullptr);
 	}
 
-	if (m_ComputeFinishedTransferSemaphore != VK_NULL_HANDLE)
-	{
-		vkDestroySemaphore(device, m_ComputeFinishedTransferSemaphore, nullptr);
-	}
-
 	if (m_GeometryFinishedSemaphore != VK_NULL_HANDLE)
 	{
 		vkDestroySemaphore(device, m_GeometryFinishedSemaphore, nullptr);
 	}
-
-	if (m_TransferFinishedGraphicsSemaphore != VK_NULL_HANDLE)
-	{
-		vkDestroySemaphore(device, m_TransferFinishedGraphicsSemaphore, nullptr);
-	}
-
-	if (m_TransferFinishedComputeSemaphore != VK_NULL_HANDLE)
-	{
-		vkDestroySemaphore(device, m_TransferFinishedComputeSemaphore, nullptr);
-	}
-
-	if (m_TransferStartSemaphore != VK_NULL_HANDLE)
-	{
-		vkDestroySemaphore(device, m_TransferStartSemaphore, nullptr);
-	}
 }
 
 bool RenderingHandlerVK::initialize()
@@ -219,6 +219,16 @@ ITextureCube* RenderingHandlerVK::generateTextureCube(ITexture2D* pPanorama, ETe
 
 void RenderingHandlerVK::render(IScene* pScene)
 {
+	//Temporaries from the last frame are released, nothing that was recorded keeps pointers into the frame allocator
+	FrameAllocator::beginFrame();
+
+#if TRACK_ALLOCATIONS
+	//Not a count of the thread, render() may continue on another worker after it has waited for tasks
+	AllocationScope frameScope;
+	uint64_t dispatchAllocations = 0;
+	g_TaskAllocations.store(0, std::memory_order_relaxed);
+#endif
+
 	SceneVK* pVulkanScene	= reinterpret_cast<SceneVK*>(pScene);
 	SwapChainVK* pSwapChain = m_pGraphicsContext->getSwapChain();
 
@@ -235,16 +245,29 @@ void RenderingHandlerVK::render(IScene* pScene)
 	m_ppComputeCommandPools[m_CurrentFrame]->reset();
 	m_ppComputeCommandBuffers[m_CurrentFrame]->begin(nullptr, VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
 
-	m_ppTransferCommandBuffers[m_CurrentFrame]->reset(true);
-	m_ppTransferCommandPools[m_CurrentFrame]->reset();
-	m_ppTransferCommandBuffers[m_CurrentFrame]->begin(nullptr, VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
+	//The fences of the frame that used these commandbuffers last have been waited on, so what was retired up until then can be destroyed
+	DeletionQueueVK* pDeletionQueue = m_pGraphicsContext->getDevice()->getDeletionQueue();
+	const uint64_t frameIndex = pDeletionQueue->getFrameIndex();
+	if (frameIndex >= MAX_FRAMES_IN_FLIGHT)
+	{
+		pDeletionQueue->collect(frameIndex - MAX_FRAMES_IN_FLIGHT);
+	}
+
+	//Copies that have finished since the last frame give their part of the upload ring back, even when nothing is loading
+	m_pGraphicsContext->getDevice()->getCopyHandler()->releaseCompletedUploads();
+
+	//Moves are finished before anything is recorded, so the whole frame sees the same mesh offsets
+#if DEFRAGMENT_GEOMETRY
+	m_pGraphicsContext->getDevice()->getGeometryBuffer()->defragment(GEOMETRY_DEFRAG_BYTES_PER_FRAME);
+#else
+	m_pGraphicsContext->getDevice()->getGeometryBuffer()->defragment(0);
+#endif
 
 	const Camera& camera			= pVulkanScene->getCamera();
-	LightSetup& lightsetup	= pVulkanScene->getLightSetup();
+	const LightSetup& lightsetup	= pVulkanScene->getRenderLightSetup();
 	updateBuffers(pVulkanScene, camera, lightsetup);
 
 	DeviceVK* pDevice = m_pGraphicsContext->getDevice();
-	m_ppTransferCommandBuffers[m_CurrentFrame]->end();
 
 	//Render all the meshes
 	FrameBufferVK*		pBackbuffer				= getCurrentBackBuffer();
@@ -256,25 +279,33 @@ void RenderingHandlerVK::render(IScene* pScene)
 #if MULTITHREADED
 	m_pMeshRenderer->beginFrame(pVulkanScene);
 
-	TaskDispatcher::execute([pVulkanScene, this]
-		{
-			auto& graphicsObjects = pVulkanScene->getGraphicsObjects();
-			for (uint32_t i = 0; i < graphicsObjects.size(); i++)
+#if TRACK_ALLOCATIONS
+	const uint64_t dispatchStartAllocations = frameScope.getAllocations();
+#endif
+
+	//Only wait for the recording, not for assets that are still loading in the background
+	TaskGroup recordingTasks;
+	for (uint32_t chunk = 0; chunk < m_pMeshRenderer->getGeometryChunkCount(); chunk++)
+	{
+		TaskDispatcher::execute(Task("Record Geometry", [this, chunk]
 			{
-				const GraphicsObjectVK& graphicsObject = graphicsObjects[i];
-				m_pMeshRenderer->submitMesh(graphicsObject.pMesh, graphicsObject.pMaterial, graphicsObject.MaterialParametersIndex, i);
-			}
-			m_pMeshRenderer->endFrame(pVulkanScene);
-		});
-	TaskDispatcher::execute([this]
+				COUNT_TASK_ALLOCATIONS();
+				m_pMeshRenderer->recordGeometryChunk(chunk);
+			}), recordingTasks);
+	}
+
+	TaskDispatcher::execute(Task("Record Light Pass", [this]
 		{
+			COUNT_TASK_ALLOCATIONS();
 			m_pMeshRenderer->buildLightPass(m_pBackBufferRenderPass, getCurrentBackBuffer());
-		});
+		}), recordingTasks);
 
 	if (m_pImGuiRenderer)
 	{
-		TaskDispatcher::execute([&, this]
+		TaskDispatcher::execute(Task("Record ImGui", [&, this]
 			{
+				COUNT_TASK_ALLOCATIONS();
+
 				// Needed to begin a secondary buffer
 				VkCommandBufferInheritanceInfo inheritanceInfo = {};
 				inheritanceInfo.sType		= VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
@@ -288,18 +319,20 @@ void RenderingHandlerVK::render(IScene* pScene)
 				pSecondaryCommandBuffer->begin(&inheritanceInfo, VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT);
 				m_pImGuiRenderer->render(pSecondaryCommandBuffer, m_CurrentFrame);
 				pSecondaryCommandBuffer->end();
-			});
+			}), recordingTasks);
 	}
+
+#if TRACK_ALLOCATIONS
+	dispatchAllocations = frameScope.getAllocations() - dispatchStartAllocations;
+#endif
+
 #else
 	m_pMeshRenderer->beginFrame(pVulkanScene);
 
-	auto& graphicsObjects = pVulkanScene->getGraphicsObjects();
-	for (uint32_t i = 0; i < graphicsObjects.size(); i++)
+	for (uint32_t chunk = 0; chunk < m_pMeshRenderer->getGeometryChunkCount(); chunk++)
 	{
-		const GraphicsObjectVK& graphicsObject = graphicsObjects[i];
-		m_pMeshRenderer->submitMesh(graphicsObject.pMesh, graphicsObject.pMaterial, graphicsObject.MaterialParametersIndex, i);
+		m_pMeshRenderer->recordGeometryChunk(chunk);
 	}
-	m_pMeshRenderer->endFrame(pVulkanScene);
 
 	m_pMeshRenderer->buildLightPass(m_pBackBufferRenderPass, getCurrentBackBuffer());
 
@@ -317,31 +350,24 @@ void RenderingHandlerVK::render(IScene* pScene)
 	m_pImGuiRenderer->render(pSecondaryCommandBuffer, m_CurrentFrame);
 	pSecondaryCommandBuffer->end();
 #endif
-	
-	{
-		static bool firstFrame = true;
-
-		const uint32_t waitCount = firstFrame ? 0 : 2;
-		firstFrame = false;
-
-		VkSemaphore				transferWaitSemphores[]		= { m_TransferStartSemaphore, m_ComputeFinishedTransferSemaphore };
-		VkPipelineStageFlags	transferWaitStages[]		= { VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT };
-		VkSemaphore				transferSignalSemaphores[]	= { m_TransferFinishedGraphicsSemaphore, m_TransferFinishedComputeSemaphore };
-
-		pDevice->executeTransfer(m_ppTransferCommandBuffers[m_CurrentFrame], transferWaitSemphores, transferWaitStages, waitCount, transferSignalSemaphores, 2);
-	}
 
 #if MULTITHREADED
-	TaskDispatcher::waitForTasks();
+	recordingTasks.wait();
 #endif
+	m_pMeshRenderer->endFrame(pVulkanScene);
+
+	//Start renderpass, the timestamps has to be written outside since the renderpass only contains secondary buffers
+	ProfilerVK* pGeometryProfiler = m_pMeshRenderer->getGeometryProfiler();
+	pGeometryProfiler->beginFrame(m_ppGraphicsCommandBuffers[m_CurrentFrame]);
 
-	//Start renderpass
 	VkClearValue clearValues[] = { m_ClearColor, m_ClearColor, m_ClearColor, m_ClearDepth };
 	m_ppGraphicsCommandBuffers[m_CurrentFrame]->beginRenderPass(m_pGeometryRenderPass, m_pGBuffer->getFrameBuffer(), (uint32_t)m_Viewport.width, (uint32_t)m_Viewport.height, clearValues, 4, VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
 
-	m_ppGraphicsCommandBuffers[m_CurrentFrame]->executeSecondary(m_pMeshRenderer->getGeometryCommandBuffer());
+	m_pMeshRenderer->executeGeometryChunks(m_ppGraphicsCommandBuffers[m_CurrentFrame]);
 	m_ppGraphicsCommandBuffers[m_CurrentFrame]->endRenderPass();
 
+	pGeometryProfiler->endFrame();
+
 	if (m_pRayTracer)
 	{
 		uint32_t computeQueueIndex	= pDevice->getQueueFamilyIndices().computeFamily.value();
@@ -368,11 +394,8 @@ void RenderingHandlerVK::render(IScene* pScene)
 		m_ppGraphicsCommandBuffers[m_CurrentFrame]->end();
 
 		{
-			VkSemaphore geometryWaitSemphores[] = { m_TransferFinishedGraphicsSemaphore };
-			VkPipelineStageFlags geometryWaitStages[] = { VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT };
-
-			VkSemaphore signalSemaphores[] = { m_GeometryFinishedSemaphore, m_TransferStartSemaphore };
-			pDevice->executeGraphics(m_ppGraphicsCommandBuffers[m_CurrentFrame], geometryWaitSemphores, geometryWaitStages, 1, signalSemaphores, 2);
+			VkSemaphore signalSemaphores[] = { m_GeometryFinishedSemaphore };
+			pDevice->executeGraphics(m_ppGraphicsCommandBuffers[m_CurrentFrame], nullptr, nullptr, 0, signalSemaphores, 1);
 		}
 
 		//Prepare seconds graphics commandbuffer
@@ -442,11 +465,8 @@ void RenderingHandlerVK::render(IScene* pScene)
 	{
 		m_ppGraphicsCommandBuffers[m_CurrentFrame]->end();
 		{
-			VkSemaphore geometryWaitSemphores[] = { m_TransferFinishedGraphicsSemaphore };
-			VkPipelineStageFlags geometryWaitStages[] = { VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT };
-
-			VkSemaphore signalSemaphores[] = { m_GeometryFinishedSemaphore, m_TransferStartSemaphore };
-			pDevice->executeGraphics(m_ppGraphicsCommandBuffers[m_CurrentFrame], geometryWaitSemphores, geometryWaitStages, 1, signalSemaphores, 2);
+			VkSemaphore signalSemaphores[] = { m_GeometryFinishedSemaphore };
+			pDevice->executeGraphics(m_ppGraphicsCommandBuffers[m_CurrentFrame], nullptr, nullptr, 0, signalSemaphores, 1);
 		}
 		m_ppGraphicsCommandBuffers2[m_CurrentFrame]->begin(nullptr, VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
 	}
@@ -472,14 +492,21 @@ void RenderingHandlerVK::render(IScene* pScene)
 		VkSemaphore graphicsWaitSemaphores[]		= { m_pImageAvailableSemaphores[m_CurrentFrame], m_ComputeFinishedGraphicsSemaphore };
 		VkPipelineStageFlags graphicswaitStages[]	= { VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT , VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT };
 
-		VkSemaphore computeSignalSemaphores[]		= { m_ComputeFinishedGraphicsSemaphore, m_ComputeFinishedTransferSemaphore };
-		VkSemaphore computeWaitSemaphores[]			= { m_GeometryFinishedSemaphore, m_TransferFinishedComputeSemaphore };
-		VkPipelineStageFlags computeWaitStages[]	= { VK_PIPELINE_STAGE_RAY_TRACING_SHADER_BIT_NV, VK_PIPELINE_STAGE_RAY_TRACING_SHADER_BIT_NV };
+		VkSemaphore computeSignalSemaphores[]		= { m_ComputeFinishedGraphicsSemaphore };
+		VkSemaphore computeWaitSemaphores[]			= { m_GeometryFinishedSemaphore };
+		VkPipelineStageFlags computeWaitStages[]	= { VK_PIPELINE_STAGE_RAY_TRACING_SHADER_BIT_NV };
 
-		pDevice->executeCompute(m_ppComputeCommandBuffers[m_CurrentFrame], computeWaitSemaphores, computeWaitStages, 2, computeSignalSemaphores, 2);
+		pDevice->executeCompute(m_ppComputeCommandBuffers[m_CurrentFrame], computeWaitSemaphores, computeWaitStages, 1, computeSignalSemaphores, 1);
 		pDevice->executeGraphics(m_ppGraphicsCommandBuffers2[m_CurrentFrame], graphicsWaitSemaphores, graphicswaitStages, 2, graphicsSignalSemaphores, 1);
 	}
 
+#if TRACK_ALLOCATIONS
+	//Once the pools, arenas and containers have grown to fit, recording a frame should never touch the heap
+	m_FrameAllocations.RenderThread		= frameScope.getAllocations() - dispatchAllocations;
+	m_FrameAllocations.TaskDispatch		= dispatchAllocations;
+	m_FrameAllocations.RecordingTasks	= g_TaskAllocations.load(std::memory_order_relaxed);
+#endif
+
 	swapBuffers();
 }
 
@@ -527,7 +554,6 @@ void RenderingHandlerVK::onSceneUpdated(IScene* pScene)
 void RenderingHandlerVK::setRayTracingResolutionDenominator(uint32_t denom)
 {
 	m_RayTracingResolutionDenominator = denom;
-	m_pGraphicsContext->getDevice()->wait();
 
 	VkExtent2D extent = m_pGBuffer->getExtent();
 
@@ -549,6 +575,8 @@ void RenderingHandlerVK::swapBuffers()
 {
     m_pGraphicsContext->swapBuffers(m_pRenderFinishedSemaphores[m_CurrentFrame]);
 	m_CurrentFrame = (m_CurrentFrame + 1) % MAX_FRAMES_IN_FLIGHT;
+
+	m_pGraphicsContext->getDevice()->getDeletionQueue()->endFrame();
 }
 
 void RenderingHandlerVK::drawProfilerUI()
@@ -556,6 +584,7 @@ void RenderingHandlerVK::drawProfilerUI()
 	if (m_pMeshRenderer)
 	{
 		m_pMeshRenderer->getGeometryProfiler()->drawResults();
+		m_pMeshRenderer->renderUI();
 		m_pMeshRenderer->getLightProfiler()->drawResults();
 	}
 
@@ -563,6 +592,161 @@ void RenderingHandlerVK::drawProfilerUI()
 	{
 		m_pRayTracer->getProfiler()->drawResults();
 	}
+
+	if (ImGui::CollapsingHeader("Device Memory"))
+	{
+		static std::vector<DeviceMemoryStatistics> statistics;
+		DeviceAllocatorVK* pAllocator = m_pGraphicsContext->getDevice()->getAllocator();
+		pAllocator->getStatistics(statistics);
+
+		ImGui::Text("vkAllocateMemory allocations: %u", pAllocator->getDeviceAllocationCount());
+
+		const FrameAllocatorStatistics frameAllocator = FrameAllocator::getStatistics();
+		ImGui::Text("Frame allocator: %.1f / %.1f KB over %u threads, %llu overflows", double(frameAllocator.UsedBytes) / 1024.0, double(frameAllocator.ArenaBytes) / 1024.0, frameAllocator.ThreadCount, (unsigned long long)frameAllocator.OverflowCount);
+#if TRACK_ALLOCATIONS
+		ImGui::Text("Heap allocations while recording: %llu (render thread %llu, task dispatch %llu, recording tasks %llu)", (unsigned long long)m_FrameAllocations.getTotal(),
+			(unsigned long long)m_FrameAllocations.RenderThread, (unsigned long long)m_FrameAllocations.TaskDispatch, (unsigned long long)m_FrameAllocations.RecordingTasks);
+#endif
+
+		const UploadRingStatistics uploadRing = m_pGraphicsContext->getDevice()->getUploadRing()->getStatistics();
+		ImGui::Text("Upload ring: %.1f / %.1f MB (peak %.1f MB), %u ranges in flight", double(uploadRing.UsedBytes) / (1024.0 * 1024.0), double(uploadRing.SizeInBytes) / (1024.0 * 1024.0), double(uploadRing.PeakBytes) / (1024.0 * 1024.0), uploadRing.RangesInFlight);
+		ImGui::Text("Upload overflows: %u (%.1f MB)", uploadRing.OverflowCount, double(uploadRing.OverflowBytes) / (1024.0 * 1024.0));
+
+		const CopyHandlerStatistics copyHandler = m_pGraphicsContext->getDevice()->getCopyHandler()->getStatistics();
+		ImGui::Text("Copies: %llu in %llu submits, %llu batches", (unsigned long long)copyHandler.CopyCount, (unsigned long long)copyHandler.SubmitCount, (unsigned long long)copyHandler.BatchCount);
+
+		const DeletionQueueStatistics deletionQueue = m_pGraphicsContext->getDevice()->getDeletionQueue()->getStatistics();
+		ImGui::Text("Deferred deletions: %u pending, %llu destroyed", deletionQueue.PendingCount, (unsigned long long)deletionQueue.DeletedCount);
+
+		const GeometryBufferStatistics geometryBuffer = m_pGraphicsContext->getDevice()->getGeometryBuffer()->getStatistics();
+		ImGui::Text("Geometry vertices: %u / %u (%u free ranges)", geometryBuffer.UsedVertices, geometryBuffer.VertexCapacity, geometryBuffer.VertexFreeRanges);
+		ImGui::Text("Geometry indices: %u / %u (%u free ranges)", geometryBuffer.UsedIndices, geometryBuffer.IndexCapacity, geometryBuffer.IndexFreeRanges);
+		ImGui::Text("Geometry fragmentation: %.1f%% vertices, %.1f%% indices", geometryBuffer.VertexFragmentation * 100.0f, geometryBuffer.IndexFragmentation * 100.0f);
+		ImGui::Text("Geometry moves: %llu (%u pending), %.2f MB last frame, %.1f MB total", (unsigned long long)geometryBuffer.MoveCount, geometryBuffer.PendingMoves, double(geometryBuffer.BytesMovedLastFrame) / (1024.0 * 1024.0), double(geometryBuffer.BytesMoved) / (1024.0 * 1024.0));
+
+		ImGui::Columns(6, "DeviceMemoryColumns");
+		const char* pHeaders[] = { "Type", "Blocks", "Allocations", "Used / Reserved", "Dedicated", "Fragmentation" };
+		for (const char* pHeader : pHeaders)
+		{
+			ImGui::Text("%s", pHeader);
+			ImGui::NextColumn();
+		}
+
+		ImGui::Separator();
+		for (const DeviceMemoryStatistics& memoryType : statistics)
+		{
+			const bool isDeviceLocal = (memoryType.Properties & VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT) != 0;
+			const bool isHostVisible = (memoryType.Properties & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) != 0;
+			ImGui::Text("%u %s%s", memoryType.MemoryTypeIndex, isDeviceLocal ? "Device" : "", isHostVisible ? " Host" : "");
+			ImGui::NextColumn();
+			ImGui::Text("%u", memoryType.BlockCount);
+			ImGui::NextColumn();
+			ImGui::Text("%u", memoryType.AllocationCount);
+			ImGui::NextColumn();
+			ImGui::Text("%.1f / %.1f MB", double(memoryType.UsedBytes) / (1024.0 * 1024.0), double(memoryType.BlockBytes) / (1024.0 * 1024.0));
+			ImGui::NextColumn();
+			ImGui::Text("%u (%.1f MB)", memoryType.DedicatedCount, double(memoryType.DedicatedBytes) / (1024.0 * 1024.0));
+			ImGui::NextColumn();
+			ImGui::Text("%.1f%% (%u free)", memoryType.Fragmentation * 100.0f, memoryType.FreeRegionCount);
+			ImGui::NextColumn();
+		}
+
+		ImGui::Columns(1);
+	}
+
+	if (ImGui::CollapsingHeader("Memory Budget"))
+	{
+		static std::vector<MemoryHeapBudget> budgets;
+		static std::vector<MemoryCategoryStatistics> categories;
+		DeviceAllocatorVK* pAllocator = m_pGraphicsContext->getDevice()->getAllocator();
+
+		const bool hasBudget = pAllocator->getHeapBudgets(budgets);
+		ImGui::Text(hasBudget ? "Heaps (VK_EXT_memory_budget)" : "Heaps (VK_EXT_memory_budget not supported, budget is the heap size)");
+		for (const MemoryHeapBudget& budget : budgets)
+		{
+			const bool isDeviceLocal = (budget.Flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) != 0;
+			const float usage = budget.Budget > 0 ? float(double(budget.Usage) / double(budget.Budget)) : 0.0f;
+
+			ImGui::Text("%u %s: %.1f / %.1f MB (%.1f%%), %.1f MB reserved by us", budget.HeapIndex, isDeviceLocal ? "Device" : "Host", double(budget.Usage) / (1024.0 * 1024.0), double(budget.Budget) / (1024.0 * 1024.0), usage * 100.0f, double(budget.ReservedBytes) / (1024.0 * 1024.0));
+			if (usage >= MEMORY_BUDGET_WARNING_THRESHOLD)
+			{
+				ImGui::TextColored(ImVec4(1.0f, 0.3f, 0.3f, 1.0f), "Warning: Heap %u is at %.1f%% of its budget, allocations may start to fail or be paged out", budget.HeapIndex, usage * 100.0f);
+			}
+		}
+
+		VkDeviceSize usedBytes = 0;
+		VkDeviceSize peakBytes = 0;
+		pAllocator->getCategoryStatistics(categories, usedBytes, peakBytes);
+
+		ImGui::Separator();
+		ImGui::Text("Allocated: %.1f MB (peak %.1f MB)", double(usedBytes) / (1024.0 * 1024.0), double(peakBytes) / (1024.0 * 1024.0));
+
+		ImGui::Columns(4, "MemoryCategoryColumns");
+		const char* pHeaders[] = { "Category", "Allocations", "Used", "Peak" };
+		for (const char* pHeader : pHeaders)
+		{
+			ImGui::Text("%s", pHeader);
+			ImGui::NextColumn();
+		}
+
+		ImGui::Separator();
+		for (const MemoryCategoryStatistics& category : categories)
+		{
+			if (category.TotalAllocations == 0)
+			{
+				continue;
+			}
+
+			ImGui::Text("%s", memoryCategoryAsString(category.Category));
+			ImGui::NextColumn();
+			ImGui::Text("%u (%llu total)", category.AllocationCount, (unsigned long long)category.TotalAllocations);
+			ImGui::NextColumn();
+			ImGui::Text("%.1f MB", double(category.UsedBytes) / (1024.0 * 1024.0));
+			ImGui::NextColumn();
+			ImGui::Text("%.1f MB", double(category.PeakBytes) / (1024.0 * 1024.0));
+			ImGui::NextColumn();
+		}
+
+		ImGui::Columns(1);
+	}
+
+#if SPINLOCK_STATISTICS
+	if (ImGui::CollapsingHeader("Spinlocks"))
+	{
+		static std::vector<SpinlockStatistics> statistics;
+		Spinlock::getStatistics(statistics);
+
+		if (ImGui::Button("Reset Lock Statistics"))
+		{
+			Spinlock::resetStatistics();
+		}
+
+		ImGui::Columns(5, "SpinlockColumns");
+		const char* pHeaders[] = { "Lock", "Acquisitions", "Contended", "Spins", "Max Hold" };
+		for (const char* pHeader : pHeaders)
+		{
+			ImGui::Text("%s", pHeader);
+			ImGui::NextColumn();
+		}
+
+		ImGui::Separator();
+		for (const SpinlockStatistics& lock : statistics)
+		{
+			ImGui::Text("%s", lock.Name.c_str());
+			ImGui::NextColumn();
+			ImGui::Text("%llu", (unsigned long long)lock.Acquisitions);
+			ImGui::NextColumn();
+			ImGui::Text("%llu", (unsigned long long)lock.ContendedAcquisitions);
+			ImGui::NextColumn();
+			ImGui::Text("%llu", (unsigned long long)lock.Spins);
+			ImGui::NextColumn();
+			ImGui::Text("%.3f ms", double(lock.MaxHoldTimeNS) / 1000000.0);
+			ImGui::NextColumn();
+		}
+
+		ImGui::Columns(1);
+	}
+#endif
 }
 
 void RenderingHandlerVK::setClearColor(float r, float g, float b)
@@ -661,7 +845,6 @@ bool RenderingHandlerVK::createCommandPoolAndBuffers()
     DeviceVK* pDevice = m_pGraphicsContext->getDevice();
     const uint32_t graphicsQueueFamilyIndex = pDevice->getQueueFamilyIndices().graphicsFamily.value();
 	const uint32_t computeQueueFamilyIndex	= pDevice->getQueueFamilyIndices().computeFamily.value();
-	const uint32_t transferQueueFamilyIndex = pDevice->getQueueFamilyIndices().transferFamily.value();
 
     for (uint32_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
 	{
@@ -707,23 +890,6 @@ bool RenderingHandlerVK::createCommandPoolAndBuffers()
 		name = "ComputeCommandBuffer[" + std::to_string(i) + "]";
 		m_ppComputeCommandBuffers[i]->setName(name.c_str());
 
-		//Transfer
-		m_ppTransferCommandPools[i] = DBG_NEW CommandPoolVK(pDevice, transferQueueFamilyIndex);
-		if (!m_ppTransferCommandPools[i]->init())
-		{
-			return false;
-		}
-		name = "TransferCommandPool[" + std::to_string(i) + "]";
-		m_ppTransferCommandPools[i]->setName(name.c_str());
-
-		m_ppTransferCommandBuffers[i] = m_ppTransferCommandPools[i]->allocateCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY);
-		if (m_ppTransferCommandBuffers[i] == nullptr)
-		{
-			return false;
-		}
-		name = "TransferCommandBuffer[" + std::to_string(i) + "]";
-		m_ppTransferCommandBuffers[i]->setName(name.c_str());
-
 		//Secondary
         m_ppCommandPoolsSecondary[i] = DBG_NEW CommandPoolVK(pDevice, graphicsQueueFamilyIndex);
 		if (!m_ppCommandPoolsSecondary[i]->init())
@@ -956,11 +1122,7 @@ bool RenderingHandlerVK::createSemaphores()
 	}
 
 	VK_CHECK_RESULT_RETURN_FALSE(vkCreateSemaphore(device, &semaphoreInfo, nullptr, &m_ComputeFinishedGraphicsSemaphore), "Failed to create semaphores for Compute Finsihed Graphics");
-	VK_CHECK_RESULT_RETURN_FALSE(vkCreateSemaphore(device, &semaphoreInfo, nullptr, &m_ComputeFinishedTransferSemaphore), "Failed to create semaphores for Compute Finsihed Transfer");
 	VK_CHECK_RESULT_RETURN_FALSE(vkCreateSemaphore(device, &semaphoreInfo, nullptr, &m_GeometryFinishedSemaphore), "Failed to create semaphores for Geometry Pass");
-	VK_CHECK_RESULT_RETURN_FALSE(vkCreateSemaphore(device, &semaphoreInfo, nullptr, &m_TransferStartSemaphore), "Failed to create semaphores for Start Transfer");
-	VK_CHECK_RESULT_RETURN_FALSE(vkCreateSemaphore(device, &semaphoreInfo, nullptr, &m_TransferFinishedGraphicsSemaphore), "Failed to create semaphores for Finished Transfer Graphics");
-	VK_CHECK_RESULT_RETURN_FALSE(vkCreateSemaphore(device, &semaphoreInfo, nullptr, &m_TransferFinishedComputeSemaphore), "Failed to create semaphores for Finished Transfer Compute");
 
 	return true;
 }
@@ -976,38 +1138,6 @@ void RenderingHandlerVK::releaseBackBuffers()
 
 void RenderingHandlerVK::updateBuffers(SceneVK* pScene, const Camera& camera, const LightSetup& lightSetup)
 {
-	DeviceVK* pDevice = m_pGraphicsContext->getDevice();
-	const uint32_t graphicsQueueFamilyIndex = pDevice->getQueueFamilyIndices().graphicsFamily.value();
-	const uint32_t computeQueueFamilyIndex	= pDevice->getQueueFamilyIndices().computeFamily.value();
-	const uint32_t transferQueueFamilyIndex = pDevice->getQueueFamilyIndices().transferFamily.value();
-
-	//Transfer ownership to transfer-queue
-	constexpr uint32_t barrierCount = 4;
-	{
-		VkBufferMemoryBarrier barriers[barrierCount] =
-		{
-			createVkBufferMemoryBarrier(m_pCameraBufferGraphics->getBuffer(),
-				VK_ACCESS_MEMORY_READ_BIT, 0, graphicsQueueFamilyIndex, transferQueueFamilyIndex, 0, VK_WHOLE_SIZE),
-			createVkBufferMemoryBarrier(m_pLightBufferGraphics->getBuffer(),
-				VK_ACCESS_MEMORY_READ_BIT, 0, graphicsQueueFamilyIndex, transferQueueFamilyIndex, 0, VK_WHOLE_SIZE),
-
-			createVkBufferMemoryBarrier(m_pCameraBufferCompute->getBuffer(),
-				VK_ACCESS_MEMORY_READ_BIT, 0, computeQueueFamilyIndex, transferQueueFamilyIndex, 0, VK_WHOLE_SIZE),
-			createVkBufferMemoryBarrier(m_pLightBufferCompute->getBuffer(),
-				VK_ACCESS_MEMORY_READ_BIT, 0, computeQueueFamilyIndex, transferQueueFamilyIndex, 0, VK_WHOLE_SIZE)
-		};
-
-		m_ppGraphicsCommandBuffers[m_CurrentFrame]->bufferMemoryBarrier(VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 2, barriers);
-		m_ppComputeCommandBuffers[m_CurrentFrame]->bufferMemoryBarrier(VK_PIPELINE_STAGE_RAY_TRACING_SHADER_BIT_NV, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 2, &barriers[2]);
-
-		for (uint32_t i = 0; i < barrierCount; i++)
-		{
-			barriers[i].srcAccessMask = 0;
-			barriers[i].dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-		}
-		m_ppTransferCommandBuffers[m_CurrentFrame]->bufferMemoryBarrier(VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, barrierCount, barriers);
-	}
-
 	// Update camera buffers
 	m_CameraBuffer.LastProjection	= m_CameraBuffer.Projection;
 	m_CameraBuffer.LastView			= m_CameraBuffer.View;
@@ -1018,111 +1148,73 @@ void RenderingHandlerVK::updateBuffers(SceneVK* pScene, const Camera& camera, co
 	m_CameraBuffer.Position			= glm::vec4(camera.getPosition(), 1.0f);
 	m_CameraBuffer.Right			= glm::vec4(camera.getRightVec(), 0.0f);
 	m_CameraBuffer.Up				= glm::vec4(camera.getUpVec(), 0.0f);
-	m_ppTransferCommandBuffers[m_CurrentFrame]->updateBuffer(m_pCameraBufferGraphics, 0, (const void*)&m_CameraBuffer, sizeof(CameraBuffer));
-	m_ppTransferCommandBuffers[m_CurrentFrame]->updateBuffer(m_pCameraBufferCompute, 0, (const void*)&m_CameraBuffer, sizeof(CameraBuffer));
+
+	//The fences of this frame have been waited on, so neither queue reads this slice anymore
+	uint8_t* pFrameSlice = m_pFrameUniformMemory + getCameraBufferOffset();
+	memcpy(pFrameSlice, &m_CameraBuffer, sizeof(CameraBuffer));
 
 	const uint32_t lightBufferSize = sizeof(PointLight) * lightSetup.getPointLightCount();
-	m_ppTransferCommandBuffers[m_CurrentFrame]->updateBuffer(m_pLightBufferGraphics, 0, (const void*)lightSetup.getPointLights(), lightBufferSize);
-	m_ppTransferCommandBuffers[m_CurrentFrame]->updateBuffer(m_pLightBufferCompute, 0, (const void*)lightSetup.getPointLights(), lightBufferSize);
+	memcpy(pFrameSlice + m_LightBufferOffset, lightSetup.getPointLights(), lightBufferSize);
 
-	pScene->copySceneData(m_ppTransferCommandBuffers[m_CurrentFrame]);
+	//The scene data is copied at the start of the geometry pass. The previous frames have to be done reading it, the compute queue
+	//is included since the last graphics submission waited for it
+	CommandBufferVK* pCommandBuffer = m_ppGraphicsCommandBuffers[m_CurrentFrame];
 
-	//Transfer back from transfer queue
-	{
-		VkBufferMemoryBarrier barriers[barrierCount] =
-		{
-			createVkBufferMemoryBarrier(m_pCameraBufferGraphics->getBuffer(),
-				VK_ACCESS_TRANSFER_WRITE_BIT, 0, transferQueueFamilyIndex, graphicsQueueFamilyIndex, 0, VK_WHOLE_SIZE),
-			createVkBufferMemoryBarrier(m_pLightBufferGraphics->getBuffer(),
-				VK_ACCESS_TRANSFER_WRITE_BIT, 0, transferQueueFamilyIndex, graphicsQueueFamilyIndex, 0, VK_WHOLE_SIZE),
-
-			createVkBufferMemoryBarrier(m_pCameraBufferCompute->getBuffer(),
-				VK_ACCESS_TRANSFER_WRITE_BIT, 0, transferQueueFamilyIndex, computeQueueFamilyIndex, 0, VK_WHOLE_SIZE),
-			createVkBufferMemoryBarrier(m_pLightBufferCompute->getBuffer(),
-				VK_ACCESS_TRANSFER_WRITE_BIT, 0, transferQueueFamilyIndex, computeQueueFamilyIndex, 0, VK_WHOLE_SIZE)
-		};
-		m_ppTransferCommandBuffers[m_CurrentFrame]->bufferMemoryBarrier(VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, barrierCount, barriers);
+	VkMemoryBarrier memoryBarrier = {};
+	memoryBarrier.sType			= VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	memoryBarrier.pNext			= nullptr;
+	memoryBarrier.srcAccessMask = 0;
+	memoryBarrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	pCommandBuffer->pipelineBarrier(VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
 
-		for (uint32_t i = 0; i < barrierCount; i++)
-		{
-			barriers[i].srcAccessMask = 0;
-			barriers[i].dstAccessMask = VK_ACCESS_MEMORY_READ_BIT;
-		}
-		m_ppGraphicsCommandBuffers[m_CurrentFrame]->bufferMemoryBarrier(VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 2, barriers);
-		m_ppComputeCommandBuffers[m_CurrentFrame]->bufferMemoryBarrier(VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_RAY_TRACING_SHADER_BIT_NV, 2, &barriers[2]);
-	}
+	pScene->copySceneData(pCommandBuffer);
+
+	memoryBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	memoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+	pCommandBuffer->pipelineBarrier(VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
 }
 
 bool RenderingHandlerVK::createBuffers()
 {
-	// Create CameraBuffers
-	BufferParams cameraBufferParams = {};
-	cameraBufferParams.Usage			= VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT;
-	cameraBufferParams.SizeInBytes		= sizeof(CameraBuffer);
-	cameraBufferParams.MemoryProperty	= VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
-	cameraBufferParams.IsExclusive		= true;
-
-	m_pCameraBufferGraphics = DBG_NEW BufferVK(m_pGraphicsContext->getDevice());
-	if (!m_pCameraBufferGraphics->init(cameraBufferParams))
-	{
-		LOG("Failed to create CameraBuffer for Graphics");
-		return false;
-	}
-	else
-	{
-		m_pCameraBufferGraphics->setName("CameraBuffer Graphics");
-	}
-
-	m_pCameraBufferCompute = DBG_NEW BufferVK(m_pGraphicsContext->getDevice());
-	if (!m_pCameraBufferCompute->init(cameraBufferParams))
+	//One slice per frame in flight with the camera followed by the lights, both have to start at a valid dynamic offset
+	const VkDeviceSize alignment = m_pGraphicsContext->getDevice()->getDeviceLimits().minUniformBufferOffsetAlignment;
+	m_LightBufferOffset		= uint32_t((CAMERA_BUFFER_SIZE + alignment - 1) & ~(alignment - 1));
+	m_FrameUniformSliceSize = uint32_t((m_LightBufferOffset + LIGHT_BUFFER_SIZE + alignment - 1) & ~(alignment - 1));
+
+	BufferParams frameUniformBufferParams = {};
+	frameUniformBufferParams.Usage			= VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT;
+	frameUniformBufferParams.SizeInBytes	= VkDeviceSize(m_FrameUniformSliceSize) * MAX_FRAMES_IN_FLIGHT;
+	frameUniformBufferParams.MemoryProperty	= VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+	//Read by the graphics and the compute queue, concurrent sharing saves the ownership transfers
+	frameUniformBufferParams.IsExclusive	= false;
+	frameUniformBufferParams.Category		= EMemoryCategory::UNIFORM_BUFFERS;
+
+	m_pFrameUniformBuffer = DBG_NEW BufferVK(m_pGraphicsContext->getDevice());
+	if (!m_pFrameUniformBuffer->init(frameUniformBufferParams))
 	{
-		LOG("Failed to create CameraBuffer for Compute");
+		LOG("Failed to create FrameUniformBuffer");
 		return false;
 	}
 	else
 	{
-		m_pCameraBufferCompute->setName("CameraBuffer Compute");
+		m_pFrameUniformBuffer->setName("FrameUniformBuffer");
 	}
 
-	// Create LightBuffers
-	BufferParams lightBufferParams = {};
-	lightBufferParams.Usage				= VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT;
-	lightBufferParams.SizeInBytes		= sizeof(PointLight) * MAX_POINTLIGHTS;
-	lightBufferParams.MemoryProperty	= VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
-	lightBufferParams.IsExclusive		= true;
-
-	m_pLightBufferGraphics = DBG_NEW BufferVK(m_pGraphicsContext->getDevice());
-	if (!m_pLightBufferGraphics->init(lightBufferParams))
-	{
-		LOG("Failed to create LightBuffer for Graphics");
-		return false;
-	}
-	else
-	{
-		m_pLightBufferGraphics->setName("LightBuffer Graphics");
-	}
-
-	m_pLightBufferCompute = DBG_NEW BufferVK(m_pGraphicsContext->getDevice());
-	if (!m_pLightBufferCompute->init(lightBufferParams))
-	{
-		LOG("Failed to create LightBuffer for Compute");
-		return false;
-	}
-	else
-	{
-		m_pLightBufferCompute->setName("LightBuffer Compute");
-	}
+	m_pFrameUniformBuffer->map((void**)&m_pFrameUniformMemory);
+	memset(m_pFrameUniformMemory, 0, size_t(frameUniformBufferParams.SizeInBytes));
 
 	return true;
 }
 
 bool RenderingHandlerVK::createRayTracingRenderImages(uint32_t width, uint32_t height)
 {
-	SAFEDELETE(m_pRadianceImage);
-	SAFEDELETE(m_pRadianceImageView);
+	//The frames in flight still use the old images
+	DeletionQueueVK* pDeletionQueue = m_pGraphicsContext->getDevice()->getDeletionQueue();
+	pDeletionQueue->destroy(m_pRadianceImageView);
+	pDeletionQueue->destroy(m_pRadianceImage);
 
-	SAFEDELETE(m_pGlossyImage);
-	SAFEDELETE(m_pGlossyImageView);
+	pDeletionQueue->destroy(m_pGlossyImageView);
+	pDeletionQueue->destroy(m_pGlossyImage);
 
 	ImageParams imageParams = {};
 	imageParams.Type = VK_IMAGE_TYPE_2D;
@@ -1135,6 +1227,7 @@ bool RenderingHandlerVK::createRayTracingRenderImages(uint32_t width, uint32_t h
 	imageParams.Samples = VK_SAMPLE_COUNT_1_BIT;
 	imageParams.Usage = VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
 	imageParams.MemoryProperty = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+	imageParams.Category = EMemoryCategory::RENDER_TARGETS;
 
 	m_pRadianceImage = DBG_NEW ImageVK(m_pGraphicsContext->getDevice());
 	m_pRadianceImage->init(imageParams);
@@ -1156,17 +1249,14 @@ bool RenderingHandlerVK::createRayTracingRenderImages(uint32_t width, uint32_t h
 	m_pGlossyImageView = DBG_NEW ImageViewVK(m_pGraphicsContext->getDevice(), m_pGlossyImage);
 	m_pGlossyImageView->init(imageViewParams);
 
-	CommandBufferVK* pTempCommandBuffer = m_ppComputeCommandPools[0]->allocateCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY);
-	pTempCommandBuffer->reset(true);
-	pTempCommandBuffer->begin(nullptr, VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
-	pTempCommandBuffer->transitionImageLayout(m_pRadianceImage, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, 0, 1, 0, 1);
-	pTempCommandBuffer->transitionImageLayout(m_pGlossyImage, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, 0, 1, 0, 1);
-	pTempCommandBuffer->end();
-
-	m_pGraphicsContext->getDevice()->executeCompute(pTempCommandBuffer, nullptr, nullptr, 0, nullptr, 0);
-	m_pGraphicsContext->getDevice()->wait();
+	//This is called while frames are in flight, so the transitions go through the copy handler instead of the pools of the frames
+	CopyHandlerVK* pCopyHandler = m_pGraphicsContext->getDevice()->getCopyHandler();
+	pCopyHandler->beginBatch();
+	pCopyHandler->transitionImageLayout(m_pRadianceImage, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, 0, 1, 0, 1);
+	pCopyHandler->transitionImageLayout(m_pGlossyImage, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, 0, 1, 0, 1);
 
-	m_ppComputeCommandPools[0]->freeCommandBuffer(&pTempCommandBuffer);
+	//The ray tracing on the compute queue writes the images in the next frame
+	pCopyHandler->wait(pCopyHandler->endBatch());
 
 	return true;
 }
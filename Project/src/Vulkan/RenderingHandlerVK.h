@@ -1,6 +1,8 @@
 #pragma once
+#include "Common/IRenderer.h"
 #include "Common/RenderingHandler.hpp"
 #include "Core/Camera.h"
+#include "Core/PointLight.h"
 
 #include "Vulkan/ImguiVK.h"
 #include "Vulkan/VulkanCommon.h"
@@ -25,6 +27,9 @@ class RenderPassVK;
 class SceneVK;
 class SkyboxRendererVK;
 
+#define CAMERA_BUFFER_SIZE	sizeof(CameraBuffer)
+#define LIGHT_BUFFER_SIZE	(sizeof(PointLight) * MAX_POINTLIGHTS)
+
 class RenderingHandlerVK : public RenderingHandler
 {
 public:
@@ -41,6 +46,8 @@ public:
 
     virtual void drawProfilerUI() override;
 
+	virtual FrameAllocations getFrameAllocations() const override { return m_FrameAllocations; }
+
     virtual void setImguiRenderer(IImgui* pImGui) override                                  { m_pImGuiRenderer = reinterpret_cast<ImguiVK*>(pImGui); }
     virtual void setMeshRenderer(IRenderer* pMeshRenderer) override                         { m_pMeshRenderer = reinterpret_cast<MeshRendererVK*>(pMeshRenderer); }
 	virtual void setRayTracer(IRenderer* pRayTracer) override				                { m_pRayTracer = reinterpret_cast<RayTracingRendererVK*>(pRayTracer); }
@@ -61,10 +68,9 @@ public:
     FORCEINLINE RenderPassVK*			getShadowMapRenderPass() const			{ return m_pShadowMapRenderPass; }
     FORCEINLINE RenderPassVK*           getBackBufferRenderPass() const         { return m_pBackBufferRenderPass; }
     FORCEINLINE RenderPassVK*           getParticleRenderPass() const           { return m_pParticleRenderPass; }
-    FORCEINLINE BufferVK*               getCameraBufferCompute() const          { return m_pCameraBufferCompute; }
-    FORCEINLINE BufferVK*               getCameraBufferGraphics() const         { return m_pCameraBufferGraphics; }
-    FORCEINLINE BufferVK*               getLightBufferCompute() const           { return m_pLightBufferCompute; }
-    FORCEINLINE BufferVK*               getLightBufferGraphics() const          { return m_pLightBufferGraphics; }
+    FORCEINLINE BufferVK*               getFrameUniformBuffer() const           { return m_pFrameUniformBuffer; }
+    FORCEINLINE uint32_t                getCameraBufferOffset() const           { return m_CurrentFrame * m_FrameUniformSliceSize; }
+    FORCEINLINE uint32_t                getLightBufferOffset() const            { return m_CurrentFrame * m_FrameUniformSliceSize + m_LightBufferOffset; }
     FORCEINLINE FrameBufferVK*          getCurrentBackBuffer() const            { return m_ppBackbuffers[m_BackBufferIndex]; }
     FORCEINLINE FrameBufferVK*          getCurrentBackBufferWithDepth() const   { return m_ppBackBuffersWithDepth[m_BackBufferIndex]; }
     FORCEINLINE CommandBufferVK*        getCurrentGraphicsCommandBuffer() const { return m_ppGraphicsCommandBuffers[m_CurrentFrame]; }
@@ -99,17 +105,11 @@ private:
 	VkSemaphore     m_pImageAvailableSemaphores[MAX_FRAMES_IN_FLIGHT];
     VkSemaphore     m_pRenderFinishedSemaphores[MAX_FRAMES_IN_FLIGHT];
     VkSemaphore     m_ComputeFinishedGraphicsSemaphore;
-    VkSemaphore     m_ComputeFinishedTransferSemaphore;
     VkSemaphore     m_GeometryFinishedSemaphore;
-    VkSemaphore     m_TransferStartSemaphore;
-    VkSemaphore     m_TransferFinishedGraphicsSemaphore;
-    VkSemaphore     m_TransferFinishedComputeSemaphore;
 
     CommandPoolVK*      m_ppGraphicsCommandPools[MAX_FRAMES_IN_FLIGHT];
 	CommandBufferVK*    m_ppGraphicsCommandBuffers[MAX_FRAMES_IN_FLIGHT];
     CommandBufferVK*    m_ppGraphicsCommandBuffers2[MAX_FRAMES_IN_FLIGHT];
-	CommandPoolVK*      m_ppTransferCommandPools[MAX_FRAMES_IN_FLIGHT];
-	CommandBufferVK*    m_ppTransferCommandBuffers[MAX_FRAMES_IN_FLIGHT];
     CommandPoolVK*      m_ppComputeCommandPools[MAX_FRAMES_IN_FLIGHT];
     CommandBufferVK*    m_ppComputeCommandBuffers[MAX_FRAMES_IN_FLIGHT];
     CommandPoolVK*      m_ppCommandPoolsSecondary[MAX_FRAMES_IN_FLIGHT];
@@ -131,15 +131,19 @@ private:
     VkViewport  m_Viewport;
 	VkRect2D    m_ScissorRect;
 
-    BufferVK*   m_pCameraBufferGraphics;
-    BufferVK*   m_pCameraBufferCompute;
-    BufferVK*   m_pLightBufferGraphics;
-    BufferVK*   m_pLightBufferCompute;
+    //Camera and lights for every frame in flight, written by the CPU and bound with dynamic offsets
+    BufferVK*   m_pFrameUniformBuffer;
+    uint8_t*    m_pFrameUniformMemory;
+    uint32_t    m_FrameUniformSliceSize;
+    uint32_t    m_LightBufferOffset;
     GBufferVK*  m_pGBuffer;
 
 	//Render Results
 	uint32_t m_RayTracingResolutionDenominator;
 
+	//Heap allocations made while the last frame was recorded, only counted when TRACK_ALLOCATIONS is set
+	FrameAllocations m_FrameAllocations;
+
 	union
 	{
 		struct
@@ -1,10 +1,16 @@
 #include "SceneVK.h"
 
+#include "Core/CookedScene.h"
 #include "Core/Material.h"
+#include "Core/VertexFormat.h"
 
 #include "Vulkan/BufferVK.h"
+#include "Vulkan/CopyHandlerVK.h"
+#include "Vulkan/DeletionQueueVK.h"
 #include "Vulkan/DescriptorPoolVK.h"
 #include "Vulkan/DeviceVK.h"
+#include "Vulkan/DeviceAllocatorVK.h"
+#include "Vulkan/GeometryBufferVK.h"
 #include "Vulkan/GraphicsContextVK.h"
 #include "Vulkan/MeshVK.h"
 #include "Vulkan/PipelineLayoutVK.h"
@@ -17,8 +23,8 @@
 
 #include "Core/TaskDispatcher.h"
 
+#include <chrono>
 #include <algorithm>
-#include <tinyobjloader/tiny_obj_loader.h>
 #include <imgui/imgui.h>
 
 #ifdef max
@@ -27,15 +33,9 @@
 
 SceneVK::SceneVK(IGraphicsContext* pContext, const RenderingHandlerVK* pRenderingHandler) :
 	m_pContext(reinterpret_cast<GraphicsContextVK*>(pContext)),
-	m_pCameraBuffer(pRenderingHandler->getCameraBufferGraphics()),
+	m_pCameraBuffer(pRenderingHandler->getFrameUniformBuffer()),
 	m_pScratchBuffer(nullptr),
 	m_pInstanceBuffer(nullptr),
-	m_pGarbageScratchBuffer(nullptr),
-	m_TotalNumberOfVertices(0),
-	m_TotalNumberOfIndices(0),
-	m_pGarbageInstanceBuffer(nullptr),
-	m_pCombinedVertexBuffer(nullptr),
-	m_pCombinedIndexBuffer(nullptr),
 	m_pMeshIndexBuffer(nullptr),
 	m_NumBottomLevelAccelerationStructures(0),
 	m_pTempCommandPool(nullptr),
@@ -51,9 +51,10 @@ SceneVK::SceneVK(IGraphicsContext* pContext, const RenderingHandlerVK* pRenderin
 	m_pMaterialParametersBuffer(nullptr),
 	m_pTransformsBufferGraphics(nullptr),
 	m_pTransformsBufferCompute(nullptr),
-	m_pGarbageTransformsBufferGraphics(nullptr),
-	m_pGarbageTransformsBufferCompute(nullptr),
 	m_DebugParametersDirty(false),
+	m_MaterialsUsePlaceholders(false),
+	m_TransformsBufferReplaced(false),
+	m_GeometryLayoutVersion(0),
 	m_pProfiler(nullptr),
 	m_RayTracingEnabled(pContext->isRayTracingEnabled()),
 	m_pDescriptorPool(nullptr),
@@ -80,10 +81,6 @@ SceneVK::~SceneVK()
 	SAFEDELETE(m_pTempCommandPool);
 	SAFEDELETE(m_pScratchBuffer);
 	SAFEDELETE(m_pInstanceBuffer);
-	SAFEDELETE(m_pGarbageScratchBuffer);
-	SAFEDELETE(m_pGarbageInstanceBuffer);
-	SAFEDELETE(m_pCombinedVertexBuffer);
-	SAFEDELETE(m_pCombinedIndexBuffer);
 	SAFEDELETE(m_pMeshIndexBuffer);
 	SAFEDELETE(m_pDefaultTexture);
 	SAFEDELETE(m_pDefaultNormal);
@@ -93,17 +90,15 @@ SceneVK::~SceneVK()
 
 	SAFEDELETE(m_pTransformsBufferGraphics);
 	SAFEDELETE(m_pTransformsBufferCompute);
-	SAFEDELETE(m_pGarbageTransformsBufferGraphics);
-	SAFEDELETE(m_pGarbageTransformsBufferCompute);
 
 	for (auto& bottomLevelAccelerationStructurePerMesh : m_NewBottomLevelAccelerationStructures)
 	{
 		//All these BLASs are the same on GPU side, so we can just grab the first one and free it
 		auto newBottomLevelAccelerationStructure = bottomLevelAccelerationStructurePerMesh.second.begin();
-		if (newBottomLevelAccelerationStructure->second.Memory != VK_NULL_HANDLE)
+		if (newBottomLevelAccelerationStructure->second.Allocation.Memory != VK_NULL_HANDLE)
 		{
-			vkFreeMemory(m_pDevice->getDevice(), newBottomLevelAccelerationStructure->second.Memory, nullptr);
 			m_pDevice->vkDestroyAccelerationStructureNV(m_pDevice->getDevice(), newBottomLevelAccelerationStructure->second.AccelerationStructure, nullptr);
+			m_pDevice->getAllocator()->deallocate(newBottomLevelAccelerationStructure->second.Allocation);
 		}
 	}
 	m_NewBottomLevelAccelerationStructures.clear();
@@ -112,27 +107,23 @@ SceneVK::~SceneVK()
 	{
 		//All these BLASs are the same on GPU side, so we can just grab the first one and free it
 		auto finalizedBottomLevelAccelerationStructure = bottomLevelAccelerationStructurePerMesh.second.begin();
-		if (finalizedBottomLevelAccelerationStructure->second.Memory != VK_NULL_HANDLE)
+		if (finalizedBottomLevelAccelerationStructure->second.Allocation.Memory != VK_NULL_HANDLE)
 		{
-			vkFreeMemory(m_pDevice->getDevice(), finalizedBottomLevelAccelerationStructure->second.Memory, nullptr);
 			m_pDevice->vkDestroyAccelerationStructureNV(m_pDevice->getDevice(), finalizedBottomLevelAccelerationStructure->second.AccelerationStructure, nullptr);
+			m_pDevice->getAllocator()->deallocate(finalizedBottomLevelAccelerationStructure->second.Allocation);
 		}
 	}
 	m_FinalizedBottomLevelAccelerationStructures.clear();
 
 
-	if (m_TopLevelAccelerationStructure.Memory != VK_NULL_HANDLE)
-	{
-		vkFreeMemory(m_pDevice->getDevice(), m_TopLevelAccelerationStructure.Memory, nullptr);
-		m_TopLevelAccelerationStructure.Memory = VK_NULL_HANDLE;
-	}
-
 	if (m_TopLevelAccelerationStructure.AccelerationStructure != VK_NULL_HANDLE)
 	{
 		m_pDevice->vkDestroyAccelerationStructureNV(m_pDevice->getDevice(), m_TopLevelAccelerationStructure.AccelerationStructure, nullptr);
 		m_TopLevelAccelerationStructure.AccelerationStructure = VK_NULL_HANDLE;
 	}
 
+	m_pDevice->getAllocator()->deallocate(m_TopLevelAccelerationStructure.Allocation);
+
 	m_TopLevelAccelerationStructure.Handle = VK_NULL_HANDLE;
 
 	for (auto pair : m_SceneTextures)
@@ -157,30 +148,72 @@ SceneVK::~SceneVK()
 
 bool SceneVK::loadFromFile(const std::string& dir, const std::string& fileName)
 {
-	tinyobj::attrib_t attributes;
-	std::vector<tinyobj::shape_t> shapes;
-	std::vector<tinyobj::material_t> materials;
-	std::string warn, err;
+	const std::chrono::high_resolution_clock::time_point startTime = std::chrono::high_resolution_clock::now();
+
+	//The OBJ is only parsed the first time, or when it has changed, after that the cooked file next to it is mapped
+	const std::string sourcePath = dir + fileName;
+	const std::string cookedPath = sourcePath + COOKED_SCENE_EXTENSION;
 
-	if (!tinyobj::LoadObj(&attributes, &shapes, &materials, &warn, &err, (dir + fileName).c_str(), dir.c_str(), true, false))
+	CookedScene cookedScene;
+	bool wasCooked = false;
+	if (!cookedScene.open(cookedPath, sourcePath))
 	{
-		LOG("Failed to load scene '%s'. Warning: %s Error: %s", (dir + fileName).c_str(), warn.c_str(), err.c_str());
-		return false;
+		std::vector<uint8_t> fileData;
+		if (!CookedScene::cookFromOBJ(dir, fileName, fileData))
+		{
+			return false;
+		}
+
+		wasCooked = true;
+		if (!CookedScene::writeToFile(cookedPath, fileData) || !cookedScene.open(cookedPath, sourcePath))
+		{
+			LOG("--- SceneVK: Could not store '%s', the scene is cooked again next time", cookedPath.c_str());
+			if (!cookedScene.openFromMemory(std::move(fileData), sourcePath))
+			{
+				return false;
+			}
+		}
 	}
 
-	m_SceneMeshes.resize(shapes.size());
-	m_SceneMaterials.resize(materials.size() + 1);
+	const uint32_t meshCount		= cookedScene.getMeshCount();
+	const uint32_t materialCount	= cookedScene.getMaterialCount();
+	const uint32_t textureCount		= cookedScene.getTextureCount();
 
-	for (uint32_t i = 0; i < shapes.size(); i++)
+	m_SceneMeshes.resize(meshCount);
+	m_SceneMaterials.resize(materialCount + 1);
+
+	for (uint32_t i = 0; i < meshCount; i++)
 	{
 		m_SceneMeshes[i] = nullptr;
 	}
 
-	for (uint32_t i = 0; i < materials.size() + 1; i++)
+	for (uint32_t i = 0; i < materialCount + 1; i++)
 	{
 		m_SceneMaterials[i] = nullptr;
 	}
 
+	//A scene streamed in on the background pool keeps its texture loads there as well
+	const ETaskPriority loadPriority = TaskDispatcher::getCurrentPriority();
+
+	//The texture table of the cooked file has no duplicates, so every entry is loaded once
+	std::vector<ITexture2D*> textures(textureCount);
+	for (uint32_t t = 0; t < textureCount; t++)
+	{
+		std::string filename = dir + cookedScene.getTexturePath(t);
+		if (m_SceneTextures.count(filename) == 0)
+		{
+			ITexture2D* pTexture = m_pContext->createTexture2D();
+			m_SceneTextures[filename] = pTexture;
+
+			TaskDispatcher::execute(Task("Load Texture", [=]
+				{
+					pTexture->initFromFile(filename, ETextureFormat::FORMAT_R8G8B8A8_UNORM);
+				}), loadPriority);
+		}
+
+		textures[t] = m_SceneTextures[filename];
+	}
+
 	SamplerParams samplerParams = {};
 	samplerParams.MinFilter = VK_FILTER_LINEAR;
 	samplerParams.MagFilter = VK_FILTER_LINEAR;
@@ -195,89 +228,29 @@ bool SceneVK::loadFromFile(const std::string& dir, const std::string& fileName)
 	pDefaultMaterial->createSampler(m_pContext, samplerParams);
 	m_SceneMaterials[0] = pDefaultMaterial;
 
-	for (uint32_t m = 1; m < materials.size() + 1; m++)
+	for (uint32_t m = 1; m < materialCount + 1; m++)
 	{
-		tinyobj::material_t& material = materials[m - 1];
+		const CookedMaterial& material = cookedScene.getMaterial(m - 1);
 
 		Material* pMaterial = DBG_NEW Material();
-		if (material.diffuse_texname.length() > 0)
+		if (material.AlbedoMap != COOKED_NO_TEXTURE)
 		{
-			std::string filename = dir + material.diffuse_texname;
-			if (m_SceneTextures.count(filename) == 0)
-			{
-				ITexture2D* pAlbedoMap = m_pContext->createTexture2D();
-				m_SceneTextures[filename] = pAlbedoMap;
-
-				TaskDispatcher::execute([=]
-					{
-						pAlbedoMap->initFromFile(filename, ETextureFormat::FORMAT_R8G8B8A8_UNORM);
-					});
-				pMaterial->setAlbedoMap(pAlbedoMap);
-			}
-			else
-			{
-				pMaterial->setAlbedoMap(m_SceneTextures[filename]);
-			}
+			pMaterial->setAlbedoMap(textures[material.AlbedoMap]);
 		}
 
-		if (material.bump_texname.length() > 0)
+		if (material.NormalMap != COOKED_NO_TEXTURE)
 		{
-			std::string filename = dir + material.bump_texname;
-			if (m_SceneTextures.count(filename) == 0)
-			{
-				ITexture2D* pNormalMap = m_pContext->createTexture2D();
-				m_SceneTextures[filename] = pNormalMap;
-
-				TaskDispatcher::execute([=]
-					{
-						pNormalMap->initFromFile(filename, ETextureFormat::FORMAT_R8G8B8A8_UNORM);
-					});
-				pMaterial->setNormalMap(pNormalMap);
-			}
-			else
-			{
-				pMaterial->setNormalMap(m_SceneTextures[filename]);
-			}
+			pMaterial->setNormalMap(textures[material.NormalMap]);
 		}
 
-		if (material.ambient_texname.length() > 0)
+		if (material.MetallicMap != COOKED_NO_TEXTURE)
 		{
-			std::string filename = dir + material.ambient_texname;
-			if (m_SceneTextures.count(filename) == 0)
-			{
-				ITexture2D* pMetallicMap = m_pContext->createTexture2D();
-				m_SceneTextures[filename] = pMetallicMap;
-
-				TaskDispatcher::execute([=]
-					{
-						pMetallicMap->initFromFile(filename, ETextureFormat::FORMAT_R8G8B8A8_UNORM);
-					});
-				pMaterial->setMetallicMap(pMetallicMap);
-			}
-			else
-			{
-				pMaterial->setMetallicMap(m_SceneTextures[filename]);
-			}
+			pMaterial->setMetallicMap(textures[material.MetallicMap]);
 		}
 
-		if (material.specular_highlight_texname.length() > 0)
+		if (material.RoughnessMap != COOKED_NO_TEXTURE)
 		{
-			std::string filename = dir + material.specular_highlight_texname;
-			if (m_SceneTextures.count(filename) == 0)
-			{
-				ITexture2D* pRoughnessMap = m_pContext->createTexture2D();
-				m_SceneTextures[filename] = pRoughnessMap;
-
-				TaskDispatcher::execute([=]
-					{
-						pRoughnessMap->initFromFile(filename, ETextureFormat::FORMAT_R8G8B8A8_UNORM);
-					});
-				pMaterial->setRoughnessMap(pRoughnessMap);
-			}
-			else
-			{
-				pMaterial->setRoughnessMap(m_SceneTextures[filename]);
-			}
+			pMaterial->setRoughnessMap(textures[material.RoughnessMap]);
 		}
 
 		pMaterial->setAlbedo(glm::vec4(1.0f));
@@ -288,79 +261,34 @@ bool SceneVK::loadFromFile(const std::string& dir, const std::string& fileName)
 		m_SceneMaterials[m] = pMaterial;
 	}
 
-	glm::mat4 transform = glm::scale(glm::mat4(1.0f), glm::vec3(0.005f));
-	for (uint32_t s = 0; s < shapes.size(); s++)
+	//All mesh uploads go out in as few submissions as possible, the renderer skips the meshes until they have arrived. The
+	//data is copied into staging memory straight from the mapped file
+	CopyHandlerVK* pCopyHandler = m_pContext->getDevice()->getCopyHandler();
+	pCopyHandler->beginBatch();
+	for (uint32_t s = 0; s < meshCount; s++)
 	{
-		tinyobj::shape_t& shape = shapes[s];
-
-		std::vector<Vertex> vertices = {};
-		std::vector<uint32_t> indices = {};
-		std::unordered_map<Vertex, uint32_t> uniqueVertices = {};
-
-		for (const tinyobj::index_t& index : shape.mesh.indices)
-		{
-			Vertex vertex = {};
-
-			//Normals and texcoords are optional, while positions are required
-			ASSERT(index.vertex_index >= 0);
-
-			vertex.Position =
-			{
-				attributes.vertices[3 * (size_t)index.vertex_index + 0],
-				attributes.vertices[3 * (size_t)index.vertex_index + 1],
-				attributes.vertices[3 * (size_t)index.vertex_index + 2]
-			};
-
-			if (index.normal_index >= 0)
-			{
-				vertex.Normal =
-				{
-					attributes.normals[3 * (size_t)index.normal_index + 0],
-					attributes.normals[3 * (size_t)index.normal_index + 1],
-					attributes.normals[3 * (size_t)index.normal_index + 2]
-				};
-			}
-
-			if (index.texcoord_index >= 0)
-			{
-				vertex.TexCoord =
-				{
-					attributes.texcoords[2 * (size_t)index.texcoord_index + 0],
-					1.0f - attributes.texcoords[2 * (size_t)index.texcoord_index + 1]
-				};
-			}
-
-			if (uniqueVertices.count(vertex) == 0)
-			{
-				uniqueVertices[vertex] = static_cast<uint32_t>(vertices.size());
-				vertices.push_back(vertex);
-			}
-
-			indices.push_back(uniqueVertices[vertex]);
-		}
-
-		//Calculate tangents
-		for (uint32_t index = 0; index < indices.size(); index += 3)
-		{
-			Vertex& v0 = vertices[indices[(size_t)index + 0]];
-			Vertex& v1 = vertices[indices[(size_t)index + 1]];
-			Vertex& v2 = vertices[indices[(size_t)index + 2]];
-
-			v0.calculateTangent(v1, v2);
-			v1.calculateTangent(v2, v0);
-			v2.calculateTangent(v0, v1);
-		}
+		const CookedMesh& mesh = cookedScene.getMesh(s);
 
 		MeshVK* pMesh = reinterpret_cast<MeshVK*>(m_pContext->createMesh());
-		pMesh->initFromMemory(vertices.data(), sizeof(Vertex), uint32_t(vertices.size()), indices.data(), uint32_t(indices.size()));
-		m_SceneMeshes[s]  = pMesh;
+		pMesh->initFromMemory(cookedScene.getVertices(mesh), sizeof(GPUVertex), mesh.VertexCount, cookedScene.getIndices(mesh), mesh.IndexCount);
+		m_SceneMeshes[s] = pMesh;
+	}
 
-		uint32_t materialIndex = shape.mesh.material_ids[0] + 1;
-		Material* pMaterial = m_SceneMaterials[materialIndex];
+	pCopyHandler->endBatch();
 
-		submitGraphicsObject(pMesh, pMaterial, transform);
+	//Meshes are submitted in order so that the graphics object indices does not depend on the threads
+	glm::mat4 transform = glm::scale(glm::mat4(1.0f), glm::vec3(0.005f));
+	for (uint32_t s = 0; s < meshCount; s++)
+	{
+		Material* pMaterial = m_SceneMaterials[cookedScene.getMesh(s).MaterialIndex];
+		submitGraphicsObject(m_SceneMeshes[s], pMaterial, transform);
 	}
 
+	const size_t sizeInBytes = cookedScene.getSizeInBytes();
+	cookedScene.close();
+
+	std::chrono::duration<float, std::milli> loadTime = std::chrono::high_resolution_clock::now() - startTime;
+	LOG("--- SceneVK: Loaded '%s' (%s, %.2f MB) in %.2f ms using %u threads", sourcePath.c_str(), wasCooked ? "cooked from OBJ" : "cooked file", float(sizeInBytes) / (1024.0f * 1024.0f), loadTime.count(), TaskDispatcher::getThreadCount());
 	return true;
 }
 
@@ -453,24 +381,27 @@ void SceneVK::updateMaterials()
 {
 	if (m_RayTracingEnabled)
 	{
+		//Textures that are still streaming in are replaced by the defaults, updateDebugParameters calls this again once they have arrived
+		m_MaterialsUsePlaceholders = false;
+
 		for (uint32_t i = 0; i < MAX_NUM_UNIQUE_MATERIALS; i++)
 		{
 			if (i < m_Materials.size())
 			{
 				const Material* pMaterial = m_Materials[i];
 
-				const Texture2DVK* pAlbedoMap = reinterpret_cast<const Texture2DVK*>(pMaterial->getAlbedoMap());
-				const Texture2DVK* pNormalMap = reinterpret_cast<const Texture2DVK*>(pMaterial->getNormalMap());
-				const Texture2DVK* pAOMap = reinterpret_cast<const Texture2DVK*>(pMaterial->getAmbientOcclusionMap());
-				const Texture2DVK* pMetallicMap = reinterpret_cast<const Texture2DVK*>(pMaterial->getMetallicMap());
-				const Texture2DVK* pRoughnessMap = reinterpret_cast<const Texture2DVK*>(pMaterial->getRoughnessMap());
+				const Texture2DVK* pAlbedoMap = getResidentTexture(pMaterial->getAlbedoMap(), m_pDefaultTexture, m_MaterialsUsePlaceholders);
+				const Texture2DVK* pNormalMap = getResidentTexture(pMaterial->getNormalMap(), m_pDefaultNormal, m_MaterialsUsePlaceholders);
+				const Texture2DVK* pAOMap = getResidentTexture(pMaterial->getAmbientOcclusionMap(), m_pDefaultTexture, m_MaterialsUsePlaceholders);
+				const Texture2DVK* pMetallicMap = getResidentTexture(pMaterial->getMetallicMap(), m_pDefaultTexture, m_MaterialsUsePlaceholders);
+				const Texture2DVK* pRoughnessMap = getResidentTexture(pMaterial->getRoughnessMap(), m_pDefaultTexture, m_MaterialsUsePlaceholders);
 				const SamplerVK* pSampler = reinterpret_cast<const SamplerVK*>(pMaterial->getSampler());
 
-				m_AlbedoMaps[i] = pAlbedoMap != nullptr ? pAlbedoMap->getImageView() : m_pDefaultTexture->getImageView();
-				m_NormalMaps[i] = pNormalMap != nullptr ? pNormalMap->getImageView() : m_pDefaultNormal->getImageView();
-				m_AOMaps[i] = pAOMap != nullptr ? pAOMap->getImageView() : m_pDefaultTexture->getImageView();
-				m_MetallicMaps[i] = pMetallicMap != nullptr ? pMetallicMap->getImageView() : m_pDefaultTexture->getImageView();
-				m_RoughnessMaps[i] = pRoughnessMap != nullptr ? pRoughnessMap->getImageView() : m_pDefaultTexture->getImageView();
+				m_AlbedoMaps[i] = pAlbedoMap->getImageView();
+				m_NormalMaps[i] = pNormalMap->getImageView();
+				m_AOMaps[i] = pAOMap->getImageView();
+				m_MetallicMaps[i] = pMetallicMap->getImageView();
+				m_RoughnessMaps[i] = pRoughnessMap->getImageView();
 				m_Samplers[i] = pSampler != nullptr ? pSampler : m_pDefaultSampler;
 				m_MaterialParameters[i] =
 				{
@@ -547,7 +478,30 @@ void SceneVK::updateMaterials()
 
 void SceneVK::updateCamera(const Camera& camera)
 {
-	m_Camera = camera;
+	m_PendingCamera = camera;
+}
+
+void SceneVK::commitFrameState()
+{
+	m_Camera		= m_PendingCamera;
+	m_LightSetup	= m_PendingLightSetup;
+
+	for (uint32_t index : m_PendingTransformIndices)
+	{
+		const glm::mat4& transform = m_PendingTransforms[index];
+		if (m_RayTracingEnabled)
+		{
+			m_GeometryInstances[index].Transform = glm::transpose(transform);
+		}
+
+		GraphicsObjectTransforms& transforms = m_SceneTransforms[index];
+		transforms.PrevTransform	= transforms.Transform;
+		transforms.Transform		= transform;
+
+		m_TransformIsPending[index] = 0;
+	}
+
+	m_PendingTransformIndices.clear();
 }
 
 uint32_t SceneVK::submitGraphicsObject(const IMesh* pMesh, const Material* pMaterial, const glm::mat4& transform, uint8_t customMask)
@@ -581,10 +535,10 @@ uint32_t SceneVK::submitGraphicsObject(const IMesh* pMesh, const Material* pMate
 
 				m_BottomLevelIsDirty = true;
 
+				//The acceleration structure is built from the vertices, so they have to be on the GPU
+				m_pDevice->getCopyHandler()->wait(pVulkanMesh->getUploadToken());
 				pBottomLevelAccelerationStructure = createBLAS(pVulkanMesh, pMaterial);
 				m_AllMeshes.push_back(pVulkanMesh);
-				m_TotalNumberOfVertices += static_cast<uint32_t>(pVulkanMesh->getVertexBuffer()->getSizeInBytes() / sizeof(Vertex));
-				m_TotalNumberOfIndices += static_cast<uint32_t>(pVulkanMesh->getIndexBuffer()->getSizeInBytes() / sizeof(uint32_t));
 			}
 			else if (finalizedBLASPerMesh->second.find(pMaterial) == finalizedBLASPerMesh->second.end())
 			{
@@ -649,22 +603,23 @@ uint32_t SceneVK::submitGraphicsObject(const IMesh* pMesh, const Material* pMate
 		registerMaterial(pMaterial);
 	}
 
-	m_GraphicsObjects.push_back({ pVulkanMesh, pMaterial, materialIndex });
+	m_GraphicsObjects.push_back({ pVulkanMesh, pMaterial, materialIndex, registerMeshPipeline(pVulkanMesh, pMaterial) });
 	m_SceneTransforms.push_back({ transform, transform });
+	m_PendingTransforms.push_back(transform);
+	m_TransformIsPending.push_back(0);
 
 	return uint32_t(m_GraphicsObjects.size()) - 1u;
 }
 
 void SceneVK::updateGraphicsObjectTransform(uint32_t index, const glm::mat4& transform)
 {
-	if (m_RayTracingEnabled)
+	//The renderer may still be reading the current transforms, so the new one waits until the next commit
+	m_PendingTransforms[index] = transform;
+	if (!m_TransformIsPending[index])
 	{
-		m_GeometryInstances[index].Transform = glm::transpose(transform);
+		m_TransformIsPending[index] = 1;
+		m_PendingTransformIndices.push_back(index);
 	}
-
-	GraphicsObjectTransforms& transforms = m_SceneTransforms[index];
-	transforms.PrevTransform	= transforms.Transform;
-	transforms.Transform		= transform;
 }
 
 void SceneVK::copySceneData(CommandBufferVK* pTransferBuffer)
@@ -687,139 +642,207 @@ void SceneVK::copySceneData(CommandBufferVK* pTransferBuffer)
 
 	if (m_MeshDataIsDirty)
 	{
-		uint32_t vertexBufferOffset = 0;
-		uint32_t indexBufferOffset = 0;
 		uint64_t meshIndexBufferOffset = 0;
 		uint32_t currentCustomInstanceIndexNV = 0;
 
+		//Instance ids are looked up per graphics object afterwards, instead of searching through every object for each BLAS
+		std::map<std::pair<const MeshVK*, const Material*>, uint32_t> customInstanceIndices;
+
+		//The meshes already live in the geometry buffer, so only their offsets are written
 		for (auto& pMesh : m_AllMeshes)
 		{
-			uint32_t numVertices = pMesh->getVertexCount();
-			uint32_t numIndices = pMesh->getIndexCount();
-
-			pTransferBuffer->copyBuffer(reinterpret_cast<BufferVK*>(pMesh->getVertexBuffer()), 0, m_pCombinedVertexBuffer, vertexBufferOffset * sizeof(Vertex), numVertices * sizeof(Vertex));
-			pTransferBuffer->copyBuffer(reinterpret_cast<BufferVK*>(pMesh->getIndexBuffer()), 0, m_pCombinedIndexBuffer, indexBufferOffset * sizeof(uint32_t), numIndices * sizeof(uint32_t));
-
 			for (auto& bottomLevelAccelerationStructure : m_FinalizedBottomLevelAccelerationStructures[pMesh])
 			{
-				for (uint32_t i = 0; i < m_GraphicsObjects.size(); i++)
-				{
-					GraphicsObjectVK& graphicsObject = m_GraphicsObjects[i];
-
-					if (graphicsObject.pMesh == pMesh && graphicsObject.pMaterial == bottomLevelAccelerationStructure.first)
-					{
-						m_GeometryInstances[i].InstanceId = currentCustomInstanceIndexNV;
-					}
-				}
+				customInstanceIndices[std::make_pair(pMesh, bottomLevelAccelerationStructure.first)] = currentCustomInstanceIndexNV;
 
-				uint32_t meshIndices[3] = { vertexBufferOffset, indexBufferOffset, bottomLevelAccelerationStructure.second.MaterialIndex };
+				uint32_t meshIndices[3] = { pMesh->getVertexOffset(), pMesh->getIndexOffset(), bottomLevelAccelerationStructure.second.MaterialIndex };
 				pTransferBuffer->updateBuffer(m_pMeshIndexBuffer, meshIndexBufferOffset * sizeof(uint32_t), meshIndices, 3 * sizeof(uint32_t));
 
 				meshIndexBufferOffset += 3;
 				currentCustomInstanceIndexNV++;
 			}
-
-			vertexBufferOffset	+= numVertices;
-			indexBufferOffset	+= numIndices;
 		}
 
+		TaskDispatcher::parallelFor(0, uint32_t(m_GraphicsObjects.size()), 1024, [&](uint32_t i)
+			{
+				const GraphicsObjectVK& graphicsObject = m_GraphicsObjects[i];
+
+				auto customInstanceIndex = customInstanceIndices.find(std::make_pair(graphicsObject.pMesh, graphicsObject.pMaterial));
+				if (customInstanceIndex != customInstanceIndices.end())
+				{
+					m_GeometryInstances[i].InstanceId = customInstanceIndex->second;
+				}
+			});
+
 		m_MeshDataIsDirty = false;
 	}
 }
 
 bool SceneVK::updateSceneData()
 {
-	if (m_pGarbageTransformsBufferGraphics || m_MaterialDataIsDirty)
+	//Meshes that the geometry buffer has moved get their offsets written again
+	const uint64_t geometryLayoutVersion = m_pDevice->getGeometryBuffer()->getLayoutVersion();
+	if (m_GeometryLayoutVersion != geometryLayoutVersion)
 	{
-		m_pDevice->wait();
-
-		for (auto& instance : m_MeshTable)
+		m_GeometryLayoutVersion = geometryLayoutVersion;
+		if (m_RayTracingEnabled && m_pMeshIndexBuffer)
 		{
-			instance.second.pDescriptorSets->writeStorageBufferDescriptor(m_pMaterialParametersBuffer, MATERIAL_PARAMETERS_BINDING);
-			instance.second.pDescriptorSets->writeStorageBufferDescriptor(m_pTransformsBufferGraphics, INSTANCE_TRANSFORMS_BINDING);
+			m_MeshDataIsDirty = true;
 		}
+	}
 
-		cleanGarbage();
+	//Sets are only written here, outside of the recording, so the geometry pass can look them up without a lock
+	writeMeshPipelines(m_TransformsBufferReplaced);
 
+	//The mesh index buffer is recreated when meshes are added, so the ray tracing set has to be written again
+	if (m_TransformsBufferReplaced || m_MaterialDataIsDirty || m_MeshDataIsDirty)
+	{
+		m_TransformsBufferReplaced = false;
 		return true;
 	}
 
 	return false;
 }
 
-DescriptorSetVK* SceneVK::getDescriptorSetFromMeshAndMaterial(const MeshVK* pMesh, const Material* pMaterial)
+uint32_t SceneVK::registerMeshPipeline(const MeshVK* pMesh, const Material* pMaterial)
 {
+	if (pMesh == nullptr || pMaterial == nullptr)
+	{
+		return 0;
+	}
+
 	MeshFilter filter = {};
 	filter.pMesh		= pMesh;
 	filter.pMaterial	= pMaterial;
 
-	if (m_MeshTable.count(filter) == 0)
+	auto meshPipeline = m_MeshTable.find(filter);
+	if (meshPipeline != m_MeshTable.end())
 	{
-		DescriptorSetVK* pDescriptorSet = m_pDescriptorPool->allocDescriptorSet(m_pGeometryDescriptorSetLayout);
-		pDescriptorSet->writeUniformBufferDescriptor(m_pCameraBuffer, CAMERA_BUFFER_BINDING);
+		return meshPipeline->second;
+	}
 
-		BufferVK* pVertBuffer = reinterpret_cast<BufferVK*>(pMesh->getVertexBuffer());
-		pDescriptorSet->writeStorageBufferDescriptor(pVertBuffer, VERTEX_BUFFER_BINDING);
+	//The descriptorset is written by the next updateSceneData, before any frame records the object
+	const uint32_t index = uint32_t(m_MeshPipelines.size());
+	MeshPipeline newMeshPipeline = {};
+	newMeshPipeline.pMesh		= pMesh;
+	newMeshPipeline.pMaterial	= pMaterial;
+	m_MeshPipelines.push_back(newMeshPipeline);
+	m_PendingMeshPipelines.push_back(index);
 
-		SamplerVK* pSampler = reinterpret_cast<SamplerVK*>(pMaterial->getSampler());
+	m_MeshTable.insert(std::make_pair(filter, index));
+	return index;
+}
 
-		Texture2DVK* pAlbedo = m_pDefaultTexture;
-		if (pMaterial->hasAlbedoMap())
+void SceneVK::writeMeshPipelines(bool rewriteAll)
+{
+	if (rewriteAll)
+	{
+		m_PendingMeshPipelines.clear();
+		for (uint32_t i = 0; i < uint32_t(m_MeshPipelines.size()); i++)
 		{
-			pAlbedo = reinterpret_cast<Texture2DVK*>(pMaterial->getAlbedoMap());
+			m_PendingMeshPipelines.push_back(i);
 		}
+	}
 
-		ImageViewVK* pAlbedoView = pAlbedo->getImageView();
-		pDescriptorSet->writeCombinedImageDescriptors(&pAlbedoView, &pSampler, 1, ALBEDO_MAP_BINDING);
-
-		Texture2DVK* pNormal = m_pDefaultNormal;
-		if (pMaterial->hasNormalMap())
+	//Pipelines that are written with placeholders stay pending until their textures are resident
+	DeletionQueueVK* pDeletionQueue = m_pDevice->getDeletionQueue();
+	uint32_t stillPending = 0;
+	for (uint32_t index : m_PendingMeshPipelines)
+	{
+		MeshPipeline& meshPipeline = m_MeshPipelines[index];
+		if (rewriteAll || !meshPipeline.pDescriptorSets || areMaterialTexturesResident(meshPipeline.pMaterial))
 		{
-			pNormal = reinterpret_cast<Texture2DVK*>(pMaterial->getNormalMap());
-		}
+			//The old descriptorset can still be used by the frames in flight, so a new one is written instead of updating it
+			if (meshPipeline.pDescriptorSets)
+			{
+				pDeletionQueue->deallocate(meshPipeline.pDescriptorSets);
+			}
 
-		ImageViewVK* pNormalView = pNormal->getImageView();
-		pDescriptorSet->writeCombinedImageDescriptors(&pNormalView, &pSampler, 1, NORMAL_MAP_BINDING);
+			meshPipeline.pDescriptorSets = createGeometryDescriptorSet(meshPipeline.pMesh, meshPipeline.pMaterial, meshPipeline.HasPlaceholders);
+		}
 
-		Texture2DVK* pAO = m_pDefaultTexture;
-		if (pMaterial->hasAmbientOcclusionMap())
+		if (meshPipeline.HasPlaceholders)
 		{
-			pAO = reinterpret_cast<Texture2DVK*>(pMaterial->getAmbientOcclusionMap());
+			m_PendingMeshPipelines[stillPending++] = index;
 		}
+	}
 
-		ImageViewVK* pAOView = pAO->getImageView();
-		pDescriptorSet->writeCombinedImageDescriptors(&pAOView, &pSampler, 1, AO_MAP_BINDING);
+	m_PendingMeshPipelines.resize(stillPending);
+}
 
-		Texture2DVK* pMetallic = m_pDefaultTexture;
-		if (pMaterial->hasMetallicMap())
-		{
-			pMetallic = reinterpret_cast<Texture2DVK*>(pMaterial->getMetallicMap());
-		}
+DescriptorSetVK* SceneVK::createGeometryDescriptorSet(const MeshVK* pMesh, const Material* pMaterial, bool& hasPlaceholders)
+{
+	hasPlaceholders = false;
 
-		ImageViewVK* pMetallicView = pMetallic->getImageView();
-		pDescriptorSet->writeCombinedImageDescriptors(&pMetallicView, &pSampler, 1, METALLIC_MAP_BINDING);
+	DescriptorSetVK* pDescriptorSet = m_pDescriptorPool->allocDescriptorSet(m_pGeometryDescriptorSetLayout);
+	pDescriptorSet->writeUniformBufferDynamicDescriptor(m_pCameraBuffer, CAMERA_BUFFER_BINDING, CAMERA_BUFFER_SIZE);
 
-		Texture2DVK* pRoughness = m_pDefaultTexture;
-		if (pMaterial->hasRoughnessMap())
-		{
-			pRoughness = reinterpret_cast<Texture2DVK*>(pMaterial->getRoughnessMap());
-		}
+	BufferVK* pVertBuffer = reinterpret_cast<BufferVK*>(pMesh->getVertexBuffer());
+	pDescriptorSet->writeStorageBufferDescriptor(pVertBuffer, VERTEX_BUFFER_BINDING);
+
+	SamplerVK* pSampler = reinterpret_cast<SamplerVK*>(pMaterial->getSampler());
+
+	Texture2DVK* pAlbedo = getResidentTexture(pMaterial->getAlbedoMap(), m_pDefaultTexture, hasPlaceholders);
+	ImageViewVK* pAlbedoView = pAlbedo->getImageView();
+	pDescriptorSet->writeCombinedImageDescriptors(&pAlbedoView, &pSampler, 1, ALBEDO_MAP_BINDING);
+
+	Texture2DVK* pNormal = getResidentTexture(pMaterial->getNormalMap(), m_pDefaultNormal, hasPlaceholders);
+	ImageViewVK* pNormalView = pNormal->getImageView();
+	pDescriptorSet->writeCombinedImageDescriptors(&pNormalView, &pSampler, 1, NORMAL_MAP_BINDING);
 
-		ImageViewVK* pRoughnessView = pRoughness->getImageView();
-		pDescriptorSet->writeCombinedImageDescriptors(&pRoughnessView, &pSampler, 1, ROUGHNESS_MAP_BINDING);
+	Texture2DVK* pAO = getResidentTexture(pMaterial->getAmbientOcclusionMap(), m_pDefaultTexture, hasPlaceholders);
+	ImageViewVK* pAOView = pAO->getImageView();
+	pDescriptorSet->writeCombinedImageDescriptors(&pAOView, &pSampler, 1, AO_MAP_BINDING);
 
-		pDescriptorSet->writeStorageBufferDescriptor(m_pMaterialParametersBuffer, MATERIAL_PARAMETERS_BINDING);
-		pDescriptorSet->writeStorageBufferDescriptor(m_pTransformsBufferGraphics, INSTANCE_TRANSFORMS_BINDING);
+	Texture2DVK* pMetallic = getResidentTexture(pMaterial->getMetallicMap(), m_pDefaultTexture, hasPlaceholders);
+	ImageViewVK* pMetallicView = pMetallic->getImageView();
+	pDescriptorSet->writeCombinedImageDescriptors(&pMetallicView, &pSampler, 1, METALLIC_MAP_BINDING);
 
-		MeshPipeline meshPipeline = {};
-		meshPipeline.pDescriptorSets = pDescriptorSet;
+	Texture2DVK* pRoughness = getResidentTexture(pMaterial->getRoughnessMap(), m_pDefaultTexture, hasPlaceholders);
+	ImageViewVK* pRoughnessView = pRoughness->getImageView();
+	pDescriptorSet->writeCombinedImageDescriptors(&pRoughnessView, &pSampler, 1, ROUGHNESS_MAP_BINDING);
 
-		m_MeshTable.insert(std::make_pair(filter, meshPipeline));
-		return pDescriptorSet;
+	pDescriptorSet->writeStorageBufferDescriptor(m_pMaterialParametersBuffer, MATERIAL_PARAMETERS_BINDING);
+	pDescriptorSet->writeStorageBufferDescriptor(m_pTransformsBufferGraphics, INSTANCE_TRANSFORMS_BINDING);
+	return pDescriptorSet;
+}
+
+Texture2DVK* SceneVK::getResidentTexture(ITexture2D* pTexture, Texture2DVK* pPlaceholder, bool& hasPlaceholders) const
+{
+	if (pTexture == nullptr)
+	{
+		return pPlaceholder;
 	}
 
-	MeshPipeline meshPipeline = m_MeshTable[filter];
-	return meshPipeline.pDescriptorSets;
+	if (!pTexture->isResident())
+	{
+		hasPlaceholders = true;
+		return pPlaceholder;
+	}
+
+	return reinterpret_cast<Texture2DVK*>(pTexture);
+}
+
+bool SceneVK::areMaterialTexturesResident(const Material* pMaterial) const
+{
+	const ITexture2D* pTextures[] =
+	{
+		pMaterial->getAlbedoMap(),
+		pMaterial->getNormalMap(),
+		pMaterial->getAmbientOcclusionMap(),
+		pMaterial->getMetallicMap(),
+		pMaterial->getRoughnessMap()
+	};
+
+	for (const ITexture2D* pTexture : pTextures)
+	{
+		if (pTexture != nullptr && !pTexture->isResident())
+		{
+			return false;
+		}
+	}
+
+	return true;
 }
 
 bool SceneVK::createDefaultTexturesAndSamplers()
@@ -869,6 +892,7 @@ void SceneVK::initBuffers()
 	materialParametersBufferParams.MemoryProperty	= VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
 	materialParametersBufferParams.SizeInBytes		= sizeof(MaterialParameters) * MAX_NUM_UNIQUE_MATERIALS;
 	materialParametersBufferParams.IsExclusive		= true;
+	materialParametersBufferParams.Category			= EMemoryCategory::SCENE_DATA;
 
 	m_pMaterialParametersBuffer = reinterpret_cast<BufferVK*>(m_pContext->createBuffer());
 	m_pMaterialParametersBuffer->init(materialParametersBufferParams);
@@ -878,6 +902,7 @@ void SceneVK::initBuffers()
 	transformBufferParams.MemoryProperty	= VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
 	transformBufferParams.SizeInBytes		= sizeof(GraphicsObjectTransforms) * NUM_INITIAL_GRAPHICS_OBJECTS;
 	transformBufferParams.IsExclusive		= true;
+	transformBufferParams.Category			= EMemoryCategory::SCENE_DATA;
 
 	m_pTransformsBufferGraphics = reinterpret_cast<BufferVK*>(m_pContext->createBuffer());
 	m_pTransformsBufferGraphics->init(transformBufferParams);
@@ -894,6 +919,7 @@ bool SceneVK::createGeometryPipelineLayout()
 	descriptorCounts.m_StorageImages	= 1024;
 	descriptorCounts.m_StorageBuffers	= 2048;
 	descriptorCounts.m_UniformBuffers	= 1024;
+	descriptorCounts.m_DynamicUniformBuffers = 1024;
 
 	m_pDescriptorPool = DBG_NEW DescriptorPoolVK(m_pContext->getDevice());
 	if (!m_pDescriptorPool->init(descriptorCounts, 512))
@@ -903,7 +929,7 @@ bool SceneVK::createGeometryPipelineLayout()
 
 	//GeometryPass
 	m_pGeometryDescriptorSetLayout = DBG_NEW DescriptorSetLayoutVK(m_pContext->getDevice());
-	m_pGeometryDescriptorSetLayout->addBindingUniformBuffer(VK_SHADER_STAGE_VERTEX_BIT, CAMERA_BUFFER_BINDING, 1);
+	m_pGeometryDescriptorSetLayout->addBindingUniformBufferDynamic(VK_SHADER_STAGE_VERTEX_BIT, CAMERA_BUFFER_BINDING, 1);
 	m_pGeometryDescriptorSetLayout->addBindingStorageBuffer(VK_SHADER_STAGE_VERTEX_BIT, VERTEX_BUFFER_BINDING, 1);
 	m_pGeometryDescriptorSetLayout->addBindingCombinedImage(VK_SHADER_STAGE_FRAGMENT_BIT, nullptr, ALBEDO_MAP_BINDING, 1);
 	m_pGeometryDescriptorSetLayout->addBindingCombinedImage(VK_SHADER_STAGE_FRAGMENT_BIT, nullptr, NORMAL_MAP_BINDING, 1);
@@ -951,6 +977,7 @@ void SceneVK::initAccelerationStructureBuffers()
 	scratchBufferParams.MemoryProperty	= VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
 	scratchBufferParams.SizeInBytes		= std::max(findMaxMemReqBLAS(), memReqTLAS.memoryRequirements.size);
 	scratchBufferParams.IsExclusive		= true;
+	scratchBufferParams.Category		= EMemoryCategory::RAY_TRACING;
 
 	m_pScratchBuffer = reinterpret_cast<BufferVK*>(m_pContext->createBuffer());
 	m_pScratchBuffer->init(scratchBufferParams);
@@ -960,6 +987,7 @@ void SceneVK::initAccelerationStructureBuffers()
 	instanceBufferParams.MemoryProperty	= VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
 	instanceBufferParams.SizeInBytes	= sizeof(GeometryInstance) * m_GeometryInstances.size();
 	instanceBufferParams.IsExclusive	= true;
+	instanceBufferParams.Category		= EMemoryCategory::RAY_TRACING;
 
 	m_pInstanceBuffer = reinterpret_cast<BufferVK*>(m_pContext->createBuffer());
 	m_pInstanceBuffer->init(instanceBufferParams);
@@ -973,12 +1001,12 @@ SceneVK::BottomLevelAccelerationStructure* SceneVK::createBLAS(const MeshVK* pMe
 	bottomLevelAccelerationStructure.Geometry.geometryType = VK_GEOMETRY_TYPE_TRIANGLES_NV;
 	bottomLevelAccelerationStructure.Geometry.geometry.triangles.sType = VK_STRUCTURE_TYPE_GEOMETRY_TRIANGLES_NV;
 	bottomLevelAccelerationStructure.Geometry.geometry.triangles.vertexData = ((BufferVK*)pMesh->getVertexBuffer())->getBuffer();
-	bottomLevelAccelerationStructure.Geometry.geometry.triangles.vertexOffset = 0;
+	bottomLevelAccelerationStructure.Geometry.geometry.triangles.vertexOffset = VkDeviceSize(pMesh->getVertexOffset()) * sizeof(GPUVertex);
 	bottomLevelAccelerationStructure.Geometry.geometry.triangles.vertexCount = pMesh->getVertexCount();
-	bottomLevelAccelerationStructure.Geometry.geometry.triangles.vertexStride = sizeof(Vertex);
+	bottomLevelAccelerationStructure.Geometry.geometry.triangles.vertexStride = sizeof(GPUVertex);
 	bottomLevelAccelerationStructure.Geometry.geometry.triangles.vertexFormat = VK_FORMAT_R32G32B32_SFLOAT;
 	bottomLevelAccelerationStructure.Geometry.geometry.triangles.indexData = ((BufferVK*)pMesh->getIndexBuffer())->getBuffer();
-	bottomLevelAccelerationStructure.Geometry.geometry.triangles.indexOffset = 0;
+	bottomLevelAccelerationStructure.Geometry.geometry.triangles.indexOffset = VkDeviceSize(pMesh->getIndexOffset()) * sizeof(uint32_t);
 	bottomLevelAccelerationStructure.Geometry.geometry.triangles.indexCount = pMesh->getIndexCount();
 	bottomLevelAccelerationStructure.Geometry.geometry.triangles.indexType = VK_INDEX_TYPE_UINT32;
 	bottomLevelAccelerationStructure.Geometry.geometry.triangles.transformData = VK_NULL_HANDLE;
@@ -1007,16 +1035,16 @@ SceneVK::BottomLevelAccelerationStructure* SceneVK::createBLAS(const MeshVK* pMe
 	VkMemoryRequirements2 memoryRequirements2 = {};
 	m_pDevice->vkGetAccelerationStructureMemoryRequirementsNV(m_pDevice->getDevice(), &memoryRequirementsInfo, &memoryRequirements2);
 
-	VkMemoryAllocateInfo memoryAllocateInfo = {};
-	memoryAllocateInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-	memoryAllocateInfo.allocationSize = memoryRequirements2.memoryRequirements.size;
-	memoryAllocateInfo.memoryTypeIndex = findMemoryType(m_pDevice->getPhysicalDevice(), memoryRequirements2.memoryRequirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-	VK_CHECK_RESULT(vkAllocateMemory(m_pDevice->getDevice(), &memoryAllocateInfo, nullptr, &bottomLevelAccelerationStructure.Memory), "--- RayTracingScene: Could not allocate memory for BLAS!");
+	if (!m_pDevice->getAllocator()->allocate(bottomLevelAccelerationStructure.Allocation, memoryRequirements2.memoryRequirements, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, EAllocationTypeVK::BUFFER, EMemoryCategory::RAY_TRACING))
+	{
+		LOG("--- RayTracingScene: Could not allocate memory for BLAS!");
+	}
 
 	VkBindAccelerationStructureMemoryInfoNV accelerationStructureMemoryInfo = {};
 	accelerationStructureMemoryInfo.sType = VK_STRUCTURE_TYPE_BIND_ACCELERATION_STRUCTURE_MEMORY_INFO_NV;
 	accelerationStructureMemoryInfo.accelerationStructure = bottomLevelAccelerationStructure.AccelerationStructure;
-	accelerationStructureMemoryInfo.memory = bottomLevelAccelerationStructure.Memory;
+	accelerationStructureMemoryInfo.memory = bottomLevelAccelerationStructure.Allocation.Memory;
+	accelerationStructureMemoryInfo.memoryOffset = bottomLevelAccelerationStructure.Allocation.Offset;
 	VK_CHECK_RESULT(m_pDevice->vkBindAccelerationStructureMemoryNV(m_pDevice->getDevice(), 1, &accelerationStructureMemoryInfo), "--- RayTracingScene: Could not bind memory for BLAS!");
 
 	VK_CHECK_RESULT(m_pDevice->vkGetAccelerationStructureHandleNV(m_pDevice->getDevice(), bottomLevelAccelerationStructure.AccelerationStructure, sizeof(uint64_t), &bottomLevelAccelerationStructure.Handle), "--- RayTracingScene: Could not get handle for BLAS!");
@@ -1034,7 +1062,6 @@ SceneVK::BottomLevelAccelerationStructure* SceneVK::createBLAS(const MeshVK* pMe
 
 bool SceneVK::buildBLASs()
 {
-	cleanGarbage();
 	updateScratchBufferForBLAS();
 
 	//Create Memory Barrier
@@ -1066,6 +1093,10 @@ bool SceneVK::buildBLASs()
 
 		for (auto& bottomLevelAccelerationStructure : bottomLevelAccelerationStructurePerMesh.second)
 		{
+			//The geometry buffer may have moved the mesh since the geometry was described
+			bottomLevelAccelerationStructure.second.Geometry.geometry.triangles.vertexOffset	= VkDeviceSize(pMesh->getVertexOffset()) * sizeof(GPUVertex);
+			bottomLevelAccelerationStructure.second.Geometry.geometry.triangles.indexOffset		= VkDeviceSize(pMesh->getIndexOffset()) * sizeof(uint32_t);
+
 			/*
 				Build bottom level acceleration structure
 			*/
@@ -1125,16 +1156,17 @@ bool SceneVK::createTLAS()
 	VkMemoryRequirements2 memoryRequirements2 = {};
 	m_pDevice->vkGetAccelerationStructureMemoryRequirementsNV(m_pDevice->getDevice(), &memoryRequirementsInfo, &memoryRequirements2);
 
-	VkMemoryAllocateInfo memoryAllocateInfo = {};
-	memoryAllocateInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-	memoryAllocateInfo.allocationSize = memoryRequirements2.memoryRequirements.size;
-	memoryAllocateInfo.memoryTypeIndex = findMemoryType(m_pDevice->getPhysicalDevice(), memoryRequirements2.memoryRequirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-	VK_CHECK_RESULT_RETURN_FALSE(vkAllocateMemory(m_pDevice->getDevice(), &memoryAllocateInfo, nullptr, &m_TopLevelAccelerationStructure.Memory), "--- RayTracingScene: Could not allocate memory for TLAS!");
+	if (!m_pDevice->getAllocator()->allocate(m_TopLevelAccelerationStructure.Allocation, memoryRequirements2.memoryRequirements, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, EAllocationTypeVK::BUFFER, EMemoryCategory::RAY_TRACING))
+	{
+		LOG("--- RayTracingScene: Could not allocate memory for TLAS!");
+		return false;
+	}
 
 	VkBindAccelerationStructureMemoryInfoNV accelerationStructureMemoryInfo = {};
 	accelerationStructureMemoryInfo.sType = VK_STRUCTURE_TYPE_BIND_ACCELERATION_STRUCTURE_MEMORY_INFO_NV;
 	accelerationStructureMemoryInfo.accelerationStructure = m_TopLevelAccelerationStructure.AccelerationStructure;
-	accelerationStructureMemoryInfo.memory = m_TopLevelAccelerationStructure.Memory;
+	accelerationStructureMemoryInfo.memory = m_TopLevelAccelerationStructure.Allocation.Memory;
+	accelerationStructureMemoryInfo.memoryOffset = m_TopLevelAccelerationStructure.Allocation.Offset;
 	VK_CHECK_RESULT_RETURN_FALSE(m_pDevice->vkBindAccelerationStructureMemoryNV(m_pDevice->getDevice(), 1, &accelerationStructureMemoryInfo), "--- RayTracingScene: Could not allocate bind memory for TLAS!");
 
 	VK_CHECK_RESULT_RETURN_FALSE(m_pDevice->vkGetAccelerationStructureHandleNV(m_pDevice->getDevice(), m_TopLevelAccelerationStructure.AccelerationStructure, sizeof(uint64_t), &m_TopLevelAccelerationStructure.Handle), "--- RayTracingScene: Could not get handle for TLAS!");
@@ -1187,7 +1219,7 @@ bool SceneVK::updateTLAS()
 	{
 		//Instance count changed, recreate TLAS
 		m_TopLevelIsDirty = false;
-		m_OldTopLevelAccelerationStructure = m_TopLevelAccelerationStructure;
+		retireTLAS();
 
 		if (!createTLAS())
 		{
@@ -1195,7 +1227,6 @@ bool SceneVK::updateTLAS()
 			return false;
 		}
 
-		cleanGarbage();
 		updateScratchBufferForTLAS();
 		updateInstanceBuffer();
 
@@ -1241,8 +1272,6 @@ bool SceneVK::updateTLAS()
 	else
 	{
 		//Instance count has not changed, update old TLAS
-
-		cleanGarbage();
 		updateScratchBufferForTLAS();
 		updateInstanceBuffer();
 
@@ -1295,27 +1324,21 @@ void SceneVK::createProfiler()
 	m_pProfiler->initTimestamp(&m_TimestampBuildAccelStruct, "Build top-level acceleration structure");
 }
 
-void SceneVK::cleanGarbage()
+void SceneVK::retireTLAS()
 {
-	SAFEDELETE(m_pGarbageScratchBuffer);
-	SAFEDELETE(m_pGarbageInstanceBuffer);
-
-	SAFEDELETE(m_pGarbageTransformsBufferGraphics);
-	SAFEDELETE(m_pGarbageTransformsBufferCompute);
-
-	if (m_OldTopLevelAccelerationStructure.Memory != VK_NULL_HANDLE)
+	//The frames in flight may still trace against the old TLAS
+	DeletionQueueVK* pDeletionQueue = m_pDevice->getDeletionQueue();
+	if (m_TopLevelAccelerationStructure.AccelerationStructure != VK_NULL_HANDLE)
 	{
-		vkFreeMemory(m_pDevice->getDevice(), m_OldTopLevelAccelerationStructure.Memory, nullptr);
-		m_OldTopLevelAccelerationStructure.Memory = VK_NULL_HANDLE;
-	}
+		DeviceVK* pDevice = m_pDevice;
+		VkAccelerationStructureNV accelerationStructure = m_TopLevelAccelerationStructure.AccelerationStructure;
+		pDeletionQueue->push([pDevice, accelerationStructure]() { pDevice->vkDestroyAccelerationStructureNV(pDevice->getDevice(), accelerationStructure, nullptr); });
 
-	if (m_OldTopLevelAccelerationStructure.AccelerationStructure != VK_NULL_HANDLE)
-	{
-		m_pDevice->vkDestroyAccelerationStructureNV(m_pDevice->getDevice(), m_OldTopLevelAccelerationStructure.AccelerationStructure, nullptr);
-		m_OldTopLevelAccelerationStructure.AccelerationStructure = VK_NULL_HANDLE;
+		m_TopLevelAccelerationStructure.AccelerationStructure = VK_NULL_HANDLE;
 	}
 
-	m_OldTopLevelAccelerationStructure.Handle = VK_NULL_HANDLE;
+	pDeletionQueue->deallocate(m_TopLevelAccelerationStructure.Allocation);
+	m_TopLevelAccelerationStructure.Handle = 0;
 }
 
 void SceneVK::updateScratchBufferForBLAS()
@@ -1324,12 +1347,13 @@ void SceneVK::updateScratchBufferForBLAS()
 
 	if (m_pScratchBuffer->getSizeInBytes() < requiredSize)
 	{
-		m_pGarbageScratchBuffer = m_pScratchBuffer;
+		m_pDevice->getDeletionQueue()->destroy(m_pScratchBuffer);
 
 		BufferParams scratchBufferParams = {};
 		scratchBufferParams.Usage = VK_BUFFER_USAGE_RAY_TRACING_BIT_NV;
 		scratchBufferParams.MemoryProperty = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
 		scratchBufferParams.SizeInBytes = requiredSize;
+		scratchBufferParams.Category = EMemoryCategory::RAY_TRACING;
 
 		m_pScratchBuffer = reinterpret_cast<BufferVK*>(m_pContext->createBuffer());
 		m_pScratchBuffer->init(scratchBufferParams);
@@ -1342,12 +1366,13 @@ void SceneVK::updateScratchBufferForTLAS()
 
 	if (m_pScratchBuffer->getSizeInBytes() < requiredSize)
 	{
-		m_pGarbageScratchBuffer = m_pScratchBuffer;
+		m_pDevice->getDeletionQueue()->destroy(m_pScratchBuffer);
 
 		BufferParams scratchBufferParams = {};
 		scratchBufferParams.Usage = VK_BUFFER_USAGE_RAY_TRACING_BIT_NV;
 		scratchBufferParams.MemoryProperty = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
 		scratchBufferParams.SizeInBytes = requiredSize;
+		scratchBufferParams.Category = EMemoryCategory::RAY_TRACING;
 
 		m_pScratchBuffer = reinterpret_cast<BufferVK*>(m_pContext->createBuffer());
 		m_pScratchBuffer->init(scratchBufferParams);
@@ -1358,12 +1383,13 @@ void SceneVK::updateInstanceBuffer()
 {
 	if (m_pInstanceBuffer->getSizeInBytes() < sizeof(GeometryInstance) * m_GeometryInstances.size())
 	{
-		m_pGarbageInstanceBuffer = m_pInstanceBuffer;
+		m_pDevice->getDeletionQueue()->destroy(m_pInstanceBuffer);
 
 		BufferParams instanceBufferParmas = {};
 		instanceBufferParmas.Usage = VK_BUFFER_USAGE_RAY_TRACING_BIT_NV | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
 		instanceBufferParmas.MemoryProperty = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
 		instanceBufferParmas.SizeInBytes = sizeof(GeometryInstance) * m_GeometryInstances.size();
+		instanceBufferParmas.Category = EMemoryCategory::RAY_TRACING;
 
 		m_pInstanceBuffer = reinterpret_cast<BufferVK*>(m_pContext->createBuffer());
 		m_pInstanceBuffer->init(instanceBufferParmas);
@@ -1384,14 +1410,17 @@ void SceneVK::updateTransformBuffer()
 	const uint32_t sizeInBytes = sizeof(GraphicsObjectTransforms) * uint32_t(m_SceneTransforms.size());
 	if (m_pTransformsBufferGraphics->getSizeInBytes() < sizeInBytes)
 	{
-		m_pGarbageTransformsBufferGraphics	= m_pTransformsBufferGraphics;
-		m_pGarbageTransformsBufferCompute	= m_pTransformsBufferCompute;
+		DeletionQueueVK* pDeletionQueue = m_pDevice->getDeletionQueue();
+		pDeletionQueue->destroy(m_pTransformsBufferGraphics);
+		pDeletionQueue->destroy(m_pTransformsBufferCompute);
+		m_TransformsBufferReplaced = true;
 
 		BufferParams transformBufferParams = {};
 		transformBufferParams.Usage				= VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
 		transformBufferParams.MemoryProperty	= VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
 		transformBufferParams.SizeInBytes		= sizeInBytes;
 		transformBufferParams.IsExclusive		= true;
+		transformBufferParams.Category			= EMemoryCategory::SCENE_DATA;
 
 		m_pTransformsBufferGraphics = reinterpret_cast<BufferVK*>(m_pContext->createBuffer());
 		m_pTransformsBufferGraphics->init(transformBufferParams);
@@ -1411,34 +1440,17 @@ bool SceneVK::createCombinedGraphicsObjectData()
 		return false;
 	}
 
-	SAFEDELETE(m_pCombinedVertexBuffer);
-	SAFEDELETE(m_pCombinedIndexBuffer);
-	SAFEDELETE(m_pMeshIndexBuffer);
-
-	m_pCombinedVertexBuffer = reinterpret_cast<BufferVK*>(m_pContext->createBuffer());
-	m_pCombinedIndexBuffer	= reinterpret_cast<BufferVK*>(m_pContext->createBuffer());
-	m_pMeshIndexBuffer		= reinterpret_cast<BufferVK*>(m_pContext->createBuffer());
-
-	BufferParams vertexBufferParams = {};
-	vertexBufferParams.Usage			= VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
-	vertexBufferParams.SizeInBytes		= sizeof(Vertex) * m_TotalNumberOfVertices;
-	vertexBufferParams.MemoryProperty	= VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
-	vertexBufferParams.IsExclusive		= true;
-
-	BufferParams indexBufferParams = {};
-	indexBufferParams.Usage				= VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
-	indexBufferParams.SizeInBytes		= sizeof(uint32_t) * m_TotalNumberOfIndices;
-	indexBufferParams.MemoryProperty	= VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
-	indexBufferParams.IsExclusive		= true;
+	//The frames in flight may still read the old offsets
+	m_pDevice->getDeletionQueue()->destroy(m_pMeshIndexBuffer);
+	m_pMeshIndexBuffer = reinterpret_cast<BufferVK*>(m_pContext->createBuffer());
 
 	BufferParams meshIndexBufferParams = {};
 	meshIndexBufferParams.Usage				= VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
 	meshIndexBufferParams.SizeInBytes		= sizeof(uint32_t) * 3 * m_NumBottomLevelAccelerationStructures;
 	meshIndexBufferParams.MemoryProperty	= VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
 	meshIndexBufferParams.IsExclusive		= true;
+	meshIndexBufferParams.Category			= EMemoryCategory::RAY_TRACING;
 
-	m_pCombinedVertexBuffer->init(vertexBufferParams);
-	m_pCombinedIndexBuffer->init(indexBufferParams);
 	m_pMeshIndexBuffer->init(meshIndexBufferParams);
 
 	m_MeshDataIsDirty = true;
@@ -1515,4 +1527,18 @@ void SceneVK::updateDebugParameters()
 		updateMaterials();
 		m_DebugParametersDirty = false;
 	}
+	else if (m_MaterialsUsePlaceholders)
+	{
+		//The ray tracing descriptors are rewritten once, when the last of the streamed textures has arrived
+		bool isResident = true;
+		for (const Material* pMaterial : m_Materials)
+		{
+			isResident = isResident && areMaterialTexturesResident(pMaterial);
+		}
+
+		if (isResident)
+		{
+			updateMaterials();
+		}
+	}
 }
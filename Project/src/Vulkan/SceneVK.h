@@ -6,6 +6,7 @@
 #include "Vulkan/ProfilerVK.h"
 #include "Vulkan/Texture2DVK.h"
 #include "Vulkan/VulkanCommon.h"
+#include "Vulkan/DeviceMemoryBlockVK.h"
 
 #include <vector>
 #include <map>
@@ -43,12 +44,17 @@ struct GraphicsObjectVK
 	const MeshVK* pMesh = nullptr;
 	const Material* pMaterial = nullptr;
 	uint32_t MaterialParametersIndex = 0;
+	uint32_t MeshPipelineIndex = 0;
 };
 
 //Meshfilter is key, returns a meshpipeline -> gets descriptorset with correct vertexbuffer, textures, etc.
 struct MeshPipeline
 {
-	DescriptorSetVK* pDescriptorSets;
+	const MeshVK* pMesh				= nullptr;
+	const Material* pMaterial		= nullptr;
+	DescriptorSetVK* pDescriptorSets = nullptr;
+	//Set when a texture had not arrived when the descriptorset was written, it is written again once they have
+	bool HasPlaceholders			= false;
 };
 
 struct MeshFilter
@@ -106,7 +112,7 @@ class SceneVK : public IScene
 
 	struct BottomLevelAccelerationStructure
 	{
-		VkDeviceMemory Memory = VK_NULL_HANDLE;
+		AllocationVK Allocation;
 		VkAccelerationStructureNV AccelerationStructure = VK_NULL_HANDLE;
 		uint64_t Handle = 0;
 		VkGeometryNV Geometry = {};
@@ -116,7 +122,7 @@ class SceneVK : public IScene
 
 	struct TopLevelAccelerationStructure
 	{
-		VkDeviceMemory Memory = VK_NULL_HANDLE;
+		AllocationVK Allocation;
 		VkAccelerationStructureNV AccelerationStructure = VK_NULL_HANDLE;
 		uint64_t Handle = 0;
 	};
@@ -144,13 +150,16 @@ public:
 	virtual void updateMaterials() override;
 
 	virtual void updateCamera(const Camera& camera) override;
+	virtual void commitFrameState() override;
 
 	virtual uint32_t submitGraphicsObject(const IMesh* pMesh, const Material* pMaterial, const glm::mat4& transform = glm::mat4(1.0f), uint8_t customMask = 0x80) override;
 	virtual void updateGraphicsObjectTransform(uint32_t index, const glm::mat4& transform) override;
 
 	// Used for geometry rendering
 	void UpdateSceneData();
-	DescriptorSetVK* getDescriptorSetFromMeshAndMaterial(const MeshVK* pMesh, const Material* pMaterial);
+	//Called from multiple threads when the geometry pass is recorded in chunks. The sets are only written in updateSceneData,
+	//which never runs at the same time as the recording, so no lock is needed
+	FORCEINLINE DescriptorSetVK* getDescriptorSet(const GraphicsObjectVK& graphicsObject) const { return m_MeshPipelines[graphicsObject.MeshPipelineIndex].pDescriptorSets; }
 
 	FORCEINLINE PipelineLayoutVK* getGeometryPipelineLayout() 			{ return m_pGeometryPipelineLayout; }
 	FORCEINLINE DescriptorSetLayoutVK* getGeometryDescriptorSetLayout() { return m_pGeometryDescriptorSetLayout; }
@@ -160,7 +169,10 @@ public:
 	virtual void renderUI() override;
 	virtual void updateDebugParameters() override;
 
-	virtual LightSetup& getLightSetup() override { return m_LightSetup; }
+	virtual LightSetup& getLightSetup() override { return m_PendingLightSetup; }
+
+	//The lights of the frame that is being rendered
+	const LightSetup& getRenderLightSetup() const { return m_LightSetup; }
 
 	// Used for geometry rendering
 	bool updateSceneData();
@@ -170,8 +182,6 @@ public:
 	const std::vector<GraphicsObjectVK>&	getGraphicsObjects() const			{ return m_GraphicsObjects; }
 	PipelineLayoutVK*						getGeometryPipelineLayout() const	{ return m_pGeometryPipelineLayout; }
 
-	FORCEINLINE BufferVK*	getCombinedVertexBuffer() { return m_pCombinedVertexBuffer; }
-	FORCEINLINE BufferVK*	getCombinedIndexBuffer()  { return m_pCombinedIndexBuffer; }
 	FORCEINLINE BufferVK*	getMeshIndexBuffer()	  { return m_pMeshIndexBuffer; }
 	FORCEINLINE ProfilerVK* getProfiler()			  { return m_pProfiler; }
 
@@ -201,7 +211,7 @@ private:
 	bool updateTLAS();
 
 	void createProfiler();
-	void cleanGarbage();
+	void retireTLAS();
 
 	void updateScratchBufferForBLAS();
 	void updateScratchBufferForTLAS();
@@ -213,10 +223,24 @@ private:
 
 	uint32_t registerMaterial(const Material* pMaterial);
 
+	uint32_t registerMeshPipeline(const MeshVK* pMesh, const Material* pMaterial);
+	//Writes the sets of new pipelines and of those whose textures have arrived, or of every pipeline when a buffer they use was replaced
+	void writeMeshPipelines(bool rewriteAll);
+	DescriptorSetVK* createGeometryDescriptorSet(const MeshVK* pMesh, const Material* pMaterial, bool& hasPlaceholders);
+	Texture2DVK* getResidentTexture(ITexture2D* pTexture, Texture2DVK* pPlaceholder, bool& hasPlaceholders) const;
+	bool areMaterialTexturesResident(const Material* pMaterial) const;
+
 private:
 	SceneParameters m_SceneParameters;
 	Camera m_Camera;
 	LightSetup m_LightSetup;
+
+	//Written by the update, copied to the members above in commitFrameState
+	Camera m_PendingCamera;
+	LightSetup m_PendingLightSetup;
+	std::vector<glm::mat4> m_PendingTransforms;
+	std::vector<uint32_t> m_PendingTransformIndices;
+	std::vector<uint8_t> m_TransformIsPending;
 	Timestamp m_TimestampBuildAccelStruct; //Todo: create more of these
 
 	GraphicsContextVK* m_pContext;
@@ -232,18 +256,16 @@ private:
 	std::vector<GeometryInstance> m_GeometryInstances;
 
 	// Geometry pass resources
-	std::unordered_map<MeshFilter, MeshPipeline> m_MeshTable;
+	std::unordered_map<MeshFilter, uint32_t> m_MeshTable;
+	std::vector<MeshPipeline> m_MeshPipelines;
+	//Pipelines that have no descriptorset yet or still use placeholder textures
+	std::vector<uint32_t> m_PendingMeshPipelines;
 	BufferVK* m_pCameraBuffer;
 	DescriptorPoolVK* m_pDescriptorPool;
 	PipelineLayoutVK* m_pGeometryPipelineLayout;
 	DescriptorSetLayoutVK* m_pGeometryDescriptorSetLayout;
 
 	std::vector<const MeshVK*> m_AllMeshes;
-	uint32_t m_TotalNumberOfVertices;
-	uint32_t m_TotalNumberOfIndices;
-
-	BufferVK* m_pCombinedVertexBuffer;
-	BufferVK* m_pCombinedIndexBuffer;
 	BufferVK* m_pMeshIndexBuffer;
 
 	std::vector<const Material*> m_Materials;
@@ -263,7 +285,6 @@ private:
 	BufferVK* m_pTransformsBufferGraphics;
 	BufferVK* m_pTransformsBufferCompute;
 
-	TopLevelAccelerationStructure m_OldTopLevelAccelerationStructure;
 	TopLevelAccelerationStructure m_TopLevelAccelerationStructure;
 	std::map<const MeshVK*, std::map<const Material*, BottomLevelAccelerationStructure>> m_NewBottomLevelAccelerationStructures;
 	std::map<const MeshVK*, std::map<const Material*, BottomLevelAccelerationStructure>> m_FinalizedBottomLevelAccelerationStructures;
@@ -272,11 +293,6 @@ private:
 	BufferVK* m_pScratchBuffer;
 	BufferVK* m_pInstanceBuffer;
 
-	BufferVK* m_pGarbageScratchBuffer;
-	BufferVK* m_pGarbageInstanceBuffer;
-	BufferVK* m_pGarbageTransformsBufferGraphics;
-	BufferVK* m_pGarbageTransformsBufferCompute;
-
 	Texture2DVK* m_pDefaultTexture;
 	Texture2DVK* m_pDefaultNormal;
 	SamplerVK* m_pDefaultSampler;
@@ -288,4 +304,7 @@ private:
 	bool m_MeshDataIsDirty;
 	bool m_RayTracingEnabled;
 	bool m_DebugParametersDirty;
+	bool m_MaterialsUsePlaceholders;
+	bool m_TransformsBufferReplaced;
+	uint64_t m_GeometryLayoutVersion;
 };
@@ -82,6 +82,7 @@ bool SkyboxRendererVK::init()
 	cubeFilterBufferParams.SizeInBytes		= sizeof(glm::mat4);
 	cubeFilterBufferParams.MemoryProperty	= VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
 	cubeFilterBufferParams.IsExclusive		= true;
+	cubeFilterBufferParams.Category		= EMemoryCategory::UNIFORM_BUFFERS;
 
 	m_pCubeFilterBuffer = DBG_NEW BufferVK(m_pDevice);
 	if (!m_pCubeFilterBuffer->init(cubeFilterBufferParams))
@@ -18,7 +18,10 @@
 Texture2DVK::Texture2DVK(DeviceVK* pDevice)
 	: m_pDevice(pDevice),
 	m_pTextureImage(nullptr),
-	m_pTextureImageView(nullptr)
+	m_pTextureImageView(nullptr),
+	m_UploadToken(),
+	m_IsUploaded(false),
+	m_IsResident(false)
 {
 }
 
@@ -83,6 +86,7 @@ bool Texture2DVK::initFromMemory(const void* pData, uint32_t width, uint32_t hei
 	imageParams.MemoryProperty	= VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
 	imageParams.Usage			= VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | usageFlags;
 	imageParams.Format			= convertFormat(format);
+	imageParams.Category		= EMemoryCategory::TEXTURES;
 	
 	if (generateMips)
 	{
@@ -100,12 +104,15 @@ bool Texture2DVK::initFromMemory(const void* pData, uint32_t width, uint32_t hei
 		uint32_t pixelStride = textureFormatStride(format);
 
 		CopyHandlerVK* pCopyHandler = m_pDevice->getCopyHandler();
+		pCopyHandler->beginBatch();
 		pCopyHandler->updateImage(pData, m_pTextureImage, width, height, pixelStride, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, 0, 0);
 
 		if (generateMips)
 		{
 			pCopyHandler->generateMips(m_pTextureImage);
 		}
+
+		m_UploadToken = pCopyHandler->endBatch();
 	}
 
 	ImageViewParams imageViewParams = {};
@@ -117,5 +124,26 @@ bool Texture2DVK::initFromMemory(const void* pData, uint32_t width, uint32_t hei
 	imageViewParams.FirstMipLevel	= 0;
 	
 	m_pTextureImageView = DBG_NEW ImageViewVK(m_pDevice, m_pTextureImage);
-	return m_pTextureImageView->init(imageViewParams);
+	if (!m_pTextureImageView->init(imageViewParams))
+	{
+		return false;
+	}
+
+	//A texture without initial data has an empty token, which is always complete
+	m_IsUploaded.store(true, std::memory_order_release);
+	return true;
+}
+
+bool Texture2DVK::isResident() const
+{
+	//The copy handler is only asked until it has reported the upload as complete once
+	if (!m_IsResident.load(std::memory_order_acquire) && m_IsUploaded.load(std::memory_order_acquire))
+	{
+		if (m_pDevice->getCopyHandler()->isComplete(m_UploadToken))
+		{
+			m_IsResident.store(true, std::memory_order_release);
+		}
+	}
+
+	return m_IsResident.load(std::memory_order_acquire);
 }
@@ -1,6 +1,9 @@
 #pragma once
 #include "Common/ITexture2D.h"
 #include "VulkanCommon.h"
+#include "CopyHandlerVK.h"
+
+#include <atomic>
 
 class IGraphicsContext;
 
@@ -21,6 +24,10 @@ public:
 	virtual bool initFromFile(const std::string& filename, ETextureFormat format, bool generateMips) override;
 	virtual bool initFromMemory(const void* pData, uint32_t width, uint32_t height, ETextureFormat format, uint32_t usageFlags, bool generateMips) override;
 
+	virtual bool isResident() const override;
+
+	FORCEINLINE const CopyTokenVK& getUploadToken() const	{ return m_UploadToken; }
+
 	FORCEINLINE ImageVK*		getImage() const		{ return m_pTextureImage; }
 	FORCEINLINE ImageViewVK*	getImageView() const	{ return m_pTextureImageView; }
 
@@ -28,4 +35,9 @@ private:
 	DeviceVK* m_pDevice;
 	ImageVK* m_pTextureImage;
 	ImageViewVK* m_pTextureImageView;
+
+	//Textures are loaded on other threads than the ones rendering them, the image view and token are only read after IsUploaded is set
+	CopyTokenVK m_UploadToken;
+	std::atomic<bool> m_IsUploaded;
+	mutable std::atomic<bool> m_IsResident;
 };
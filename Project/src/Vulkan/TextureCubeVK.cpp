@@ -34,6 +34,7 @@ bool TextureCubeVK::init(uint32_t width, uint32_t miplevels, ETextureFormat form
 	imageParams.Samples			= VK_SAMPLE_COUNT_1_BIT;
 	imageParams.Usage			= VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
 	imageParams.Format			= convertFormat(format);
+	imageParams.Category		= EMemoryCategory::TEXTURES;
 
 	m_pImage = DBG_NEW ImageVK(m_pDevice);
 	if (!m_pImage->init(imageParams))
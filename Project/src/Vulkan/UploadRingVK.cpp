@@ -0,0 +1,142 @@
+#include "UploadRingVK.h"
+#include "DeviceVK.h"
+#include "BufferVK.h"
+
+#include <mutex>
+#include <algorithm>
+
+UploadRingVK::UploadRingVK(DeviceVK* pDevice)
+	: m_pDevice(pDevice),
+	m_pBuffer(nullptr),
+	m_pHostMemory(nullptr),
+	m_SizeInBytes(0),
+	m_Alignment(16),
+	m_Head(0),
+	m_Tail(0),
+	m_RangeEnds(),
+	m_IsRetired(),
+	m_FirstRange(0),
+	m_NextRange(0),
+	m_PeakBytes(0),
+	m_OverflowCount(0),
+	m_OverflowBytes(0)
+{
+}
+
+UploadRingVK::~UploadRingVK()
+{
+	if (m_FirstRange != m_NextRange)
+	{
+		LOG("--- UploadRingVK: %llu ranges were never retired", (unsigned long long)(m_NextRange - m_FirstRange));
+	}
+
+	SAFEDELETE(m_pBuffer);
+	m_pDevice = nullptr;
+}
+
+bool UploadRingVK::init(VkDeviceSize sizeInBytes)
+{
+	BufferParams params = {};
+	params.Usage			= VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+	params.MemoryProperty	= VK_MEMORY_PROPERTY_HOST_COHERENT_BIT | VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT;
+	params.SizeInBytes		= sizeInBytes;
+	params.IsExclusive		= true;
+	params.Category			= EMemoryCategory::STAGING;
+
+	m_pBuffer = DBG_NEW BufferVK(m_pDevice);
+	if (!m_pBuffer->init(params))
+	{
+		LOG("--- UploadRingVK: Failed to create buffer");
+		return false;
+	}
+
+	m_pBuffer->setName("Upload Ring");
+	m_pBuffer->map((void**)&m_pHostMemory);
+	m_SizeInBytes = sizeInBytes;
+
+	//Image copies need the offset to be a multiple of the texel size, 16 covers every format that is uploaded
+	m_Alignment = std::max<VkDeviceSize>(16, m_pDevice->getDeviceLimits().optimalBufferCopyOffsetAlignment);
+	m_Lock.enableStatistics("UploadRingVK");
+
+	D_LOG("--- UploadRingVK: Created ring of %llu bytes", (unsigned long long)sizeInBytes);
+	return true;
+}
+
+bool UploadRingVK::allocate(UploadAllocationVK& allocation, uint64_t& range, VkDeviceSize sizeInBytes)
+{
+	if (sizeInBytes > m_SizeInBytes)
+	{
+		return false;
+	}
+
+	std::scoped_lock<Spinlock> lock(m_Lock);
+
+	//Wrap to the start if the upload does not fit before the end, the rest of the ring becomes part of the range
+	const uint64_t wrapStart	= m_Head - (m_Head % m_SizeInBytes);
+	uint64_t begin				= wrapStart + ((m_Head - wrapStart + m_Alignment - 1) & ~(m_Alignment - 1));
+	if ((begin - wrapStart) + sizeInBytes > m_SizeInBytes)
+	{
+		begin = wrapStart + m_SizeInBytes;
+	}
+
+	const uint64_t end = begin + sizeInBytes;
+	if (end - m_Tail > m_SizeInBytes)
+	{
+		return false;
+	}
+
+	const bool isLastRange = range != UPLOAD_RING_NO_RANGE && range + 1 == m_NextRange;
+	if (!isLastRange)
+	{
+		if (m_NextRange - m_FirstRange >= UPLOAD_RING_MAX_RANGES)
+		{
+			return false;
+		}
+
+		range = m_NextRange++;
+		m_IsRetired[range % UPLOAD_RING_MAX_RANGES] = false;
+	}
+
+	m_RangeEnds[range % UPLOAD_RING_MAX_RANGES] = end;
+	m_Head		= end;
+	m_PeakBytes = std::max(m_PeakBytes, m_Head - m_Tail);
+
+	allocation.pBuffer		= m_pBuffer;
+	allocation.Offset		= begin % m_SizeInBytes;
+	allocation.pHostMemory	= m_pHostMemory + allocation.Offset;
+	return true;
+}
+
+void UploadRingVK::retire(uint64_t range)
+{
+	std::scoped_lock<Spinlock> lock(m_Lock);
+	ASSERT(range >= m_FirstRange && range < m_NextRange);
+
+	m_IsRetired[range % UPLOAD_RING_MAX_RANGES] = true;
+	while (m_FirstRange < m_NextRange && m_IsRetired[m_FirstRange % UPLOAD_RING_MAX_RANGES])
+	{
+		m_Tail = m_RangeEnds[m_FirstRange % UPLOAD_RING_MAX_RANGES];
+		m_FirstRange++;
+	}
+}
+
+void UploadRingVK::addOverflow(VkDeviceSize sizeInBytes)
+{
+	std::scoped_lock<Spinlock> lock(m_Lock);
+	m_OverflowCount++;
+	m_OverflowBytes += sizeInBytes;
+}
+
+UploadRingStatistics UploadRingVK::getStatistics()
+{
+	std::scoped_lock<Spinlock> lock(m_Lock);
+
+	UploadRingStatistics statistics = {};
+	statistics.SizeInBytes		= m_SizeInBytes;
+	statistics.UsedBytes		= m_Head - m_Tail;
+	statistics.PeakBytes		= m_PeakBytes;
+	statistics.RangesInFlight	= uint32_t(m_NextRange - m_FirstRange);
+	statistics.OverflowCount	= m_OverflowCount;
+	statistics.OverflowBytes	= m_OverflowBytes;
+	return statistics;
+}
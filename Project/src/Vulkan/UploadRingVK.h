@@ -0,0 +1,75 @@
+#pragma once
+#include "Core/Spinlock.h"
+
+#include "VulkanCommon.h"
+
+//Size of the upload ring that all command buffers share, uploads that do not fit get a staging buffer of their own
+#define UPLOAD_RING_SIZE		(32ULL * 1024ULL * 1024ULL)
+//Number of ranges that can wait for their fence at the same time, a command buffer extends its range when no one else has allocated in between
+#define UPLOAD_RING_MAX_RANGES	1024U
+#define UPLOAD_RING_NO_RANGE	UINT64_MAX
+
+class DeviceVK;
+class BufferVK;
+
+struct UploadAllocationVK
+{
+	BufferVK* pBuffer	= nullptr;
+	VkDeviceSize Offset = 0;
+	void* pHostMemory	= nullptr;
+};
+
+struct UploadRingStatistics
+{
+	VkDeviceSize SizeInBytes	= 0;
+	VkDeviceSize UsedBytes		= 0;
+	VkDeviceSize PeakBytes		= 0;
+	uint32_t RangesInFlight		= 0;
+	uint32_t OverflowCount		= 0;
+	VkDeviceSize OverflowBytes	= 0;
+};
+
+//Persistently mapped staging memory that is handed out linearly and wraps around. Every allocation belongs to a range
+//that is retired when the fence of the command buffer that recorded the copy has been waited on. Ranges are retired
+//out of order, but the space is only reused once all ranges before it are retired as well
+class UploadRingVK
+{
+public:
+	UploadRingVK(DeviceVK* pDevice);
+	~UploadRingVK();
+
+	DECL_NO_COPY(UploadRingVK);
+
+	bool init(VkDeviceSize sizeInBytes);
+
+	//Returns false when the ring is full or the upload is larger than the ring, the caller has to use a buffer of its own then.
+	//When range is the last one that was handed out it is grown, otherwise it is set to a new range
+	bool allocate(UploadAllocationVK& allocation, uint64_t& range, VkDeviceSize sizeInBytes);
+	void retire(uint64_t range);
+
+	//Uploads that went past the ring, only kept for the statistics
+	void addOverflow(VkDeviceSize sizeInBytes);
+
+	UploadRingStatistics getStatistics();
+
+private:
+	DeviceVK* m_pDevice;
+	BufferVK* m_pBuffer;
+	uint8_t* m_pHostMemory;
+	VkDeviceSize m_SizeInBytes;
+	VkDeviceSize m_Alignment;
+
+	//Positions are never wrapped, the offset in the buffer is the position modulo the size
+	uint64_t m_Head;
+	uint64_t m_Tail;
+	uint64_t m_RangeEnds[UPLOAD_RING_MAX_RANGES];
+	bool m_IsRetired[UPLOAD_RING_MAX_RANGES];
+	uint64_t m_FirstRange;
+	uint64_t m_NextRange;
+
+	VkDeviceSize m_PeakBytes;
+	uint32_t m_OverflowCount;
+	VkDeviceSize m_OverflowBytes;
+
+	Spinlock m_Lock;
+};
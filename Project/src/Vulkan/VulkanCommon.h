@@ -8,6 +8,38 @@
 
 #include <vulkan/vulkan.h>
 
+//What a buffer or an image is used for, the device allocator keeps the current and peak bytes of each category
+enum class EMemoryCategory : uint32_t
+{
+    UNKNOWN         = 0,
+    RENDER_TARGETS  = 1,
+    TEXTURES        = 2,
+    MESHES          = 3,
+    RAY_TRACING     = 4,
+    SCENE_DATA      = 5,
+    UNIFORM_BUFFERS = 6,
+    STAGING         = 7,
+    IMGUI           = 8
+};
+
+#define MEMORY_CATEGORY_COUNT 9U
+
+inline const char* memoryCategoryAsString(EMemoryCategory category)
+{
+    switch (category)
+    {
+    case EMemoryCategory::RENDER_TARGETS:   return "Render Targets";
+    case EMemoryCategory::TEXTURES:         return "Textures";
+    case EMemoryCategory::MESHES:           return "Meshes";
+    case EMemoryCategory::RAY_TRACING:      return "Ray Tracing";
+    case EMemoryCategory::SCENE_DATA:       return "Scene Data";
+    case EMemoryCategory::UNIFORM_BUFFERS:  return "Uniform Buffers";
+    case EMemoryCategory::STAGING:          return "Staging";
+    case EMemoryCategory::IMGUI:            return "ImGui";
+    default: return "Unknown";
+    }
+}
+
 inline VkImageMemoryBarrier createVkImageMemoryBarrier(VkImage image, VkAccessFlags srcAccessMask, VkAccessFlags dstAccessMask, uint32_t srcQueueFamilyIndex,
     uint32_t dstQueueFamilyIndex, VkImageLayout oldLayout, VkImageLayout newLayout, VkImageAspectFlags aspectMask, uint32_t baseLayer, uint32_t baseMiplevel, uint32_t layerCount, uint32_t miplevelCount)
 {
@@ -1,18 +1,88 @@
 #include "Common/Debug.h"
 #include "Core/Application.h"
+#include "Core/AllocationCounter.h"
+#include "Core/TimelineTracer.h"
+#include "Core/SceneLoadBenchmark.h"
+#include "Core/TaskDispatcherBenchmark.h"
+
+#include <cstdlib>
+#include <cstring>
 
 int main(int argc, const char* argv[])
 {
-	UNREFERENCED_PARAMETER(argc);
-	UNREFERENCED_PARAMETER(argv);
-
 #if defined(_DEBUG) && defined(_WIN32)
 	_CrtSetDbgFlag (_CRTDBG_ALLOC_MEM_DF | _CRTDBG_LEAK_CHECK_DF);
 #endif
 
+	bool checkFrameAllocations = false;
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "--benchmark-tasks") == 0)
+		{
+			TaskDispatcherBenchmark::run("Results/benchmark_tasks.tsv");
+			return 0;
+		}
+		else if (strcmp(argv[i], "--benchmark-parallel-for") == 0)
+		{
+			TaskDispatcherBenchmark::runParallelFor("Results/benchmark_parallel_for.tsv");
+			return 0;
+		}
+		else if (strcmp(argv[i], "--check-task-allocations") == 0)
+		{
+			return TaskDispatcherBenchmark::checkFrameAllocations() ? 0 : EXIT_FAILURE;
+		}
+		else if (strcmp(argv[i], "--benchmark-scene-load") == 0)
+		{
+			SceneLoadBenchmark::run("assets/sponza/", "sponza.obj", "Results/benchmark_scene_load.tsv");
+			return 0;
+		}
+		else if (strcmp(argv[i], "--benchmark-vertex-dedup") == 0)
+		{
+			SceneLoadBenchmark::runVertexDeduplication({ "assets/sponza/sponza.obj", "assets/meshes/gun.obj" }, "Results/benchmark_vertex_dedup.tsv");
+			return 0;
+		}
+		else if (strcmp(argv[i], "--benchmark-vertex-cache") == 0)
+		{
+			SceneLoadBenchmark::runVertexCache({ "assets/sponza/sponza.obj", "assets/meshes/gun.obj" }, "Results/benchmark_vertex_cache.tsv");
+			return 0;
+		}
+		else if (strcmp(argv[i], "--check-frame-allocations") == 0)
+		{
+			//Renders a fixed number of frames and exits with a failure if recording any of them allocated from the heap
+			checkFrameAllocations = true;
+		}
+		else if (strcmp(argv[i], "--trace") == 0)
+		{
+			//Records the job system and GPU timeline, dumped with F5 and at exit
+			TimelineTracer::setEnabled(true);
+		}
+	}
+
+#if !TRACK_ALLOCATIONS
+	if (checkFrameAllocations)
+	{
+		LOG("--- Frame allocation check: Needs a build with TRACK_ALLOCATIONS");
+		return EXIT_FAILURE;
+	}
+#else
+	if (checkFrameAllocations && !AllocationCounter::verifyCounting())
+	{
+		LOG("--- Frame allocation check: FAILED, not every allocation is counted");
+		return EXIT_FAILURE;
+	}
+#endif
+
 	Application app;
 	app.init();
+	if (checkFrameAllocations)
+	{
+		//A second of warmup lets the pools and arenas grow for the frames in flight
+		app.enableFrameAllocationCheck(60, 1000);
+	}
+
 	app.run();
+
+	const bool failed = checkFrameAllocations && !app.hasPassedFrameAllocationCheck();
 	app.release();
-	return 0;
+	return failed ? EXIT_FAILURE : 0;
 }